@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_BENCH_H_
+#define _UTK_BENCH_H_
+
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * bench.h - helpers shared by the benchmarks
+ *
+ * Benchmarks aren't run by "make check", build and run them with:
+ *
+ *  $ ./configure CFLAGS=-O2
+ *  $ make bench
+ *  $ ./bench/bench_foo
+ */
+
+/**
+ * Monotonic time in seconds
+ */
+static inline double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Print a result line
+ */
+#define BENCH_PRINT(fmt, ...)			\
+    printf("%-40s " fmt "\n", __func__, ##__VA_ARGS__)
+
+#endif
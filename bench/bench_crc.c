@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/crc.h>
+#include <utk/array.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+/**
+ * Throughput of utk_crc32c() for small, medium and big buffers.
+ *
+ * Usage: bench_crc
+ */
+
+static void bench_crc32c(const unsigned char *buf, size_t len)
+{
+    size_t total,
+	n,
+	i;
+    uint32_t crc;
+    double start,
+	elapsed;
+
+    /* about 4GB of data per size */
+    n = (size_t)4 * 1024 * 1024 * 1024 / len;
+
+    crc = 0;
+    start = bench_now();
+    for(i = 0; i < n; ++i)
+    {
+	crc = utk_crc32c(crc, buf, len);
+    }
+    elapsed = bench_now() - start;
+    total = n * len;
+
+    BENCH_PRINT("%8zu bytes: %6.2f GB/s (crc %08x)",
+		len, (double)total / elapsed / 1e9, crc);
+}
+
+int main(void)
+{
+    const size_t lens[] = { 64, 4096, 1024 * 1024 };
+    unsigned char *buf = NULL;
+    size_t i;
+
+    buf = malloc(1024 * 1024);
+    if(buf == NULL)
+    {
+	perror("malloc");
+	return 1;
+    }
+
+    for(i = 0; i < 1024 * 1024; ++i)
+    {
+	buf[i] = (unsigned char)(i * 7);
+    }
+
+    printf("implementation: %s\n", utk_crc32c_implementation());
+
+    for(i = 0; i < UTK_ARRAY_SIZE(lens); ++i)
+    {
+	bench_crc32c(buf, lens[i]);
+    }
+
+    free(buf);
+
+    return 0;
+}
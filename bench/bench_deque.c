@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/deque.h>
+#include <utk/list.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Fill and walk 10M integers in an utk_deque and in an utk_list_head list
+ * of allocated nodes, in allocation order and after the nodes were
+ * shuffled (the order of a long lived list).
+ *
+ * Usage: bench_deque [integers]
+ *
+ * - Default is 10M integers.
+ */
+
+struct bench_deque_node {
+    struct utk_list_head list;
+    int value;
+};
+
+static void bench_deque(size_t nb)
+{
+    struct utk_deque dq;
+    struct utk_deque_iter it;
+    int *pos = NULL;
+    int *elem = NULL;
+    int64_t sum = 0;
+    double start,
+	fill,
+	walk;
+    size_t i;
+
+    utk_deque_init(&dq, sizeof(int), 0);
+
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	elem = utk_deque_push_back(&dq);
+	if(elem == NULL)
+	{
+	    perror("utk_deque_push_back");
+	    exit(1);
+	}
+	*elem = (int)i;
+    }
+    fill = bench_now() - start;
+
+    start = bench_now();
+    utk_deque_for_each(pos, it, &dq)
+    {
+	sum += *pos;
+    }
+    walk = bench_now() - start;
+
+    BENCH_PRINT("fill %6.1f ns/int, walk %5.2f ns/int [%lld]",
+		fill * 1e9 / (double)nb, walk * 1e9 / (double)nb,
+		(long long)sum);
+
+    start = bench_now();
+    while(utk_deque_pop_front(&dq, NULL) == 0)
+    {
+    }
+    BENCH_PRINT("pop  %6.1f ns/int",
+		(bench_now() - start) * 1e9 / (double)nb);
+
+    utk_deque_cleanup(&dq);
+}
+
+static double bench_deque_list_walk(struct utk_list_head *head, size_t nb)
+{
+    struct bench_deque_node *pos = NULL;
+    int64_t sum = 0;
+    double start;
+
+    start = bench_now();
+    utk_list_for_each_entry(pos, head, list)
+    {
+	sum += pos->value;
+    }
+
+    if(sum != (int64_t)nb * (int64_t)(nb - 1) / 2)
+    {
+	fprintf(stderr, "bad sum\n");
+	exit(1);
+    }
+
+    return (bench_now() - start) * 1e9 / (double)nb;
+}
+
+static void bench_deque_list(size_t nb)
+{
+    UTK_LIST_HEAD(head);
+    struct bench_deque_node **nodes = NULL;
+    struct bench_deque_node *tmp = NULL;
+    unsigned int seed = 42;
+    double start,
+	fill,
+	walk;
+    size_t i,
+	j;
+
+    nodes = malloc(nb * sizeof(*nodes));
+    if(nodes == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	nodes[i] = malloc(sizeof(**nodes));
+	if(nodes[i] == NULL)
+	{
+	    perror("malloc");
+	    exit(1);
+	}
+	nodes[i]->value = (int)i;
+	utk_list_add_tail(&nodes[i]->list, &head);
+    }
+    fill = bench_now() - start;
+    walk = bench_deque_list_walk(&head, nb);
+    BENCH_PRINT("fill %6.1f ns/int, walk %5.2f ns/int (allocation order)",
+		fill * 1e9 / (double)nb, walk);
+
+    /* relink in random order */
+    for(i = nb - 1; i > 0; --i)
+    {
+	seed = seed * 1103515245 + 12345;
+	j = ((size_t)seed << 8 ^ seed >> 8) % (i + 1);
+	tmp = nodes[i];
+	nodes[i] = nodes[j];
+	nodes[j] = tmp;
+    }
+    utk_list_head_init(&head);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_list_add_tail(&nodes[i]->list, &head);
+    }
+    walk = bench_deque_list_walk(&head, nb);
+    BENCH_PRINT("                 walk %5.2f ns/int (shuffled)", walk);
+
+    for(i = 0; i < nb; ++i)
+    {
+	free(nodes[i]);
+    }
+    free(nodes);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t nb = 10000000;
+
+    if(argc > 1)
+    {
+	nb = strtoul(argv[1], NULL, 10);
+    }
+
+    bench_deque(nb);
+    bench_deque_list(nb);
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/ev.h>
+#include <utk/io.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "bench.h"
+
+/**
+ * Cost of an event loop iteration with a few active descriptors among
+ * thousands of registered socketpairs, utk_ev (epoll) against poll(2).
+ *
+ * Usage: bench_ev [active]
+ *
+ * - active is the number of sockets written before each iteration
+ *   (default 10).
+ */
+
+#define BENCH_EV_ITERATIONS 20000
+
+struct bench_ev_conn {
+    struct utk_ev_io io;
+    int peer;
+};
+
+static unsigned int bench_seed = 1;
+
+static unsigned int bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+
+    return bench_seed >> 8;
+}
+
+static void bench_ev_read_cb(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			     int events)
+{
+    char buf[64];
+
+    (void)loop;
+    (void)events;
+
+    while(utk_io_read_nonblock(io->fd, buf, sizeof(buf)) > 0)
+    {
+    }
+}
+
+static struct bench_ev_conn *bench_ev_open(unsigned int nb_conns)
+{
+    struct bench_ev_conn *conns = NULL;
+    unsigned int i;
+    int fds[2];
+
+    conns = calloc(nb_conns, sizeof(*conns));
+    if(conns == NULL)
+    {
+	perror("calloc");
+	exit(1);
+    }
+
+    for(i = 0; i < nb_conns; ++i)
+    {
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+	    perror("socketpair");
+	    exit(1);
+	}
+	utk_io_set_nonblock(fds[0], 1);
+	conns[i].io.fd = fds[0];
+	conns[i].peer = fds[1];
+    }
+
+    return conns;
+}
+
+static void bench_ev_close(struct bench_ev_conn *conns, unsigned int nb_conns)
+{
+    unsigned int i;
+
+    for(i = 0; i < nb_conns; ++i)
+    {
+	close(conns[i].io.fd);
+	close(conns[i].peer);
+    }
+    free(conns);
+}
+
+static void bench_ev_epoll(unsigned int nb_conns, unsigned int active)
+{
+    struct bench_ev_conn *conns = NULL;
+    struct utk_ev_loop loop;
+    unsigned int i,
+	j;
+    double start,
+	elapsed;
+
+    conns = bench_ev_open(nb_conns);
+    if(utk_ev_loop_init(&loop, 0) != 0)
+    {
+	perror("utk_ev_loop_init");
+	exit(1);
+    }
+    for(i = 0; i < nb_conns; ++i)
+    {
+	utk_ev_io_start(&loop, &conns[i].io, conns[i].io.fd, UTK_EV_READ,
+			bench_ev_read_cb);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_EV_ITERATIONS; ++i)
+    {
+	for(j = 0; j < active; ++j)
+	{
+	    utk_io_write(conns[bench_rand() % nb_conns].peer, "x", 1);
+	}
+	utk_ev_run_once(&loop, -1);
+    }
+    elapsed = bench_now() - start;
+
+    BENCH_PRINT("%6u fds: %8.2f us/iteration", nb_conns,
+		elapsed / BENCH_EV_ITERATIONS * 1e6);
+
+    utk_ev_loop_cleanup(&loop);
+    bench_ev_close(conns, nb_conns);
+}
+
+static void bench_ev_poll(unsigned int nb_conns, unsigned int active)
+{
+    struct bench_ev_conn *conns = NULL;
+    struct pollfd *pfds = NULL;
+    unsigned int i,
+	j;
+    double start,
+	elapsed;
+
+    conns = bench_ev_open(nb_conns);
+    pfds = calloc(nb_conns, sizeof(*pfds));
+    if(pfds == NULL)
+    {
+	perror("calloc");
+	exit(1);
+    }
+    for(i = 0; i < nb_conns; ++i)
+    {
+	pfds[i].fd = conns[i].io.fd;
+	pfds[i].events = POLLIN;
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_EV_ITERATIONS; ++i)
+    {
+	for(j = 0; j < active; ++j)
+	{
+	    utk_io_write(conns[bench_rand() % nb_conns].peer, "x", 1);
+	}
+
+	if(poll(pfds, nb_conns, -1) < 0)
+	{
+	    perror("poll");
+	    exit(1);
+	}
+	for(j = 0; j < nb_conns; ++j)
+	{
+	    if(pfds[j].revents != 0)
+	    {
+		bench_ev_read_cb(NULL, &conns[j].io, 0);
+	    }
+	}
+    }
+    elapsed = bench_now() - start;
+
+    BENCH_PRINT("%6u fds: %8.2f us/iteration", nb_conns,
+		elapsed / BENCH_EV_ITERATIONS * 1e6);
+
+    free(pfds);
+    bench_ev_close(conns, nb_conns);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int sizes[] = { 100, 1000, 4000, 8000 };
+    unsigned int active = 10,
+	max_conns,
+	i;
+    struct rlimit rl;
+
+    if(argc > 1)
+    {
+	active = (unsigned int)strtoul(argv[1], NULL, 10);
+    }
+
+    /* 2 descriptors per socketpair */
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    max_conns = (unsigned int)((rl.rlim_cur - 16) / 2);
+
+    printf("%u active sockets per iteration\n", active);
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+	if(sizes[i] > max_conns || active > sizes[i])
+	{
+	    continue;
+	}
+	bench_ev_epoll(sizes[i], active);
+	bench_ev_poll(sizes[i], active);
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/heap.h>
+#include <utk/list.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Priority queues holding 100K entries: "hold" operations (pop the top
+ * and push it back with a later key) and decrease-key, with an
+ * utk_heap, an utk_pheap and a sorted list.
+ *
+ * Usage: bench_heap [entries]
+ *
+ * - Default is 100K entries.
+ */
+
+#define BENCH_HEAP_NB_OPS 1000000
+#define BENCH_HEAP_NB_LIST_OPS 2000
+
+struct bench_heap_item {
+    struct utk_heap_node hnode;
+    struct utk_pheap_node pnode;
+    struct utk_list_head list;
+    uint64_t key;
+};
+
+static int bench_heap_cmp(const struct utk_heap_node *a,
+			  const struct utk_heap_node *b)
+{
+    uint64_t ka = utk_heap_entry(a, const struct bench_heap_item,
+				 hnode)->key;
+    uint64_t kb = utk_heap_entry(b, const struct bench_heap_item,
+				 hnode)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static int bench_pheap_cmp(const struct utk_pheap_node *a,
+			   const struct utk_pheap_node *b)
+{
+    uint64_t ka = utk_pheap_entry(a, const struct bench_heap_item,
+				  pnode)->key;
+    uint64_t kb = utk_pheap_entry(b, const struct bench_heap_item,
+				  pnode)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Pseudo random numbers (xorshift)
+ */
+static uint64_t bench_heap_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void bench_heap_fill(struct bench_heap_item *items, size_t nb)
+{
+    uint64_t state = 88172645463325252ULL;
+    size_t i;
+
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].hnode.index = 0;
+	items[i].key = bench_heap_rand(&state) % (nb * 16);
+    }
+}
+
+static void bench_heap_dary(struct bench_heap_item *items, size_t nb,
+			    size_t arity)
+{
+    struct utk_heap heap;
+    struct bench_heap_item *item = NULL;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    double start,
+	hold,
+	decrease;
+    size_t i;
+
+    bench_heap_fill(items, nb);
+    utk_heap_init(&heap, arity, bench_heap_cmp);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_heap_push(&heap, &items[i].hnode);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HEAP_NB_OPS; ++i)
+    {
+	item = utk_heap_entry(utk_heap_pop(&heap), struct bench_heap_item,
+			      hnode);
+	item->key += bench_heap_rand(&state) % (nb * 16);
+	utk_heap_push(&heap, &item->hnode);
+    }
+    hold = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HEAP_NB_OPS; ++i)
+    {
+	item = &items[bench_heap_rand(&state) % nb];
+	item->key -= item->key / 4;
+	utk_heap_update(&heap, &item->hnode);
+    }
+    decrease = bench_now() - start;
+
+    BENCH_PRINT("%zu-ary, %zu entries: hold %6.1f ns, decrease %6.1f ns",
+		arity, nb, hold * 1e9 / BENCH_HEAP_NB_OPS,
+		decrease * 1e9 / BENCH_HEAP_NB_OPS);
+
+    utk_heap_cleanup(&heap);
+}
+
+static void bench_heap_pairing(struct bench_heap_item *items, size_t nb)
+{
+    struct utk_pheap heap;
+    struct bench_heap_item *item = NULL;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    double start,
+	hold,
+	decrease;
+    size_t i;
+
+    bench_heap_fill(items, nb);
+    utk_pheap_init(&heap, bench_pheap_cmp);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_pheap_push(&heap, &items[i].pnode);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HEAP_NB_OPS; ++i)
+    {
+	item = utk_pheap_entry(utk_pheap_pop(&heap), struct bench_heap_item,
+			       pnode);
+	item->key += bench_heap_rand(&state) % (nb * 16);
+	utk_pheap_push(&heap, &item->pnode);
+    }
+    hold = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HEAP_NB_OPS; ++i)
+    {
+	item = &items[bench_heap_rand(&state) % nb];
+	item->key -= item->key / 4;
+	utk_pheap_decrease(&heap, &item->pnode);
+    }
+    decrease = bench_now() - start;
+
+    BENCH_PRINT("%zu entries: hold %6.1f ns, decrease %6.1f ns",
+		nb, hold * 1e9 / BENCH_HEAP_NB_OPS,
+		decrease * 1e9 / BENCH_HEAP_NB_OPS);
+}
+
+/*
+ * Sorted insertion: the way it is done without a heap
+ */
+static void bench_heap_list_insert(struct utk_list_head *head,
+				   struct bench_heap_item *item)
+{
+    struct bench_heap_item *pos = NULL;
+
+    utk_list_for_each_entry(pos, head, list)
+    {
+	if(pos->key > item->key)
+	{
+	    break;
+	}
+    }
+    utk_list_add_tail(&item->list, &pos->list);
+}
+
+static void bench_heap_list(struct bench_heap_item *items, size_t nb)
+{
+    UTK_LIST_HEAD(head);
+    struct bench_heap_item *item = NULL;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    double start;
+    size_t i;
+
+    /* sorted fill without the O(n^2) insertions */
+    bench_heap_fill(items, nb);
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = i * 16;
+	utk_list_add_tail(&items[i].list, &head);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HEAP_NB_LIST_OPS; ++i)
+    {
+	item = utk_list_entry(head.next, struct bench_heap_item, list);
+	utk_list_del(&item->list);
+	item->key += bench_heap_rand(&state) % (nb * 16);
+	bench_heap_list_insert(&head, item);
+    }
+
+    BENCH_PRINT("%zu entries: hold %6.1f ns",
+		nb, (bench_now() - start) * 1e9 / BENCH_HEAP_NB_LIST_OPS);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_heap_item *items = NULL;
+    size_t nb = 100000;
+
+    if(argc > 1)
+    {
+	nb = strtoul(argv[1], NULL, 10);
+    }
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL || nb == 0)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    bench_heap_dary(items, nb, 2);
+    bench_heap_dary(items, nb, 4);
+    bench_heap_dary(items, nb, 8);
+    bench_heap_pairing(items, nb);
+    bench_heap_list(items, nb);
+
+    free(items);
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/hmap.h>
+#include <utk/htable.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Insertions, hits and misses with 64 bits keys in an UTK_HMAP_DEFINE()
+ * map (open addressing) and in an utk_htable (chained, one allocation per
+ * entry).
+ *
+ * Usage: bench_hmap [max entries]
+ *
+ * - Default max entries is 10M.
+ */
+
+#define BENCH_HMAP_NB_LOOKUPS 10000000
+
+UTK_HMAP_DEFINE(bench_map, uint64_t, uint64_t, utk_hmap_hash_u64, UTK_HMAP_EQ)
+
+struct bench_hmap_item {
+    struct utk_htable_node node;
+    uint64_t key;
+    uint64_t val;
+};
+
+static size_t bench_hmap_hash(const void *key)
+{
+    return utk_htable_hash_u64(*(const uint64_t *)key);
+}
+
+static int bench_hmap_cmp(const struct utk_htable_node *node,
+			  const void *key)
+{
+    const struct bench_hmap_item *item =
+	utk_htable_entry(node, const struct bench_hmap_item, node);
+
+    return item->key != *(const uint64_t *)key;
+}
+
+/*
+ * Pseudo random keys (xorshift)
+ */
+static uint64_t bench_hmap_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void bench_hmap_open(const uint64_t *keys, size_t nb)
+{
+    struct bench_map map;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint64_t sum = 0;
+    uint64_t *val = NULL;
+    double start,
+	insert,
+	hit,
+	miss;
+    size_t i;
+
+    if(bench_map_init(&map, 0, 0) != 0)
+    {
+	perror("bench_map_init");
+	exit(1);
+    }
+
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	bench_map_put(&map, keys[i], i);
+    }
+    insert = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HMAP_NB_LOOKUPS; ++i)
+    {
+	val = bench_map_get(&map, keys[bench_hmap_rand(&state) % nb]);
+	sum += *val;
+    }
+    hit = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HMAP_NB_LOOKUPS; ++i)
+    {
+	/* keys are odd */
+	sum += bench_map_get(&map, bench_hmap_rand(&state) << 1) != NULL;
+    }
+    miss = bench_now() - start;
+
+    BENCH_PRINT("%9zu entries: insert %6.1f ns hit %6.1f ns "
+		"miss %6.1f ns (%zu bytes/entry) [%llu]",
+		nb, insert * 1e9 / (double)nb,
+		hit * 1e9 / BENCH_HMAP_NB_LOOKUPS,
+		miss * 1e9 / BENCH_HMAP_NB_LOOKUPS,
+		(map.mask + 1) * (sizeof(*map.slots) + 1) / nb,
+		(unsigned long long)(sum & 0xff));
+
+    bench_map_cleanup(&map);
+}
+
+static void bench_hmap_chained(const uint64_t *keys, size_t nb)
+{
+    struct utk_htable ht;
+    struct bench_hmap_item *items = NULL;
+    struct bench_hmap_item *item = NULL;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint64_t sum = 0;
+    uint64_t key;
+    double start,
+	insert,
+	hit,
+	miss;
+    size_t i;
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL || utk_htable_init(&ht, 0, bench_hmap_hash,
+					bench_hmap_cmp) != 0)
+    {
+	perror("bench_hmap_chained");
+	exit(1);
+    }
+
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = keys[i];
+	items[i].val = i;
+	utk_htable_add(&ht, &items[i].node, &items[i].key);
+    }
+    insert = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HMAP_NB_LOOKUPS; ++i)
+    {
+	key = keys[bench_hmap_rand(&state) % nb];
+	item = utk_htable_entry(utk_htable_find(&ht, &key),
+				struct bench_hmap_item, node);
+	sum += item->val;
+    }
+    hit = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < BENCH_HMAP_NB_LOOKUPS; ++i)
+    {
+	key = bench_hmap_rand(&state) << 1;
+	sum += utk_htable_find(&ht, &key) != NULL;
+    }
+    miss = bench_now() - start;
+
+    BENCH_PRINT("%9zu entries: insert %6.1f ns hit %6.1f ns "
+		"miss %6.1f ns (%zu bytes/entry) [%llu]",
+		nb, insert * 1e9 / (double)nb,
+		hit * 1e9 / BENCH_HMAP_NB_LOOKUPS,
+		miss * 1e9 / BENCH_HMAP_NB_LOOKUPS,
+		sizeof(*items) + (ht.mask[0] + 1) * sizeof(*ht.buckets[0]) / nb,
+		(unsigned long long)(sum & 0xff));
+
+    utk_htable_cleanup(&ht);
+    free(items);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t state = 88172645463325252ULL;
+    uint64_t *keys = NULL;
+    size_t max = 10000000,
+	nb,
+	i;
+
+    if(argc > 1)
+    {
+	max = strtoul(argv[1], NULL, 10);
+    }
+
+    keys = malloc(max * sizeof(*keys));
+    if(keys == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+    for(i = 0; i < max; ++i)
+    {
+	keys[i] = bench_hmap_rand(&state) | 1;
+    }
+
+    for(nb = 1000; nb <= max; nb *= 10)
+    {
+	bench_hmap_open(keys, nb);
+	bench_hmap_chained(keys, nb);
+    }
+
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/htable.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Lookups in an utk_htable with 64 bits keys from 1K to 10M entries, the
+ * worst insertion time (growths are incremental) and lookups in a list
+ * for comparison.
+ *
+ * Usage: bench_htable [max entries]
+ *
+ * - Default max entries is 10M.
+ */
+
+#define BENCH_HTABLE_NB_LOOKUPS 10000000
+
+struct bench_htable_item {
+    struct utk_htable_node node;
+    struct utk_list_head list;
+    uint64_t key;
+};
+
+static size_t bench_htable_hash(const void *key)
+{
+    return utk_htable_hash_u64(*(const uint64_t *)key);
+}
+
+static int bench_htable_cmp(const struct utk_htable_node *node,
+			    const void *key)
+{
+    const struct bench_htable_item *item =
+	utk_htable_entry(node, const struct bench_htable_item, node);
+
+    return item->key != *(const uint64_t *)key;
+}
+
+/*
+ * Pseudo random keys (xorshift)
+ */
+static uint64_t bench_htable_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void bench_htable_lookup(size_t nb)
+{
+    struct utk_htable ht;
+    struct bench_htable_item *items = NULL;
+    struct utk_htable_node *node = NULL;
+    double start,
+	insert,
+	worst,
+	t;
+    uint64_t state = 88172645463325252ULL;
+    uint64_t key;
+    size_t found = 0,
+	i;
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL || utk_htable_init(&ht, 0, bench_htable_hash,
+					bench_htable_cmp) != 0)
+    {
+	perror("bench_htable_lookup");
+	exit(1);
+    }
+
+    worst = 0;
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = bench_htable_rand(&state);
+	t = bench_now();
+	utk_htable_add(&ht, &items[i].node, &items[i].key);
+	t = bench_now() - t;
+	if(t > worst)
+	{
+	    worst = t;
+	}
+    }
+    insert = bench_now() - start;
+
+    state = 0x9e3779b97f4a7c15ULL;
+    start = bench_now();
+    for(i = 0; i < BENCH_HTABLE_NB_LOOKUPS; ++i)
+    {
+	key = items[bench_htable_rand(&state) % nb].key;
+	node = utk_htable_find(&ht, &key);
+	found += node != NULL;
+    }
+    t = bench_now() - start;
+
+    BENCH_PRINT("%9zu entries: insert %6.1f ns (worst %6.1f us) "
+		"lookup %6.1f ns",
+		nb, insert * 1e9 / (double)nb, worst * 1e6,
+		t * 1e9 / BENCH_HTABLE_NB_LOOKUPS);
+    if(found != BENCH_HTABLE_NB_LOOKUPS)
+    {
+	fprintf(stderr, "missing entries\n");
+	exit(1);
+    }
+
+    utk_htable_cleanup(&ht);
+    free(items);
+}
+
+static void bench_htable_list(size_t nb)
+{
+    struct bench_htable_item *items = NULL;
+    struct bench_htable_item *pos = NULL;
+    UTK_LIST_HEAD(list);
+    double start,
+	t;
+    uint64_t state = 88172645463325252ULL;
+    uint64_t key;
+    size_t nb_lookups = BENCH_HTABLE_NB_LOOKUPS / 100,
+	found = 0,
+	i;
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL)
+    {
+	perror("bench_htable_list");
+	exit(1);
+    }
+
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = bench_htable_rand(&state);
+	utk_list_add_tail(&items[i].list, &list);
+    }
+
+    state = 0x9e3779b97f4a7c15ULL;
+    start = bench_now();
+    for(i = 0; i < nb_lookups; ++i)
+    {
+	key = items[bench_htable_rand(&state) % nb].key;
+	utk_list_for_each_entry(pos, &list, list)
+	{
+	    if(pos->key == key)
+	    {
+		found++;
+		break;
+	    }
+	}
+    }
+    t = bench_now() - start;
+
+    BENCH_PRINT("%9zu entries: lookup %6.1f ns",
+		nb, t * 1e9 / (double)nb_lookups);
+    if(found != nb_lookups)
+    {
+	fprintf(stderr, "missing entries\n");
+	exit(1);
+    }
+
+    free(items);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max = 10000000,
+	nb;
+
+    if(argc > 1)
+    {
+	max = strtoul(argv[1], NULL, 10);
+    }
+
+    for(nb = 1000; nb <= max; nb *= 10)
+    {
+	bench_htable_lookup(nb);
+    }
+    bench_htable_list(1000);
+
+    return 0;
+}
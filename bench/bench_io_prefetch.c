@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/io.h>
+#include <utk/crc.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench.h"
+
+/**
+ * Read a file with cold page cache with a utk_io_read() loop then with
+ * utk_io_prefetch, the consumer computing the CRC-32C of each chunk.
+ *
+ * Usage: bench_io_prefetch [file] [size in MiB]
+ *
+ * - Pages of the file are dropped (posix_fadvise(DONTNEED)) before each
+ *   run so reads hit the device, put the file on the device to measure.
+ */
+
+#define BENCH_CHUNK (1024 * 1024)
+
+static void drop_cache(const char *filename)
+{
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if(fd >= 0)
+    {
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+    }
+}
+
+static void bench_read_loop(const char *filename)
+{
+    unsigned char *buf = NULL;
+    uint32_t crc = 0;
+    size_t total = 0;
+    double start;
+    ssize_t cc;
+    int fd;
+
+    buf = malloc(BENCH_CHUNK);
+    if(buf == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    drop_cache(filename);
+
+    start = bench_now();
+    fd = open(filename, O_RDONLY);
+    while((cc = utk_io_read(fd, buf, BENCH_CHUNK)) > 0)
+    {
+	crc = utk_crc32c(crc, buf, (size_t)cc);
+	total += (size_t)cc;
+    }
+    close(fd);
+
+    BENCH_PRINT("utk_io_read loop:     %8.2f MB/s (crc %08x)",
+		(double)total / (bench_now() - start) / 1e6, crc);
+
+    free(buf);
+}
+
+static void bench_prefetch(const char *filename, unsigned int nb_chunks)
+{
+    struct utk_io_prefetch pf;
+    const void *chunk = NULL;
+    uint32_t crc = 0;
+    size_t total = 0;
+    double start;
+    ssize_t cc;
+    int fd;
+
+    drop_cache(filename);
+
+    start = bench_now();
+    fd = open(filename, O_RDONLY);
+    if(utk_io_prefetch_open(&pf, fd, nb_chunks, BENCH_CHUNK, 0) != 0)
+    {
+	perror("utk_io_prefetch_open");
+	exit(1);
+    }
+    while((cc = utk_io_prefetch_next(&pf, &chunk)) > 0)
+    {
+	crc = utk_crc32c(crc, chunk, (size_t)cc);
+	total += (size_t)cc;
+    }
+    utk_io_prefetch_close(&pf);
+    close(fd);
+
+    BENCH_PRINT("prefetch %u chunks:    %8.2f MB/s (crc %08x)", nb_chunks,
+		(double)total / (bench_now() - start) / 1e6, crc);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filename = "/tmp/bench_io_prefetch";
+    size_t len = 1024,
+	i;
+    char *buf = NULL;
+
+    if(argc > 1)
+    {
+	filename = argv[1];
+    }
+    if(argc > 2)
+    {
+	len = strtoul(argv[2], NULL, 10);
+    }
+    len *= 1024 * 1024;
+
+    buf = malloc(len);
+    if(buf == NULL)
+    {
+	perror("malloc");
+	return 1;
+    }
+    for(i = 0; i < len; ++i)
+    {
+	buf[i] = (char)(i * 31 + (i >> 12));
+    }
+
+    unlink(filename);
+    if(utk_io_file_write(filename, buf, len) != (ssize_t)len)
+    {
+	perror("utk_io_file_write");
+	return 1;
+    }
+    free(buf);
+
+    printf("file %s, %zu MiB\n", filename, len / (1024 * 1024));
+
+    bench_read_loop(filename);
+    bench_prefetch(filename, 2);
+    bench_prefetch(filename, 3);
+
+    unlink(filename);
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/io.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench.h"
+
+/**
+ * Read a large file with utk_io_read() then with utk_io_file_read_parallel()
+ * and 1 to 32 threads.
+ *
+ * Usage: bench_io_read_parallel [file] [size in MiB]
+ *
+ * - Pages of the file are dropped (posix_fadvise(DONTNEED)) before each
+ *   run so reads hit the device, put the file on the device to measure.
+ */
+
+static void drop_cache(const char *filename)
+{
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if(fd >= 0)
+    {
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+    }
+}
+
+static void bench_sequential(const char *filename, char *dst, size_t len)
+{
+    double start;
+    ssize_t ret;
+    int fd;
+
+    drop_cache(filename);
+
+    start = bench_now();
+    fd = open(filename, O_RDONLY);
+    ret = utk_io_read(fd, dst, len);
+    close(fd);
+
+    BENCH_PRINT("utk_io_read:          %8.2f MB/s",
+		(double)ret / (bench_now() - start) / 1e6);
+}
+
+static void bench_parallel(const char *filename, char *dst, size_t len,
+			   unsigned int nb_threads)
+{
+    double start;
+    ssize_t ret;
+
+    drop_cache(filename);
+
+    start = bench_now();
+    ret = utk_io_file_read_parallel(filename, dst, len, nb_threads, 0,
+				    NULL, NULL);
+
+    BENCH_PRINT("%2u threads:           %8.2f MB/s",
+		nb_threads, (double)ret / (bench_now() - start) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filename = "/tmp/bench_io_read_parallel";
+    size_t len = 512;
+    char *buf = NULL;
+    unsigned int nb_threads;
+
+    if(argc > 1)
+    {
+	filename = argv[1];
+    }
+    if(argc > 2)
+    {
+	len = strtoul(argv[2], NULL, 10);
+    }
+    len *= 1024 * 1024;
+
+    buf = malloc(len);
+    if(buf == NULL)
+    {
+	perror("malloc");
+	return 1;
+    }
+    memset(buf, 'x', len);
+
+    unlink(filename);
+    if(utk_io_file_write(filename, buf, len) != (ssize_t)len)
+    {
+	perror("utk_io_file_write");
+	return 1;
+    }
+
+    printf("file %s, %zu MiB\n", filename, len / (1024 * 1024));
+
+    bench_sequential(filename, buf, len);
+    for(nb_threads = 1; nb_threads <= 32; nb_threads *= 2)
+    {
+	bench_parallel(filename, buf, len, nb_threads);
+    }
+
+    unlink(filename);
+    free(buf);
+
+    return 0;
+}
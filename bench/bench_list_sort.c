@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/list.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Sort of a list of random integers with utk_list_sort() and by copying
+ * the nodes to an array sorted with qsort() then relinked.
+ *
+ * Usage: bench_list_sort [nodes]
+ *
+ * - Default nodes is 1M.
+ */
+
+struct bench_list_item {
+    struct utk_list_head node;
+    unsigned int key;
+};
+
+static int bench_list_cmp(void *priv, const struct utk_list_head *a,
+			  const struct utk_list_head *b)
+{
+    unsigned int ka = utk_list_entry(a, const struct bench_list_item,
+				     node)->key;
+    unsigned int kb = utk_list_entry(b, const struct bench_list_item,
+				     node)->key;
+
+    (void)priv;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static int bench_list_qsort_cmp(const void *a, const void *b)
+{
+    unsigned int ka = (*(struct bench_list_item * const *)a)->key;
+    unsigned int kb = (*(struct bench_list_item * const *)b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Link the items in a random order (the nodes aren't contiguous in the
+ * list, like in a real program)
+ */
+static void bench_list_fill(struct utk_list_head *head,
+			    struct bench_list_item *items, size_t nb)
+{
+    unsigned int seed = 42;
+    size_t i,
+	j;
+
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = (unsigned int)i;
+    }
+    for(i = nb - 1; i > 0; --i)
+    {
+	seed = seed * 1103515245 + 12345;
+	j = ((size_t)seed << 8 ^ seed >> 8) % (i + 1);
+	items[i].key ^= items[j].key;
+	items[j].key ^= items[i].key;
+	items[i].key ^= items[j].key;
+    }
+
+    utk_list_head_init(head);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_list_add_tail(&items[(i * 7919) % nb].node, head);
+    }
+}
+
+static void bench_list_sort(struct bench_list_item *items, size_t nb)
+{
+    UTK_LIST_HEAD(head);
+    double start;
+
+    bench_list_fill(&head, items, nb);
+
+    start = bench_now();
+    utk_list_sort(NULL, &head, bench_list_cmp);
+
+    BENCH_PRINT("%zu nodes: %7.1f ms", nb, (bench_now() - start) * 1e3);
+}
+
+static void bench_list_qsort(struct bench_list_item *items, size_t nb)
+{
+    UTK_LIST_HEAD(head);
+    struct bench_list_item **array = NULL;
+    struct bench_list_item *pos = NULL;
+    double start;
+    size_t i = 0;
+
+    bench_list_fill(&head, items, nb);
+
+    start = bench_now();
+    array = malloc(nb * sizeof(*array));
+    if(array == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+    utk_list_for_each_entry(pos, &head, node)
+    {
+	array[i++] = pos;
+    }
+    qsort(array, nb, sizeof(*array), bench_list_qsort_cmp);
+    utk_list_head_init(&head);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_list_add_tail(&array[i]->node, &head);
+    }
+    free(array);
+
+    BENCH_PRINT("%zu nodes: %7.1f ms", nb, (bench_now() - start) * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_list_item *items = NULL;
+    size_t nb = 1000000;
+
+    if(argc > 1)
+    {
+	nb = strtoul(argv[1], NULL, 10);
+    }
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL || nb == 0)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    bench_list_sort(items, nb);
+    bench_list_qsort(items, nb);
+
+    free(items);
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/lz.h>
+#include <utk/io.h>
+#include <utk/array.h>
+#include <utk/math.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+/**
+ * Compression and decompression speed of utk_lz on 64KiB blocks.
+ *
+ * Usage: bench_lz [file]
+ *
+ * - Without file, a generated text-like sample of 64MiB is used.
+ */
+
+#define BENCH_LZ_BLOCK (64 * 1024)
+
+static void bench_lz(const unsigned char *src, size_t len)
+{
+    unsigned char *comp = NULL,
+	*dec = NULL;
+    size_t *clens = NULL,
+	nb_blocks,
+	block,
+	n,
+	total_comp;
+    double start,
+	comp_time,
+	dec_time;
+
+    nb_blocks = (len + BENCH_LZ_BLOCK - 1) / BENCH_LZ_BLOCK;
+    comp = malloc(nb_blocks * utk_lz_compress_bound(BENCH_LZ_BLOCK));
+    dec = malloc(len);
+    clens = malloc(nb_blocks * sizeof(*clens));
+    if(comp == NULL || dec == NULL || clens == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    /* fault pages in before timing */
+    memset(comp, 0, nb_blocks * utk_lz_compress_bound(BENCH_LZ_BLOCK));
+    memset(dec, 0, len);
+
+    total_comp = 0;
+    start = bench_now();
+    for(block = 0; block < nb_blocks; ++block)
+    {
+	n = (block == nb_blocks - 1 ? len - block * BENCH_LZ_BLOCK
+	     : BENCH_LZ_BLOCK);
+	clens[block] = (size_t)utk_lz_compress(
+	    src + block * BENCH_LZ_BLOCK, n,
+	    comp + block * utk_lz_compress_bound(BENCH_LZ_BLOCK),
+	    utk_lz_compress_bound(BENCH_LZ_BLOCK));
+	total_comp += clens[block];
+    }
+    comp_time = bench_now() - start;
+
+    start = bench_now();
+    for(block = 0; block < nb_blocks; ++block)
+    {
+	utk_lz_decompress(comp + block * utk_lz_compress_bound(BENCH_LZ_BLOCK),
+			  clens[block], dec + block * BENCH_LZ_BLOCK,
+			  BENCH_LZ_BLOCK);
+    }
+    dec_time = bench_now() - start;
+
+    if(memcmp(src, dec, len) != 0)
+    {
+	fprintf(stderr, "round trip failed\n");
+	exit(1);
+    }
+
+    BENCH_PRINT("ratio:      %6.3f", (double)len / (double)total_comp);
+    BENCH_PRINT("compress:   %8.1f MB/s", (double)len / comp_time / 1e6);
+    BENCH_PRINT("decompress: %8.1f MB/s", (double)len / dec_time / 1e6);
+
+    free(comp);
+    free(dec);
+    free(clens);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *words[] = {
+	"the ", "of ", "and ", "utk ", "toolkit ", "micro ", "list ",
+	"buffer ", "read ", "write ", "file ", "descriptor ", "\n",
+    };
+    const char *word = NULL;
+    unsigned char *src = NULL;
+    unsigned int seed = 1;
+    size_t len,
+	i,
+	n;
+    ssize_t ret;
+
+    if(argc > 1)
+    {
+	ret = utk_io_file_read_all(argv[1], (void **)&src, NULL);
+	if(ret < 0)
+	{
+	    perror("utk_io_file_read_all");
+	    return 1;
+	}
+	len = (size_t)ret;
+    }
+    else
+    {
+	len = 64 * 1024 * 1024;
+	src = malloc(len);
+	if(src == NULL)
+	{
+	    perror("malloc");
+	    return 1;
+	}
+
+	for(i = 0; i < len; i += n)
+	{
+	    seed = seed * 1103515245 + 12345;
+	    word = words[(seed >> 16) % UTK_ARRAY_SIZE(words)];
+	    n = utk_math_min(strlen(word), len - i);
+	    memcpy(src + i, word, n);
+	}
+    }
+
+    printf("%zu bytes\n", len);
+    bench_lz(src, len);
+
+    free(src);
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/mpsc.h>
+#include <utk/list.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "bench.h"
+
+/**
+ * Throughput of 1 to 32 producer threads posting preallocated work items
+ * to one consumer thread through an utk_mpsc_queue (consumer taking all
+ * the items at once) and through a mutex protected utk_list_head queue.
+ *
+ * Usage: bench_mpsc [items]
+ *
+ * - Default is 4M items per run, shared between the producers.
+ */
+
+#define BENCH_MPSC_MAX_PRODUCERS 32
+
+struct bench_mpsc_item {
+    struct utk_mpsc_node node;
+    struct utk_list_head list;
+    uint64_t value;
+};
+
+struct bench_mpsc_ctx {
+    struct utk_mpsc_queue queue;
+    pthread_mutex_t lock;
+    struct utk_list_head list;
+    struct bench_mpsc_item *items;
+    size_t nb;
+    size_t nb_producers;
+};
+
+struct bench_mpsc_producer {
+    struct bench_mpsc_ctx *ctx;
+    size_t first;
+    size_t last;
+};
+
+static void bench_die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static void *bench_mpsc_producer(void *arg)
+{
+    struct bench_mpsc_producer *producer = arg;
+    size_t i;
+
+    for(i = producer->first; i < producer->last; ++i)
+    {
+	utk_mpsc_push(&producer->ctx->queue, &producer->ctx->items[i].node);
+    }
+
+    return NULL;
+}
+
+static void *bench_mpsc_list_producer(void *arg)
+{
+    struct bench_mpsc_producer *producer = arg;
+    struct bench_mpsc_ctx *ctx = producer->ctx;
+    size_t i;
+
+    for(i = producer->first; i < producer->last; ++i)
+    {
+	pthread_mutex_lock(&ctx->lock);
+	utk_list_add_tail(&ctx->items[i].list, &ctx->list);
+	pthread_mutex_unlock(&ctx->lock);
+    }
+
+    return NULL;
+}
+
+static uint64_t bench_mpsc_consume(struct bench_mpsc_ctx *ctx)
+{
+    struct bench_mpsc_item *pos = NULL;
+    struct bench_mpsc_item *n = NULL;
+    struct utk_mpsc_node *first = NULL;
+    uint64_t sum = 0;
+    size_t count = 0;
+
+    while(count < ctx->nb)
+    {
+	first = utk_mpsc_take_all(&ctx->queue);
+	if(first == NULL)
+	{
+	    sched_yield();
+	    continue;
+	}
+	utk_mpsc_for_each_entry_safe(pos, n, first, node)
+	{
+	    sum += pos->value;
+	    count++;
+	}
+    }
+
+    return sum;
+}
+
+static uint64_t bench_mpsc_list_consume(struct bench_mpsc_ctx *ctx)
+{
+    UTK_LIST_HEAD(batch);
+    struct bench_mpsc_item *pos = NULL;
+    uint64_t sum = 0;
+    size_t count = 0;
+
+    while(count < ctx->nb)
+    {
+	/* take all the items too, for fairness */
+	pthread_mutex_lock(&ctx->lock);
+	utk_list_splice_init(&ctx->list, &batch);
+	pthread_mutex_unlock(&ctx->lock);
+	if(utk_list_empty(&batch))
+	{
+	    sched_yield();
+	    continue;
+	}
+	utk_list_for_each_entry(pos, &batch, list)
+	{
+	    sum += pos->value;
+	    count++;
+	}
+	utk_list_head_init(&batch);
+    }
+
+    return sum;
+}
+
+static double bench_mpsc_run(struct bench_mpsc_ctx *ctx, int locked)
+{
+    struct bench_mpsc_producer producers[BENCH_MPSC_MAX_PRODUCERS];
+    pthread_t threads[BENCH_MPSC_MAX_PRODUCERS];
+    uint64_t sum;
+    double start,
+	elapsed;
+    size_t i;
+
+    utk_mpsc_init(&ctx->queue);
+    utk_list_head_init(&ctx->list);
+
+    start = bench_now();
+    for(i = 0; i < ctx->nb_producers; ++i)
+    {
+	producers[i].ctx = ctx;
+	producers[i].first = ctx->nb * i / ctx->nb_producers;
+	producers[i].last = ctx->nb * (i + 1) / ctx->nb_producers;
+	if(pthread_create(&threads[i], NULL,
+			  locked ? bench_mpsc_list_producer
+			  : bench_mpsc_producer, &producers[i]) != 0)
+	{
+	    bench_die("pthread_create");
+	}
+    }
+
+    sum = locked ? bench_mpsc_list_consume(ctx) : bench_mpsc_consume(ctx);
+
+    for(i = 0; i < ctx->nb_producers; ++i)
+    {
+	pthread_join(threads[i], NULL);
+    }
+    elapsed = bench_now() - start;
+
+    if(sum != (uint64_t)ctx->nb * (ctx->nb - 1) / 2)
+    {
+	fprintf(stderr, "bad sum\n");
+	exit(1);
+    }
+
+    return (double)ctx->nb / elapsed;
+}
+
+static void bench_mpsc(struct bench_mpsc_ctx *ctx)
+{
+    double mpsc,
+	list;
+
+    mpsc = bench_mpsc_run(ctx, 0);
+    list = bench_mpsc_run(ctx, 1);
+    BENCH_PRINT("%2zu producers: mpsc %11.0f items/s, mutex %11.0f items/s",
+		ctx->nb_producers, mpsc, list);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_mpsc_ctx ctx;
+    size_t i;
+
+    ctx.nb = 4000000;
+    if(argc > 1)
+    {
+	ctx.nb = strtoul(argv[1], NULL, 10);
+    }
+
+    ctx.items = malloc(ctx.nb * sizeof(*ctx.items));
+    if(ctx.items == NULL)
+    {
+	bench_die("malloc");
+    }
+    for(i = 0; i < ctx.nb; ++i)
+    {
+	ctx.items[i].value = i;
+    }
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    for(ctx.nb_producers = 1;
+	ctx.nb_producers <= BENCH_MPSC_MAX_PRODUCERS;
+	ctx.nb_producers *= 2)
+    {
+	bench_mpsc(&ctx);
+    }
+
+    pthread_mutex_destroy(&ctx.lock);
+    free(ctx.items);
+
+    return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/net.h>
+#include <utk/io.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "bench.h"
+
+/**
+ * Datagrams per second between two threads, one syscall per message
+ * against sendmmsg/recvmmsg batches, over AF_UNIX and UDP 127.0.0.1.
+ *
+ * Usage: bench_net [message size]
+ *
+ * - Default message size is 64 bytes;
+ * - UDP may drop datagrams when the receiver is late: the rate of
+ *   received datagrams is reported.
+ */
+
+#define BENCH_NET_NB_MSGS 1000000
+#define BENCH_NET_BATCH 64
+
+struct bench_net_rx {
+    int fd;
+    int batched;
+    size_t len;
+    unsigned long received;
+    double end;
+};
+
+static void *bench_net_rx_thread(void *data)
+{
+    struct bench_net_rx *rx = data;
+    struct utk_net_batch batch;
+    char buf[65536];
+    size_t mlen = 0;
+    ssize_t cc;
+    int n;
+
+    if(utk_net_batch_init_recv(&batch, BENCH_NET_BATCH, rx->len) != 0)
+    {
+	perror("utk_net_batch_init_recv");
+	exit(1);
+    }
+
+    /* a zero-length datagram ends the run */
+    for(;;)
+    {
+	if(rx->batched)
+	{
+	    n = utk_net_recv_batch(rx->fd, &batch, 0);
+	    if(n > 0)
+	    {
+		utk_net_batch_msg(&batch, (unsigned int)n - 1, &mlen);
+	    }
+	    if(n <= 0 || mlen == 0)
+	    {
+		rx->received += (n > 0 ? (unsigned long)n - 1 : 0);
+		break;
+	    }
+	    rx->received += (unsigned long)n;
+	}
+	else
+	{
+	    cc = recv(rx->fd, buf, rx->len, 0);
+	    if(cc <= 0)
+	    {
+		break;
+	    }
+	    rx->received++;
+	}
+    }
+    rx->end = bench_now();
+
+    utk_net_batch_cleanup(&batch);
+
+    return NULL;
+}
+
+static void bench_net(const char *name, int tx, int rx_fd, size_t len,
+		      int batched)
+{
+    struct bench_net_rx rx;
+    struct utk_net_batch batch;
+    pthread_t thread;
+    char buf[65536];
+    unsigned int i,
+	j;
+    double start;
+
+    memset(buf, 0x5a, len);
+    memset(&rx, 0, sizeof(rx));
+    rx.fd = rx_fd;
+    rx.batched = batched;
+    rx.len = len;
+
+    if(utk_net_batch_init(&batch, BENCH_NET_BATCH, BENCH_NET_BATCH) != 0)
+    {
+	perror("utk_net_batch_init");
+	exit(1);
+    }
+    for(j = 0; j < BENCH_NET_BATCH; ++j)
+    {
+	utk_net_batch_add(&batch, buf, len);
+    }
+
+    start = bench_now();
+    pthread_create(&thread, NULL, bench_net_rx_thread, &rx);
+
+    if(batched)
+    {
+	for(i = 0; i < BENCH_NET_NB_MSGS; i += BENCH_NET_BATCH)
+	{
+	    if(utk_net_send_batch(tx, &batch, 0) != BENCH_NET_BATCH)
+	    {
+		perror("utk_net_send_batch");
+		exit(1);
+	    }
+	}
+    }
+    else
+    {
+	for(i = 0; i < BENCH_NET_NB_MSGS; ++i)
+	{
+	    if(utk_io_write(tx, buf, len) != (ssize_t)len)
+	    {
+		perror("utk_io_write");
+		exit(1);
+	    }
+	}
+    }
+
+    /* UDP may drop the end marker too: send a few */
+    for(j = 0; j < 16; ++j)
+    {
+	send(tx, buf, 0, 0);
+	usleep(1000);
+    }
+    pthread_join(thread, NULL);
+
+    printf("%-40s %-22s %10.0f msgs/s (%lu received)\n", name,
+	   batched ? "sendmmsg/recvmmsg" : "write/recv per msg",
+	   (double)rx.received / (rx.end - start), rx.received);
+
+    utk_net_batch_cleanup(&batch);
+}
+
+static void bench_net_unix(size_t len)
+{
+    int fds[2];
+    int batched;
+
+    for(batched = 0; batched < 2; ++batched)
+    {
+	if(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0)
+	{
+	    perror("socketpair");
+	    exit(1);
+	}
+	bench_net(__func__, fds[0], fds[1], len, batched);
+	close(fds[0]);
+	close(fds[1]);
+    }
+}
+
+static void bench_net_udp(size_t len)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int size = 8 * 1024 * 1024;
+    int tx,
+	rx,
+	batched;
+
+    for(batched = 0; batched < 2; ++batched)
+    {
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	if(bind(rx, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	   || getsockname(rx, (struct sockaddr *)&addr, &addrlen) != 0
+	   || connect(tx, (struct sockaddr *)&addr, addrlen) != 0)
+	{
+	    perror("udp socket");
+	    exit(1);
+	}
+	bench_net(__func__, tx, rx, len, batched);
+	close(tx);
+	close(rx);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t len = 64;
+
+    if(argc > 1)
+    {
+	len = strtoul(argv[1], NULL, 10);
+	if(len == 0 || len > 65000)
+	{
+	    fprintf(stderr, "message size must be in [1, 65000]\n");
+	    return 1;
+	}
+    }
+
+    printf("%u messages of %zu bytes\n", BENCH_NET_NB_MSGS, len);
+    bench_net_unix(len);
+    bench_net_udp(len);
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/shm.h>
+#include <utk/io.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+
+/**
+ * Throughput and ping-pong latency between two processes with an
+ * utk_shm_ring and with a pipe.
+ *
+ * Usage: bench_shm [record size]
+ *
+ * - Default record size is 64 bytes.
+ */
+
+#define BENCH_SHM_RING_SIZE (1024 * 1024)
+#define BENCH_SHM_NB_MSGS 2000000
+#define BENCH_SHM_NB_PINGS 100000
+
+static void bench_die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static void bench_wait(pid_t pid)
+{
+    int status;
+
+    if(waitpid(pid, &status, 0) != pid
+       || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+	fprintf(stderr, "child failed\n");
+	exit(1);
+    }
+}
+
+static void bench_shm_throughput(size_t len)
+{
+    struct utk_shm_ring ring;
+    unsigned char buf[65536];
+    double start,
+	elapsed;
+    unsigned int i;
+    pid_t pid;
+
+    if(utk_shm_ring_create(&ring, NULL, BENCH_SHM_RING_SIZE) != 0)
+    {
+	bench_die("utk_shm_ring_create");
+    }
+    memset(buf, 0x5a, len);
+
+    start = bench_now();
+    pid = fork();
+    if(pid == 0)
+    {
+	for(i = 0; i < BENCH_SHM_NB_MSGS; ++i)
+	{
+	    if(utk_shm_ring_push(&ring, buf, len, -1) != 0)
+	    {
+		_exit(1);
+	    }
+	}
+	_exit(0);
+    }
+
+    for(i = 0; i < BENCH_SHM_NB_MSGS; ++i)
+    {
+	if(utk_shm_ring_pop(&ring, buf, sizeof(buf), -1) != (ssize_t)len)
+	{
+	    bench_die("utk_shm_ring_pop");
+	}
+    }
+    elapsed = bench_now() - start;
+    bench_wait(pid);
+
+    BENCH_PRINT("%10.0f msgs/s %8.1f MB/s",
+		BENCH_SHM_NB_MSGS / elapsed,
+		(double)len * BENCH_SHM_NB_MSGS / elapsed / 1e6);
+
+    utk_shm_ring_close(&ring);
+}
+
+static void bench_pipe_throughput(size_t len)
+{
+    unsigned char buf[65536];
+    double start,
+	elapsed;
+    unsigned int i;
+    int fds[2];
+    pid_t pid;
+
+    if(pipe(fds) != 0)
+    {
+	bench_die("pipe");
+    }
+    memset(buf, 0x5a, len);
+
+    start = bench_now();
+    pid = fork();
+    if(pid == 0)
+    {
+	close(fds[0]);
+	for(i = 0; i < BENCH_SHM_NB_MSGS; ++i)
+	{
+	    if(utk_io_write(fds[1], buf, len) != (ssize_t)len)
+	    {
+		_exit(1);
+	    }
+	}
+	_exit(0);
+    }
+
+    close(fds[1]);
+    for(i = 0; i < BENCH_SHM_NB_MSGS; ++i)
+    {
+	if(utk_io_read(fds[0], buf, len) != (ssize_t)len)
+	{
+	    bench_die("utk_io_read");
+	}
+    }
+    elapsed = bench_now() - start;
+    bench_wait(pid);
+
+    BENCH_PRINT("%10.0f msgs/s %8.1f MB/s",
+		BENCH_SHM_NB_MSGS / elapsed,
+		(double)len * BENCH_SHM_NB_MSGS / elapsed / 1e6);
+
+    close(fds[0]);
+}
+
+static void bench_shm_pingpong(size_t len)
+{
+    struct utk_shm_ring ping,
+	pong;
+    unsigned char buf[65536];
+    double start,
+	elapsed;
+    unsigned int i;
+    pid_t pid;
+
+    if(utk_shm_ring_create(&ping, NULL, BENCH_SHM_RING_SIZE) != 0
+       || utk_shm_ring_create(&pong, NULL, BENCH_SHM_RING_SIZE) != 0)
+    {
+	bench_die("utk_shm_ring_create");
+    }
+    memset(buf, 0x5a, len);
+
+    pid = fork();
+    if(pid == 0)
+    {
+	for(i = 0; i < BENCH_SHM_NB_PINGS; ++i)
+	{
+	    if(utk_shm_ring_pop(&ping, buf, sizeof(buf), -1) != (ssize_t)len
+	       || utk_shm_ring_push(&pong, buf, len, -1) != 0)
+	    {
+		_exit(1);
+	    }
+	}
+	_exit(0);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_SHM_NB_PINGS; ++i)
+    {
+	if(utk_shm_ring_push(&ping, buf, len, -1) != 0
+	   || utk_shm_ring_pop(&pong, buf, sizeof(buf), -1) != (ssize_t)len)
+	{
+	    bench_die("utk_shm_ring");
+	}
+    }
+    elapsed = bench_now() - start;
+    bench_wait(pid);
+
+    BENCH_PRINT("%8.2f us round trip", elapsed / BENCH_SHM_NB_PINGS * 1e6);
+
+    utk_shm_ring_close(&ping);
+    utk_shm_ring_close(&pong);
+}
+
+static void bench_pipe_pingpong(size_t len)
+{
+    unsigned char buf[65536];
+    double start,
+	elapsed;
+    unsigned int i;
+    int ping[2],
+	pong[2];
+    pid_t pid;
+
+    if(pipe(ping) != 0 || pipe(pong) != 0)
+    {
+	bench_die("pipe");
+    }
+    memset(buf, 0x5a, len);
+
+    pid = fork();
+    if(pid == 0)
+    {
+	for(i = 0; i < BENCH_SHM_NB_PINGS; ++i)
+	{
+	    if(utk_io_read(ping[0], buf, len) != (ssize_t)len
+	       || utk_io_write(pong[1], buf, len) != (ssize_t)len)
+	    {
+		_exit(1);
+	    }
+	}
+	_exit(0);
+    }
+
+    start = bench_now();
+    for(i = 0; i < BENCH_SHM_NB_PINGS; ++i)
+    {
+	if(utk_io_write(ping[1], buf, len) != (ssize_t)len
+	   || utk_io_read(pong[0], buf, len) != (ssize_t)len)
+	{
+	    bench_die("pipe");
+	}
+    }
+    elapsed = bench_now() - start;
+    bench_wait(pid);
+
+    BENCH_PRINT("%8.2f us round trip", elapsed / BENCH_SHM_NB_PINGS * 1e6);
+
+    close(ping[0]);
+    close(ping[1]);
+    close(pong[0]);
+    close(pong[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t len = 64;
+
+    if(argc > 1)
+    {
+	len = strtoul(argv[1], NULL, 10);
+	if(len == 0 || len > 65536)
+	{
+	    fprintf(stderr, "record size must be in [1, 65536]\n");
+	    return 1;
+	}
+    }
+
+    printf("%zu bytes records\n", len);
+    bench_shm_throughput(len);
+    bench_pipe_throughput(len);
+    bench_shm_pingpong(len);
+    bench_pipe_pingpong(len);
+
+    return 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/array.h>
+#include <utk/list.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "bench.h"
+
+/**
+ * Throughput between a producer and a consumer thread with an
+ * UTK_SPSC_DEFINE() ring (one by one and in batches), an utk_spsc_ring
+ * of records and a mutex protected utk_list_head queue with an
+ * allocation per message.
+ *
+ * Usage: bench_spsc [messages]
+ *
+ * - Default is 100M messages (10M for the record ring, 2M for the list);
+ * - both threads spin (with sched_yield()) when the ring is full or empty:
+ *   run it with 2 free CPUs.
+ */
+
+#define BENCH_SPSC_RING_SIZE 65536
+#define BENCH_SPSC_BATCH 64
+#define BENCH_SPSC_RECORD 16
+
+UTK_SPSC_DEFINE(bench_ring, uint64_t)
+
+struct bench_spsc_ctx {
+    struct bench_ring ring;
+    struct utk_spsc_ring records;
+    pthread_mutex_t lock;
+    struct utk_list_head list;
+    size_t nb;
+    size_t batch;
+};
+
+struct bench_spsc_msg {
+    struct utk_list_head list;
+    uint64_t value;
+};
+
+static void bench_die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static void *bench_spsc_producer(void *arg)
+{
+    struct bench_spsc_ctx *ctx = arg;
+    uint64_t buf[BENCH_SPSC_BATCH];
+    uint64_t next = 0;
+    size_t nb,
+	i;
+
+    while(next < ctx->nb)
+    {
+	if(ctx->batch == 1)
+	{
+	    if(bench_ring_push(&ctx->ring, next) == 0)
+	    {
+		next++;
+		continue;
+	    }
+	}
+	else
+	{
+	    nb = ctx->nb - next < ctx->batch ? ctx->nb - next : ctx->batch;
+	    for(i = 0; i < nb; ++i)
+	    {
+		buf[i] = next + i;
+	    }
+	    nb = bench_ring_push_batch(&ctx->ring, buf, nb);
+	    next += nb;
+	    if(nb > 0)
+	    {
+		continue;
+	    }
+	}
+	sched_yield();
+    }
+
+    return NULL;
+}
+
+static void bench_spsc(size_t nb, size_t batch)
+{
+    struct bench_spsc_ctx ctx;
+    uint64_t buf[BENCH_SPSC_BATCH];
+    uint64_t sum = 0;
+    pthread_t thread;
+    double start,
+	elapsed;
+    size_t count = 0,
+	got,
+	i;
+
+    if(bench_ring_init(&ctx.ring, BENCH_SPSC_RING_SIZE, NULL) != 0)
+    {
+	bench_die("bench_ring_init");
+    }
+    ctx.nb = nb;
+    ctx.batch = batch;
+
+    start = bench_now();
+    if(pthread_create(&thread, NULL, bench_spsc_producer, &ctx) != 0)
+    {
+	bench_die("pthread_create");
+    }
+    while(count < nb)
+    {
+	if(batch == 1)
+	{
+	    got = bench_ring_pop(&ctx.ring, buf) == 0 ? 1 : 0;
+	}
+	else
+	{
+	    got = bench_ring_pop_batch(&ctx.ring, buf, batch);
+	}
+	if(got == 0)
+	{
+	    sched_yield();
+	    continue;
+	}
+	for(i = 0; i < got; ++i)
+	{
+	    sum += buf[i];
+	}
+	count += got;
+    }
+    pthread_join(thread, NULL);
+    elapsed = bench_now() - start;
+
+    if(sum != (uint64_t)nb * (nb - 1) / 2)
+    {
+	fprintf(stderr, "bad sum\n");
+	exit(1);
+    }
+
+    BENCH_PRINT("batch %2zu: %12.0f msgs/s", batch, (double)nb / elapsed);
+
+    bench_ring_cleanup(&ctx.ring);
+}
+
+static void *bench_spsc_ring_producer(void *arg)
+{
+    struct bench_spsc_ctx *ctx = arg;
+    unsigned char buf[BENCH_SPSC_RECORD];
+    size_t i;
+
+    memset(buf, 0x5a, sizeof(buf));
+    for(i = 0; i < ctx->nb; ++i)
+    {
+	while(utk_spsc_ring_push(&ctx->records, buf, sizeof(buf)) != 0)
+	{
+	    sched_yield();
+	}
+    }
+
+    return NULL;
+}
+
+static void bench_spsc_ring(size_t nb)
+{
+    struct bench_spsc_ctx ctx;
+    const void *data = NULL;
+    pthread_t thread;
+    double start,
+	elapsed;
+    size_t count = 0;
+
+    if(utk_spsc_ring_init(&ctx.records, BENCH_SPSC_RING_SIZE * 16,
+			  NULL) != 0)
+    {
+	bench_die("utk_spsc_ring_init");
+    }
+    ctx.nb = nb;
+
+    start = bench_now();
+    if(pthread_create(&thread, NULL, bench_spsc_ring_producer, &ctx) != 0)
+    {
+	bench_die("pthread_create");
+    }
+    while(count < nb)
+    {
+	if(utk_spsc_ring_peek(&ctx.records, &data) != BENCH_SPSC_RECORD)
+	{
+	    utk_spsc_ring_consume(&ctx.records);
+	    sched_yield();
+	    continue;
+	}
+	count++;
+	if(count % BENCH_SPSC_BATCH == 0)
+	{
+	    utk_spsc_ring_consume(&ctx.records);
+	}
+    }
+    pthread_join(thread, NULL);
+    elapsed = bench_now() - start;
+
+    BENCH_PRINT("%2d bytes: %12.0f msgs/s", BENCH_SPSC_RECORD,
+		(double)nb / elapsed);
+
+    utk_spsc_ring_cleanup(&ctx.records);
+}
+
+static void *bench_spsc_list_producer(void *arg)
+{
+    struct bench_spsc_ctx *ctx = arg;
+    struct bench_spsc_msg *msg = NULL;
+    size_t i;
+
+    for(i = 0; i < ctx->nb; ++i)
+    {
+	msg = malloc(sizeof(*msg));
+	if(msg == NULL)
+	{
+	    bench_die("malloc");
+	}
+	msg->value = i;
+	pthread_mutex_lock(&ctx->lock);
+	utk_list_add_tail(&msg->list, &ctx->list);
+	pthread_mutex_unlock(&ctx->lock);
+    }
+
+    return NULL;
+}
+
+static void bench_spsc_list(size_t nb)
+{
+    struct bench_spsc_ctx ctx;
+    struct bench_spsc_msg *msg = NULL;
+    uint64_t sum = 0;
+    pthread_t thread;
+    double start,
+	elapsed;
+    size_t count = 0;
+
+    pthread_mutex_init(&ctx.lock, NULL);
+    utk_list_head_init(&ctx.list);
+    ctx.nb = nb;
+
+    start = bench_now();
+    if(pthread_create(&thread, NULL, bench_spsc_list_producer, &ctx) != 0)
+    {
+	bench_die("pthread_create");
+    }
+    while(count < nb)
+    {
+	pthread_mutex_lock(&ctx.lock);
+	msg = NULL;
+	if(!utk_list_empty(&ctx.list))
+	{
+	    msg = utk_list_first_entry(&ctx.list, struct bench_spsc_msg, list);
+	    utk_list_del(&msg->list);
+	}
+	pthread_mutex_unlock(&ctx.lock);
+	if(msg == NULL)
+	{
+	    sched_yield();
+	    continue;
+	}
+	sum += msg->value;
+	free(msg);
+	count++;
+    }
+    pthread_join(thread, NULL);
+    elapsed = bench_now() - start;
+
+    if(sum != (uint64_t)nb * (nb - 1) / 2)
+    {
+	fprintf(stderr, "bad sum\n");
+	exit(1);
+    }
+
+    BENCH_PRINT("          %12.0f msgs/s", (double)nb / elapsed);
+
+    pthread_mutex_destroy(&ctx.lock);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t nb = 100000000;
+
+    if(argc > 1)
+    {
+	nb = strtoul(argv[1], NULL, 10);
+    }
+
+    bench_spsc(nb, 1);
+    bench_spsc(nb, BENCH_SPSC_BATCH);
+    bench_spsc_ring(nb / 10);
+    bench_spsc_list(nb / 50);
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utk/timer.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/**
+ * Start, cancel and expiration costs of an utk_timer_wheel holding
+ * millions of timers, and the cost of the scan of a list of timers that
+ * it replaces.
+ *
+ * Usage: bench_timer [timers]
+ *
+ * - Default is 10M timers with timeouts up to 100K ticks.
+ */
+
+#define BENCH_TIMER_MAX_TIMEOUT 100000
+
+struct bench_timer_item {
+    struct utk_timer timer;
+    uint64_t deadline;
+};
+
+static size_t bench_timer_expired;
+
+static void bench_timer_cb(void *opaque, struct utk_list_head *expired)
+{
+    struct utk_timer *timer = NULL;
+
+    (void)opaque;
+
+    utk_list_for_each_entry(timer, expired, node)
+    {
+	bench_timer_expired++;
+    }
+}
+
+/*
+ * Pseudo random numbers (xorshift)
+ */
+static uint64_t bench_timer_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void bench_timer_wheel(struct bench_timer_item *items, size_t nb)
+{
+    struct utk_timer_wheel wheel;
+    uint64_t state = 88172645463325252ULL;
+    uint64_t now;
+    double start,
+	elapsed,
+	tick,
+	worst = 0;
+    size_t i;
+
+    utk_timer_wheel_init(&wheel, 1, 0, bench_timer_cb, NULL);
+    for(i = 0; i < nb; ++i)
+    {
+	utk_timer_init(&items[i].timer);
+	items[i].deadline = bench_timer_rand(&state) % BENCH_TIMER_MAX_TIMEOUT;
+    }
+
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	utk_timer_wheel_start(&wheel, &items[i].timer, items[i].deadline);
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("start:   %6.1f ns/timer (%zu timers)",
+		elapsed * 1e9 / (double)nb, nb);
+
+    /* restart: the usual case of a connection timeout */
+    start = bench_now();
+    for(i = 0; i < nb; ++i)
+    {
+	utk_timer_wheel_start(&wheel, &items[i].timer,
+			      BENCH_TIMER_MAX_TIMEOUT - 1 - items[i].deadline);
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("restart: %6.1f ns/timer", elapsed * 1e9 / (double)nb);
+
+    start = bench_now();
+    for(i = 0; i < nb; i += 2)
+    {
+	utk_timer_wheel_cancel(&wheel, &items[i].timer);
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("cancel:  %6.1f ns/timer", elapsed * 2e9 / (double)nb);
+
+    /* tick by tick until all expired */
+    bench_timer_expired = 0;
+    start = bench_now();
+    for(now = 1; now <= BENCH_TIMER_MAX_TIMEOUT; ++now)
+    {
+	tick = bench_now();
+	utk_timer_wheel_advance(&wheel, now);
+	tick = bench_now() - tick;
+	if(tick > worst)
+	{
+	    worst = tick;
+	}
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("expire:  %6.1f us/tick (worst %.1f us), %.1f ns/timer",
+		elapsed * 1e6 / BENCH_TIMER_MAX_TIMEOUT, worst * 1e6,
+		elapsed * 1e9 / (double)bench_timer_expired);
+
+    if(bench_timer_expired != nb / 2 || utk_timer_wheel_count(&wheel) != 0)
+    {
+	fprintf(stderr, "%zu timers expired\n", bench_timer_expired);
+	exit(1);
+    }
+}
+
+/*
+ * One tick of the scan of a list of timers
+ */
+static void bench_timer_list(struct bench_timer_item *items, size_t nb)
+{
+    struct bench_timer_item *pos = NULL;
+    UTK_LIST_HEAD(list);
+    double start;
+    size_t expired = 0,
+	i;
+
+    for(i = 0; i < nb; ++i)
+    {
+	utk_list_add_tail(&items[i].timer.node, &list);
+    }
+
+    start = bench_now();
+    utk_list_for_each_entry(pos, &list, timer.node)
+    {
+	expired += pos->deadline == 0;
+    }
+    BENCH_PRINT("scan:    %6.1f us/tick (%zu expired)",
+		(bench_now() - start) * 1e6, expired);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_timer_item *items = NULL;
+    size_t nb = 10000000;
+
+    if(argc > 1)
+    {
+	nb = strtoul(argv[1], NULL, 10);
+    }
+
+    items = malloc(nb * sizeof(*items));
+    if(items == NULL)
+    {
+	perror("malloc");
+	exit(1);
+    }
+
+    bench_timer_wheel(items, nb);
+    bench_timer_list(items, nb);
+
+    free(items);
+
+    return 0;
+}
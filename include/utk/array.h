@@ -20,6 +20,730 @@
 #ifndef _UTK_ARRAY_H_
 #define _UTK_ARRAY_H_
 
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
 #define UTK_ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
+/**
+ * UTK_VEC_DEFINE(name, type) defines a growable vector of type, struct
+ * name, and its functions:
+ *
+ *  void name_init(struct name *v, const struct utk_array_allocator *alloc);
+ *  void name_cleanup(struct name *v);
+ *  size_t name_count(const struct name *v);
+ *  int name_reserve(struct name *v, size_t capacity);
+ *  int name_shrink(struct name *v);
+ *  int name_push(struct name *v, type val);
+ *  int name_pop(struct name *v, type *dst);
+ *  int name_insert(struct name *v, size_t index, type val);
+ *  int name_erase(struct name *v, size_t index, size_t nb);
+ *  void name_clear(struct name *v);
+ *
+ * UTK_VEC_SMALL_DEFINE(name, type, n) defines the same vector with room
+ * for n elements inside struct name: no allocation is done until it
+ * holds more than n elements. Example:
+ *
+ *  UTK_VEC_DEFINE(int_vec, int)
+ *
+ *  struct int_vec vec;
+ *  int *pos = NULL;
+ *
+ *  int_vec_init(&vec, NULL);
+ *  int_vec_push(&vec, 42);
+ *  utk_vec_for_each(pos, &vec)
+ *  {
+ *      // your stuff //
+ *  }
+ *  int_vec_cleanup(&vec);
+ *
+ * - Elements are v->data[0 .. v->count - 1], v->data is moved by the
+ *   functions which add elements or shrink the vector;
+ * - the capacity doubles when the vector is full (amortized O(1) push),
+ *   sizes are checked for overflow: ENOMEM is returned instead;
+ * - elements are copied by assignment and moved with memmove(3);
+ * - v->data of a small vector may point inside struct name: don't copy
+ *   the structure.
+ */
+
+/* capacity of the first allocation */
+#define UTK_VEC_MIN_CAPACITY 8
+
+/*
+ * Allocator of the vectors (see struct utk_io_allocator)
+ *
+ * - realloc() must behave like realloc(3): ptr may be NULL for the
+ *   first allocation, old_size is given for arena or pool allocators
+ *   which can't guess it;
+ * - free() may be NULL if the allocator doesn't need it (arena).
+ */
+struct utk_array_allocator {
+    void *(*realloc)(void *opaque, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *opaque, void *ptr);
+    void *opaque;
+};
+
+/*
+ * utk_array_realloc
+ *
+ *  Resize a buffer with an allocator
+ *
+ * \param alloc Allocator or NULL for libc allocator
+ * \param ptr Buffer or NULL
+ * \param old_size Size of the buffer
+ * \param new_size New size of the buffer
+ * \return The buffer or NULL to indicate error
+ */
+static inline void *utk_array_realloc(const struct utk_array_allocator *alloc,
+				      void *ptr, size_t old_size,
+				      size_t new_size)
+{
+    if(alloc == NULL)
+    {
+	return realloc(ptr, new_size);
+    }
+
+    return alloc->realloc(alloc->opaque, ptr, old_size, new_size);
+}
+
+/*
+ * utk_array_free
+ *
+ *  Release a buffer with an allocator
+ *
+ * \param alloc Allocator or NULL for libc allocator
+ * \param ptr Buffer or NULL
+ * \return void
+ */
+static inline void utk_array_free(const struct utk_array_allocator *alloc,
+				  void *ptr)
+{
+    if(alloc == NULL)
+    {
+	free(ptr);
+    }
+    else if(alloc->free != NULL && ptr != NULL)
+    {
+	alloc->free(alloc->opaque, ptr);
+    }
+}
+
+/*
+ * utk_array_grow
+ *
+ *  Next capacity of an array which must hold needed elements
+ *
+ * - The capacity doubles, it is clamped to the largest array of
+ *   elem_size elements which can be addressed.
+ *
+ * \param capacity Current capacity
+ * \param needed Number of elements to hold
+ * \param elem_size Size of an element
+ * \return The new capacity or 0 if needed elements can't be addressed
+ */
+static inline size_t utk_array_grow(size_t capacity, size_t needed,
+				    size_t elem_size)
+{
+    size_t max = SIZE_MAX / elem_size;
+
+    if(needed > max)
+    {
+	return 0;
+    }
+
+    capacity = capacity > max / 2 ? max : capacity * 2;
+    if(capacity < UTK_VEC_MIN_CAPACITY)
+    {
+	capacity = UTK_VEC_MIN_CAPACITY < max ? UTK_VEC_MIN_CAPACITY : max;
+    }
+    if(capacity < needed)
+    {
+	capacity = needed;
+    }
+
+    return capacity;
+}
+
+/*!
+ * utk_vec_for_each    -    iterate over the elements of a vector
+ * @pos:    the type * to use as a loop counter.
+ * @v:    the vector.
+ *
+ * Elements mustn't be added or removed while iterating.
+ */
+#define utk_vec_for_each(pos, v)					\
+    for (pos = (v)->data; pos != (v)->data + (v)->count; pos++)
+
+#define UTK_VEC_NO_BUF(v) NULL
+#define UTK_VEC_BUF(v) ((v)->buf)
+
+#define UTK_VEC_DEFINE(name, type)					\
+									\
+struct name {								\
+    type *data;								\
+    size_t count;							\
+    size_t capacity;							\
+    const struct utk_array_allocator *alloc;				\
+};									\
+									\
+UTK_VEC_DEFINE_FUNCS(name, type, 0, UTK_VEC_NO_BUF)
+
+#define UTK_VEC_SMALL_DEFINE(name, type, n)				\
+									\
+struct name {								\
+    type *data;								\
+    size_t count;							\
+    size_t capacity;							\
+    const struct utk_array_allocator *alloc;				\
+    type buf[n];							\
+};									\
+									\
+UTK_VEC_DEFINE_FUNCS(name, type, n, UTK_VEC_BUF)
+
+/* buf(v) is the inline buffer of buf_len elements (NULL if buf_len is 0) */
+#define UTK_VEC_DEFINE_FUNCS(name, type, buf_len, buf)			\
+									\
+static inline void name##_init(struct name *v,				\
+			       const struct utk_array_allocator *alloc)	\
+{									\
+    v->data = buf(v);							\
+    v->count = 0;							\
+    v->capacity = (buf_len);						\
+    v->alloc = alloc;							\
+}									\
+									\
+static inline void name##_cleanup(struct name *v)			\
+{									\
+    if(v->data != buf(v))						\
+    {									\
+	utk_array_free(v->alloc, v->data);				\
+    }									\
+    v->data = buf(v);							\
+    v->count = 0;							\
+    v->capacity = (buf_len);						\
+}									\
+									\
+static inline size_t name##_count(const struct name *v)			\
+{									\
+    return v->count;							\
+}									\
+									\
+static inline int name##_reserve(struct name *v, size_t capacity)	\
+{									\
+    type *data = NULL;							\
+									\
+    if(capacity <= v->capacity)						\
+    {									\
+	return 0;							\
+    }									\
+    if(capacity > SIZE_MAX / sizeof(type))				\
+    {									\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+									\
+    if(v->data == buf(v))						\
+    {									\
+	/* empty or inline: elements are copied to the new buffer */	\
+	data = utk_array_realloc(v->alloc, NULL, 0,			\
+				 capacity * sizeof(type));		\
+	if(data != NULL && v->count > 0)				\
+	{								\
+	    memcpy(data, v->data, v->count * sizeof(type));		\
+	}								\
+    }									\
+    else								\
+    {									\
+	data = utk_array_realloc(v->alloc, v->data,			\
+				 v->capacity * sizeof(type),		\
+				 capacity * sizeof(type));		\
+    }									\
+    if(data == NULL)							\
+    {									\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+									\
+    v->data = data;							\
+    v->capacity = capacity;						\
+									\
+    return 0;								\
+}									\
+									\
+/* make room for nb more elements */					\
+static inline int name##_grow(struct name *v, size_t nb)		\
+{									\
+    size_t capacity;							\
+									\
+    if(nb <= v->capacity - v->count)					\
+    {									\
+	return 0;							\
+    }									\
+    if(nb > SIZE_MAX - v->count						\
+       || (capacity = utk_array_grow(v->capacity, v->count + nb,	\
+				     sizeof(type))) == 0)		\
+    {									\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+									\
+    return name##_reserve(v, capacity);					\
+}									\
+									\
+static inline int name##_shrink(struct name *v)				\
+{									\
+    type *data = NULL;							\
+									\
+    if(v->data == buf(v) || v->count == v->capacity)			\
+    {									\
+	return 0;							\
+    }									\
+									\
+    if(v->count <= (buf_len))						\
+    {									\
+	/* back to the inline buffer (or no buffer) */			\
+	data = buf(v);							\
+	if(v->count > 0)						\
+	{								\
+	    memcpy(data, v->data, v->count * sizeof(type));		\
+	}								\
+	utk_array_free(v->alloc, v->data);				\
+	v->data = data;							\
+	v->capacity = (buf_len);					\
+	return 0;							\
+    }									\
+									\
+    data = utk_array_realloc(v->alloc, v->data,				\
+			     v->capacity * sizeof(type),		\
+			     v->count * sizeof(type));			\
+    if(data == NULL)							\
+    {									\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+    v->data = data;							\
+    v->capacity = v->count;						\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_push(struct name *v, type val)			\
+{									\
+    if(v->count == v->capacity && name##_grow(v, 1) != 0)		\
+    {									\
+	return -1;							\
+    }									\
+    v->data[v->count++] = val;						\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_pop(struct name *v, type *dst)			\
+{									\
+    if(v->count == 0)							\
+    {									\
+	errno = ENOENT;							\
+	return -1;							\
+    }									\
+    v->count--;								\
+    if(dst != NULL)							\
+    {									\
+	*dst = v->data[v->count];					\
+    }									\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_insert(struct name *v, size_t index, type val)	\
+{									\
+    if(index > v->count)						\
+    {									\
+	errno = EINVAL;							\
+	return -1;							\
+    }									\
+    if(v->count == v->capacity && name##_grow(v, 1) != 0)		\
+    {									\
+	return -1;							\
+    }									\
+									\
+    if(index < v->count)						\
+    {									\
+	memmove(v->data + index + 1, v->data + index,			\
+		(v->count - index) * sizeof(type));			\
+    }									\
+    v->data[index] = val;						\
+    v->count++;								\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_erase(struct name *v, size_t index, size_t nb)	\
+{									\
+    if(index > v->count || nb > v->count - index)			\
+    {									\
+	errno = EINVAL;							\
+	return -1;							\
+    }									\
+									\
+    /* data may be NULL when nothing is moved */			\
+    if(nb > 0 && index + nb < v->count)					\
+    {									\
+	memmove(v->data + index, v->data + index + nb,			\
+		(v->count - index - nb) * sizeof(type));		\
+    }									\
+    v->count -= nb;							\
+									\
+    return 0;								\
+}									\
+									\
+static inline void name##_clear(struct name *v)				\
+{									\
+    v->count = 0;							\
+}
+
+/**
+ * UTK_SPSC_DEFINE(name, type) defines a lock-free single producer single
+ * consumer ring of type, struct name, and its functions:
+ *
+ *  int name_init(struct name *r, size_t size,
+ *                const struct utk_array_allocator *alloc);
+ *  void name_cleanup(struct name *r);
+ *  size_t name_capacity(const struct name *r);
+ *  size_t name_count(const struct name *r);
+ *  int name_push(struct name *r, type val);
+ *  size_t name_push_batch(struct name *r, const type *src, size_t nb);
+ *  int name_pop(struct name *r, type *dst);
+ *  size_t name_pop_batch(struct name *r, type *dst, size_t nb);
+ *
+ * One thread pushes, another one pops, without lock nor system call.
+ * name_push() and name_pop() return -1 with EAGAIN when the ring is
+ * full or empty: the caller decides to spin, yield or sleep.
+ *
+ * - The capacity is size rounded up to a power of 2;
+ * - head (producer) and tail (consumer) are on their own cache lines,
+ *   published with release stores and read with acquire loads;
+ * - each side keeps a copy of the other side index and only reads the
+ *   shared one when the copy says the ring is full (or empty), so the
+ *   cache lines only bounce when the ring is close to full or empty;
+ * - batch functions move up to nb elements with one index update;
+ * - see struct utk_spsc_ring for variable-length records.
+ */
+
+#define UTK_ARRAY_CACHELINE 64
+
+#define UTK_SPSC_DEFINE(name, type)					\
+									\
+struct name {								\
+    /* producer side: head and last seen tail */			\
+    size_t head __attribute__((aligned(UTK_ARRAY_CACHELINE)));		\
+    size_t tail_cache;							\
+									\
+    /* consumer side: tail and last seen head */			\
+    size_t tail __attribute__((aligned(UTK_ARRAY_CACHELINE)));		\
+    size_t head_cache;							\
+									\
+    type *slots __attribute__((aligned(UTK_ARRAY_CACHELINE)));		\
+    size_t mask;							\
+    const struct utk_array_allocator *alloc;				\
+};									\
+									\
+static inline int name##_init(struct name *r, size_t size,		\
+			      const struct utk_array_allocator *alloc)	\
+{									\
+    size_t capacity = 2;						\
+									\
+    while(capacity < size)						\
+    {									\
+	if(capacity > (SIZE_MAX >> 2) / sizeof(type))			\
+	{								\
+	    errno = EINVAL;						\
+	    return -1;							\
+	}								\
+	capacity <<= 1;							\
+    }									\
+									\
+    r->slots = utk_array_realloc(alloc, NULL, 0,			\
+				 capacity * sizeof(type));		\
+    if(r->slots == NULL)						\
+    {									\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+    r->mask = capacity - 1;						\
+    r->alloc = alloc;							\
+    r->head = 0;							\
+    r->tail_cache = 0;							\
+    r->tail = 0;							\
+    r->head_cache = 0;							\
+									\
+    return 0;								\
+}									\
+									\
+static inline void name##_cleanup(struct name *r)			\
+{									\
+    utk_array_free(r->alloc, r->slots);					\
+    r->slots = NULL;							\
+}									\
+									\
+static inline size_t name##_capacity(const struct name *r)		\
+{									\
+    return r->mask + 1;							\
+}									\
+									\
+/* approximate when the other side is running */			\
+static inline size_t name##_count(const struct name *r)			\
+{									\
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);		\
+									\
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - tail;		\
+}									\
+									\
+/* free slots seen by the producer, at least nb if possible */		\
+static inline size_t name##_room(struct name *r, size_t head, size_t nb) \
+{									\
+    size_t room = r->mask + 1 - (head - r->tail_cache);			\
+									\
+    if(room < nb)							\
+    {									\
+	r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);	\
+	room = r->mask + 1 - (head - r->tail_cache);			\
+    }									\
+									\
+    return room;							\
+}									\
+									\
+/* elements seen by the consumer, at least nb if possible */		\
+static inline size_t name##_ready(struct name *r, size_t tail, size_t nb) \
+{									\
+    size_t ready = r->head_cache - tail;				\
+									\
+    if(ready < nb)							\
+    {									\
+	r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);	\
+	ready = r->head_cache - tail;					\
+    }									\
+									\
+    return ready;							\
+}									\
+									\
+static inline int name##_push(struct name *r, type val)			\
+{									\
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);		\
+									\
+    if(name##_room(r, head, 1) == 0)					\
+    {									\
+	errno = EAGAIN;							\
+	return -1;							\
+    }									\
+									\
+    r->slots[head & r->mask] = val;					\
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);		\
+									\
+    return 0;								\
+}									\
+									\
+static inline size_t name##_push_batch(struct name *r, const type *src,	\
+				       size_t nb)			\
+{									\
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);		\
+    size_t room = name##_room(r, head, nb);				\
+    size_t i;								\
+									\
+    if(nb > room)							\
+    {									\
+	nb = room;							\
+    }									\
+    for(i = 0; i < nb; ++i)						\
+    {									\
+	r->slots[(head + i) & r->mask] = src[i];			\
+    }									\
+    __atomic_store_n(&r->head, head + nb, __ATOMIC_RELEASE);		\
+									\
+    return nb;								\
+}									\
+									\
+static inline int name##_pop(struct name *r, type *dst)			\
+{									\
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);		\
+									\
+    if(name##_ready(r, tail, 1) == 0)					\
+    {									\
+	errno = EAGAIN;							\
+	return -1;							\
+    }									\
+									\
+    *dst = r->slots[tail & r->mask];					\
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);		\
+									\
+    return 0;								\
+}									\
+									\
+static inline size_t name##_pop_batch(struct name *r, type *dst,	\
+				      size_t nb)			\
+{									\
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);		\
+    size_t ready = name##_ready(r, tail, nb);				\
+    size_t i;								\
+									\
+    if(nb > ready)							\
+    {									\
+	nb = ready;							\
+    }									\
+    for(i = 0; i < nb; ++i)						\
+    {									\
+	dst[i] = r->slots[(tail + i) & r->mask];			\
+    }									\
+    __atomic_store_n(&r->tail, tail + nb, __ATOMIC_RELEASE);		\
+									\
+    return nb;								\
+}
+
+/*
+ * Lock-free single producer single consumer ring of variable-length
+ * records, in the memory of the process (see utk/shm.h between
+ * processes).
+ *
+ * - Records are contiguous in the ring: the producer can receive data
+ *   in place with utk_spsc_ring_reserve()/utk_spsc_ring_commit(), the
+ *   consumer can read them in place with utk_spsc_ring_peek();
+ * - records peeked since the last utk_spsc_ring_consume() are released
+ *   together by the next one (batch dequeue);
+ * - indexes are laid out like UTK_SPSC_DEFINE() rings.
+ */
+struct utk_spsc_ring {
+    /* producer side */
+    size_t head __attribute__((aligned(UTK_ARRAY_CACHELINE)));
+    size_t tail_cache;
+    /* record being written */
+    size_t reserved;
+
+    /* consumer side */
+    size_t tail __attribute__((aligned(UTK_ARRAY_CACHELINE)));
+    size_t head_cache;
+    /* end of the peeked records */
+    size_t peeked;
+
+    unsigned char *data __attribute__((aligned(UTK_ARRAY_CACHELINE)));
+    size_t size;
+    const struct utk_array_allocator *alloc;
+};
+
+/*
+ * utk_spsc_ring_init
+ *
+ *  Initialize a ring of records
+ *
+ * \param ring The ring
+ * \param size Capacity of the ring in bytes (rounded up to a power of 2)
+ * \param alloc Allocator of the ring or NULL for libc allocator
+ * \return 0 on success or -1 to indicate error (EINVAL, ENOMEM)
+ */
+int utk_spsc_ring_init(struct utk_spsc_ring *ring, size_t size,
+		       const struct utk_array_allocator *alloc);
+
+/*
+ * utk_spsc_ring_cleanup
+ *
+ *  Release the memory of a ring
+ *
+ * \param ring The ring
+ * \return void
+ */
+void utk_spsc_ring_cleanup(struct utk_spsc_ring *ring);
+
+/*
+ * utk_spsc_ring_max_record
+ *
+ *  Biggest record which can be pushed
+ *
+ * \param ring The ring
+ * \return The length in bytes
+ */
+size_t utk_spsc_ring_max_record(const struct utk_spsc_ring *ring);
+
+/*
+ * utk_spsc_ring_reserve
+ *
+ *  Get room for a record of at most len bytes (producer side)
+ *
+ * - The record is only visible to the consumer after
+ *   utk_spsc_ring_commit();
+ * - calling it again without commit reserves a new record instead.
+ *
+ * \param ring The ring
+ * \param len Maximum record length
+ * \return Where to write the record or NULL to indicate error (errno is
+ *         EAGAIN when the ring is full, EMSGSIZE when len is too big)
+ */
+void *utk_spsc_ring_reserve(struct utk_spsc_ring *ring, size_t len);
+
+/*
+ * utk_spsc_ring_commit
+ *
+ *  Publish the record returned by utk_spsc_ring_reserve()
+ *
+ * \param ring The ring
+ * \param len Record length, lower or equal to the reserved length
+ * \return void
+ */
+void utk_spsc_ring_commit(struct utk_spsc_ring *ring, size_t len);
+
+/*
+ * utk_spsc_ring_push
+ *
+ *  Copy a record in the ring (producer side)
+ *
+ * \param ring The ring
+ * \param data Record data
+ * \param len Record length
+ * \return 0 on success or -1 to indicate error (see
+ *         utk_spsc_ring_reserve())
+ */
+int utk_spsc_ring_push(struct utk_spsc_ring *ring, const void *data,
+		       size_t len);
+
+/*
+ * utk_spsc_ring_peek
+ *
+ *  Get the next record without copying it (consumer side)
+ *
+ * - The record stays valid until utk_spsc_ring_consume(): peek again to
+ *   get the following records.
+ *
+ * \param ring The ring
+ * \param data Pointer where the address of the record is stored
+ * \return The length of the record or -1 to indicate error (errno is
+ *         EAGAIN when there is no more record)
+ */
+ssize_t utk_spsc_ring_peek(struct utk_spsc_ring *ring, const void **data);
+
+/*
+ * utk_spsc_ring_consume
+ *
+ *  Release the records returned by utk_spsc_ring_peek()
+ *
+ * \param ring The ring
+ * \return void
+ */
+void utk_spsc_ring_consume(struct utk_spsc_ring *ring);
+
+/*
+ * utk_spsc_ring_pop
+ *
+ *  Copy the next record and release it (consumer side)
+ *
+ * - Records peeked before are released too.
+ *
+ * \param ring The ring
+ * \param dst Destination pointer
+ * \param size Size of destination buffer
+ * \return The length of the record or -1 to indicate error (errno is
+ *         EAGAIN when the ring is empty, EMSGSIZE if dst is too small, the
+ *         record is kept in this case)
+ */
+ssize_t utk_spsc_ring_pop(struct utk_spsc_ring *ring, void *dst, size_t size);
+
 #endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_CRC_H_
+#define _UTK_CRC_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * utk_crc32c
+ *
+ *  Compute the CRC-32C (Castagnoli) of a buffer
+ *
+ * - The implementation is chosen at runtime: SSE4.2 crc32 instruction
+ *   with 3 interleaved lanes for big buffers (combined with PCLMULQDQ when
+ *   available) or slicing-by-8 tables;
+ * - As zlib crc32(), start with crc = 0 and give the previous return to
+ *   compute the checksum of data in several calls.
+ *
+ * Example:
+ *
+ *      crc = utk_crc32c(0, header, sizeof(header));
+ *      crc = utk_crc32c(crc, payload, payload_len);
+ *
+ * \param crc CRC of the previous data or 0
+ * \param buf Data pointer
+ * \param len Number of byte of data
+ * \return The CRC-32C
+ */
+uint32_t utk_crc32c(uint32_t crc, const void *buf, size_t len);
+
+/*
+ * utk_crc32c_combine
+ *
+ *  Compute the CRC-32C of two concatenated buffers from the CRC-32C of
+ *  each buffer
+ *
+ * - Chunks of a buffer can be checksummed in parallel then combined.
+ *
+ * \param crc1 CRC-32C of the first buffer
+ * \param crc2 CRC-32C of the second buffer
+ * \param len2 Length of the second buffer
+ * \return The CRC-32C of the first buffer followed by the second one
+ */
+uint32_t utk_crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/*
+ * utk_crc32c_implementation
+ *
+ *  Tell which implementation of utk_crc32c() is used
+ *
+ * \return A constant string ("sse4.2+pclmul", "sse4.2" or "slicing-by-8")
+ */
+const char *utk_crc32c_implementation(void);
+
+/*
+ * utk_crc32c_set_implementation
+ *
+ *  Force the implementation of utk_crc32c() (tests, benchmarks)
+ *
+ * - Not thread safe: call it before other threads compute CRCs.
+ *
+ * \param name A name returned by utk_crc32c_implementation() or NULL
+ *             for the best implementation supported by the CPU
+ * \return 0 on success or -1 to indicate error (EINVAL for an unknown
+ *         name, ENOTSUP if the CPU doesn't support it)
+ */
+int utk_crc32c_set_implementation(const char *name);
+
+#endif
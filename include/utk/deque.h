@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_DEQUE_H_
+#define _UTK_DEQUE_H_
+
+#include <stdlib.h>
+
+#include "utk/list.h"
+
+/**
+ * deque.h - double ended queue of fixed size elements stored in blocks
+ *
+ * Elements are stored contiguously in blocks of block_len elements, the
+ * blocks are chained in an utk_list_head list: push and pop at both ends
+ * are O(1), walking the deque reads contiguous memory instead of one
+ * allocation per element like an utk_list_head list.
+ *
+ * - Elements never move: their address is valid until they are popped;
+ * - one empty block is kept to not allocate and free a block at each
+ *   push and pop around a block boundary;
+ * - the deque doesn't lock: protect it if several threads use it.
+ *
+ * Example:
+ *
+ *  struct utk_deque dq;
+ *  struct utk_deque_iter it;
+ *  int *pos = NULL;
+ *
+ *  utk_deque_init(&dq, sizeof(int), 0);
+ *  pos = utk_deque_push_back(&dq);
+ *  *pos = 42;
+ *  utk_deque_for_each(pos, it, &dq)
+ *  {
+ *      // your stuff //
+ *  }
+ *  utk_deque_cleanup(&dq);
+ */
+
+/* block size (with its header) if block_len isn't given */
+#define UTK_DEQUE_BLOCK_SIZE 4096
+
+struct utk_deque_block {
+    struct utk_list_head list;
+    unsigned char data[];
+};
+
+struct utk_deque {
+    struct utk_list_head blocks;
+    struct utk_deque_block *spare;
+    size_t elem_size;
+    size_t block_len;
+    size_t count;
+    /* first element in the first block, end in the last block */
+    size_t head;
+    size_t tail;
+};
+
+struct utk_deque_iter {
+    struct utk_deque_block *block;
+    /* end (or start when walking backwards) of the elements in block */
+    void *end;
+};
+
+/*!
+ * utk_deque_for_each    -    iterate over the elements of a deque
+ * @pos:    the type * to use as a loop counter (sizeof(*pos) must be the
+ *          element size).
+ * @it:    a struct utk_deque_iter to use as temporary storage.
+ * @dq:    the deque.
+ *
+ * Elements mustn't be pushed or popped while iterating.
+ */
+#define utk_deque_for_each(pos, it, dq)					\
+    for (pos = utk_deque_iter_first(dq, &(it));				\
+	 pos != NULL;							\
+	 pos = (void *)((pos) + 1) != (it).end				\
+	     ? (pos) + 1 : utk_deque_iter_next(dq, &(it)))
+
+/*!
+ * utk_deque_for_each_reverse    -    iterate backwards over the elements
+ * of a deque
+ * @pos:    the type * to use as a loop counter (sizeof(*pos) must be the
+ *          element size).
+ * @it:    a struct utk_deque_iter to use as temporary storage.
+ * @dq:    the deque.
+ */
+#define utk_deque_for_each_reverse(pos, it, dq)				\
+    for (pos = utk_deque_iter_last(dq, &(it));				\
+	 pos != NULL;							\
+	 pos = (void *)(pos) != (it).end					\
+	     ? (pos) - 1 : utk_deque_iter_prev(dq, &(it)))
+
+/*
+ * utk_deque_init
+ *
+ *  Initialize an empty deque (no allocation)
+ *
+ * \param dq The deque
+ * \param elem_size Size of an element
+ * \param block_len Elements per block, 0 for blocks of
+ *                  UTK_DEQUE_BLOCK_SIZE bytes
+ * \return 0 on success or -1 to indicate error (EINVAL)
+ */
+int utk_deque_init(struct utk_deque *dq, size_t elem_size, size_t block_len);
+
+/*
+ * utk_deque_cleanup
+ *
+ *  Release the blocks of a deque
+ *
+ * \param dq The deque
+ * \return void
+ */
+void utk_deque_cleanup(struct utk_deque *dq);
+
+/*
+ * utk_deque_push_back
+ *
+ *  Add an element at the end
+ *
+ * \param dq The deque
+ * \return The new element (to fill) or NULL to indicate error (ENOMEM)
+ */
+void *utk_deque_push_back(struct utk_deque *dq);
+
+/*
+ * utk_deque_push_front
+ *
+ *  Add an element at the beginning
+ *
+ * \param dq The deque
+ * \return The new element (to fill) or NULL to indicate error (ENOMEM)
+ */
+void *utk_deque_push_front(struct utk_deque *dq);
+
+/*
+ * utk_deque_pop_back
+ *
+ *  Remove the last element
+ *
+ * \param dq The deque
+ * \param dst Where to copy the element or NULL
+ * \return 0 on success or -1 if the deque is empty (ENOENT)
+ */
+int utk_deque_pop_back(struct utk_deque *dq, void *dst);
+
+/*
+ * utk_deque_pop_front
+ *
+ *  Remove the first element
+ *
+ * \param dq The deque
+ * \param dst Where to copy the element or NULL
+ * \return 0 on success or -1 if the deque is empty (ENOENT)
+ */
+int utk_deque_pop_front(struct utk_deque *dq, void *dst);
+
+/*!
+ * utk_deque_front - first element or NULL
+ * @dq: the deque
+ */
+static inline void *utk_deque_front(const struct utk_deque *dq)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0)
+    {
+	return NULL;
+    }
+
+    block = utk_list_entry(dq->blocks.next, struct utk_deque_block, list);
+
+    return block->data + dq->head * dq->elem_size;
+}
+
+/*!
+ * utk_deque_back - last element or NULL
+ * @dq: the deque
+ */
+static inline void *utk_deque_back(const struct utk_deque *dq)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0)
+    {
+	return NULL;
+    }
+
+    block = utk_list_entry(dq->blocks.prev, struct utk_deque_block, list);
+
+    return block->data + (dq->tail - 1) * dq->elem_size;
+}
+
+static inline size_t utk_deque_count(const struct utk_deque *dq)
+{
+    return dq->count;
+}
+
+static inline int utk_deque_empty(const struct utk_deque *dq)
+{
+    return dq->count == 0;
+}
+
+/*
+ * Iteration helpers of utk_deque_for_each() and
+ * utk_deque_for_each_reverse()
+ */
+
+static inline void *utk_deque_iter_block(const struct utk_deque *dq,
+					 struct utk_deque_iter *it,
+					 struct utk_list_head *list)
+{
+    size_t start = 0,
+	end = dq->block_len;
+
+    if(list == &dq->blocks)
+    {
+	return NULL;
+    }
+
+    it->block = utk_list_entry(list, struct utk_deque_block, list);
+    if(list == dq->blocks.next)
+    {
+	start = dq->head;
+    }
+    if(list == dq->blocks.prev)
+    {
+	end = dq->tail;
+    }
+    it->end = it->block->data + end * dq->elem_size;
+
+    return it->block->data + start * dq->elem_size;
+}
+
+static inline void *utk_deque_iter_first(const struct utk_deque *dq,
+					 struct utk_deque_iter *it)
+{
+    if(dq->count == 0)
+    {
+	return NULL;
+    }
+
+    return utk_deque_iter_block(dq, it, dq->blocks.next);
+}
+
+static inline void *utk_deque_iter_next(const struct utk_deque *dq,
+					struct utk_deque_iter *it)
+{
+    return utk_deque_iter_block(dq, it, it->block->list.next);
+}
+
+static inline void *utk_deque_iter_rblock(const struct utk_deque *dq,
+					  struct utk_deque_iter *it,
+					  struct utk_list_head *list)
+{
+    size_t start = 0,
+	end = dq->block_len;
+
+    if(list == &dq->blocks)
+    {
+	return NULL;
+    }
+
+    it->block = utk_list_entry(list, struct utk_deque_block, list);
+    if(list == dq->blocks.next)
+    {
+	start = dq->head;
+    }
+    if(list == dq->blocks.prev)
+    {
+	end = dq->tail;
+    }
+    it->end = it->block->data + start * dq->elem_size;
+
+    return it->block->data + (end - 1) * dq->elem_size;
+}
+
+static inline void *utk_deque_iter_last(const struct utk_deque *dq,
+					struct utk_deque_iter *it)
+{
+    if(dq->count == 0)
+    {
+	return NULL;
+    }
+
+    return utk_deque_iter_rblock(dq, it, dq->blocks.prev);
+}
+
+static inline void *utk_deque_iter_prev(const struct utk_deque *dq,
+					struct utk_deque_iter *it)
+{
+    return utk_deque_iter_rblock(dq, it, it->block->list.prev);
+}
+
+#endif
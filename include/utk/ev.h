@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_EV_H_
+#define _UTK_EV_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/epoll.h>
+
+#include "utk/list.h"
+
+/**
+ * ev.h - event loop for non-blocking descriptors, timers and signals
+ *
+ * The loop is built on epoll(7): the cost of an iteration depends on the
+ * number of active descriptors, not on the number of registered ones.
+ *
+ * - Watchers are embedded in the user structures (container_of() gives
+ *   back the owner in callbacks) and must stay valid while started;
+ * - all functions but utk_ev_async_send() must be called from the thread
+ *   running the loop;
+ * - a watcher can be stopped (and freed) from any callback, even when it
+ *   has pending events in the current iteration.
+ */
+
+/* events of an io watcher */
+#define UTK_EV_READ 0x01
+#define UTK_EV_WRITE 0x02
+/* edge-triggered: the callback is called when the descriptor becomes
+ * ready, read or write until EAGAIN before waiting again */
+#define UTK_EV_EDGE 0x04
+/* given to callbacks: error or hang up on the descriptor */
+#define UTK_EV_ERROR 0x08
+
+struct utk_ev_loop;
+struct utk_ev_io;
+struct utk_ev_timer;
+struct utk_ev_signal;
+struct utk_ev_async;
+
+typedef void (*utk_ev_io_cb_t)(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			       int events);
+typedef void (*utk_ev_timer_cb_t)(struct utk_ev_loop *loop,
+				  struct utk_ev_timer *timer);
+typedef void (*utk_ev_signal_cb_t)(struct utk_ev_loop *loop,
+				   struct utk_ev_signal *sig);
+typedef void (*utk_ev_async_cb_t)(struct utk_ev_loop *loop,
+				  struct utk_ev_async *async);
+
+struct utk_ev_io {
+    int fd;
+    int events;
+    utk_ev_io_cb_t cb;
+};
+
+struct utk_ev_timer {
+    uint64_t expire;
+    uint64_t interval;
+    size_t index;
+    utk_ev_timer_cb_t cb;
+};
+
+struct utk_ev_signal {
+    struct utk_list_head list;
+    int signo;
+    utk_ev_signal_cb_t cb;
+};
+
+struct utk_ev_async {
+    struct utk_list_head list;
+    int pending;
+    utk_ev_async_cb_t cb;
+};
+
+struct utk_ev_loop {
+    int epfd;
+    int stop;
+    uint64_t now;
+
+    /* events of the current iteration */
+    struct epoll_event *events;
+    int nb_events;
+    int max_events;
+    int cur_event;
+
+    /* binary min heap of timers */
+    struct utk_ev_timer **timers;
+    size_t nb_timers;
+    size_t timers_size;
+
+    struct utk_ev_io signal_io;
+    sigset_t sigmask;
+    struct utk_list_head signals;
+
+    struct utk_ev_io async_io;
+    struct utk_list_head asyncs;
+};
+
+/*
+ * utk_ev_loop_init
+ *
+ *  Initialize a loop
+ *
+ * \param loop The loop
+ * \param max_events Maximum number of events handled per iteration or 0
+ *                   for the default (256)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_loop_init(struct utk_ev_loop *loop, int max_events);
+
+/*
+ * utk_ev_loop_cleanup
+ *
+ *  Release a loop
+ *
+ * - Watchers aren't touched, signals watched are unblocked.
+ *
+ * \param loop The loop
+ * \return void
+ */
+void utk_ev_loop_cleanup(struct utk_ev_loop *loop);
+
+/*
+ * utk_ev_run_once
+ *
+ *  Wait for events (until the next timer at most) and call the callbacks
+ *
+ * \param loop The loop
+ * \param timeout_ms Maximum time to wait: 0 to not wait, -1 forever
+ * \return The number of callbacks called or -1 to indicate error
+ */
+int utk_ev_run_once(struct utk_ev_loop *loop, int timeout_ms);
+
+/*
+ * utk_ev_run
+ *
+ *  Run the loop until utk_ev_stop()
+ *
+ * \param loop The loop
+ * \return 0 when stopped or -1 to indicate error
+ */
+int utk_ev_run(struct utk_ev_loop *loop);
+
+/*
+ * utk_ev_stop
+ *
+ *  Make utk_ev_run() return after the current iteration
+ *
+ * \param loop The loop
+ * \return void
+ */
+void utk_ev_stop(struct utk_ev_loop *loop);
+
+/*
+ * utk_ev_now
+ *
+ *  Time of the current iteration
+ *
+ * \param loop The loop
+ * \return Monotonic time in milliseconds
+ */
+uint64_t utk_ev_now(const struct utk_ev_loop *loop);
+
+/*
+ * utk_ev_io_start
+ *
+ *  Watch a descriptor
+ *
+ * - The descriptor should be non-blocking (see utk_io_set_nonblock()).
+ *
+ * \param loop The loop
+ * \param io The watcher
+ * \param fd The descriptor
+ * \param events UTK_EV_READ and/or UTK_EV_WRITE, with UTK_EV_EDGE for
+ *               edge-triggered notifications
+ * \param cb Callback called with the events which occurred
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_io_start(struct utk_ev_loop *loop, struct utk_ev_io *io, int fd,
+		    int events, utk_ev_io_cb_t cb);
+
+/*
+ * utk_ev_io_modify
+ *
+ *  Change the events watched
+ *
+ * \param loop The loop
+ * \param io The watcher
+ * \param events See utk_ev_io_start()
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_io_modify(struct utk_ev_loop *loop, struct utk_ev_io *io,
+		     int events);
+
+/*
+ * utk_ev_io_stop
+ *
+ *  Stop watching a descriptor (call it before closing the descriptor)
+ *
+ * \param loop The loop
+ * \param io The watcher
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_io_stop(struct utk_ev_loop *loop, struct utk_ev_io *io);
+
+/*
+ * utk_ev_timer_init
+ *
+ *  Initialize a stopped timer (before its first utk_ev_timer_start())
+ *
+ * \param timer The timer
+ * \return void
+ */
+void utk_ev_timer_init(struct utk_ev_timer *timer);
+
+/*
+ * utk_ev_timer_start
+ *
+ *  Start a timer
+ *
+ * - The timer must have been initialized with utk_ev_timer_init();
+ * - a started timer is restarted with the new timeout.
+ *
+ * \param loop The loop
+ * \param timer The timer
+ * \param timeout_ms Delay before the first expiration
+ * \param interval_ms Delay between the next expirations or 0 for a one-shot
+ *                    timer
+ * \param cb Callback called at each expiration
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_timer_start(struct utk_ev_loop *loop, struct utk_ev_timer *timer,
+		       uint64_t timeout_ms, uint64_t interval_ms,
+		       utk_ev_timer_cb_t cb);
+
+/*
+ * utk_ev_timer_stop
+ *
+ *  Stop a timer (nothing is done if it isn't started)
+ *
+ * \param loop The loop
+ * \param timer The timer
+ * \return void
+ */
+void utk_ev_timer_stop(struct utk_ev_loop *loop, struct utk_ev_timer *timer);
+
+/*
+ * utk_ev_timer_active
+ *
+ *  Tell if a timer is started
+ *
+ * \param timer The timer
+ * \return 1 if the timer is started, 0 otherwise
+ */
+int utk_ev_timer_active(const struct utk_ev_timer *timer);
+
+/*
+ * utk_ev_signal_start
+ *
+ *  Handle a signal in the loop (signalfd(2))
+ *
+ * - The signal is blocked in the calling thread: start signal watchers
+ *   before creating other threads, or block the signal in them.
+ *
+ * \param loop The loop
+ * \param sig The watcher
+ * \param signo The signal
+ * \param cb Callback called when the signal is received
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_ev_signal_start(struct utk_ev_loop *loop, struct utk_ev_signal *sig,
+			int signo, utk_ev_signal_cb_t cb);
+
+/*
+ * utk_ev_signal_stop
+ *
+ *  Stop handling a signal (it is unblocked when no watcher is left)
+ *
+ * \param loop The loop
+ * \param sig The watcher
+ * \return void
+ */
+void utk_ev_signal_stop(struct utk_ev_loop *loop, struct utk_ev_signal *sig);
+
+/*
+ * utk_ev_async_start
+ *
+ *  Start a watcher which can be triggered from other threads
+ *
+ * \param loop The loop
+ * \param async The watcher
+ * \param cb Callback called in the loop after utk_ev_async_send()
+ * \return void
+ */
+void utk_ev_async_start(struct utk_ev_loop *loop, struct utk_ev_async *async,
+			utk_ev_async_cb_t cb);
+
+/*
+ * utk_ev_async_stop
+ *
+ *  Stop an async watcher
+ *
+ * \param loop The loop
+ * \param async The watcher
+ * \return void
+ */
+void utk_ev_async_stop(struct utk_ev_loop *loop, struct utk_ev_async *async);
+
+/*
+ * utk_ev_async_send
+ *
+ *  Wake the loop up and call the callback of async (any thread)
+ *
+ * - Sends done before the callback is called are coalesced into one call.
+ *
+ * \param loop The loop
+ * \param async The watcher
+ * \return void
+ */
+void utk_ev_async_send(struct utk_ev_loop *loop, struct utk_ev_async *async);
+
+#endif
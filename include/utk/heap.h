@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_HEAP_H_
+#define _UTK_HEAP_H_
+
+#include <stdlib.h>
+
+#include "utk/list.h"
+
+/**
+ * heap.h - intrusive priority queues
+ *
+ * Two heaps of entries embedding a node, found back with
+ * utk_heap_entry() or utk_pheap_entry() (container_of()):
+ *
+ * - struct utk_heap: d-ary heap over an array of node pointers. Nodes
+ *   store their position, so a node can be removed or moved after a
+ *   change of its key in O(log n). The array grows by doubling;
+ * - struct utk_pheap: pairing heap of linked nodes, no allocation at
+ *   all. Push and decrease-key are O(1), pop and remove O(log n)
+ *   amortized.
+ *
+ * The top of both heaps is the node which sorts first for the compare
+ * function (a min heap with a "less than" function). The heaps don't
+ * lock: protect them if several threads use them.
+ */
+
+#define UTK_HEAP_DEFAULT_ARITY 4
+
+struct utk_heap_node {
+    /* position in the heap plus one, 0 if not queued */
+    size_t index;
+};
+
+/*
+ * Compare function: return < 0 if a must be popped before b
+ */
+typedef int (*utk_heap_cmp_cb_t)(const struct utk_heap_node *a,
+				 const struct utk_heap_node *b);
+
+struct utk_heap {
+    struct utk_heap_node **nodes;
+    size_t count;
+    size_t size;
+    size_t arity;
+    utk_heap_cmp_cb_t cmp;
+};
+
+struct utk_pheap_node {
+    struct utk_pheap_node *child;
+    struct utk_pheap_node *next;
+    /* parent for a first child, previous sibling otherwise */
+    struct utk_pheap_node *prev;
+};
+
+/*
+ * Compare function: return < 0 if a must be popped before b
+ */
+typedef int (*utk_pheap_cmp_cb_t)(const struct utk_pheap_node *a,
+				  const struct utk_pheap_node *b);
+
+struct utk_pheap {
+    struct utk_pheap_node *root;
+    size_t count;
+    utk_pheap_cmp_cb_t cmp;
+};
+
+/*!
+ * utk_heap_entry - get the struct for this node
+ * @ptr:    the &struct utk_heap_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_heap_node within the struct.
+ */
+#define utk_heap_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_heap_entry_safe - get the struct for this node or NULL
+ * @ptr:    the &struct utk_heap_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_heap_node within the struct.
+ */
+#define utk_heap_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_heap_entry(____ptr, type, member) : NULL;})
+
+/*!
+ * utk_pheap_entry - get the struct for this node
+ * @ptr:    the &struct utk_pheap_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_pheap_node within the struct.
+ */
+#define utk_pheap_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_pheap_entry_safe - get the struct for this node or NULL
+ * @ptr:    the &struct utk_pheap_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_pheap_node within the struct.
+ */
+#define utk_pheap_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_pheap_entry(____ptr, type, member) : NULL;})
+
+/*
+ * utk_heap_init
+ *
+ *  Initialize a d-ary heap
+ *
+ * \param heap The heap
+ * \param arity Number of children per node (>= 2), 0 for
+ *              UTK_HEAP_DEFAULT_ARITY
+ * \param cmp Compare function
+ * \return 0 on success or -1 to indicate error (EINVAL)
+ */
+int utk_heap_init(struct utk_heap *heap, size_t arity, utk_heap_cmp_cb_t cmp);
+
+/*
+ * utk_heap_cleanup
+ *
+ *  Release the array of a heap (nodes aren't touched)
+ *
+ * \param heap The heap
+ * \return void
+ */
+void utk_heap_cleanup(struct utk_heap *heap);
+
+/*
+ * utk_heap_push
+ *
+ *  Queue a node
+ *
+ * \param heap The heap
+ * \param node The node (not queued)
+ * \return 0 on success or -1 to indicate error (ENOMEM)
+ */
+int utk_heap_push(struct utk_heap *heap, struct utk_heap_node *node);
+
+/*
+ * utk_heap_pop
+ *
+ *  Remove the top node
+ *
+ * \param heap The heap
+ * \return The node or NULL if the heap is empty
+ */
+struct utk_heap_node *utk_heap_pop(struct utk_heap *heap);
+
+/*
+ * utk_heap_remove
+ *
+ *  Remove a queued node
+ *
+ * \param heap The heap
+ * \param node The node
+ * \return void
+ */
+void utk_heap_remove(struct utk_heap *heap, struct utk_heap_node *node);
+
+/*
+ * utk_heap_update
+ *
+ *  Move a queued node after a change of its key (decrease or increase)
+ *
+ * \param heap The heap
+ * \param node The node
+ * \return void
+ */
+void utk_heap_update(struct utk_heap *heap, struct utk_heap_node *node);
+
+/*!
+ * utk_heap_top - node which is popped next or NULL
+ * @heap: the heap
+ */
+static inline struct utk_heap_node *utk_heap_top(const struct utk_heap *heap)
+{
+    return heap->count > 0 ? heap->nodes[0] : NULL;
+}
+
+static inline size_t utk_heap_count(const struct utk_heap *heap)
+{
+    return heap->count;
+}
+
+/*!
+ * utk_heap_queued - is node in a heap?
+ * @node: the node (zeroed or popped if not)
+ */
+static inline int utk_heap_queued(const struct utk_heap_node *node)
+{
+    return node->index != 0;
+}
+
+/*
+ * utk_pheap_init
+ *
+ *  Initialize a pairing heap
+ *
+ * \param heap The heap
+ * \param cmp Compare function
+ * \return void
+ */
+void utk_pheap_init(struct utk_pheap *heap, utk_pheap_cmp_cb_t cmp);
+
+/*
+ * utk_pheap_push
+ *
+ *  Queue a node
+ *
+ * \param heap The heap
+ * \param node The node (not queued)
+ * \return void
+ */
+void utk_pheap_push(struct utk_pheap *heap, struct utk_pheap_node *node);
+
+/*
+ * utk_pheap_pop
+ *
+ *  Remove the top node
+ *
+ * \param heap The heap
+ * \return The node or NULL if the heap is empty
+ */
+struct utk_pheap_node *utk_pheap_pop(struct utk_pheap *heap);
+
+/*
+ * utk_pheap_remove
+ *
+ *  Remove a queued node
+ *
+ * \param heap The heap
+ * \param node The node
+ * \return void
+ */
+void utk_pheap_remove(struct utk_pheap *heap, struct utk_pheap_node *node);
+
+/*
+ * utk_pheap_decrease
+ *
+ *  Move a queued node after its key was decreased (it sorts earlier)
+ *
+ * - Use utk_pheap_remove() and utk_pheap_push() for an increase.
+ *
+ * \param heap The heap
+ * \param node The node
+ * \return void
+ */
+void utk_pheap_decrease(struct utk_pheap *heap, struct utk_pheap_node *node);
+
+/*!
+ * utk_pheap_top - node which is popped next or NULL
+ * @heap: the heap
+ */
+static inline struct utk_pheap_node *
+utk_pheap_top(const struct utk_pheap *heap)
+{
+    return heap->root;
+}
+
+static inline size_t utk_pheap_count(const struct utk_pheap *heap)
+{
+    return heap->count;
+}
+
+/*!
+ * utk_pheap_queued - is node in heap?
+ * @heap: the heap
+ * @node: the node (zeroed or popped if not)
+ */
+static inline int utk_pheap_queued(const struct utk_pheap *heap,
+				   const struct utk_pheap_node *node)
+{
+    return node == heap->root || node->prev != NULL;
+}
+
+#endif
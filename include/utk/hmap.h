@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_HMAP_H_
+#define _UTK_HMAP_H_
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * hmap.h - open addressing hash map generated for a key and a value type
+ *
+ * UTK_HMAP_DEFINE(name, key_t, val_t, hash, eq) defines struct name and
+ * its functions:
+ *
+ *  int name_init(struct name *m, size_t size, unsigned int max_load);
+ *  void name_cleanup(struct name *m);
+ *  size_t name_count(const struct name *m);
+ *  val_t *name_get(struct name *m, key_t key);
+ *  int name_put(struct name *m, key_t key, val_t val);
+ *  int name_del(struct name *m, key_t key);
+ *
+ * hash(key) returns a size_t, eq(a, b) is true if two keys are equal;
+ * both may be macros. Example:
+ *
+ *  UTK_HMAP_DEFINE(id_map, uint64_t, uint32_t,
+ *                  utk_hmap_hash_u64, UTK_HMAP_EQ)
+ *
+ *  struct id_map map;
+ *  uint32_t *index = NULL;
+ *
+ *  id_map_init(&map, 0, 0);
+ *  id_map_put(&map, 42, 7);
+ *  index = id_map_get(&map, 42);
+ *
+ * - Keys and values are stored in a flat array of slots with Robin Hood
+ *   linear probing: an entry takes the slot of a "richer" entry (closer
+ *   to its home slot), which bounds probe lengths. Probe distances are
+ *   kept in a separate byte array, a lookup stops at the first slot
+ *   which is closer to its home than the key would be;
+ * - deletion shifts the following entries back (no tombstone);
+ * - the map doubles when it holds more than max_load percent of its
+ *   slots (UTK_HMAP_DEFAULT_LOAD if 0), or if a probe distance would
+ *   exceed UTK_HMAP_MAX_DIST;
+ * - pointers returned by name_get() and slot indexes of
+ *   utk_hmap_for_each() are valid until the next name_put() or
+ *   name_del();
+ * - keys and values are copied by assignment: use small types.
+ */
+
+#define UTK_HMAP_MIN_SIZE 8
+#define UTK_HMAP_DEFAULT_LOAD 80
+#define UTK_HMAP_MAX_DIST 255
+
+#define UTK_HMAP_EQ(a, b) ((a) == (b))
+
+/*
+ * utk_hmap_hash_u64
+ *
+ *  Hash an integer key (mixer of MurmurHash3)
+ *
+ * \param key The key
+ * \return The hash
+ */
+static inline size_t utk_hmap_hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (size_t)key;
+}
+
+/*
+ * utk_hmap_scan
+ *
+ *  Index of the first used slot from i (see utk_hmap_for_each())
+ *
+ * \param dist Distances of the slots
+ * \param mask Number of slots - 1
+ * \param i Index to start from
+ * \return The index or mask + 1 at the end
+ */
+static inline size_t utk_hmap_scan(const uint8_t *dist, size_t mask, size_t i)
+{
+    while(i <= mask && dist[i] == 0)
+    {
+	i++;
+    }
+
+    return i;
+}
+
+/*!
+ * utk_hmap_for_each    -    iterate over the used slots of a map
+ * @i:    the size_t to use as a loop counter.
+ * @m:    the map.
+ *
+ * Entries mustn't be added or removed while iterating.
+ */
+#define utk_hmap_for_each(i, m)						\
+    for (i = utk_hmap_scan((m)->dist, (m)->mask, 0);			\
+	 i <= (m)->mask;						\
+	 i = utk_hmap_scan((m)->dist, (m)->mask, i + 1))
+
+/*!
+ * utk_hmap_key - key of a used slot
+ * @m:    the map.
+ * @i:    the slot index.
+ */
+#define utk_hmap_key(m, i) ((m)->slots[i].key)
+
+/*!
+ * utk_hmap_val - value of a used slot
+ * @m:    the map.
+ * @i:    the slot index.
+ */
+#define utk_hmap_val(m, i) ((m)->slots[i].val)
+
+#define UTK_HMAP_DEFINE(name, key_t, val_t, hash, eq)			\
+									\
+struct name##_slot {							\
+    key_t key;								\
+    val_t val;								\
+};									\
+									\
+struct name {								\
+    struct name##_slot *slots;						\
+    /* probe distance + 1 of each slot, 0 if empty */			\
+    uint8_t *dist;							\
+    size_t mask;							\
+    size_t count;							\
+    size_t max_count;							\
+    unsigned int max_load;						\
+};									\
+									\
+static inline size_t name##_max_count(size_t size, unsigned int max_load) \
+{									\
+    return size / 100 * max_load + size % 100 * max_load / 100;		\
+}									\
+									\
+/* find the slot of key, return mask + 1 if not found */		\
+static inline size_t name##_lookup(const struct name *m, key_t key)	\
+{									\
+    size_t i = (size_t)(hash(key)) & m->mask;				\
+    unsigned int d = 1;							\
+									\
+    while(m->dist[i] >= d)						\
+    {									\
+	if(m->dist[i] == d && eq(m->slots[i].key, key))			\
+	{								\
+	    return i;							\
+	}								\
+	i = (i + 1) & m->mask;						\
+	d++;								\
+    }									\
+									\
+    return m->mask + 1;							\
+}									\
+									\
+/* insert a new key (shift the run right), -1 if a distance overflows */ \
+static inline int name##_place(struct name *m, key_t key, val_t val)	\
+{									\
+    size_t i = (size_t)(hash(key)) & m->mask;				\
+    size_t e;								\
+    unsigned int d = 1;							\
+									\
+    /* richer entries are passed */					\
+    while(m->dist[i] >= d)						\
+    {									\
+	if(++d > UTK_HMAP_MAX_DIST)					\
+	{								\
+	    return -1;							\
+	}								\
+	i = (i + 1) & m->mask;						\
+    }									\
+									\
+    /* the run up to the next empty slot is shifted by one */		\
+    for(e = i; m->dist[e] != 0; e = (e + 1) & m->mask)			\
+    {									\
+	if(m->dist[e] == UTK_HMAP_MAX_DIST)				\
+	{								\
+	    return -1;							\
+	}								\
+    }									\
+    for(; e != i; e = (e - 1) & m->mask)				\
+    {									\
+	m->slots[e] = m->slots[(e - 1) & m->mask];			\
+	m->dist[e] = (uint8_t)(m->dist[(e - 1) & m->mask] + 1);		\
+    }									\
+									\
+    m->slots[i].key = key;						\
+    m->slots[i].val = val;						\
+    m->dist[i] = (uint8_t)d;						\
+    m->count++;								\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_resize(struct name *m, size_t size)		\
+{									\
+    struct name old = *m;						\
+    size_t i;								\
+									\
+    for(;;)								\
+    {									\
+	if(size > SIZE_MAX / sizeof(struct name##_slot))		\
+	{								\
+	    errno = ENOMEM;						\
+	    return -1;							\
+	}								\
+									\
+	m->slots = malloc(size * sizeof(struct name##_slot));		\
+	m->dist = calloc(size, 1);					\
+	if(m->slots == NULL || m->dist == NULL)				\
+	{								\
+	    free(m->slots);						\
+	    free(m->dist);						\
+	    *m = old;							\
+	    errno = ENOMEM;						\
+	    return -1;							\
+	}								\
+	m->mask = size - 1;						\
+	m->count = 0;							\
+	m->max_count = name##_max_count(size, m->max_load);		\
+									\
+	for(i = 0; i < old.mask + 1; ++i)				\
+	{								\
+	    if(old.dist[i] != 0						\
+	       && name##_place(m, old.slots[i].key, old.slots[i].val) != 0) \
+	    {								\
+		break;							\
+	    }								\
+	}								\
+	if(i == old.mask + 1)						\
+	{								\
+	    break;							\
+	}								\
+									\
+	/* too many collisions: try bigger */				\
+	free(m->slots);							\
+	free(m->dist);							\
+	size <<= 1;							\
+    }									\
+									\
+    free(old.slots);							\
+    free(old.dist);							\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_init(struct name *m, size_t size,		\
+			      unsigned int max_load)			\
+{									\
+    size_t capacity = UTK_HMAP_MIN_SIZE;				\
+									\
+    if(max_load == 0)							\
+    {									\
+	max_load = UTK_HMAP_DEFAULT_LOAD;				\
+    }									\
+    if(max_load >= 100)							\
+    {									\
+	errno = EINVAL;							\
+	return -1;							\
+    }									\
+									\
+    while(name##_max_count(capacity, max_load) < size)			\
+    {									\
+	if(capacity > (SIZE_MAX >> 2))					\
+	{								\
+	    errno = EINVAL;						\
+	    return -1;							\
+	}								\
+	capacity <<= 1;							\
+    }									\
+									\
+    m->slots = malloc(capacity * sizeof(struct name##_slot));		\
+    m->dist = calloc(capacity, 1);					\
+    if(m->slots == NULL || m->dist == NULL)				\
+    {									\
+	free(m->slots);							\
+	free(m->dist);							\
+	errno = ENOMEM;							\
+	return -1;							\
+    }									\
+    m->mask = capacity - 1;						\
+    m->count = 0;							\
+    m->max_load = max_load;						\
+    m->max_count = name##_max_count(capacity, max_load);		\
+									\
+    return 0;								\
+}									\
+									\
+static inline void name##_cleanup(struct name *m)			\
+{									\
+    free(m->slots);							\
+    free(m->dist);							\
+    m->slots = NULL;							\
+    m->dist = NULL;							\
+    m->count = 0;							\
+}									\
+									\
+static inline size_t name##_count(const struct name *m)			\
+{									\
+    return m->count;							\
+}									\
+									\
+static inline val_t *name##_get(struct name *m, key_t key)		\
+{									\
+    size_t i = name##_lookup(m, key);					\
+									\
+    return i > m->mask ? NULL : &m->slots[i].val;			\
+}									\
+									\
+static inline int name##_put(struct name *m, key_t key, val_t val)	\
+{									\
+    size_t i = name##_lookup(m, key);					\
+									\
+    if(i <= m->mask)							\
+    {									\
+	m->slots[i].val = val;						\
+	return 0;							\
+    }									\
+									\
+    if(m->count >= m->max_count						\
+       && name##_resize(m, (m->mask + 1) << 1) != 0)			\
+    {									\
+	return -1;							\
+    }									\
+    while(name##_place(m, key, val) != 0)				\
+    {									\
+	if(name##_resize(m, (m->mask + 1) << 1) != 0)			\
+	{								\
+	    return -1;							\
+	}								\
+    }									\
+									\
+    return 0;								\
+}									\
+									\
+static inline int name##_del(struct name *m, key_t key)			\
+{									\
+    size_t i = name##_lookup(m, key);					\
+    size_t j;								\
+									\
+    if(i > m->mask)							\
+    {									\
+	errno = ENOENT;							\
+	return -1;							\
+    }									\
+									\
+    /* backward shift: no tombstone */					\
+    for(j = (i + 1) & m->mask; m->dist[j] > 1; j = (j + 1) & m->mask)	\
+    {									\
+	m->slots[i] = m->slots[j];					\
+	m->dist[i] = (uint8_t)(m->dist[j] - 1);				\
+	i = j;								\
+    }									\
+    m->dist[i] = 0;							\
+    m->count--;								\
+									\
+    return 0;								\
+}
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_HTABLE_H_
+#define _UTK_HTABLE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "utk/list.h"
+
+/**
+ * htable.h - intrusive hash table
+ *
+ * Entries embed a struct utk_htable_node and are found back with
+ * utk_htable_entry() (container_of()), like utk_list_entry(). Buckets are
+ * utk_hlist_head: one pointer each.
+ *
+ * - The table is keyed by a user hash function and a compare function;
+ *   the hash of each entry is kept in its node, so chains are walked
+ *   without calling compare on other hashes and the table is resized
+ *   without hashing again;
+ * - the table doubles when it holds more entries than buckets. The
+ *   entries are moved to the new buckets incrementally, a few buckets at
+ *   each utk_htable_add(): a growth never stalls a single insertion;
+ * - utk_htable_find() and utk_htable_del() never move entries, entries
+ *   can be looked up and deleted while iterating (but not added);
+ * - the table doesn't lock: protect it if several threads use it.
+ */
+
+struct utk_htable_node {
+    struct utk_hlist_node node;
+    size_t hash;
+};
+
+/*
+ * Hash function of keys
+ */
+typedef size_t (*utk_htable_hash_cb_t)(const void *key);
+
+/*
+ * Compare function: return 0 if node has key
+ */
+typedef int (*utk_htable_cmp_cb_t)(const struct utk_htable_node *node,
+				   const void *key);
+
+struct utk_htable {
+    /* buckets[1] is the new table while rehashing */
+    struct utk_hlist_head *buckets[2];
+    size_t mask[2];
+    size_t rehash_pos;
+    size_t count;
+    utk_htable_hash_cb_t hash;
+    utk_htable_cmp_cb_t cmp;
+};
+
+/*!
+ * utk_htable_entry - get the struct for this node
+ * @ptr:    the &struct utk_htable_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_htable_node within the struct.
+ */
+#define utk_htable_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_htable_entry_safe - get the struct for this node or NULL
+ * @ptr:    the &struct utk_htable_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_htable_node within the struct.
+ */
+#define utk_htable_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_htable_entry(____ptr, type, member) : NULL;})
+
+/*!
+ * utk_htable_for_each    -    iterate over the nodes of a table
+ * @pos:    the &struct utk_htable_node to use as a loop counter.
+ * @ht:    the table.
+ */
+#define utk_htable_for_each(pos, ht)					\
+    for (pos = utk_htable_first(ht); pos; pos = utk_htable_next(ht, pos))
+
+/*!
+ * utk_htable_for_each_safe - iterate over the nodes of a table safe
+ * against removal of node
+ * @pos:    the &struct utk_htable_node to use as a loop counter.
+ * @n:        another &struct utk_htable_node to use as temporary storage
+ * @ht:    the table.
+ */
+#define utk_htable_for_each_safe(pos, n, ht)				\
+    for (pos = utk_htable_first(ht);					\
+	 pos && ({ n = utk_htable_next(ht, pos); 1; });			\
+	 pos = n)
+
+/*!
+ * utk_htable_for_each_entry    -    iterate over the entries of a table
+ * @pos:    the type * to use as a loop counter.
+ * @ht:    the table.
+ * @member:    the name of the utk_htable_node within the struct.
+ */
+#define utk_htable_for_each_entry(pos, ht, member)			\
+    for (pos = utk_htable_entry_safe(utk_htable_first(ht),		\
+				     typeof(*pos), member);		\
+	 pos;								\
+	 pos = utk_htable_entry_safe(utk_htable_next(ht, &pos->member),	\
+				     typeof(*pos), member))
+
+/*!
+ * utk_htable_for_each_entry_safe - iterate over the entries of a table
+ * safe against removal of entry
+ * @pos:    the type * to use as a loop counter.
+ * @n:        another type * to use as temporary storage
+ * @ht:    the table.
+ * @member:    the name of the utk_htable_node within the struct.
+ */
+#define utk_htable_for_each_entry_safe(pos, n, ht, member)		\
+    for (pos = utk_htable_entry_safe(utk_htable_first(ht),		\
+				     typeof(*pos), member);		\
+	 pos && ({ n = utk_htable_entry_safe(utk_htable_next(ht,	\
+							     &pos->member), \
+					     typeof(*pos), member); 1; }); \
+	 pos = n)
+
+/*!
+ * utk_htable_for_each_possible_entry - iterate over the entries which may
+ * have a key (same hash), to find duplicated keys
+ * @pos:    the type * to use as a loop counter.
+ * @ht:    the table.
+ * @key:    the key.
+ * @member:    the name of the utk_htable_node within the struct.
+ */
+#define utk_htable_for_each_possible_entry(pos, ht, key, member)	\
+    for (pos = utk_htable_entry_safe(utk_htable_find(ht, key),		\
+				     typeof(*pos), member);		\
+	 pos;								\
+	 pos = utk_htable_entry_safe(utk_htable_find_next(ht, &pos->member, \
+							  key),		\
+				     typeof(*pos), member))
+
+/*
+ * utk_htable_init
+ *
+ *  Initialize a table
+ *
+ * \param ht The table
+ * \param size Number of entries expected (the table grows anyway), may be 0
+ * \param hash Hash function of keys
+ * \param cmp Compare function
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_htable_init(struct utk_htable *ht, size_t size,
+		    utk_htable_hash_cb_t hash, utk_htable_cmp_cb_t cmp);
+
+/*
+ * utk_htable_cleanup
+ *
+ *  Release the buckets of a table (entries aren't touched)
+ *
+ * \param ht The table
+ * \return void
+ */
+void utk_htable_cleanup(struct utk_htable *ht);
+
+/*
+ * utk_htable_add
+ *
+ *  Add an entry
+ *
+ * - The key isn't checked for unicity: use utk_htable_find() before if
+ *   needed.
+ *
+ * \param ht The table
+ * \param node Node of the entry
+ * \param key Key of the entry
+ * \return 0 on success or -1 to indicate error (the table couldn't grow,
+ *         the entry is added anyway)
+ */
+int utk_htable_add(struct utk_htable *ht, struct utk_htable_node *node,
+		   const void *key);
+
+/*
+ * utk_htable_del
+ *
+ *  Remove an entry
+ *
+ * \param ht The table
+ * \param node Node of the entry
+ * \return void
+ */
+void utk_htable_del(struct utk_htable *ht, struct utk_htable_node *node);
+
+/*
+ * utk_htable_find
+ *
+ *  Find an entry by key
+ *
+ * \param ht The table
+ * \param key The key
+ * \return The node of the first entry with key or NULL
+ */
+struct utk_htable_node *utk_htable_find(const struct utk_htable *ht,
+					const void *key);
+
+/*
+ * utk_htable_find_next
+ *
+ *  Find the next entry with the same key
+ *
+ * \param ht The table
+ * \param node Node returned by utk_htable_find() or this function
+ * \param key The key
+ * \return The node of the next entry with key or NULL
+ */
+struct utk_htable_node *utk_htable_find_next(const struct utk_htable *ht,
+					     const struct utk_htable_node *node,
+					     const void *key);
+
+/*
+ * utk_htable_count
+ *
+ *  Number of entries in a table
+ *
+ * \param ht The table
+ * \return The number of entries
+ */
+static inline size_t utk_htable_count(const struct utk_htable *ht)
+{
+    return ht->count;
+}
+
+/*
+ * utk_htable_first
+ *
+ *  First node of an iteration over a table (see utk_htable_for_each())
+ *
+ * \param ht The table
+ * \return The node or NULL if the table is empty
+ */
+struct utk_htable_node *utk_htable_first(const struct utk_htable *ht);
+
+/*
+ * utk_htable_next
+ *
+ *  Next node of an iteration over a table
+ *
+ * \param ht The table
+ * \param node The current node
+ * \return The node or NULL at the end of the table
+ */
+struct utk_htable_node *utk_htable_next(const struct utk_htable *ht,
+					const struct utk_htable_node *node);
+
+/*
+ * utk_htable_hash_u64
+ *
+ *  Hash an integer key (mixer of MurmurHash3)
+ *
+ * \param key The key
+ * \return The hash
+ */
+static inline size_t utk_htable_hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (size_t)key;
+}
+
+/*
+ * utk_htable_hash_str
+ *
+ *  Hash a string key (FNV-1a)
+ *
+ * \param key The key
+ * \return The hash
+ */
+static inline size_t utk_htable_hash_str(const char *key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while(*key != '\0')
+    {
+	hash ^= (unsigned char)*key++;
+	hash *= 0x100000001b3ULL;
+    }
+
+    return (size_t)hash;
+}
+
+#endif
@@ -23,6 +23,26 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "utk/list.h"
+
+/*
+ * Allocator used by functions which size their destination buffer
+ * themselves (utk_io_file_read_all(), ...).
+ *
+ * - realloc() must behave like realloc(3): ptr may be NULL for the
+ *   first allocation, old_size is given for arena or pool allocators
+ *   which can't guess it;
+ * - free() is called on the buffer when an error occurred, it may
+ *   be NULL if the allocator doesn't need it (arena).
+ */
+struct utk_io_allocator {
+    void *(*realloc)(void *opaque, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *opaque, void *ptr);
+    void *opaque;
+};
 
 /*
  * utk_io_write
@@ -52,6 +72,87 @@ ssize_t utk_io_write(int fd, const void *buf, size_t len);
  */
 ssize_t utk_io_read(int fd, void *dst, size_t len);
 
+/*
+ * utk_io_pwrite
+ *
+ *  Write data in file by his descriptor at a given offset
+ *
+ * - Like utk_io_write() but the file offset isn't used nor changed: several
+ *   threads can share the same descriptor.
+ *
+ * \param fd File descriptor
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \param offset Position in file where data are written
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_io_pwrite(int fd, const void *buf, size_t len, off_t offset);
+
+/*
+ * utk_io_pread
+ *
+ *  Read data from file by his descriptor at a given offset
+ *
+ * - Like utk_io_read() but the file offset isn't used nor changed: several
+ *   threads can share the same descriptor;
+ * - If you want read a string, be sure to put the \0 caracter at
+ *   the value of the return (when this function doesn't return -1 !)
+ *
+ * \param fd File descriptor
+ * \param dst Destination pointer
+ * \param len Number of byte being read and copied to destination pointer
+ * \param offset Position in file where data are read
+ * \return The number of byte actually read (less or egal to len, less
+ *         only at end of file) or -1 to indicate error
+ */
+ssize_t utk_io_pread(int fd, void *dst, size_t len, off_t offset);
+
+/*
+ * utk_io_set_nonblock
+ *
+ *  Set or clear O_NONBLOCK on a descriptor
+ *
+ * \param fd File descriptor
+ * \param nonblock 1 to set, 0 to clear
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_set_nonblock(int fd, int nonblock);
+
+/*
+ * utk_io_write_nonblock
+ *
+ *  Write data in a non-blocking descriptor
+ *
+ * - Like utk_io_write() but stops when the descriptor can't take more
+ *   data: a return less than len means write(2) gave EAGAIN;
+ * - data already written isn't lost in an error, the number of byte
+ *   written is returned.
+ *
+ * \param fd File descriptor
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error (errno is
+ *         EAGAIN if nothing could be written)
+ */
+ssize_t utk_io_write_nonblock(int fd, const void *buf, size_t len);
+
+/*
+ * utk_io_read_nonblock
+ *
+ *  Read data from a non-blocking descriptor
+ *
+ * - Like utk_io_read() but stops when no more data is available: a
+ *   return less than len means read(2) gave EAGAIN or end of file, the
+ *   next call gives -1 with EAGAIN or 0.
+ *
+ * \param fd File descriptor
+ * \param dst Destination pointer
+ * \param len Number of byte being read and copied to destination pointer
+ * \return The number of byte read, 0 at end of file or -1 to indicate
+ *         error (errno is EAGAIN if no data is available)
+ */
+ssize_t utk_io_read_nonblock(int fd, void *dst, size_t len);
+
 /*
  * utk_io_file_write
  *
@@ -80,4 +181,864 @@ ssize_t utk_io_file_write(const char *filename, const void *buf, size_t len);
  */
 ssize_t utk_io_file_read(const char *filename, void *dst, size_t len);
 
+/*
+ * utk_io_read_all
+ *
+ *  Read all data from file descriptor until end of file in a buffer
+ *  allocated by this function
+ *
+ * - For regular files, buffer is sized with fstat() in one allocation
+ *   (with room to see the end of file) in the common case, data are
+ *   read until end of file: a file growing after fstat() isn't
+ *   truncated;
+ * - for special files (pipes, procfs, sysfs, ...) where size is unknown,
+ *   buffer grows geometrically;
+ * - buffer is always terminated by a \0 caracter (not counted in return),
+ *   so it can be used as a string;
+ * - when alloc is NULL, buffer is allocated with realloc(3) and must be
+ *   released with free(3).
+ *
+ * \param fd File descriptor
+ * \param dst Pointer where the address of the allocated buffer is stored
+ * \param alloc Allocator used for the buffer or NULL for libc allocator
+ * \return The number of byte read or -1 to indicate error (*dst is
+ *         untouched in this case)
+ */
+ssize_t utk_io_read_all(int fd, void **dst,
+			const struct utk_io_allocator *alloc);
+
+/*
+ * utk_io_file_read_all
+ *
+ *  Read all data from file by his filename in a buffer allocated by this
+ *  function
+ *
+ * - See utk_io_read_all().
+ *
+ * \param filename File name
+ * \param dst Pointer where the address of the allocated buffer is stored
+ * \param alloc Allocator used for the buffer or NULL for libc allocator
+ * \return The number of byte read or -1 to indicate error
+ */
+ssize_t utk_io_file_read_all(const char *filename, void **dst,
+			     const struct utk_io_allocator *alloc);
+
+/*
+ * utk_io_file_replace
+ *
+ *  Replace atomically and durably the content of a file by his filename
+ *
+ * - data are written in a temporary file in the same directory, this file
+ *   is synced to disk then renamed over filename and the directory is
+ *   synced. After a crash, filename contains either old or new data, never
+ *   a mix of both;
+ * - unlike utk_io_file_write(), the file is truncated to len;
+ * - mode of an existing file is kept.
+ *
+ * \param filename File name
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_io_file_replace(const char *filename, const void *buf, size_t len);
+
+/*
+ * Group commit context.
+ *
+ *  Threads replacing files concurrently with utk_io_group_commit_replace()
+ *  share syncfs(2) rounds instead of each paying its own fsync latency.
+ *  All the files must live on the filesystem of the path given to
+ *  utk_io_group_commit_init().
+ */
+struct utk_io_group_commit {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int fd;
+    int syncing;
+    unsigned long started;
+    unsigned long completed;
+    unsigned long failed;
+    int failed_errno;
+};
+
+/*
+ * utk_io_group_commit_init
+ *
+ *  Init a group commit context
+ *
+ * \param gc The context which will be initialized
+ * \param path A file or a directory of the filesystem where files will be
+ *             replaced
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_group_commit_init(struct utk_io_group_commit *gc, const char *path);
+
+/*
+ * utk_io_group_commit_cleanup
+ *
+ *  Release a group commit context
+ *
+ * - No utk_io_group_commit_replace() must be in progress.
+ *
+ * \param gc The context
+ * \return void
+ */
+void utk_io_group_commit_cleanup(struct utk_io_group_commit *gc);
+
+/*
+ * utk_io_group_commit_replace
+ *
+ *  Same as utk_io_file_replace() but syncs are batched with other threads
+ *  using the same group commit context
+ *
+ * - Return only when the new content is durable.
+ *
+ * \param gc The group commit context
+ * \param filename File name
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_io_group_commit_replace(struct utk_io_group_commit *gc,
+				    const char *filename,
+				    const void *buf, size_t len);
+
+/*
+ * Callback called by utk_io_file_read_parallel() each time a chunk of the
+ * file has arrived in the destination buffer.
+ *
+ * - It is called from the worker threads, concurrently and in any order;
+ * - return 0 to continue, another value to abort the read.
+ */
+typedef int (*utk_io_chunk_cb_t)(void *opaque, const void *chunk,
+				 off_t offset, size_t len);
+
+/*
+ * utk_io_file_read_parallel
+ *
+ *  Read data from file by his filename with several threads
+ *
+ * - The file is split in ranges of chunk_size bytes which are read with
+ *   pread(2) by nb_threads workers (the caller thread is one of them)
+ *   directly into dst;
+ * - chunk_size 0 means a default size (1MiB), nb_threads 0 means one
+ *   thread per online CPU;
+ * - cb, if not NULL, lets parsing start before the whole file has arrived.
+ *
+ * \param filename File name
+ * \param dst Destination pointer
+ * \param len Number of byte being read and copied to destination pointer
+ * \param nb_threads Number of threads reading the file
+ * \param chunk_size Size of each range
+ * \param cb Callback called for each chunk read or NULL
+ * \param opaque Argument given to cb
+ * \return The number of byte actually read (less or egal to len)
+ *         or -1 to indicate error
+ */
+ssize_t utk_io_file_read_parallel(const char *filename, void *dst, size_t len,
+				  unsigned int nb_threads, size_t chunk_size,
+				  utk_io_chunk_cb_t cb, void *opaque);
+
+/*
+ * Direct I/O (O_DIRECT) mode.
+ *
+ *  Data bypass the page cache: large sequential streams don't evict the
+ *  hot working set and don't produce write-back stalls.
+ *
+ *  O_DIRECT requires buffer address, file offset and length to be aligned
+ *  on dio->align. utk_io_direct_write() and utk_io_direct_read() transfer
+ *  the aligned part with O_DIRECT and the unaligned tail with a buffered
+ *  transfer, so the tail of a stream doesn't need padding. Once the file
+ *  offset is unaligned, or if buffer isn't aligned, transfers are
+ *  buffered.
+ *
+ *  Buffered transfers use tail_fd, a second descriptor of the file opened
+ *  without O_DIRECT: the mode of fd never changes. Transfers are done at
+ *  dio->offset with pwrite(2)/pread(2), not at the descriptors offset.
+ *
+ *  Allocate buffers with utk_io_direct_alloc() to respect alignment.
+ */
+struct utk_io_direct {
+    int fd;
+    int tail_fd;
+    size_t align;
+    off_t offset;
+};
+
+/*
+ * utk_io_direct_open
+ *
+ *  Open a file in direct I/O mode
+ *
+ * - flags are the open(2) flags, O_DIRECT is added by this function;
+ * - fail with EINVAL if the filesystem doesn't support O_DIRECT.
+ *
+ * \param dio The direct I/O context which will be initialized
+ * \param filename File name
+ * \param flags open(2) flags
+ * \param mode open(2) mode when O_CREAT is in flags
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_direct_open(struct utk_io_direct *dio, const char *filename,
+		       int flags, mode_t mode);
+
+/*
+ * utk_io_direct_close
+ *
+ *  Close a file opened with utk_io_direct_open()
+ *
+ * \param dio The direct I/O context
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_direct_close(struct utk_io_direct *dio);
+
+/*
+ * utk_io_direct_alloc
+ *
+ *  Allocate a buffer suitable for direct I/O
+ *
+ * - size is rounded up to a multiple of dio->align;
+ * - release buffer with free(3).
+ *
+ * \param dio The direct I/O context
+ * \param size Size of the buffer
+ * \return The buffer or NULL to indicate error
+ */
+void *utk_io_direct_alloc(const struct utk_io_direct *dio, size_t size);
+
+/*
+ * utk_io_direct_write
+ *
+ *  Write data in a file opened in direct I/O mode
+ *
+ * \param dio The direct I/O context
+ * \param buf Source pointer (aligned on dio->align for direct transfer)
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_io_direct_write(struct utk_io_direct *dio,
+			    const void *buf, size_t len);
+
+/*
+ * utk_io_direct_read
+ *
+ *  Read data from a file opened in direct I/O mode
+ *
+ * \param dio The direct I/O context
+ * \param dst Destination pointer (aligned on dio->align for direct transfer)
+ * \param len Number of byte being read and copied to destination pointer
+ * \return The number of byte actually read (less or egal to len)
+ *         or -1 to indicate error
+ */
+ssize_t utk_io_direct_read(struct utk_io_direct *dio, void *dst, size_t len);
+
+/*
+ * Double buffered direct I/O writer.
+ *
+ *  The caller fills one buffer while a background thread writes the
+ *  other one with O_DIRECT.
+ */
+struct utk_io_direct_writer {
+    struct utk_io_direct *dio;
+    char *buf[2];
+    size_t size;
+    size_t fill;
+    unsigned int cur;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const char *pending;
+    int stop;
+    int error;
+};
+
+/*
+ * utk_io_direct_writer_init
+ *
+ *  Init a double buffered writer
+ *
+ * \param w The writer which will be initialized
+ * \param dio An opened direct I/O context
+ * \param size Size of each buffer (rounded up to dio->align), at least
+ *             dio->align
+ * \return 0 on success or -1 to indicate error (EINVAL if size is too
+ *         small)
+ */
+int utk_io_direct_writer_init(struct utk_io_direct_writer *w,
+			      struct utk_io_direct *dio, size_t size);
+
+/*
+ * utk_io_direct_writer_write
+ *
+ *  Append data to the stream
+ *
+ * \param w The writer
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte copied or -1 to indicate a write error
+ */
+ssize_t utk_io_direct_writer_write(struct utk_io_direct_writer *w,
+				   const void *buf, size_t len);
+
+/*
+ * utk_io_direct_writer_cleanup
+ *
+ *  Flush the remaining data (the unaligned tail with a buffered write)
+ *  and release the writer
+ *
+ * - dio isn't closed.
+ *
+ * \param w The writer
+ * \return 0 on success or -1 if a write error occurred
+ */
+int utk_io_direct_writer_cleanup(struct utk_io_direct_writer *w);
+
+/*
+ * Prefetching sequential reader.
+ *
+ *  A background thread reads the file chunk after chunk into a ring of
+ *  buffers (double or triple buffering) while the consumer processes the
+ *  previous chunks, and asks the kernel to read ahead the next window
+ *  with posix_fadvise(POSIX_FADV_WILLNEED). Chunks are handed out without
+ *  copy.
+ *
+ * - The readahead window adapts to the consumer: it doubles each time the
+ *   consumer has to wait for a chunk (the disk is late) and halves when
+ *   the reader repeatedly finds all the buffers full (the consumer is
+ *   slower than the disk, a large window would only fill the page cache).
+ */
+#define UTK_IO_PREFETCH_FREE 0
+#define UTK_IO_PREFETCH_FILLED 1
+
+struct utk_io_prefetch_chunk {
+    unsigned char *data;
+    size_t len;
+    int state;
+    int error;
+};
+
+struct utk_io_prefetch {
+    int fd;
+    size_t chunk_size;
+    unsigned int nb_chunks;
+    struct utk_io_prefetch_chunk *chunks;
+    unsigned int head;
+    unsigned int tail;
+    int held;
+    unsigned long consumed;
+    off_t offset;
+    off_t advised;
+    size_t window;
+    size_t max_window;
+    unsigned int full_waits;
+    int stop;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/*
+ * utk_io_prefetch_open
+ *
+ *  Start reading a file sequentially from its current offset
+ *
+ * - fd isn't closed by utk_io_prefetch_close(), its offset isn't changed.
+ *
+ * \param pf The reader
+ * \param fd File descriptor
+ * \param nb_chunks Number of buffers: 2 (double buffering) or more
+ * \param chunk_size Size of each buffer or 0 for the default (1MiB)
+ * \param max_window Maximum readahead window or 0 for the default
+ *                   (64 chunks)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_prefetch_open(struct utk_io_prefetch *pf, int fd,
+			 unsigned int nb_chunks, size_t chunk_size,
+			 size_t max_window);
+
+/*
+ * utk_io_prefetch_next
+ *
+ *  Get the next chunk of the file
+ *
+ * - The chunk stays valid until the next call or utk_io_prefetch_close().
+ *
+ * \param pf The reader
+ * \param data Pointer where the address of the chunk is stored
+ * \return The length of the chunk, 0 at end of file or -1 to indicate
+ *         error
+ */
+ssize_t utk_io_prefetch_next(struct utk_io_prefetch *pf, const void **data);
+
+/*
+ * utk_io_prefetch_close
+ *
+ *  Stop the reader and release its buffers
+ *
+ * \param pf The reader
+ * \return void
+ */
+void utk_io_prefetch_close(struct utk_io_prefetch *pf);
+
+/*
+ * Descriptor cache.
+ *
+ *  utk_io_file_read() and utk_io_file_write() open and close the file at
+ *  each call. When the same files (sysfs, procfs, state files, ...) are
+ *  read or written many times per second, the descriptors can be kept
+ *  open in a LRU cache keyed by path and access mode. Cached reads and
+ *  writes are done with pread(2)/pwrite(2) at offset 0.
+ *
+ * - The cache can be used from several threads;
+ * - with UTK_IO_FDCACHE_REVALIDATE, the inode of the path is checked with
+ *   stat(2) at each access and the file is reopened if it was replaced
+ *   (rename over it, log rotation, ...). Without it, use
+ *   utk_io_fdcache_invalidate() when a file is replaced.
+ */
+#define UTK_IO_FDCACHE_REVALIDATE 0x01
+
+struct utk_io_fdcache {
+    pthread_mutex_t lock;
+    struct utk_list_head lru;
+    struct utk_list_head *buckets;
+    unsigned int nb_buckets;
+    unsigned int count;
+    unsigned int max;
+    int flags;
+};
+
+/*
+ * utk_io_fdcache_init
+ *
+ *  Init a descriptor cache
+ *
+ * \param cache The cache which will be initialized
+ * \param max Maximum number of descriptors kept open
+ * \param flags 0 or UTK_IO_FDCACHE_REVALIDATE
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_fdcache_init(struct utk_io_fdcache *cache,
+			unsigned int max, int flags);
+
+/*
+ * utk_io_fdcache_cleanup
+ *
+ *  Close all descriptors and release the cache
+ *
+ * \param cache The cache
+ * \return void
+ */
+void utk_io_fdcache_cleanup(struct utk_io_fdcache *cache);
+
+/*
+ * utk_io_fdcache_read
+ *
+ *  Same as utk_io_file_read() using a cached descriptor
+ *
+ * \param cache The cache
+ * \param filename File name
+ * \param dst Destination pointer
+ * \param len Number of byte being read and copied to destination pointer
+ * \return The number of byte actually read (less or egal to len)
+ *         or -1 to indicate error
+ */
+ssize_t utk_io_fdcache_read(struct utk_io_fdcache *cache,
+			    const char *filename, void *dst, size_t len);
+
+/*
+ * utk_io_fdcache_write
+ *
+ *  Same as utk_io_file_write() using a cached descriptor
+ *
+ * \param cache The cache
+ * \param filename File name
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_io_fdcache_write(struct utk_io_fdcache *cache,
+			     const char *filename, const void *buf, size_t len);
+
+/*
+ * utk_io_fdcache_invalidate
+ *
+ *  Close the cached descriptors of a file (all access modes)
+ *
+ * \param cache The cache
+ * \param filename File name
+ * \return void
+ */
+void utk_io_fdcache_invalidate(struct utk_io_fdcache *cache,
+			       const char *filename);
+
+/*
+ * utk_io_fdcache_invalidate_all
+ *
+ *  Close all the cached descriptors
+ *
+ * \param cache The cache
+ * \return void
+ */
+void utk_io_fdcache_invalidate_all(struct utk_io_fdcache *cache);
+
+/*
+ * Append-only record log (write-ahead log, journal, ...).
+ *
+ *  Each record is framed with a header of 8 bytes, little endian:
+ *
+ *      | len (32 bits) | crc32c of len and data (32 bits) | data (len) |
+ *
+ *  Appends are batched in a buffer and written with large writes. When a
+ *  record becomes durable depends on the sync policy:
+ *
+ *  - UTK_IO_LOG_SYNC_ALWAYS: utk_io_log_append() returns once the record
+ *    is on disk;
+ *  - UTK_IO_LOG_SYNC_INTERVAL: a background thread writes and syncs the
+ *    pending records every sync_interval_ms milliseconds;
+ *  - UTK_IO_LOG_SYNC_NEVER: records are written when the buffer is full,
+ *    on utk_io_log_sync() and on utk_io_log_close().
+ *
+ *  Opening a log scans it and truncates the first torn record (crash
+ *  during an append) and everything after it.
+ *
+ *  A log can be used by several threads.
+ */
+#define UTK_IO_LOG_SYNC_NEVER 0
+#define UTK_IO_LOG_SYNC_ALWAYS 1
+#define UTK_IO_LOG_SYNC_INTERVAL 2
+
+#define UTK_IO_LOG_HEADER_SIZE 8
+
+struct utk_io_log {
+    int fd;
+    int sync_policy;
+    unsigned int sync_interval_ms;
+    char *buf;
+    size_t buf_size;
+    size_t buf_fill;
+    unsigned long written;
+    unsigned long synced;
+    int syncing;
+    int stop;
+    int error;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/*
+ * Callback called by utk_io_log_scan() for each valid record.
+ *
+ * - return 0 to continue, another value to stop the scan.
+ */
+typedef int (*utk_io_log_cb_t)(void *opaque, const void *data, size_t len,
+			       off_t offset);
+
+/*
+ * utk_io_log_scan
+ *
+ *  Walk over the valid records of a log file
+ *
+ * - The file is mapped with mmap(2) when possible;
+ * - the scan stops at the first torn or corrupted record.
+ *
+ * \param filename File name
+ * \param cb Callback called for each record or NULL
+ * \param opaque Argument given to cb
+ * \return The offset of the end of the last valid record (where next
+ *         record must be appended) or -1 to indicate error
+ */
+off_t utk_io_log_scan(const char *filename, utk_io_log_cb_t cb, void *opaque);
+
+/*
+ * utk_io_log_open
+ *
+ *  Open (and create if needed) a log file, recover it and get it ready
+ *  for appends
+ *
+ * \param log The log which will be initialized
+ * \param filename File name
+ * \param sync_policy UTK_IO_LOG_SYNC_NEVER, _ALWAYS or _INTERVAL
+ * \param sync_interval_ms Sync period for UTK_IO_LOG_SYNC_INTERVAL
+ * \param buf_size Size of the append buffer (0 for a default size)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_log_open(struct utk_io_log *log, const char *filename,
+		    int sync_policy, unsigned int sync_interval_ms,
+		    size_t buf_size);
+
+/*
+ * utk_io_log_append
+ *
+ *  Append a record to the log
+ *
+ * \param log The log
+ * \param data Record data
+ * \param len Record length (less than 4GiB)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_log_append(struct utk_io_log *log, const void *data, size_t len);
+
+/*
+ * utk_io_log_sync
+ *
+ *  Write the pending records and sync them to disk
+ *
+ * \param log The log
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_log_sync(struct utk_io_log *log);
+
+/*
+ * utk_io_log_close
+ *
+ *  Sync and close the log
+ *
+ * \param log The log
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_log_close(struct utk_io_log *log);
+
+/*
+ * I/O statistics
+ *
+ *  utk_io_read(), utk_io_write(), utk_io_pread() and utk_io_pwrite() can
+ *  count their calls, transferred bytes, syscalls issued, EINTR retries,
+ *  short transfers (a syscall transferring less than asked) and errors,
+ *  and keep a log-linear histogram of call latencies.
+ *
+ * - Collection is off by default, turn it on with utk_io_stats_enable() or
+ *   from startup by configuring utk with --enable-io-stats;
+ * - when off, a call costs one load and one predicted branch more;
+ * - each thread updates its own counters without lock nor atomic
+ *   read-modify-write, utk_io_stats_get() aggregates them.
+ */
+
+enum utk_io_stats_op {
+    UTK_IO_STATS_READ,
+    UTK_IO_STATS_WRITE,
+    UTK_IO_STATS_PREAD,
+    UTK_IO_STATS_PWRITE,
+    UTK_IO_STATS_NB_OPS
+};
+
+/* 4 buckets per power of 2 of nanoseconds */
+#define UTK_IO_STATS_NB_BUCKETS 252
+
+struct utk_io_stats {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t syscalls;
+    uint64_t eintr;
+    uint64_t short_transfers;
+    uint64_t errors;
+    uint64_t latency[UTK_IO_STATS_NB_BUCKETS];
+};
+
+/*
+ * utk_io_stats_enable
+ *
+ *  Start or stop collecting statistics
+ *
+ * \param enable 1 to start, 0 to stop
+ * \return void
+ */
+void utk_io_stats_enable(int enable);
+
+/*
+ * utk_io_stats_enabled
+ *
+ *  Tell if statistics are collected
+ *
+ * \return 1 if statistics are collected, 0 otherwise
+ */
+int utk_io_stats_enabled(void);
+
+/*
+ * utk_io_stats_get
+ *
+ *  Get statistics of an operation aggregated over all threads since the
+ *  last utk_io_stats_reset()
+ *
+ * \param op The operation
+ * \param stats Destination of statistics
+ * \return void
+ */
+void utk_io_stats_get(enum utk_io_stats_op op, struct utk_io_stats *stats);
+
+/*
+ * utk_io_stats_reset
+ *
+ *  Restart statistics of all operations from zero
+ *
+ * \return void
+ */
+void utk_io_stats_reset(void);
+
+/*
+ * utk_io_stats_bucket_ns
+ *
+ *  Lower bound of a latency bucket
+ *
+ * \param bucket Index of the bucket
+ * \return Latency in nanoseconds
+ */
+uint64_t utk_io_stats_bucket_ns(unsigned int bucket);
+
+/*
+ * utk_io_stats_percentile
+ *
+ *  Estimate a latency percentile from the histogram
+ *
+ * \param stats Statistics
+ * \param percentile Percentile in [0, 100]
+ * \return Upper bound in nanoseconds of the bucket holding the
+ *         percentile, or 0 if there was no call
+ */
+uint64_t utk_io_stats_percentile(const struct utk_io_stats *stats,
+				 double percentile);
+
+/*
+ * utk_io_stats_dump
+ *
+ *  Write a human readable summary of statistics (one line per operation)
+ *
+ * \param fd File descriptor
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_stats_dump(int fd);
+
+/*
+ * File follower (tail -f).
+ *
+ *  Follow files which are appended to (logs, ...) without polling: the
+ *  descriptors are kept open and inotify(7) tells when they are modified,
+ *  truncated, or replaced by a new file (rotation: the name then points to
+ *  another inode, the rest of the old file is delivered before switching
+ *  to the new one). Any number of files are followed from one thread.
+ *
+ * - New data is delivered to a callback by utk_io_follow_dispatch() or,
+ *   for files added without callback, read with utk_io_follow_read();
+ * - a followed file may not exist yet, its directory must.
+ */
+#define UTK_IO_FOLLOW_FROM_START 0x01
+
+/*
+ * Callback called by utk_io_follow_dispatch() with new data of a file.
+ *
+ * - return 0 to continue, another value to stop the dispatch.
+ */
+typedef int (*utk_io_follow_cb_t)(void *opaque, const void *data, size_t len);
+
+struct utk_io_follow_file {
+    struct utk_list_head list;
+    utk_io_follow_cb_t cb;
+    void *opaque;
+    int fd;
+    int wd;
+    int dir_wd;
+    int pending;
+    dev_t dev;
+    ino_t ino;
+    off_t offset;
+    const char *basename;
+    char filename[];
+};
+
+struct utk_io_follow {
+    int fd;
+    unsigned char *buf;
+    size_t buf_size;
+    struct utk_list_head files;
+};
+
+/*
+ * utk_io_follow_init
+ *
+ *  Initialize a follower
+ *
+ * - follow->fd (the inotify descriptor) becomes readable when files have
+ *   events, it can be watched with poll(2) or an event loop.
+ *
+ * \param follow The follower
+ * \param buf_size Size of the buffer used to deliver data to callbacks or
+ *                 0 for the default (64KiB)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_io_follow_init(struct utk_io_follow *follow, size_t buf_size);
+
+/*
+ * utk_io_follow_cleanup
+ *
+ *  Stop following all the files and release the follower
+ *
+ * \param follow The follower
+ * \return void
+ */
+void utk_io_follow_cleanup(struct utk_io_follow *follow);
+
+/*
+ * utk_io_follow_add
+ *
+ *  Follow a file
+ *
+ * \param follow The follower
+ * \param filename File name
+ * \param flags UTK_IO_FOLLOW_FROM_START to deliver the current content of
+ *              the file, else only data appended from now is delivered
+ * \param cb Callback called with new data or NULL to read it with
+ *           utk_io_follow_read()
+ * \param opaque Argument given to cb
+ * \return The followed file or NULL to indicate error
+ */
+struct utk_io_follow_file *utk_io_follow_add(struct utk_io_follow *follow,
+					     const char *filename, int flags,
+					     utk_io_follow_cb_t cb,
+					     void *opaque);
+
+/*
+ * utk_io_follow_remove
+ *
+ *  Stop following a file
+ *
+ * \param follow The follower
+ * \param file The file returned by utk_io_follow_add()
+ * \return void
+ */
+void utk_io_follow_remove(struct utk_io_follow *follow,
+			  struct utk_io_follow_file *file);
+
+/*
+ * utk_io_follow_dispatch
+ *
+ *  Wait for events and deliver new data of files to their callback
+ *
+ * \param follow The follower
+ * \param timeout_ms Time to wait for events: 0 to not wait, -1 forever
+ * \return The number of files which had events, 0 if the timeout expired
+ *         or -1 to indicate error (errno is ECANCELED if a callback
+ *         stopped the dispatch)
+ */
+int utk_io_follow_dispatch(struct utk_io_follow *follow, int timeout_ms);
+
+/*
+ * utk_io_follow_read
+ *
+ *  Read new data of a file added without callback
+ *
+ * - While waiting, events of the other files are dispatched.
+ *
+ * \param follow The follower
+ * \param file The file returned by utk_io_follow_add()
+ * \param dst Destination pointer
+ * \param len Size of destination buffer
+ * \param timeout_ms Time to wait for data: 0 to not wait, -1 forever
+ * \return The number of byte read or -1 to indicate error (errno is EAGAIN
+ *         when there is no new data and timeout_ms is 0, ETIMEDOUT when the
+ *         timeout expired)
+ */
+ssize_t utk_io_follow_read(struct utk_io_follow *follow,
+			   struct utk_io_follow_file *file,
+			   void *dst, size_t len, int timeout_ms);
+
 #endif
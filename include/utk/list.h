@@ -437,4 +437,190 @@ utk_list_splice_init(struct utk_list_head *list, struct utk_list_head *head)
 	 &pos->member != (head);					\
 	 pos = n, n = utk_list_entry(n->member.prev, typeof(*n), member))
 
+/*
+ * Compare function of utk_list_sort(): return < 0 if a sorts before b,
+ * > 0 if a sorts after b, 0 to keep their order
+ */
+typedef int (*utk_list_cmp_cb_t)(void *priv, const struct utk_list_head *a,
+				 const struct utk_list_head *b);
+
+/*
+ * utk_list_sort
+ *
+ *  Sort a list
+ *
+ * - Bottom-up merge sort in O(n log n): no allocation, stable (equal
+ *   entries keep their order), prev links are restored;
+ * - cmp is called with priv, use utk_list_entry() to get the entries.
+ *
+ * \param priv Opaque data given to cmp
+ * \param head The head of the list
+ * \param cmp Compare function
+ * \return void
+ */
+void utk_list_sort(void *priv, struct utk_list_head *head,
+		   utk_list_cmp_cb_t cmp);
+
+/*!
+ * Double linked lists with a single pointer list head.
+ *
+ * Mostly useful for hash tables where the two pointer list head is
+ * too wasteful. You lose the ability to access the tail in O(1).
+ */
+
+struct utk_hlist_head {
+    struct utk_hlist_node *first;
+};
+
+struct utk_hlist_node {
+    struct utk_hlist_node *next, **pprev;
+};
+
+#define UTK_HLIST_HEAD(name)				\
+    struct utk_hlist_head name = { NULL }
+
+static inline void utk_hlist_head_init(struct utk_hlist_head *h)
+{
+    h->first = NULL;
+}
+
+static inline void utk_hlist_node_init(struct utk_hlist_node *n)
+{
+    n->next = NULL;
+    n->pprev = NULL;
+}
+
+/*!
+ * utk_hlist_unhashed - has node been removed from list and reinitialized?
+ * @n: the node to test
+ */
+static inline int utk_hlist_unhashed(const struct utk_hlist_node *n)
+{
+    return !n->pprev;
+}
+
+/*!
+ * utk_hlist_empty - is the specified hlist head empty?
+ * @h: the head to test
+ */
+static inline int utk_hlist_empty(const struct utk_hlist_head *h)
+{
+    return !h->first;
+}
+
+static inline void __utk_hlist_del(struct utk_hlist_node *n)
+{
+    struct utk_hlist_node *next = n->next;
+    struct utk_hlist_node **pprev = n->pprev;
+
+    *pprev = next;
+    if (next)
+	next->pprev = pprev;
+}
+
+/*!
+ * utk_hlist_del - delete the specified hlist node from its list
+ * @n: the node to delete
+ *
+ * Note that this function leaves the node in an undefined state.
+ */
+static inline void utk_hlist_del(struct utk_hlist_node *n)
+{
+    __utk_hlist_del(n);
+    n->next = UTK_LIST_POISON1;
+    n->pprev = UTK_LIST_POISON2;
+}
+
+/*!
+ * utk_hlist_del_init - delete the specified hlist node from its list and
+ * initialize
+ * @n: the node to delete
+ */
+static inline void utk_hlist_del_init(struct utk_hlist_node *n)
+{
+    if (!utk_hlist_unhashed(n)) {
+	__utk_hlist_del(n);
+	utk_hlist_node_init(n);
+    }
+}
+
+/*!
+ * utk_hlist_add_head - add a new entry at the beginning of the hlist
+ * @n: new entry to be added
+ * @h: hlist head to add it after
+ */
+static inline void utk_hlist_add_head(struct utk_hlist_node *n,
+				      struct utk_hlist_head *h)
+{
+    struct utk_hlist_node *first = h->first;
+
+    n->next = first;
+    if (first)
+	first->pprev = &n->next;
+    h->first = n;
+    n->pprev = &h->first;
+}
+
+/*!
+ * utk_hlist_entry - get the struct for this entry
+ * @ptr:    the &struct utk_hlist_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_hlist_node within the struct.
+ */
+#define utk_hlist_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_hlist_entry_safe - get the struct for this entry or NULL
+ * @ptr:    the &struct utk_hlist_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_hlist_node within the struct.
+ */
+#define utk_hlist_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_hlist_entry(____ptr, type, member) : NULL;})
+
+/*!
+ * utk_hlist_for_each    -    iterate over a hlist
+ * @pos:    the &struct utk_hlist_node to use as a loop counter.
+ * @head:    the head for your hlist.
+ */
+#define utk_hlist_for_each(pos, head)				\
+    for (pos = (head)->first; pos; pos = pos->next)
+
+/*!
+ * utk_hlist_for_each_safe - iterate over a hlist safe against removal of
+ * hlist entry
+ * @pos:    the &struct utk_hlist_node to use as a loop counter.
+ * @n:        another &struct utk_hlist_node to use as temporary storage
+ * @head:    the head for your hlist.
+ */
+#define utk_hlist_for_each_safe(pos, n, head)			\
+    for (pos = (head)->first; pos && ({ n = pos->next; 1; });	\
+	 pos = n)
+
+/*!
+ * utk_hlist_for_each_entry    -    iterate over hlist of given type
+ * @pos:    the type * to use as a loop counter.
+ * @head:    the head for your hlist.
+ * @member:    the name of the utk_hlist_node within the struct.
+ */
+#define utk_hlist_for_each_entry(pos, head, member)			\
+    for (pos = utk_hlist_entry_safe((head)->first, typeof(*(pos)), member); \
+	 pos;								\
+	 pos = utk_hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+/*!
+ * utk_hlist_for_each_entry_safe - iterate over hlist of given type safe
+ * against removal of hlist entry
+ * @pos:    the type * to use as a loop counter.
+ * @n:        a &struct utk_hlist_node to use as temporary storage
+ * @head:    the head for your hlist.
+ * @member:    the name of the utk_hlist_node within the struct.
+ */
+#define utk_hlist_for_each_entry_safe(pos, n, head, member)		\
+    for (pos = utk_hlist_entry_safe((head)->first, typeof(*pos), member); \
+	 pos && ({ n = pos->member.next; 1; });				\
+	 pos = utk_hlist_entry_safe(n, typeof(*pos), member))
+
 #endif
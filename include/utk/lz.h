@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_LZ_H_
+#define _UTK_LZ_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/**
+ * lz.h - fast LZ77 block compression (LZ4 style)
+ *
+ * Speed is favored over ratio: one hash probe per position, no entropy
+ * coding.
+ *
+ * Block format:
+ * -------------
+ *
+ *  A block is a list of sequences:
+ *
+ *      | token | [literals length] | literals | offset | [match length] |
+ *
+ *  - token: high 4 bits are the literals length, low 4 bits are the match
+ *    length minus 4; 15 means more length bytes follow (each 255 adds 255
+ *    and continues);
+ *  - offset: 2 bytes, little endian, distance of the match (1 to 65535);
+ *  - the last sequence has only literals.
+ *
+ * Frame format (utk_lz_writer/utk_lz_reader):
+ * ------------------------------------------
+ *
+ *      | "UTKZ" | block size (32) | blocks... | 0 (32) |
+ *
+ *  each block is:
+ *
+ *      | size (32) | crc32c of uncompressed data (32) | data |
+ *
+ *  all integers are little endian. Bit 31 of size is set when data are
+ *  stored uncompressed (incompressible block).
+ */
+
+/*
+ * utk_lz_compress_bound
+ *
+ *  Maximum compressed size of a block (incompressible data)
+ *
+ * \param len Uncompressed size
+ * \return The size of destination buffer needed by utk_lz_compress()
+ */
+static inline size_t utk_lz_compress_bound(size_t len)
+{
+    return len + len / 255 + 16;
+}
+
+/*
+ * utk_lz_compress
+ *
+ *  Compress a block
+ *
+ * \param src Source pointer
+ * \param src_len Number of byte to compress
+ * \param dst Destination pointer
+ * \param dst_size Size of destination buffer
+ *        (utk_lz_compress_bound(src_len) is always enough)
+ * \return The compressed size or -1 if dst is too small
+ */
+ssize_t utk_lz_compress(const void *src, size_t src_len,
+			void *dst, size_t dst_size);
+
+/*
+ * utk_lz_decompress
+ *
+ *  Decompress a block
+ *
+ * - Corrupted or malicious data never make this function read or write
+ *   out of src and dst buffers.
+ *
+ * \param src Source pointer
+ * \param src_len Size of the compressed block
+ * \param dst Destination pointer
+ * \param dst_size Size of destination buffer
+ * \return The decompressed size or -1 if the block is corrupted or dst is
+ *         too small
+ */
+ssize_t utk_lz_decompress(const void *src, size_t src_len,
+			  void *dst, size_t dst_size);
+
+/*
+ * Stream writer producing a compressed frame on a file descriptor.
+ */
+struct utk_lz_writer {
+    int fd;
+    unsigned char *buf;
+    unsigned char *cbuf;
+    size_t block_size;
+    size_t fill;
+};
+
+/*
+ * utk_lz_writer_init
+ *
+ *  Init a writer and write the frame header
+ *
+ * \param w The writer which will be initialized
+ * \param fd File descriptor where the frame is written
+ * \param block_size Uncompressed block size (0 for 64KiB)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_lz_writer_init(struct utk_lz_writer *w, int fd, size_t block_size);
+
+/*
+ * utk_lz_writer_write
+ *
+ *  Compress and write data
+ *
+ * \param w The writer
+ * \param buf Source pointer
+ * \param len Number of byte being copied from the source pointer
+ * \return The number of byte written or -1 to indicate error
+ */
+ssize_t utk_lz_writer_write(struct utk_lz_writer *w,
+			    const void *buf, size_t len);
+
+/*
+ * utk_lz_writer_finish
+ *
+ *  Write the last block and the end of frame, then release the writer
+ *
+ * - fd isn't closed.
+ *
+ * \param w The writer
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_lz_writer_finish(struct utk_lz_writer *w);
+
+/*
+ * Stream reader decompressing a frame from a file descriptor.
+ */
+struct utk_lz_reader {
+    int fd;
+    unsigned char *buf;
+    unsigned char *cbuf;
+    size_t block_size;
+    size_t len;
+    size_t pos;
+    int eof;
+};
+
+/*
+ * utk_lz_reader_init
+ *
+ *  Init a reader and read the frame header
+ *
+ * \param r The reader which will be initialized
+ * \param fd File descriptor where the frame is read
+ * \return 0 on success or -1 to indicate error (errno is EBADMSG if the
+ *         frame header is invalid)
+ */
+int utk_lz_reader_init(struct utk_lz_reader *r, int fd);
+
+/*
+ * utk_lz_reader_read
+ *
+ *  Read and decompress data
+ *
+ * - Same semantics as utk_io_read(): less than len is returned only at
+ *   the end of frame.
+ *
+ * \param r The reader
+ * \param dst Destination pointer
+ * \param len Number of byte being read and copied to destination pointer
+ * \return The number of byte actually read or -1 to indicate error (errno
+ *         is EBADMSG if the frame is corrupted)
+ */
+ssize_t utk_lz_reader_read(struct utk_lz_reader *r, void *dst, size_t len);
+
+/*
+ * utk_lz_reader_cleanup
+ *
+ *  Release the reader
+ *
+ * - fd isn't closed.
+ *
+ * \param r The reader
+ * \return void
+ */
+void utk_lz_reader_cleanup(struct utk_lz_reader *r);
+
+#endif
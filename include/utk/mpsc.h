@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_MPSC_H_
+#define _UTK_MPSC_H_
+
+#include <stdlib.h>
+
+#include "utk/list.h"
+
+/**
+ * mpsc.h - intrusive lock-free multi producer single consumer queue
+ *
+ * Entries embed a struct utk_mpsc_node and are found back with
+ * utk_mpsc_entry() (container_of()), like utk_list_entry(). Any thread
+ * can push, only one thread at a time pops (Dmitry Vyukov's queue):
+ *
+ * - utk_mpsc_push() is wait-free: one atomic exchange and one store,
+ *   no loop, no allocation;
+ * - the queue is FIFO; utk_mpsc_take_all() detaches all visible entries
+ *   at once as a NULL terminated chain for batch consumption;
+ * - a producer preempted between its exchange and its store hides the
+ *   entries pushed after its own until it runs again: utk_mpsc_pop()
+ *   then returns NULL although utk_mpsc_empty() is false;
+ * - the producers tail and the consumer head are on their own cache
+ *   lines.
+ *
+ * Example:
+ *
+ *  struct work {
+ *      struct utk_mpsc_node node;
+ *      // your stuff //
+ *  };
+ *
+ *  // producers
+ *  utk_mpsc_push(&queue, &work->node);
+ *
+ *  // consumer
+ *  first = utk_mpsc_take_all(&queue);
+ *  utk_mpsc_for_each_entry_safe(work, n, first, node)
+ *  {
+ *      // your stuff //
+ *  }
+ */
+
+#define UTK_MPSC_CACHELINE 64
+
+struct utk_mpsc_node {
+    struct utk_mpsc_node *next;
+};
+
+struct utk_mpsc_queue {
+    /* last pushed node (producers) */
+    struct utk_mpsc_node *tail __attribute__((aligned(UTK_MPSC_CACHELINE)));
+
+    /* next node to pop (consumer) */
+    struct utk_mpsc_node *head __attribute__((aligned(UTK_MPSC_CACHELINE)));
+    /* stays in the queue when it is empty */
+    struct utk_mpsc_node stub;
+};
+
+/*!
+ * utk_mpsc_entry - get the struct for this node
+ * @ptr:    the &struct utk_mpsc_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_mpsc_node within the struct.
+ */
+#define utk_mpsc_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_mpsc_entry_safe - get the struct for this node or NULL
+ * @ptr:    the &struct utk_mpsc_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_mpsc_node within the struct.
+ */
+#define utk_mpsc_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_mpsc_entry(____ptr, type, member) : NULL;})
+
+/*!
+ * utk_mpsc_for_each_entry_safe - iterate over a chain returned by
+ * utk_mpsc_take_all(), safe against release of the entry
+ * @pos:    the type * to use as a loop counter.
+ * @n:    another type * to use as temporary storage.
+ * @first:    the first &struct utk_mpsc_node of the chain.
+ * @member:    the name of the utk_mpsc_node within the struct.
+ */
+#define utk_mpsc_for_each_entry_safe(pos, n, first, member)		\
+    for (pos = utk_mpsc_entry_safe(first, typeof(*pos), member),	\
+	     n = pos ? utk_mpsc_entry_safe(pos->member.next,		\
+					   typeof(*pos), member) : NULL; \
+	 pos != NULL;							\
+	 pos = n,							\
+	     n = pos ? utk_mpsc_entry_safe(pos->member.next,		\
+					   typeof(*pos), member) : NULL)
+
+/*
+ * utk_mpsc_init
+ *
+ *  Initialize an empty queue
+ *
+ * \param q The queue
+ * \return void
+ */
+static inline void utk_mpsc_init(struct utk_mpsc_queue *q)
+{
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+/*
+ * utk_mpsc_push
+ *
+ *  Add a node at the end of the queue (any thread, wait-free)
+ *
+ * \param q The queue
+ * \param node The node
+ * \return void
+ */
+static inline void utk_mpsc_push(struct utk_mpsc_queue *q,
+				 struct utk_mpsc_node *node)
+{
+    struct utk_mpsc_node *prev = NULL;
+
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->tail, node, __ATOMIC_ACQ_REL);
+    /* the consumer can't go past prev until this store */
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/*
+ * utk_mpsc_empty
+ *
+ *  Check if the queue is empty (consumer thread)
+ *
+ * \param q The queue
+ * \return 1 if the queue is empty, 0 otherwise
+ */
+static inline int utk_mpsc_empty(struct utk_mpsc_queue *q)
+{
+    return q->head == &q->stub
+	&& __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == &q->stub;
+}
+
+/*
+ * utk_mpsc_pop
+ *
+ *  Remove the first node of the queue (consumer thread)
+ *
+ * \param q The queue
+ * \return The node or NULL if the queue is empty or if the first node
+ *         isn't linked yet
+ */
+static inline struct utk_mpsc_node *utk_mpsc_pop(struct utk_mpsc_queue *q)
+{
+    struct utk_mpsc_node *head = q->head;
+    struct utk_mpsc_node *next = NULL;
+
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if(head == &q->stub)
+    {
+	if(next == NULL)
+	{
+	    return NULL;
+	}
+	q->head = next;
+	head = next;
+	next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+
+    if(next != NULL)
+    {
+	q->head = next;
+	return head;
+    }
+
+    /* head is the last linked node: a producer is linking the next one */
+    if(head != __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+    {
+	return NULL;
+    }
+
+    /* head is the last node: queue the stub behind it to unlink it */
+    utk_mpsc_push(q, &q->stub);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if(next != NULL)
+    {
+	q->head = next;
+	return head;
+    }
+
+    return NULL;
+}
+
+/*
+ * utk_mpsc_take_all
+ *
+ *  Remove all the linked nodes of the queue (consumer thread)
+ *
+ * \param q The queue
+ * \return The first node of a chain linked by next and ended by NULL, or
+ *         NULL (see utk_mpsc_pop())
+ */
+static inline struct utk_mpsc_node *utk_mpsc_take_all(struct utk_mpsc_queue *q)
+{
+    struct utk_mpsc_node *first = NULL;
+    struct utk_mpsc_node *last = NULL;
+    struct utk_mpsc_node *node = NULL;
+
+    /* the popped nodes are relinked to skip the stub */
+    while((node = utk_mpsc_pop(q)) != NULL)
+    {
+	if(last == NULL)
+	{
+	    first = node;
+	}
+	else
+	{
+	    last->next = node;
+	}
+	last = node;
+    }
+    if(last != NULL)
+    {
+	last->next = NULL;
+    }
+
+    return first;
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_NET_H_
+#define _UTK_NET_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * net.h - socket I/O helpers
+ *
+ * Datagrams are sent and received by batches with sendmmsg(2) and
+ * recvmmsg(2): one syscall moves up to a whole batch of messages instead
+ * of one. Stream sockets get full-transfer loops like utk_io_write() and
+ * utk_io_read().
+ */
+
+/*
+ * Batch of messages.
+ *
+ *  To send, a batch is filled with utk_net_batch_begin() and
+ *  utk_net_batch_append() (several buffers make one message: scatter
+ *  /gather) or utk_net_batch_add(). To receive, it is initialized with
+ *  utk_net_batch_init_recv() and each message has its own buffer.
+ *
+ * - Buffers given to utk_net_batch_append() aren't copied, they must stay
+ *   valid until the batch is sent.
+ */
+struct utk_net_batch {
+    struct mmsghdr *msgs;
+    unsigned int nb_msgs;
+    unsigned int max_msgs;
+    struct iovec *iov;
+    unsigned int nb_iov;
+    unsigned int max_iov;
+    struct sockaddr_storage *addrs;
+    unsigned char *buf;
+    size_t msg_size;
+};
+
+/*
+ * utk_net_batch_init
+ *
+ *  Initialize a batch to send messages
+ *
+ * \param batch The batch
+ * \param max_msgs Maximum number of messages in the batch
+ * \param max_iov Maximum number of buffers of all the messages
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_net_batch_init(struct utk_net_batch *batch, unsigned int max_msgs,
+		       unsigned int max_iov);
+
+/*
+ * utk_net_batch_init_recv
+ *
+ *  Initialize a batch to receive messages
+ *
+ * \param batch The batch
+ * \param max_msgs Maximum number of messages received at once
+ * \param msg_size Size of the buffer of each message (longer datagrams
+ *                 are truncated)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_net_batch_init_recv(struct utk_net_batch *batch,
+			    unsigned int max_msgs, size_t msg_size);
+
+/*
+ * utk_net_batch_cleanup
+ *
+ *  Release a batch
+ *
+ * \param batch The batch
+ * \return void
+ */
+void utk_net_batch_cleanup(struct utk_net_batch *batch);
+
+/*
+ * utk_net_batch_reset
+ *
+ *  Remove all the messages of a batch
+ *
+ * \param batch The batch
+ * \return void
+ */
+void utk_net_batch_reset(struct utk_net_batch *batch);
+
+/*
+ * utk_net_batch_begin
+ *
+ *  Start a new message in a batch
+ *
+ * \param batch The batch
+ * \param addr Destination or NULL for a connected socket
+ * \param addrlen Length of addr
+ * \return 0 on success or -1 to indicate error (errno is ENOBUFS when the
+ *         batch is full)
+ */
+int utk_net_batch_begin(struct utk_net_batch *batch,
+			const struct sockaddr *addr, socklen_t addrlen);
+
+/*
+ * utk_net_batch_append
+ *
+ *  Append a buffer to the current message of a batch
+ *
+ * \param batch The batch
+ * \param buf Buffer
+ * \param len Length of buffer
+ * \return 0 on success or -1 to indicate error (errno is ENOBUFS when the
+ *         batch is full)
+ */
+int utk_net_batch_append(struct utk_net_batch *batch, const void *buf,
+			 size_t len);
+
+/*
+ * utk_net_batch_add
+ *
+ *  Add a message made of one buffer to a batch (for a connected socket)
+ *
+ * \param batch The batch
+ * \param buf Buffer
+ * \param len Length of buffer
+ * \return 0 on success or -1 to indicate error (errno is ENOBUFS when the
+ *         batch is full)
+ */
+int utk_net_batch_add(struct utk_net_batch *batch, const void *buf,
+		      size_t len);
+
+/*
+ * utk_net_batch_msg
+ *
+ *  Get a message received by utk_net_recv_batch()
+ *
+ * \param batch The batch
+ * \param index Index of the message
+ * \param len Pointer where the length of the message is stored
+ * \return The message data
+ */
+const void *utk_net_batch_msg(const struct utk_net_batch *batch,
+			      unsigned int index, size_t *len);
+
+/*
+ * utk_net_send_batch
+ *
+ *  Send the messages of a batch
+ *
+ * - Messages are sent by sendmmsg(2) calls until all are sent, on a
+ *   non-blocking socket it stops at EAGAIN;
+ * - the batch isn't reset.
+ *
+ * \param fd Socket
+ * \param batch The batch
+ * \param flags Flags of sendmmsg(2) (MSG_NOSIGNAL is added)
+ * \return The number of messages sent or -1 to indicate error
+ */
+int utk_net_send_batch(int fd, struct utk_net_batch *batch, int flags);
+
+/*
+ * utk_net_recv_batch
+ *
+ *  Receive messages in a batch
+ *
+ * - Blocks until at least one message is available (unless the socket is
+ *   non-blocking or MSG_DONTWAIT is given), then takes all the available
+ *   messages which fit in the batch;
+ * - the source address of each message is in batch->addrs.
+ *
+ * \param fd Socket
+ * \param batch The batch initialized with utk_net_batch_init_recv()
+ * \param flags Flags of recvmmsg(2) (MSG_WAITFORONE is added)
+ * \return The number of messages received or -1 to indicate error
+ */
+int utk_net_recv_batch(int fd, struct utk_net_batch *batch, int flags);
+
+/*
+ * utk_net_send_all
+ *
+ *  Send data on a stream socket
+ *
+ * - Like utk_io_write(), with MSG_NOSIGNAL: a closed peer gives EPIPE
+ *   instead of SIGPIPE.
+ *
+ * \param fd Socket
+ * \param buf Source pointer
+ * \param len Number of byte being sent
+ * \return The number of byte sent or -1 to indicate error
+ */
+ssize_t utk_net_send_all(int fd, const void *buf, size_t len);
+
+/*
+ * utk_net_sendv_all
+ *
+ *  Send several buffers on a stream socket (sendmsg(2) gather)
+ *
+ * - iov is modified to follow partial sends.
+ *
+ * \param fd Socket
+ * \param iov Buffers
+ * \param iovcnt Number of buffers
+ * \return The number of byte sent or -1 to indicate error
+ */
+ssize_t utk_net_sendv_all(int fd, struct iovec *iov, int iovcnt);
+
+/*
+ * utk_net_recv_all
+ *
+ *  Receive data from a stream socket
+ *
+ * - Like utk_io_read().
+ *
+ * \param fd Socket
+ * \param dst Destination pointer
+ * \param len Number of byte being received
+ * \return The number of byte actually received (less or egal to len, less
+ *         only if the peer closed) or -1 to indicate error
+ */
+ssize_t utk_net_recv_all(int fd, void *dst, size_t len);
+
+/*
+ * utk_net_set_busy_poll
+ *
+ *  Busy poll the device queue when receiving (SO_BUSY_POLL)
+ *
+ * - Raising it above the net.core.busy_read sysctl may require
+ *   CAP_NET_ADMIN.
+ *
+ * \param fd Socket
+ * \param usec Time to busy poll in microseconds, 0 to disable
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_net_set_busy_poll(int fd, int usec);
+
+/*
+ * utk_net_set_gro
+ *
+ *  Receive coalesced UDP datagrams (UDP_GRO)
+ *
+ * - Only for UDP sockets: with it, a message received may hold several
+ *   datagrams of the same size (see UDP_GRO in udp(7)). The size is given
+ *   in a control message which utk_net_recv_batch() doesn't collect: use
+ *   it when the datagrams have a size known by the application.
+ *
+ * \param fd Socket
+ * \param enable 1 to enable, 0 to disable
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_net_set_gro(int fd, int enable);
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_RBTREE_H_
+#define _UTK_RBTREE_H_
+
+#include <stdlib.h>
+
+#include "utk/list.h"
+
+/**
+ * rbtree.h - intrusive red-black tree
+ *
+ * Entries embed a struct utk_rbtree_node and are found back with
+ * utk_rbtree_entry() (container_of()), like utk_list_entry(). The tree
+ * doesn't allocate: insertion and removal are O(log n), the first
+ * (smallest) node is cached and utk_rbtree_first() is O(1).
+ *
+ * - The order is given by the compare function passed to
+ *   utk_rbtree_insert(), lookups take a compare function of a node and a
+ *   key which must agree with it;
+ * - equal nodes are allowed, a new node is inserted after its equals;
+ * - utk_rbtree_erase() only relinks nodes: other nodes stay valid, the
+ *   next node can be kept while erasing (utk_rbtree_for_each_safe());
+ * - the tree doesn't lock: protect it if several threads use it.
+ *
+ * Example:
+ *
+ *  struct item {
+ *      struct utk_rbtree_node node;
+ *      int key;
+ *  };
+ *
+ *  static int item_cmp(const struct utk_rbtree_node *a,
+ *                      const struct utk_rbtree_node *b)
+ *  {
+ *      int ka = utk_rbtree_entry(a, const struct item, node)->key;
+ *      int kb = utk_rbtree_entry(b, const struct item, node)->key;
+ *
+ *      return (ka > kb) - (ka < kb);
+ *  }
+ *
+ *  utk_rbtree_insert(&tree, &item->node, item_cmp);
+ */
+
+struct utk_rbtree_node {
+    struct utk_rbtree_node *parent;
+    struct utk_rbtree_node *left;
+    struct utk_rbtree_node *right;
+    int color;
+};
+
+struct utk_rbtree {
+    struct utk_rbtree_node *root;
+    /* smallest node */
+    struct utk_rbtree_node *leftmost;
+    size_t count;
+};
+
+/*
+ * Compare function of two nodes: return < 0 if a sorts before b, > 0 if a
+ * sorts after b, 0 if they are equal
+ */
+typedef int (*utk_rbtree_cmp_cb_t)(const struct utk_rbtree_node *a,
+				   const struct utk_rbtree_node *b);
+
+/*
+ * Compare function of a node and a key: return < 0 if node sorts before
+ * key, > 0 if node sorts after key, 0 if node has key
+ */
+typedef int (*utk_rbtree_key_cb_t)(const struct utk_rbtree_node *node,
+				   const void *key);
+
+#define UTK_RBTREE(name)			\
+    struct utk_rbtree name = { NULL, NULL, 0 }
+
+static inline void utk_rbtree_init(struct utk_rbtree *tree)
+{
+    tree->root = NULL;
+    tree->leftmost = NULL;
+    tree->count = 0;
+}
+
+/*!
+ * utk_rbtree_node_init - mark a node as not in a tree
+ * @node: the node
+ */
+static inline void utk_rbtree_node_init(struct utk_rbtree_node *node)
+{
+    node->parent = node;
+}
+
+/*!
+ * utk_rbtree_node_empty - is node out of a tree?
+ * @node: the node (initialized with utk_rbtree_node_init() or erased)
+ */
+static inline int utk_rbtree_node_empty(const struct utk_rbtree_node *node)
+{
+    return node->parent == node;
+}
+
+static inline int utk_rbtree_empty(const struct utk_rbtree *tree)
+{
+    return tree->root == NULL;
+}
+
+static inline size_t utk_rbtree_count(const struct utk_rbtree *tree)
+{
+    return tree->count;
+}
+
+/*!
+ * utk_rbtree_first - smallest node in O(1) or NULL
+ * @tree: the tree
+ */
+static inline struct utk_rbtree_node *
+utk_rbtree_first(const struct utk_rbtree *tree)
+{
+    return tree->leftmost;
+}
+
+/*!
+ * utk_rbtree_entry - get the struct for this node
+ * @ptr:    the &struct utk_rbtree_node pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_rbtree_node within the struct.
+ */
+#define utk_rbtree_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_rbtree_entry_safe - get the struct for this node or NULL
+ * @ptr:    the &struct utk_rbtree_node pointer or NULL.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_rbtree_node within the struct.
+ */
+#define utk_rbtree_entry_safe(ptr, type, member) ({			\
+      typeof(ptr) ____ptr = (ptr);					\
+      ____ptr ? utk_rbtree_entry(____ptr, type, member) : NULL;})
+
+/*!
+ * utk_rbtree_for_each    -    iterate over the nodes of a tree in order
+ * @pos:    the &struct utk_rbtree_node to use as a loop counter.
+ * @tree:    the tree.
+ */
+#define utk_rbtree_for_each(pos, tree)					\
+    for (pos = utk_rbtree_first(tree); pos; pos = utk_rbtree_next(pos))
+
+/*!
+ * utk_rbtree_for_each_reverse    -    iterate backwards over the nodes
+ * of a tree
+ * @pos:    the &struct utk_rbtree_node to use as a loop counter.
+ * @tree:    the tree.
+ */
+#define utk_rbtree_for_each_reverse(pos, tree)				\
+    for (pos = utk_rbtree_last(tree); pos; pos = utk_rbtree_prev(pos))
+
+/*!
+ * utk_rbtree_for_each_safe - iterate over the nodes of a tree in order
+ * safe against removal of node
+ * @pos:    the &struct utk_rbtree_node to use as a loop counter.
+ * @n:        another &struct utk_rbtree_node to use as temporary storage
+ * @tree:    the tree.
+ */
+#define utk_rbtree_for_each_safe(pos, n, tree)				\
+    for (pos = utk_rbtree_first(tree);					\
+	 pos && ({ n = utk_rbtree_next(pos); 1; });			\
+	 pos = n)
+
+/*!
+ * utk_rbtree_for_each_entry    -    iterate over the entries of a tree
+ * in order
+ * @pos:    the type * to use as a loop counter.
+ * @tree:    the tree.
+ * @member:    the name of the utk_rbtree_node within the struct.
+ */
+#define utk_rbtree_for_each_entry(pos, tree, member)			\
+    for (pos = utk_rbtree_entry_safe(utk_rbtree_first(tree),		\
+				     typeof(*pos), member);		\
+	 pos;								\
+	 pos = utk_rbtree_entry_safe(utk_rbtree_next(&pos->member),	\
+				     typeof(*pos), member))
+
+/*!
+ * utk_rbtree_for_each_entry_from - iterate over the entries of a tree in
+ * order from the current point (a lower bound for instance)
+ * @pos:    the type * to use as a loop counter, may be NULL.
+ * @member:    the name of the utk_rbtree_node within the struct.
+ */
+#define utk_rbtree_for_each_entry_from(pos, member)			\
+    for (; pos;								\
+	 pos = utk_rbtree_entry_safe(utk_rbtree_next(&pos->member),	\
+				     typeof(*pos), member))
+
+/*!
+ * utk_rbtree_for_each_entry_safe - iterate over the entries of a tree in
+ * order safe against removal of entry
+ * @pos:    the type * to use as a loop counter.
+ * @n:        another type * to use as temporary storage
+ * @tree:    the tree.
+ * @member:    the name of the utk_rbtree_node within the struct.
+ */
+#define utk_rbtree_for_each_entry_safe(pos, n, tree, member)		\
+    for (pos = utk_rbtree_entry_safe(utk_rbtree_first(tree),		\
+				     typeof(*pos), member);		\
+	 pos && ({ n = utk_rbtree_entry_safe(utk_rbtree_next(&pos->member), \
+					     typeof(*pos), member); 1; }); \
+	 pos = n)
+
+/*
+ * utk_rbtree_insert
+ *
+ *  Insert a node, after the nodes equal to it
+ *
+ * \param tree The tree
+ * \param node The node
+ * \param cmp Compare function
+ * \return void
+ */
+void utk_rbtree_insert(struct utk_rbtree *tree, struct utk_rbtree_node *node,
+		       utk_rbtree_cmp_cb_t cmp);
+
+/*
+ * utk_rbtree_insert_unique
+ *
+ *  Insert a node if no node is equal to it
+ *
+ * \param tree The tree
+ * \param node The node
+ * \param cmp Compare function
+ * \return NULL if node was inserted or the node equal to it
+ */
+struct utk_rbtree_node *utk_rbtree_insert_unique(struct utk_rbtree *tree,
+						 struct utk_rbtree_node *node,
+						 utk_rbtree_cmp_cb_t cmp);
+
+/*
+ * utk_rbtree_erase
+ *
+ *  Remove a node (the node is marked with utk_rbtree_node_init())
+ *
+ * \param tree The tree
+ * \param node The node
+ * \return void
+ */
+void utk_rbtree_erase(struct utk_rbtree *tree, struct utk_rbtree_node *node);
+
+/*
+ * utk_rbtree_find
+ *
+ *  Find a node by key
+ *
+ * \param tree The tree
+ * \param key The key
+ * \param cmp Compare function of a node and a key
+ * \return The first node with key or NULL
+ */
+struct utk_rbtree_node *utk_rbtree_find(const struct utk_rbtree *tree,
+					const void *key,
+					utk_rbtree_key_cb_t cmp);
+
+/*
+ * utk_rbtree_lower_bound
+ *
+ *  First node which doesn't sort before a key
+ *
+ * \param tree The tree
+ * \param key The key
+ * \param cmp Compare function of a node and a key
+ * \return The first node >= key or NULL
+ */
+struct utk_rbtree_node *utk_rbtree_lower_bound(const struct utk_rbtree *tree,
+					       const void *key,
+					       utk_rbtree_key_cb_t cmp);
+
+/*
+ * utk_rbtree_upper_bound
+ *
+ *  First node which sorts after a key
+ *
+ * \param tree The tree
+ * \param key The key
+ * \param cmp Compare function of a node and a key
+ * \return The first node > key or NULL
+ */
+struct utk_rbtree_node *utk_rbtree_upper_bound(const struct utk_rbtree *tree,
+					       const void *key,
+					       utk_rbtree_key_cb_t cmp);
+
+/*
+ * utk_rbtree_last
+ *
+ *  Biggest node in O(log n)
+ *
+ * \param tree The tree
+ * \return The node or NULL if the tree is empty
+ */
+struct utk_rbtree_node *utk_rbtree_last(const struct utk_rbtree *tree);
+
+/*
+ * utk_rbtree_next
+ *
+ *  Next node in order
+ *
+ * \param node The node
+ * \return The next node or NULL
+ */
+struct utk_rbtree_node *utk_rbtree_next(const struct utk_rbtree_node *node);
+
+/*
+ * utk_rbtree_prev
+ *
+ *  Previous node in order
+ *
+ * \param node The node
+ * \return The previous node or NULL
+ */
+struct utk_rbtree_node *utk_rbtree_prev(const struct utk_rbtree_node *node);
+
+#endif
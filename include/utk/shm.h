@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_SHM_H_
+#define _UTK_SHM_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/**
+ * shm.h - shared memory ring buffer for inter-process data transfer
+ *
+ * Producers and a consumer living in different processes exchange
+ * variable-length records through a lock-free ring mapped in all of
+ * them: no syscall and one copy per record (zero with
+ * utk_shm_ring_peek()).
+ *
+ * - Several producers can push concurrently (MPSC), only one consumer can
+ *   pop at a time;
+ * - head and tail indexes are on their own cache lines;
+ * - a consumer waiting for data (or a producer waiting for space) yields
+ *   the CPU a few times then sleeps on a futex, producers and consumer only
+ *   issue a wake up syscall when the other side is sleeping.
+ *
+ * The ring is created in a memfd (share the descriptor with fork() or
+ * SCM_RIGHTS) or in a named POSIX shared memory object (/dev/shm).
+ */
+
+struct utk_shm_ring_shared;
+
+struct utk_shm_ring {
+    struct utk_shm_ring_shared *shared;
+    unsigned char *data;
+    size_t size;
+    size_t map_size;
+    size_t peek_span;
+    int fd;
+};
+
+/*
+ * utk_shm_ring_create
+ *
+ *  Create a ring
+ *
+ * \param ring The ring which will be initialized
+ * \param name Name of the POSIX shared memory object ("/foo") or NULL to
+ *             create an anonymous memfd (ring->fd)
+ * \param size Capacity of the ring in bytes (rounded up to a power of 2)
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_shm_ring_create(struct utk_shm_ring *ring, const char *name,
+			size_t size);
+
+/*
+ * utk_shm_ring_open
+ *
+ *  Map a ring created by another process with a name
+ *
+ * \param ring The ring which will be initialized
+ * \param name Name given to utk_shm_ring_create()
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_shm_ring_open(struct utk_shm_ring *ring, const char *name);
+
+/*
+ * utk_shm_ring_open_fd
+ *
+ *  Map a ring from the descriptor of a memfd received from another process
+ *
+ * - fd is duplicated, the caller keeps its own descriptor.
+ *
+ * \param ring The ring which will be initialized
+ * \param fd Descriptor of the ring
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_shm_ring_open_fd(struct utk_shm_ring *ring, int fd);
+
+/*
+ * utk_shm_ring_close
+ *
+ *  Unmap the ring
+ *
+ * \param ring The ring
+ * \return void
+ */
+void utk_shm_ring_close(struct utk_shm_ring *ring);
+
+/*
+ * utk_shm_ring_unlink
+ *
+ *  Remove the name of a ring created with a name
+ *
+ * \param name Name given to utk_shm_ring_create()
+ * \return 0 on success or -1 to indicate error
+ */
+int utk_shm_ring_unlink(const char *name);
+
+/*
+ * utk_shm_ring_max_record
+ *
+ *  Maximum size of a record in the ring
+ *
+ * \param ring The ring
+ * \return Size in bytes
+ */
+size_t utk_shm_ring_max_record(const struct utk_shm_ring *ring);
+
+/*
+ * utk_shm_ring_push
+ *
+ *  Copy a record in the ring (producer side)
+ *
+ * \param ring The ring
+ * \param data Record data
+ * \param len Record length
+ * \param timeout_ms Time to wait for space: 0 to not wait, -1 forever
+ * \return 0 on success or -1 to indicate error (errno is EAGAIN when the
+ *         ring is full and timeout_ms is 0, ETIMEDOUT when the timeout
+ *         expired, EMSGSIZE when len is too big)
+ */
+int utk_shm_ring_push(struct utk_shm_ring *ring, const void *data, size_t len,
+		      int timeout_ms);
+
+/*
+ * utk_shm_ring_peek
+ *
+ *  Get the next record without copying it (consumer side)
+ *
+ * - The record stays valid until utk_shm_ring_consume().
+ *
+ * \param ring The ring
+ * \param data Pointer where the address of the record is stored
+ * \param timeout_ms Time to wait for a record: 0 to not wait, -1 forever
+ * \return The length of the record or -1 to indicate error (errno is
+ *         EAGAIN when the ring is empty and timeout_ms is 0, ETIMEDOUT when
+ *         the timeout expired)
+ */
+ssize_t utk_shm_ring_peek(struct utk_shm_ring *ring, const void **data,
+			  int timeout_ms);
+
+/*
+ * utk_shm_ring_consume
+ *
+ *  Release the record returned by utk_shm_ring_peek()
+ *
+ * \param ring The ring
+ * \return void
+ */
+void utk_shm_ring_consume(struct utk_shm_ring *ring);
+
+/*
+ * utk_shm_ring_pop
+ *
+ *  Copy the next record and release it (consumer side)
+ *
+ * \param ring The ring
+ * \param dst Destination pointer
+ * \param size Size of destination buffer
+ * \param timeout_ms Time to wait for a record: 0 to not wait, -1 forever
+ * \return The length of the record or -1 to indicate error (see
+ *         utk_shm_ring_peek(), errno is EMSGSIZE if dst is too small, the
+ *         record is kept in this case)
+ */
+ssize_t utk_shm_ring_pop(struct utk_shm_ring *ring, void *dst, size_t size,
+			 int timeout_ms);
+
+#endif
@@ -423,6 +423,20 @@ unsigned int utk_str_list_length(struct utk_str_list *list);
 unsigned int utk_str_list_toarray(struct utk_str_list *list,
 				  const char **array, size_t size);
 
+/*
+ * utk_str_list_sort
+ *
+ * Sort a list of str.
+ *
+ * - The sort is stable: equal strings keep their order.
+ *
+ * \param list The list to sort
+ * \param cmp Compare function of strings or NULL for strcmp()
+ * \return void
+ */
+void utk_str_list_sort(struct utk_str_list *list,
+		       int (*cmp)(const char *, const char *));
+
 /*
  * Walk over string list
  */
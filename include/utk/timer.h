@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_TIMER_H_
+#define _UTK_TIMER_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "utk/list.h"
+
+/**
+ * timer.h - hierarchical timer wheel
+ *
+ * A wheel holds any number of timers: starting, canceling and expiring a
+ * timer cost O(1) (amortized), whatever the number of armed timers.
+ *
+ * - Time is counted in the unit of the caller (milliseconds of
+ *   utk_ev_now() for instance) and rounded up to the tick of the wheel:
+ *   a timer never expires early but may expire up to a tick late;
+ * - the first level has UTK_TIMER_WHEEL_LVL0_SIZE slots of one tick, each
+ *   next level has UTK_TIMER_WHEEL_LVL_SIZE slots covering a whole turn of
+ *   the previous level. Timers of a slot are moved down (cascaded) when
+ *   the previous level wraps. Timeouts of more than 2^32 ticks are
+ *   cascaded until they expire;
+ * - timers are intrusive: embed a struct utk_timer and use
+ *   utk_timer_entry() (container_of()) in the callback;
+ * - expired timers are given all at once to the callback of the wheel,
+ *   at the end of utk_timer_wheel_advance();
+ * - the wheel doesn't lock: protect it if several threads use it.
+ */
+
+#define UTK_TIMER_WHEEL_LVL0_BITS 8
+#define UTK_TIMER_WHEEL_LVL_BITS 6
+#define UTK_TIMER_WHEEL_LVL0_SIZE (1 << UTK_TIMER_WHEEL_LVL0_BITS)
+#define UTK_TIMER_WHEEL_LVL_SIZE (1 << UTK_TIMER_WHEEL_LVL_BITS)
+#define UTK_TIMER_WHEEL_NB_LVLS 4
+
+struct utk_timer {
+    struct utk_list_head node;
+    /* tick of expiration */
+    uint64_t expires;
+};
+
+/*
+ * Expiration callback
+ *
+ * - expired is a list of the expired timers (struct utk_timer node);
+ * - timers may be restarted (utk_timer_wheel_start()) or canceled while
+ *   walking the list with utk_list_for_each_entry_safe(), the ones left
+ *   in the list are stopped when the callback returns.
+ */
+typedef void (*utk_timer_wheel_cb_t)(void *opaque,
+				     struct utk_list_head *expired);
+
+struct utk_timer_wheel {
+    struct utk_list_head lvl0[UTK_TIMER_WHEEL_LVL0_SIZE];
+    struct utk_list_head lvl[UTK_TIMER_WHEEL_NB_LVLS][UTK_TIMER_WHEEL_LVL_SIZE];
+    struct utk_list_head expired;
+    /* next tick to process */
+    uint64_t tick;
+    uint64_t tick_size;
+    /* time given to the last utk_timer_wheel_advance() */
+    uint64_t now;
+    size_t count;
+    utk_timer_wheel_cb_t cb;
+    void *opaque;
+};
+
+/*!
+ * utk_timer_entry - get the struct for this timer
+ * @ptr:    the &struct utk_timer pointer.
+ * @type:    the type of the struct this is embedded in.
+ * @member:    the name of the utk_timer within the struct.
+ */
+#define utk_timer_entry(ptr, type, member)	\
+    container_of(ptr, type, member)
+
+/*!
+ * utk_timer_init - initialize a stopped timer
+ * @timer: the timer
+ */
+static inline void utk_timer_init(struct utk_timer *timer)
+{
+    utk_list_head_init(&timer->node);
+    timer->expires = 0;
+}
+
+/*!
+ * utk_timer_pending - is timer started?
+ * @timer: the timer
+ */
+static inline int utk_timer_pending(const struct utk_timer *timer)
+{
+    return !utk_list_empty(&timer->node);
+}
+
+/*
+ * utk_timer_wheel_init
+ *
+ *  Initialize a wheel (no allocation)
+ *
+ * \param wheel The wheel
+ * \param tick_size Resolution in time unit
+ * \param now Current time
+ * \param cb Expiration callback
+ * \param opaque Data given to cb
+ * \return 0 on success or -1 to indicate error (EINVAL)
+ */
+int utk_timer_wheel_init(struct utk_timer_wheel *wheel, uint64_t tick_size,
+			 uint64_t now, utk_timer_wheel_cb_t cb, void *opaque);
+
+/*
+ * utk_timer_wheel_start
+ *
+ *  Start a timer, or restart it if it is already started
+ *
+ * \param wheel The wheel
+ * \param timer The timer (initialized with utk_timer_init())
+ * \param timeout Delay from the current time of the wheel
+ * \return void
+ */
+void utk_timer_wheel_start(struct utk_timer_wheel *wheel,
+			   struct utk_timer *timer, uint64_t timeout);
+
+/*
+ * utk_timer_wheel_cancel
+ *
+ *  Stop a timer (nothing is done if it isn't started)
+ *
+ * \param wheel The wheel
+ * \param timer The timer
+ * \return void
+ */
+void utk_timer_wheel_cancel(struct utk_timer_wheel *wheel,
+			    struct utk_timer *timer);
+
+/*
+ * utk_timer_wheel_advance
+ *
+ *  Move the wheel to the current time and expire timers
+ *
+ * \param wheel The wheel
+ * \param now Current time (ignored if it is before the last one)
+ * \return The number of expired timers given to the callback
+ */
+size_t utk_timer_wheel_advance(struct utk_timer_wheel *wheel, uint64_t now);
+
+/*
+ * utk_timer_wheel_count
+ *
+ *  Number of started timers
+ *
+ * \param wheel The wheel
+ * \return The number of timers
+ */
+static inline size_t utk_timer_wheel_count(const struct utk_timer_wheel *wheel)
+{
+    return wheel->count;
+}
+
+#endif
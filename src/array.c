@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/array.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SPSC_RING_MIN_SIZE 64
+
+/*
+ * Records are aligned on 8 bytes and start with a 64 bits header:
+ * length in low 32 bits, flags in high 32 bits. A padding record fills
+ * the end of the ring when the next record doesn't fit there.
+ */
+#define SPSC_REC_HEADER 8
+#define SPSC_REC_PAD ((uint64_t)1 << 32)
+#define SPSC_REC_SPAN(len) ((SPSC_REC_HEADER + (len) + 7) & ~(size_t)7)
+
+int utk_spsc_ring_init(struct utk_spsc_ring *ring, size_t size,
+		       const struct utk_array_allocator *alloc)
+{
+    size_t capacity = SPSC_RING_MIN_SIZE;
+
+    while(capacity < size)
+    {
+	/* lengths are stored on 32 bits */
+	if(capacity > UINT32_MAX / 2 || capacity > (SIZE_MAX >> 2))
+	{
+	    errno = EINVAL;
+	    return -1;
+	}
+	capacity <<= 1;
+    }
+
+    ring->data = utk_array_realloc(alloc, NULL, 0, capacity);
+    if(ring->data == NULL)
+    {
+	errno = ENOMEM;
+	return -1;
+    }
+    ring->size = capacity;
+    ring->alloc = alloc;
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->reserved = 0;
+    ring->tail = 0;
+    ring->head_cache = 0;
+    ring->peeked = 0;
+
+    return 0;
+}
+
+void utk_spsc_ring_cleanup(struct utk_spsc_ring *ring)
+{
+    utk_array_free(ring->alloc, ring->data);
+    ring->data = NULL;
+}
+
+size_t utk_spsc_ring_max_record(const struct utk_spsc_ring *ring)
+{
+    /* a record with its padding must fit in an empty ring */
+    return ring->size / 2 - SPSC_REC_HEADER;
+}
+
+void *utk_spsc_ring_reserve(struct utk_spsc_ring *ring, size_t len)
+{
+    size_t head,
+	need,
+	pad,
+	pos;
+
+    if(len > utk_spsc_ring_max_record(ring))
+    {
+	errno = EMSGSIZE;
+	return NULL;
+    }
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    pos = head & (ring->size - 1);
+    need = SPSC_REC_SPAN(len);
+
+    /* a record never wraps: pad the end of the ring */
+    pad = (need > ring->size - pos ? ring->size - pos : 0);
+
+    if(head + pad + need - ring->tail_cache > ring->size)
+    {
+	ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if(head + pad + need - ring->tail_cache > ring->size)
+	{
+	    errno = EAGAIN;
+	    return NULL;
+	}
+    }
+
+    if(pad != 0)
+    {
+	/* published with the record by utk_spsc_ring_commit() */
+	*(uint64_t *)(ring->data + pos) = SPSC_REC_PAD | pad;
+	head += pad;
+	pos = 0;
+    }
+    ring->reserved = head;
+
+    return ring->data + pos + SPSC_REC_HEADER;
+}
+
+void utk_spsc_ring_commit(struct utk_spsc_ring *ring, size_t len)
+{
+    *(uint64_t *)(ring->data + (ring->reserved & (ring->size - 1))) = len;
+    __atomic_store_n(&ring->head, ring->reserved + SPSC_REC_SPAN(len),
+		     __ATOMIC_RELEASE);
+}
+
+int utk_spsc_ring_push(struct utk_spsc_ring *ring, const void *data,
+		       size_t len)
+{
+    void *dst = NULL;
+
+    dst = utk_spsc_ring_reserve(ring, len);
+    if(dst == NULL)
+    {
+	return -1;
+    }
+
+    /* data may be NULL for an empty record */
+    if(len != 0)
+    {
+	memcpy(dst, data, len);
+    }
+    utk_spsc_ring_commit(ring, len);
+
+    return 0;
+}
+
+ssize_t utk_spsc_ring_peek(struct utk_spsc_ring *ring, const void **data)
+{
+    size_t pos = ring->peeked;
+    uint64_t header;
+
+    for(;;)
+    {
+	if(pos == ring->head_cache)
+	{
+	    ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	    if(pos == ring->head_cache)
+	    {
+		errno = EAGAIN;
+		return -1;
+	    }
+	}
+
+	header = *(const uint64_t *)(ring->data + (pos & (ring->size - 1)));
+	if((header & SPSC_REC_PAD) == 0)
+	{
+	    break;
+	}
+	pos += (size_t)(header & UINT32_MAX);
+    }
+
+    *data = ring->data + (pos & (ring->size - 1)) + SPSC_REC_HEADER;
+    ring->peeked = pos + SPSC_REC_SPAN((size_t)header);
+
+    return (ssize_t)header;
+}
+
+void utk_spsc_ring_consume(struct utk_spsc_ring *ring)
+{
+    __atomic_store_n(&ring->tail, ring->peeked, __ATOMIC_RELEASE);
+}
+
+ssize_t utk_spsc_ring_pop(struct utk_spsc_ring *ring, void *dst, size_t size)
+{
+    const void *data = NULL;
+    size_t peeked = ring->peeked;
+    ssize_t len;
+
+    len = utk_spsc_ring_peek(ring, &data);
+    if(len < 0)
+    {
+	return -1;
+    }
+
+    if((size_t)len > size)
+    {
+	ring->peeked = peeked;
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    if(len != 0)
+    {
+	memcpy(dst, data, (size_t)len);
+    }
+    utk_spsc_ring_consume(ring);
+
+    return len;
+}
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/crc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#define UTK_CRC32C_X86 1
+#endif
+
+/* CRC-32C reversed polynomial */
+#define UTK_CRC32C_POLY 0x82f63b78u
+
+/*
+ * Lanes sizes of the interleaved hardware CRC: big buffers are cut in 3
+ * lanes computed in parallel (crc32 instruction has a latency of 3 cycles
+ * and a throughput of 1 per cycle) then combined.
+ */
+#define UTK_CRC32C_LONG 8192
+#define UTK_CRC32C_SHORT 256
+
+static uint32_t crc32c_table[8][256];
+
+/* x^(2^n) mod P */
+static uint32_t crc32c_x2n_table[32];
+
+static uint32_t (*crc32c_impl)(uint32_t crc, const unsigned char *p,
+			       size_t len);
+static const char *crc32c_impl_name;
+/* best implementation supported by the CPU */
+static uint32_t (*crc32c_best_impl)(uint32_t crc, const unsigned char *p,
+				    size_t len);
+static const char *crc32c_best_impl_name;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Multiply a and b modulo P (bit reflected polynomials)
+ */
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m,
+	p;
+
+    m = (uint32_t)1 << 31;
+    p = 0;
+    for(;;)
+    {
+	if(a & m)
+	{
+	    p ^= b;
+	    if((a & (m - 1)) == 0)
+	    {
+		break;
+	    }
+	}
+	m >>= 1;
+	b = (b & 1 ? (b >> 1) ^ UTK_CRC32C_POLY : b >> 1);
+    }
+
+    return p;
+}
+
+/*
+ * x^(n * 2^k) mod P
+ */
+static uint32_t crc32c_x2nmodp(uint64_t n, unsigned int k)
+{
+    uint32_t p;
+
+    p = (uint32_t)1 << 31;
+    while(n != 0)
+    {
+	if(n & 1)
+	{
+	    p = crc32c_multmodp(crc32c_x2n_table[k & 31], p);
+	}
+	n >>= 1;
+	k++;
+    }
+
+    return p;
+}
+
+/*
+ * Slicing-by-8 software implementation, works on the raw crc register
+ */
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while(len != 0 && ((uintptr_t)p & 7) != 0)
+    {
+	crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	len--;
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while(len >= 8)
+    {
+	uint64_t w;
+
+	memcpy(&w, p, sizeof(w));
+	w ^= crc;
+	crc = crc32c_table[7][w & 0xff]
+	    ^ crc32c_table[6][(w >> 8) & 0xff]
+	    ^ crc32c_table[5][(w >> 16) & 0xff]
+	    ^ crc32c_table[4][(w >> 24) & 0xff]
+	    ^ crc32c_table[3][(w >> 32) & 0xff]
+	    ^ crc32c_table[2][(w >> 40) & 0xff]
+	    ^ crc32c_table[1][(w >> 48) & 0xff]
+	    ^ crc32c_table[0][w >> 56];
+	p += 8;
+	len -= 8;
+    }
+#endif
+
+    while(len != 0)
+    {
+	crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	len--;
+    }
+
+    return crc;
+}
+
+#ifdef UTK_CRC32C_X86
+
+/* shift constants of the lanes, see crc32c_init() */
+static uint32_t crc32c_long_shift;
+static uint32_t crc32c_short_shift;
+static uint32_t crc32c_long_shift_clmul;
+static uint32_t crc32c_short_shift_clmul;
+
+/*
+ * Shift crc by the length of a lane (append zeros) in software
+ */
+static uint32_t crc32c_shift_sw(uint32_t k, uint32_t k_clmul, uint32_t crc)
+{
+    (void)k_clmul;
+
+    return crc32c_multmodp(k, crc);
+}
+
+/*
+ * Shift crc by the length of a lane with a carry-less multiplication,
+ * the crc32 instruction does the reduction modulo P. The product of two
+ * reflected 32 bits polynomials is multiplied by x and crc32 multiplies
+ * it by x^32, so k_clmul is x^(8 * lane - 33) mod P.
+ */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_shift_clmul(uint32_t k, uint32_t k_clmul, uint32_t crc)
+{
+    __m128i r;
+
+    (void)k;
+
+    r = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc),
+			     _mm_cvtsi32_si128((int)k_clmul), 0);
+
+    return (uint32_t)_mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(r));
+}
+
+#define CRC32C_HW_LANES(lane, shift, k, k_clmul) do			\
+    {									\
+	while(len >= 3 * (lane))					\
+	{								\
+	    uint64_t crc0 = crc,					\
+		crc1 = 0,						\
+		crc2 = 0,						\
+		w0, w1, w2;						\
+	    const unsigned char *end = p + (lane);			\
+									\
+	    do								\
+	    {								\
+		memcpy(&w0, p, 8);					\
+		memcpy(&w1, p + (lane), 8);				\
+		memcpy(&w2, p + 2 * (lane), 8);				\
+		crc0 = _mm_crc32_u64(crc0, w0);				\
+		crc1 = _mm_crc32_u64(crc1, w1);				\
+		crc2 = _mm_crc32_u64(crc2, w2);				\
+		p += 8;							\
+	    } while(p < end);						\
+									\
+	    crc = shift(k, k_clmul, (uint32_t)crc0) ^ (uint32_t)crc1;	\
+	    crc = shift(k, k_clmul, crc) ^ (uint32_t)crc2;		\
+	    p += 2 * (lane);						\
+	    len -= 3 * (lane);						\
+	}								\
+    } while(0)
+
+/*
+ * Hardware implementations with the SSE4.2 crc32 instruction, the lanes
+ * are combined in software or with PCLMULQDQ.
+ */
+#define CRC32C_HW_DEFINE(name, isa, shift)				\
+    __attribute__((target(isa)))					\
+    static uint32_t name(uint32_t crc, const unsigned char *p, size_t len) \
+    {									\
+	uint64_t w;							\
+									\
+	while(len != 0 && ((uintptr_t)p & 7) != 0)			\
+	{								\
+	    crc = _mm_crc32_u8(crc, *p++);				\
+	    len--;							\
+	}								\
+									\
+	CRC32C_HW_LANES(UTK_CRC32C_LONG, shift,				\
+			crc32c_long_shift, crc32c_long_shift_clmul);	\
+	CRC32C_HW_LANES(UTK_CRC32C_SHORT, shift,			\
+			crc32c_short_shift, crc32c_short_shift_clmul);	\
+									\
+	while(len >= 8)							\
+	{								\
+	    memcpy(&w, p, 8);						\
+	    crc = (uint32_t)_mm_crc32_u64(crc, w);			\
+	    p += 8;							\
+	    len -= 8;							\
+	}								\
+									\
+	while(len != 0)							\
+	{								\
+	    crc = _mm_crc32_u8(crc, *p++);				\
+	    len--;							\
+	}								\
+									\
+	return crc;							\
+    }
+
+CRC32C_HW_DEFINE(crc32c_hw, "sse4.2", crc32c_shift_sw)
+CRC32C_HW_DEFINE(crc32c_hw_clmul, "sse4.2,pclmul", crc32c_shift_clmul)
+
+#endif /* UTK_CRC32C_X86 */
+
+static void crc32c_init(void)
+{
+    uint32_t crc;
+    unsigned int i,
+	j;
+
+    for(i = 0; i < 256; ++i)
+    {
+	crc = i;
+	for(j = 0; j < 8; ++j)
+	{
+	    crc = (crc & 1 ? (crc >> 1) ^ UTK_CRC32C_POLY : crc >> 1);
+	}
+	crc32c_table[0][i] = crc;
+    }
+
+    for(i = 0; i < 256; ++i)
+    {
+	for(j = 1; j < 8; ++j)
+	{
+	    crc = crc32c_table[j - 1][i];
+	    crc32c_table[j][i] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+	}
+    }
+
+    /* x^1, then square */
+    crc32c_x2n_table[0] = (uint32_t)1 << 30;
+    for(i = 1; i < 32; ++i)
+    {
+	crc32c_x2n_table[i] = crc32c_multmodp(crc32c_x2n_table[i - 1],
+					      crc32c_x2n_table[i - 1]);
+    }
+
+    crc32c_impl = crc32c_sw;
+    crc32c_impl_name = "slicing-by-8";
+
+#ifdef UTK_CRC32C_X86
+    crc32c_long_shift = crc32c_x2nmodp(UTK_CRC32C_LONG, 3);
+    crc32c_short_shift = crc32c_x2nmodp(UTK_CRC32C_SHORT, 3);
+    crc32c_long_shift_clmul = crc32c_x2nmodp(8 * UTK_CRC32C_LONG - 33, 0);
+    crc32c_short_shift_clmul = crc32c_x2nmodp(8 * UTK_CRC32C_SHORT - 33, 0);
+
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+    {
+	if(__builtin_cpu_supports("pclmul"))
+	{
+	    crc32c_impl = crc32c_hw_clmul;
+	    crc32c_impl_name = "sse4.2+pclmul";
+	}
+	else
+	{
+	    crc32c_impl = crc32c_hw;
+	    crc32c_impl_name = "sse4.2";
+	}
+    }
+#endif
+
+    crc32c_best_impl = crc32c_impl;
+    crc32c_best_impl_name = crc32c_impl_name;
+}
+
+uint32_t utk_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    return ~crc32c_impl(~crc, buf, len);
+}
+
+uint32_t utk_crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    return crc32c_multmodp(crc32c_x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+const char *utk_crc32c_implementation(void)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    return crc32c_impl_name;
+}
+
+int utk_crc32c_set_implementation(const char *name)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    if(name == NULL)
+    {
+	crc32c_impl = crc32c_best_impl;
+	crc32c_impl_name = crc32c_best_impl_name;
+	return 0;
+    }
+
+    if(strcmp(name, "slicing-by-8") == 0)
+    {
+	crc32c_impl = crc32c_sw;
+	crc32c_impl_name = "slicing-by-8";
+	return 0;
+    }
+
+#ifdef UTK_CRC32C_X86
+    /* the best one is also supported by the CPU */
+    if(strcmp(name, "sse4.2") == 0 && crc32c_best_impl != crc32c_sw)
+    {
+	crc32c_impl = crc32c_hw;
+	crc32c_impl_name = "sse4.2";
+	return 0;
+    }
+    if(strcmp(name, "sse4.2+pclmul") == 0
+       && crc32c_best_impl == crc32c_hw_clmul)
+    {
+	crc32c_impl = crc32c_hw_clmul;
+	crc32c_impl_name = "sse4.2+pclmul";
+	return 0;
+    }
+#endif
+
+    if(strcmp(name, "sse4.2") == 0 || strcmp(name, "sse4.2+pclmul") == 0)
+    {
+	errno = ENOTSUP;
+    }
+    else
+    {
+	errno = EINVAL;
+    }
+
+    return -1;
+}
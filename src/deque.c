@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/deque.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+static struct utk_deque_block *deque_block_get(struct utk_deque *dq)
+{
+    struct utk_deque_block *block = dq->spare;
+
+    if(block != NULL)
+    {
+	dq->spare = NULL;
+	return block;
+    }
+
+    block = malloc(sizeof(*block) + dq->block_len * dq->elem_size);
+    if(block == NULL)
+    {
+	errno = ENOMEM;
+    }
+
+    return block;
+}
+
+static void deque_block_put(struct utk_deque *dq,
+			    struct utk_deque_block *block)
+{
+    utk_list_del(&block->list);
+
+    if(dq->spare == NULL)
+    {
+	dq->spare = block;
+    }
+    else
+    {
+	free(block);
+    }
+}
+
+int utk_deque_init(struct utk_deque *dq, size_t elem_size, size_t block_len)
+{
+    if(elem_size == 0)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    if(block_len == 0)
+    {
+	block_len = (UTK_DEQUE_BLOCK_SIZE - sizeof(struct utk_deque_block))
+	    / elem_size;
+	if(block_len == 0)
+	{
+	    block_len = 1;
+	}
+    }
+    if(block_len > (SIZE_MAX - sizeof(struct utk_deque_block)) / elem_size)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    utk_list_head_init(&dq->blocks);
+    dq->spare = NULL;
+    dq->elem_size = elem_size;
+    dq->block_len = block_len;
+    dq->count = 0;
+    dq->head = 0;
+    dq->tail = 0;
+
+    return 0;
+}
+
+void utk_deque_cleanup(struct utk_deque *dq)
+{
+    struct utk_deque_block *block = NULL;
+    struct utk_deque_block *n = NULL;
+
+    utk_list_for_each_entry_safe(block, n, &dq->blocks, list)
+    {
+	utk_list_del(&block->list);
+	free(block);
+    }
+    free(dq->spare);
+    dq->spare = NULL;
+    dq->count = 0;
+    dq->head = 0;
+    dq->tail = 0;
+}
+
+void *utk_deque_push_back(struct utk_deque *dq)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0 || dq->tail == dq->block_len)
+    {
+	block = deque_block_get(dq);
+	if(block == NULL)
+	{
+	    return NULL;
+	}
+	utk_list_add_tail(&block->list, &dq->blocks);
+	if(dq->count == 0)
+	{
+	    dq->head = 0;
+	}
+	dq->tail = 0;
+    }
+    else
+    {
+	block = utk_list_entry(dq->blocks.prev, struct utk_deque_block, list);
+    }
+
+    dq->count++;
+
+    return block->data + dq->tail++ * dq->elem_size;
+}
+
+void *utk_deque_push_front(struct utk_deque *dq)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0 || dq->head == 0)
+    {
+	block = deque_block_get(dq);
+	if(block == NULL)
+	{
+	    return NULL;
+	}
+	utk_list_add(&block->list, &dq->blocks);
+	if(dq->count == 0)
+	{
+	    dq->tail = dq->block_len;
+	}
+	dq->head = dq->block_len;
+    }
+    else
+    {
+	block = utk_list_entry(dq->blocks.next, struct utk_deque_block, list);
+    }
+
+    dq->count++;
+
+    return block->data + --dq->head * dq->elem_size;
+}
+
+int utk_deque_pop_back(struct utk_deque *dq, void *dst)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0)
+    {
+	errno = ENOENT;
+	return -1;
+    }
+
+    block = utk_list_entry(dq->blocks.prev, struct utk_deque_block, list);
+    dq->tail--;
+    if(dst != NULL)
+    {
+	memcpy(dst, block->data + dq->tail * dq->elem_size, dq->elem_size);
+    }
+
+    if(--dq->count == 0)
+    {
+	deque_block_put(dq, block);
+	dq->head = 0;
+	dq->tail = 0;
+    }
+    else if(dq->tail == 0)
+    {
+	deque_block_put(dq, block);
+	dq->tail = dq->block_len;
+    }
+
+    return 0;
+}
+
+int utk_deque_pop_front(struct utk_deque *dq, void *dst)
+{
+    struct utk_deque_block *block = NULL;
+
+    if(dq->count == 0)
+    {
+	errno = ENOENT;
+	return -1;
+    }
+
+    block = utk_list_entry(dq->blocks.next, struct utk_deque_block, list);
+    if(dst != NULL)
+    {
+	memcpy(dst, block->data + dq->head * dq->elem_size, dq->elem_size);
+    }
+    dq->head++;
+
+    if(--dq->count == 0)
+    {
+	deque_block_put(dq, block);
+	dq->head = 0;
+	dq->tail = 0;
+    }
+    else if(dq->head == dq->block_len)
+    {
+	deque_block_put(dq, block);
+	dq->head = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,584 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/ev.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+#define EV_DEFAULT_MAX_EVENTS 256
+#define EV_NS_PER_MS 1000000
+
+static uint64_t ev_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Timers: binary min heap on expire, timer->index is the position in the
+ * heap plus one (0 for a stopped timer, like a zeroed one).
+ */
+
+static void ev_timer_set(struct utk_ev_loop *loop, size_t pos,
+			 struct utk_ev_timer *timer)
+{
+    loop->timers[pos] = timer;
+    timer->index = pos + 1;
+}
+
+static void ev_timer_up(struct utk_ev_loop *loop, size_t pos)
+{
+    struct utk_ev_timer *timer = loop->timers[pos];
+    size_t parent;
+
+    while(pos > 0)
+    {
+	parent = (pos - 1) / 2;
+	if(loop->timers[parent]->expire <= timer->expire)
+	{
+	    break;
+	}
+	ev_timer_set(loop, pos, loop->timers[parent]);
+	pos = parent;
+    }
+
+    ev_timer_set(loop, pos, timer);
+}
+
+static void ev_timer_down(struct utk_ev_loop *loop, size_t pos)
+{
+    struct utk_ev_timer *timer = loop->timers[pos];
+    size_t child;
+
+    for(;;)
+    {
+	child = pos * 2 + 1;
+	if(child >= loop->nb_timers)
+	{
+	    break;
+	}
+	if(child + 1 < loop->nb_timers
+	   && loop->timers[child + 1]->expire < loop->timers[child]->expire)
+	{
+	    child++;
+	}
+	if(timer->expire <= loop->timers[child]->expire)
+	{
+	    break;
+	}
+	ev_timer_set(loop, pos, loop->timers[child]);
+	pos = child;
+    }
+
+    ev_timer_set(loop, pos, timer);
+}
+
+static void ev_timer_remove(struct utk_ev_loop *loop,
+			    struct utk_ev_timer *timer)
+{
+    struct utk_ev_timer *last = NULL;
+    size_t pos = timer->index - 1;
+
+    timer->index = 0;
+    last = loop->timers[--loop->nb_timers];
+    if(last == timer)
+    {
+	return;
+    }
+
+    ev_timer_set(loop, pos, last);
+    if(pos > 0 && loop->timers[(pos - 1) / 2]->expire > last->expire)
+    {
+	ev_timer_up(loop, pos);
+    }
+    else
+    {
+	ev_timer_down(loop, pos);
+    }
+}
+
+void utk_ev_timer_init(struct utk_ev_timer *timer)
+{
+    timer->expire = 0;
+    timer->interval = 0;
+    timer->index = 0;
+    timer->cb = NULL;
+}
+
+int utk_ev_timer_start(struct utk_ev_loop *loop, struct utk_ev_timer *timer,
+		       uint64_t timeout_ms, uint64_t interval_ms,
+		       utk_ev_timer_cb_t cb)
+{
+    struct utk_ev_timer **timers = NULL;
+    size_t size;
+
+    if(timer->index != 0)
+    {
+	ev_timer_remove(loop, timer);
+    }
+
+    if(loop->nb_timers == loop->timers_size)
+    {
+	size = (loop->timers_size == 0 ? 16 : loop->timers_size * 2);
+	timers = realloc(loop->timers, size * sizeof(*timers));
+	if(timers == NULL)
+	{
+	    return -1;
+	}
+	loop->timers = timers;
+	loop->timers_size = size;
+    }
+
+    timer->expire = ev_clock() + timeout_ms * EV_NS_PER_MS;
+    timer->interval = interval_ms * EV_NS_PER_MS;
+    timer->cb = cb;
+
+    loop->timers[loop->nb_timers] = timer;
+    ev_timer_up(loop, loop->nb_timers++);
+
+    return 0;
+}
+
+void utk_ev_timer_stop(struct utk_ev_loop *loop, struct utk_ev_timer *timer)
+{
+    if(timer->index != 0)
+    {
+	ev_timer_remove(loop, timer);
+    }
+}
+
+int utk_ev_timer_active(const struct utk_ev_timer *timer)
+{
+    return (timer->index != 0);
+}
+
+/*
+ * Call the callbacks of the expired timers
+ */
+static int ev_timers_expire(struct utk_ev_loop *loop)
+{
+    struct utk_ev_timer *timer = NULL;
+    int count = 0;
+
+    while(loop->nb_timers != 0 && loop->timers[0]->expire <= loop->now)
+    {
+	timer = loop->timers[0];
+	if(timer->interval != 0)
+	{
+	    /* don't try to catch up expirations missed by a late loop */
+	    timer->expire += timer->interval;
+	    if(timer->expire <= loop->now)
+	    {
+		timer->expire = loop->now + timer->interval;
+	    }
+	    ev_timer_down(loop, 0);
+	}
+	else
+	{
+	    ev_timer_remove(loop, timer);
+	}
+
+	timer->cb(loop, timer);
+	count++;
+    }
+
+    return count;
+}
+
+/*
+ * Descriptors
+ */
+
+static uint32_t ev_to_epoll(int events)
+{
+    return ((events & UTK_EV_READ ? EPOLLIN | EPOLLRDHUP : 0)
+	    | (events & UTK_EV_WRITE ? EPOLLOUT : 0)
+	    | (events & UTK_EV_EDGE ? EPOLLET : 0));
+}
+
+static int ev_from_epoll(uint32_t events)
+{
+    return ((events & (EPOLLIN | EPOLLRDHUP) ? UTK_EV_READ : 0)
+	    | (events & EPOLLOUT ? UTK_EV_WRITE : 0)
+	    | (events & (EPOLLERR | EPOLLHUP) ? UTK_EV_ERROR : 0));
+}
+
+int utk_ev_io_start(struct utk_ev_loop *loop, struct utk_ev_io *io, int fd,
+		    int events, utk_ev_io_cb_t cb)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = ev_to_epoll(events);
+    ev.data.ptr = io;
+
+    io->fd = fd;
+    io->events = events;
+    io->cb = cb;
+
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int utk_ev_io_modify(struct utk_ev_loop *loop, struct utk_ev_io *io,
+		     int events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = ev_to_epoll(events);
+    ev.data.ptr = io;
+
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_MOD, io->fd, &ev) != 0)
+    {
+	return -1;
+    }
+
+    io->events = events;
+
+    return 0;
+}
+
+int utk_ev_io_stop(struct utk_ev_loop *loop, struct utk_ev_io *io)
+{
+    int i;
+
+    /* forget the events of io not dispatched yet */
+    for(i = loop->cur_event + 1; i < loop->nb_events; ++i)
+    {
+	if(loop->events[i].data.ptr == io)
+	{
+	    loop->events[i].data.ptr = NULL;
+	}
+    }
+
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, io->fd, NULL);
+}
+
+/*
+ * Signals
+ */
+
+static void ev_signal_cb(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			 int events)
+{
+    struct utk_ev_signal *sig = NULL,
+	*n = NULL;
+    struct signalfd_siginfo info;
+
+    (void)events;
+
+    while(read(io->fd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+    {
+	utk_list_for_each_entry_safe(sig, n, &loop->signals, list)
+	{
+	    if(sig->signo == (int)info.ssi_signo)
+	    {
+		sig->cb(loop, sig);
+	    }
+	}
+    }
+}
+
+int utk_ev_signal_start(struct utk_ev_loop *loop, struct utk_ev_signal *sig,
+			int signo, utk_ev_signal_cb_t cb)
+{
+    sigset_t set;
+    int fd;
+
+    sigemptyset(&set);
+    if(sigaddset(&set, signo) != 0)
+    {
+	return -1;
+    }
+    sigaddset(&loop->sigmask, signo);
+
+    errno = pthread_sigmask(SIG_BLOCK, &set, NULL);
+    if(errno != 0)
+    {
+	return -1;
+    }
+
+    fd = signalfd(loop->signal_io.fd, &loop->sigmask,
+		  SFD_NONBLOCK | SFD_CLOEXEC);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    if(loop->signal_io.fd < 0
+       && utk_ev_io_start(loop, &loop->signal_io, fd, UTK_EV_READ,
+			  ev_signal_cb) != 0)
+    {
+	close(fd);
+	return -1;
+    }
+
+    sig->signo = signo;
+    sig->cb = cb;
+    utk_list_add_tail(&sig->list, &loop->signals);
+
+    return 0;
+}
+
+void utk_ev_signal_stop(struct utk_ev_loop *loop, struct utk_ev_signal *sig)
+{
+    struct utk_ev_signal *other = NULL;
+    sigset_t set;
+
+    utk_list_del(&sig->list);
+
+    utk_list_for_each_entry(other, &loop->signals, list)
+    {
+	if(other->signo == sig->signo)
+	{
+	    return;
+	}
+    }
+
+    sigdelset(&loop->sigmask, sig->signo);
+    signalfd(loop->signal_io.fd, &loop->sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    sigemptyset(&set);
+    sigaddset(&set, sig->signo);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+}
+
+/*
+ * Wake ups from other threads
+ */
+
+static void ev_async_cb(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			int events)
+{
+    struct utk_ev_async *async = NULL,
+	*n = NULL;
+    uint64_t value;
+
+    (void)events;
+
+    if(read(io->fd, &value, sizeof(value)) < 0)
+    {
+	return;
+    }
+
+    utk_list_for_each_entry_safe(async, n, &loop->asyncs, list)
+    {
+	if(__atomic_exchange_n(&async->pending, 0, __ATOMIC_ACQ_REL))
+	{
+	    async->cb(loop, async);
+	}
+    }
+}
+
+void utk_ev_async_start(struct utk_ev_loop *loop, struct utk_ev_async *async,
+			utk_ev_async_cb_t cb)
+{
+    async->pending = 0;
+    async->cb = cb;
+    utk_list_add_tail(&async->list, &loop->asyncs);
+}
+
+void utk_ev_async_stop(struct utk_ev_loop *loop, struct utk_ev_async *async)
+{
+    (void)loop;
+
+    utk_list_del(&async->list);
+}
+
+void utk_ev_async_send(struct utk_ev_loop *loop, struct utk_ev_async *async)
+{
+    uint64_t one = 1;
+    ssize_t cc;
+
+    /* one write until the loop has seen the send */
+    if(__atomic_exchange_n(&async->pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+	/* only fails if the counter would overflow: the loop is woken up */
+	cc = write(loop->async_io.fd, &one, sizeof(one));
+	(void)cc;
+    }
+}
+
+/*
+ * Loop
+ */
+
+int utk_ev_loop_init(struct utk_ev_loop *loop, int max_events)
+{
+    int fd;
+
+    memset(loop, 0, sizeof(*loop));
+    loop->signal_io.fd = -1;
+    loop->async_io.fd = -1;
+    sigemptyset(&loop->sigmask);
+    utk_list_head_init(&loop->signals);
+    utk_list_head_init(&loop->asyncs);
+
+    loop->max_events = (max_events <= 0 ? EV_DEFAULT_MAX_EVENTS
+			: max_events);
+    loop->events = malloc((size_t)loop->max_events * sizeof(*loop->events));
+    if(loop->events == NULL)
+    {
+	return -1;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(loop->epfd < 0)
+    {
+	goto ex_on_error;
+    }
+
+    fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd < 0)
+    {
+	goto ex_on_error;
+    }
+    if(utk_ev_io_start(loop, &loop->async_io, fd, UTK_EV_READ,
+		       ev_async_cb) != 0)
+    {
+	close(fd);
+	goto ex_on_error;
+    }
+
+    loop->now = ev_clock();
+
+    return 0;
+
+ex_on_error:
+    if(loop->epfd >= 0)
+    {
+	close(loop->epfd);
+    }
+    free(loop->events);
+
+    return -1;
+}
+
+void utk_ev_loop_cleanup(struct utk_ev_loop *loop)
+{
+    if(loop->signal_io.fd >= 0)
+    {
+	close(loop->signal_io.fd);
+	pthread_sigmask(SIG_UNBLOCK, &loop->sigmask, NULL);
+    }
+    close(loop->async_io.fd);
+    close(loop->epfd);
+    free(loop->events);
+    free(loop->timers);
+}
+
+int utk_ev_run_once(struct utk_ev_loop *loop, int timeout_ms)
+{
+    struct utk_ev_io *io = NULL;
+    uint64_t now,
+	delay;
+    int timeout,
+	count,
+	n;
+
+    timeout = timeout_ms;
+    if(loop->nb_timers != 0)
+    {
+	now = ev_clock();
+	delay = 0;
+	if(loop->timers[0]->expire > now)
+	{
+	    /* round up: waking up before the expiration is useless */
+	    delay = (loop->timers[0]->expire - now + EV_NS_PER_MS - 1)
+		/ EV_NS_PER_MS;
+	}
+	if(delay > INT_MAX)
+	{
+	    delay = INT_MAX;
+	}
+	if(timeout < 0 || (uint64_t)timeout > delay)
+	{
+	    timeout = (int)delay;
+	}
+    }
+
+    n = epoll_wait(loop->epfd, loop->events, loop->max_events, timeout);
+    if(n < 0)
+    {
+	if(errno != EINTR)
+	{
+	    return -1;
+	}
+	n = 0;
+    }
+
+    loop->now = ev_clock();
+
+    count = 0;
+    loop->nb_events = n;
+    for(loop->cur_event = 0; loop->cur_event < n; ++loop->cur_event)
+    {
+	io = loop->events[loop->cur_event].data.ptr;
+	if(io != NULL)
+	{
+	    io->cb(loop, io,
+		   ev_from_epoll(loop->events[loop->cur_event].events));
+	    count++;
+	}
+    }
+    loop->nb_events = 0;
+    loop->cur_event = 0;
+
+    return count + ev_timers_expire(loop);
+}
+
+int utk_ev_run(struct utk_ev_loop *loop)
+{
+    loop->stop = 0;
+    while(!loop->stop)
+    {
+	if(utk_ev_run_once(loop, -1) < 0)
+	{
+	    return -1;
+	}
+    }
+
+    return 0;
+}
+
+void utk_ev_stop(struct utk_ev_loop *loop)
+{
+    loop->stop = 1;
+}
+
+uint64_t utk_ev_now(const struct utk_ev_loop *loop)
+{
+    return loop->now / EV_NS_PER_MS;
+}
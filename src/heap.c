@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/heap.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+#define UTK_HEAP_MIN_SIZE 16
+
+/*
+ * d-ary heap: node->index is the position in the array plus one (0 for
+ * a node which isn't queued, like a zeroed one)
+ */
+
+static inline void heap_set(struct utk_heap *heap, size_t pos,
+			    struct utk_heap_node *node)
+{
+    heap->nodes[pos] = node;
+    node->index = pos + 1;
+}
+
+static void heap_up(struct utk_heap *heap, size_t pos)
+{
+    struct utk_heap_node *node = heap->nodes[pos];
+    size_t parent;
+
+    while(pos > 0)
+    {
+	parent = (pos - 1) / heap->arity;
+	if(heap->cmp(node, heap->nodes[parent]) >= 0)
+	{
+	    break;
+	}
+	heap_set(heap, pos, heap->nodes[parent]);
+	pos = parent;
+    }
+
+    heap_set(heap, pos, node);
+}
+
+static void heap_down(struct utk_heap *heap, size_t pos)
+{
+    struct utk_heap_node *node = heap->nodes[pos];
+    size_t first,
+	last,
+	best,
+	child;
+
+    for(;;)
+    {
+	first = pos * heap->arity + 1;
+	if(first >= heap->count)
+	{
+	    break;
+	}
+	last = first + heap->arity;
+	if(last > heap->count)
+	{
+	    last = heap->count;
+	}
+
+	best = first;
+	for(child = first + 1; child < last; ++child)
+	{
+	    if(heap->cmp(heap->nodes[child], heap->nodes[best]) < 0)
+	    {
+		best = child;
+	    }
+	}
+	if(heap->cmp(heap->nodes[best], node) >= 0)
+	{
+	    break;
+	}
+	heap_set(heap, pos, heap->nodes[best]);
+	pos = best;
+    }
+
+    heap_set(heap, pos, node);
+}
+
+int utk_heap_init(struct utk_heap *heap, size_t arity, utk_heap_cmp_cb_t cmp)
+{
+    if(arity == 0)
+    {
+	arity = UTK_HEAP_DEFAULT_ARITY;
+    }
+    if(arity < 2 || cmp == NULL)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    heap->nodes = NULL;
+    heap->count = 0;
+    heap->size = 0;
+    heap->arity = arity;
+    heap->cmp = cmp;
+
+    return 0;
+}
+
+void utk_heap_cleanup(struct utk_heap *heap)
+{
+    free(heap->nodes);
+    heap->nodes = NULL;
+    heap->count = 0;
+    heap->size = 0;
+}
+
+int utk_heap_push(struct utk_heap *heap, struct utk_heap_node *node)
+{
+    struct utk_heap_node **nodes = NULL;
+    size_t size;
+
+    if(heap->count == heap->size)
+    {
+	size = (heap->size == 0 ? UTK_HEAP_MIN_SIZE : heap->size * 2);
+	if(size > SIZE_MAX / sizeof(*nodes))
+	{
+	    errno = ENOMEM;
+	    return -1;
+	}
+	nodes = realloc(heap->nodes, size * sizeof(*nodes));
+	if(nodes == NULL)
+	{
+	    return -1;
+	}
+	heap->nodes = nodes;
+	heap->size = size;
+    }
+
+    heap->nodes[heap->count] = node;
+    heap_up(heap, heap->count++);
+
+    return 0;
+}
+
+void utk_heap_remove(struct utk_heap *heap, struct utk_heap_node *node)
+{
+    struct utk_heap_node *last = NULL;
+    size_t pos = node->index - 1;
+
+    node->index = 0;
+    last = heap->nodes[--heap->count];
+    if(last == node)
+    {
+	return;
+    }
+
+    heap_set(heap, pos, last);
+    utk_heap_update(heap, last);
+}
+
+struct utk_heap_node *utk_heap_pop(struct utk_heap *heap)
+{
+    struct utk_heap_node *node = utk_heap_top(heap);
+
+    if(node != NULL)
+    {
+	utk_heap_remove(heap, node);
+    }
+
+    return node;
+}
+
+void utk_heap_update(struct utk_heap *heap, struct utk_heap_node *node)
+{
+    size_t pos = node->index - 1;
+
+    if(pos > 0 && heap->cmp(node, heap->nodes[(pos - 1) / heap->arity]) < 0)
+    {
+	heap_up(heap, pos);
+    }
+    else
+    {
+	heap_down(heap, pos);
+    }
+}
+
+/*
+ * Pairing heap: the children of a node are a list from node->child
+ * linked by next, the prev of the first child is the parent. A node which
+ * isn't queued has a NULL prev (and isn't the root).
+ */
+
+/*
+ * Link two roots: the one sorting last becomes the first child
+ */
+static struct utk_pheap_node *pheap_meld(struct utk_pheap *heap,
+					 struct utk_pheap_node *a,
+					 struct utk_pheap_node *b)
+{
+    struct utk_pheap_node *tmp = NULL;
+
+    if(heap->cmp(b, a) < 0)
+    {
+	tmp = a;
+	a = b;
+	b = tmp;
+    }
+
+    b->prev = a;
+    b->next = a->child;
+    if(a->child != NULL)
+    {
+	a->child->prev = b;
+    }
+    a->child = b;
+    a->next = NULL;
+    a->prev = NULL;
+
+    return a;
+}
+
+/*
+ * Merge a list of siblings: pairs from left to right, then the pairs
+ * from right to left
+ */
+static struct utk_pheap_node *pheap_merge_pairs(struct utk_pheap *heap,
+						struct utk_pheap_node *first)
+{
+    struct utk_pheap_node *pairs = NULL;
+    struct utk_pheap_node *node = NULL;
+    struct utk_pheap_node *next = NULL;
+
+    if(first == NULL)
+    {
+	return NULL;
+    }
+
+    /* pairs is linked by next in reverse order */
+    while(first != NULL)
+    {
+	node = first;
+	next = node->next;
+	if(next != NULL)
+	{
+	    first = next->next;
+	    node = pheap_meld(heap, node, next);
+	}
+	else
+	{
+	    first = NULL;
+	}
+	node->next = pairs;
+	pairs = node;
+    }
+
+    node = pairs;
+    pairs = pairs->next;
+    while(pairs != NULL)
+    {
+	next = pairs->next;
+	node = pheap_meld(heap, pairs, node);
+	pairs = next;
+    }
+
+    node->next = NULL;
+    node->prev = NULL;
+
+    return node;
+}
+
+/*
+ * Unlink a node (and its subtree) from its parent and siblings
+ */
+static void pheap_cut(struct utk_pheap_node *node)
+{
+    if(node->prev->child == node)
+    {
+	node->prev->child = node->next;
+    }
+    else
+    {
+	node->prev->next = node->next;
+    }
+    if(node->next != NULL)
+    {
+	node->next->prev = node->prev;
+    }
+
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+void utk_pheap_init(struct utk_pheap *heap, utk_pheap_cmp_cb_t cmp)
+{
+    heap->root = NULL;
+    heap->count = 0;
+    heap->cmp = cmp;
+}
+
+void utk_pheap_push(struct utk_pheap *heap, struct utk_pheap_node *node)
+{
+    node->child = NULL;
+    node->next = NULL;
+    node->prev = NULL;
+
+    heap->root = heap->root == NULL ? node
+	: pheap_meld(heap, heap->root, node);
+    heap->count++;
+}
+
+struct utk_pheap_node *utk_pheap_pop(struct utk_pheap *heap)
+{
+    struct utk_pheap_node *node = heap->root;
+
+    if(node != NULL)
+    {
+	heap->root = pheap_merge_pairs(heap, node->child);
+	node->child = NULL;
+	heap->count--;
+    }
+
+    return node;
+}
+
+void utk_pheap_remove(struct utk_pheap *heap, struct utk_pheap_node *node)
+{
+    struct utk_pheap_node *sub = NULL;
+
+    if(node == heap->root)
+    {
+	utk_pheap_pop(heap);
+	return;
+    }
+
+    pheap_cut(node);
+    sub = pheap_merge_pairs(heap, node->child);
+    node->child = NULL;
+    if(sub != NULL)
+    {
+	heap->root = pheap_meld(heap, heap->root, sub);
+    }
+    heap->count--;
+}
+
+void utk_pheap_decrease(struct utk_pheap *heap, struct utk_pheap_node *node)
+{
+    if(node == heap->root)
+    {
+	return;
+    }
+
+    /* the subtree stays ordered: only its root moved up */
+    pheap_cut(node);
+    heap->root = pheap_meld(heap, heap->root, node);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/htable.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define UTK_HTABLE_MIN_SIZE 8
+/* buckets moved at each utk_htable_add() while rehashing */
+#define UTK_HTABLE_REHASH_STEP 2
+/* empty buckets skipped at most at each step */
+#define UTK_HTABLE_REHASH_EMPTY 32
+
+static inline int htable_rehashing(const struct utk_htable *ht)
+{
+    return ht->buckets[1] != NULL;
+}
+
+/*
+ * Buckets of the old table below rehash_pos are moved to the new table
+ */
+static struct utk_hlist_head *htable_bucket(const struct utk_htable *ht,
+					    size_t hash)
+{
+    size_t i = hash & ht->mask[0];
+
+    if(htable_rehashing(ht) && i < ht->rehash_pos)
+    {
+	return &ht->buckets[1][hash & ht->mask[1]];
+    }
+
+    return &ht->buckets[0][i];
+}
+
+static struct utk_hlist_head *htable_alloc(size_t size)
+{
+    struct utk_hlist_head *buckets = NULL;
+
+    if(size > SIZE_MAX / sizeof(struct utk_hlist_head))
+    {
+	errno = ENOMEM;
+	return NULL;
+    }
+
+    /* NULL first pointers: empty buckets */
+    buckets = calloc(size, sizeof(struct utk_hlist_head));
+
+    return buckets;
+}
+
+static void htable_rehash_end(struct utk_htable *ht)
+{
+    free(ht->buckets[0]);
+    ht->buckets[0] = ht->buckets[1];
+    ht->mask[0] = ht->mask[1];
+    ht->buckets[1] = NULL;
+    ht->mask[1] = 0;
+    ht->rehash_pos = 0;
+}
+
+/*
+ * Move at most nb non empty buckets of the old table to the new one
+ */
+static void htable_rehash_step(struct utk_htable *ht, size_t nb)
+{
+    struct utk_hlist_head *bucket = NULL;
+    struct utk_hlist_node *pos = NULL;
+    struct utk_hlist_node *n = NULL;
+    struct utk_htable_node *node = NULL;
+    size_t empty = UTK_HTABLE_REHASH_EMPTY;
+
+    while(nb > 0 && ht->rehash_pos <= ht->mask[0])
+    {
+	bucket = &ht->buckets[0][ht->rehash_pos++];
+	if(utk_hlist_empty(bucket))
+	{
+	    if(--empty == 0)
+	    {
+		break;
+	    }
+	    continue;
+	}
+
+	utk_hlist_for_each_safe(pos, n, bucket)
+	{
+	    node = utk_hlist_entry(pos, struct utk_htable_node, node);
+	    __utk_hlist_del(pos);
+	    utk_hlist_add_head(pos,
+			       &ht->buckets[1][node->hash & ht->mask[1]]);
+	}
+	utk_hlist_head_init(bucket);
+	nb--;
+    }
+
+    if(ht->rehash_pos > ht->mask[0])
+    {
+	htable_rehash_end(ht);
+    }
+}
+
+int utk_htable_init(struct utk_htable *ht, size_t size,
+		    utk_htable_hash_cb_t hash, utk_htable_cmp_cb_t cmp)
+{
+    size_t capacity = UTK_HTABLE_MIN_SIZE;
+
+    while(capacity < size)
+    {
+	if(capacity > (SIZE_MAX >> 2))
+	{
+	    errno = EINVAL;
+	    return -1;
+	}
+	capacity <<= 1;
+    }
+
+    ht->buckets[0] = htable_alloc(capacity);
+    if(ht->buckets[0] == NULL)
+    {
+	return -1;
+    }
+    ht->buckets[1] = NULL;
+    ht->mask[0] = capacity - 1;
+    ht->mask[1] = 0;
+    ht->rehash_pos = 0;
+    ht->count = 0;
+    ht->hash = hash;
+    ht->cmp = cmp;
+
+    return 0;
+}
+
+void utk_htable_cleanup(struct utk_htable *ht)
+{
+    free(ht->buckets[0]);
+    free(ht->buckets[1]);
+    ht->buckets[0] = NULL;
+    ht->buckets[1] = NULL;
+    ht->count = 0;
+}
+
+int utk_htable_add(struct utk_htable *ht, struct utk_htable_node *node,
+		   const void *key)
+{
+    size_t size;
+
+    node->hash = ht->hash(key);
+    utk_hlist_add_head(&node->node, htable_bucket(ht, node->hash));
+    ht->count++;
+
+    if(htable_rehashing(ht))
+    {
+	htable_rehash_step(ht, UTK_HTABLE_REHASH_STEP);
+    }
+
+    size = ht->mask[0] + 1;
+    if(!htable_rehashing(ht) && ht->count > size)
+    {
+	if(size > (SIZE_MAX >> 2))
+	{
+	    errno = ENOMEM;
+	    return -1;
+	}
+
+	ht->buckets[1] = htable_alloc(size << 1);
+	if(ht->buckets[1] == NULL)
+	{
+	    return -1;
+	}
+	ht->mask[1] = (size << 1) - 1;
+	ht->rehash_pos = 0;
+    }
+
+    return 0;
+}
+
+void utk_htable_del(struct utk_htable *ht, struct utk_htable_node *node)
+{
+    __utk_hlist_del(&node->node);
+    utk_hlist_node_init(&node->node);
+    ht->count--;
+}
+
+struct utk_htable_node *utk_htable_find(const struct utk_htable *ht,
+					const void *key)
+{
+    struct utk_htable_node *node = NULL;
+    size_t hash = ht->hash(key);
+
+    utk_hlist_for_each_entry(node, htable_bucket(ht, hash), node)
+    {
+	if(node->hash == hash && ht->cmp(node, key) == 0)
+	{
+	    return node;
+	}
+    }
+
+    return NULL;
+}
+
+struct utk_htable_node *utk_htable_find_next(const struct utk_htable *ht,
+					     const struct utk_htable_node *node,
+					     const void *key)
+{
+    struct utk_hlist_node *pos = NULL;
+    struct utk_htable_node *next = NULL;
+
+    for(pos = node->node.next; pos != NULL; pos = pos->next)
+    {
+	next = utk_hlist_entry(pos, struct utk_htable_node, node);
+	if(next->hash == node->hash && ht->cmp(next, key) == 0)
+	{
+	    return next;
+	}
+    }
+
+    return NULL;
+}
+
+/*
+ * First node of the buckets of table t from i
+ */
+static struct utk_htable_node *htable_scan(const struct utk_htable *ht,
+					   unsigned int t, size_t i)
+{
+    for(; t < 2 && ht->buckets[t] != NULL; t++, i = 0)
+    {
+	for(; i <= ht->mask[t]; i++)
+	{
+	    if(!utk_hlist_empty(&ht->buckets[t][i]))
+	    {
+		return utk_hlist_entry(ht->buckets[t][i].first,
+				       struct utk_htable_node, node);
+	    }
+	}
+    }
+
+    return NULL;
+}
+
+struct utk_htable_node *utk_htable_first(const struct utk_htable *ht)
+{
+    if(ht->count == 0)
+    {
+	return NULL;
+    }
+
+    return htable_scan(ht, 0, htable_rehashing(ht) ? ht->rehash_pos : 0);
+}
+
+struct utk_htable_node *utk_htable_next(const struct utk_htable *ht,
+					const struct utk_htable_node *node)
+{
+    size_t i = node->hash & ht->mask[0];
+
+    if(node->node.next != NULL)
+    {
+	return utk_hlist_entry(node->node.next,
+			       struct utk_htable_node, node);
+    }
+
+    if(htable_rehashing(ht) && i < ht->rehash_pos)
+    {
+	return htable_scan(ht, 1, (node->hash & ht->mask[1]) + 1);
+    }
+
+    return htable_scan(ht, 0, i + 1);
+}
@@ -17,35 +17,46 @@
  * along with Utk. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+
 #include "utk/io.h"
 #include "utk/math.h"
+#include "utk/str.h"
+#include "io_stats.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <string.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 ssize_t utk_io_write(int fd, const void *buf, size_t len)
 {
+    struct io_stats_probe probe;
     ssize_t cc;
     ssize_t total;
 
+    io_stats_begin(&probe);
+
     total = 0;
     while(len != 0)
     {
 	do
 	{
 	    cc = write(fd, buf, len);
+	    io_stats_syscall(&probe, cc, len);
 	}
 	while(cc < 0 && errno == EINTR);
 
 	if(cc < 0)
 	{
-	    return cc;
+	    return io_stats_end(&probe, UTK_IO_STATS_WRITE, cc);
 	}
 
 	total += cc;
@@ -53,18 +64,165 @@ ssize_t utk_io_write(int fd, const void *buf, size_t len)
 	len -= (size_t)cc;
     }
 
-    return total;
+    return io_stats_end(&probe, UTK_IO_STATS_WRITE, total);
 }
 
 ssize_t utk_io_read(int fd, void *dst, size_t len)
 {
+    struct io_stats_probe probe;
     ssize_t cc;
     ssize_t total;
 
+    io_stats_begin(&probe);
+
     total = 0;
     while(len != 0)
     {
 	do 
+	{
+	    cc = read(fd, dst, len);
+	    io_stats_syscall(&probe, cc, len);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return io_stats_end(&probe, UTK_IO_STATS_READ, cc);
+	}
+
+	if(cc == 0)
+	{
+	    break;
+	}
+
+	dst = ((char *)dst) + cc;
+	total += cc;
+	len -= (size_t)cc;
+    }
+
+    return io_stats_end(&probe, UTK_IO_STATS_READ, total);
+}
+
+ssize_t utk_io_pwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+    struct io_stats_probe probe;
+    ssize_t cc;
+    ssize_t total;
+
+    io_stats_begin(&probe);
+
+    total = 0;
+    while(len != 0)
+    {
+	do
+	{
+	    cc = pwrite(fd, buf, len, offset);
+	    io_stats_syscall(&probe, cc, len);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return io_stats_end(&probe, UTK_IO_STATS_PWRITE, cc);
+	}
+
+	total += cc;
+	offset += cc;
+	buf = ((const char *)buf) + cc;
+	len -= (size_t)cc;
+    }
+
+    return io_stats_end(&probe, UTK_IO_STATS_PWRITE, total);
+}
+
+ssize_t utk_io_pread(int fd, void *dst, size_t len, off_t offset)
+{
+    struct io_stats_probe probe;
+    ssize_t cc;
+    ssize_t total;
+
+    io_stats_begin(&probe);
+
+    total = 0;
+    while(len != 0)
+    {
+	do
+	{
+	    cc = pread(fd, dst, len, offset);
+	    io_stats_syscall(&probe, cc, len);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return io_stats_end(&probe, UTK_IO_STATS_PREAD, cc);
+	}
+
+	if(cc == 0)
+	{
+	    break;
+	}
+
+	dst = ((char *)dst) + cc;
+	offset += cc;
+	total += cc;
+	len -= (size_t)cc;
+    }
+
+    return io_stats_end(&probe, UTK_IO_STATS_PREAD, total);
+}
+
+int utk_io_set_nonblock(int fd, int nonblock)
+{
+    int flags;
+
+    flags = fcntl(fd, F_GETFL);
+    if(flags < 0)
+    {
+	return -1;
+    }
+
+    flags = (nonblock ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+
+    return fcntl(fd, F_SETFL, flags);
+}
+
+ssize_t utk_io_write_nonblock(int fd, const void *buf, size_t len)
+{
+    ssize_t cc;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	do
+	{
+	    cc = write(fd, buf, len);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return (total != 0 ? total : cc);
+	}
+
+	total += cc;
+	buf = ((const char *)buf) + cc;
+	len -= (size_t)cc;
+    }
+
+    return total;
+}
+
+ssize_t utk_io_read_nonblock(int fd, void *dst, size_t len)
+{
+    ssize_t cc;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	do
 	{
 	    cc = read(fd, dst, len);
 	}
@@ -72,7 +230,7 @@ ssize_t utk_io_read(int fd, void *dst, size_t len)
 
 	if(cc < 0)
 	{
-	    return cc;
+	    return (total != 0 ? total : cc);
 	}
 
 	if(cc == 0)
@@ -125,3 +283,362 @@ ssize_t utk_io_file_read(const char *filename, void *dst, size_t len)
 
     return count;
 }
+
+/*
+ * Initial capacity used when the size of the file can't be guessed
+ */
+#define UTK_IO_READ_ALL_MIN_SIZE 4096
+
+static void *io_alloc_realloc(const struct utk_io_allocator *alloc,
+			      void *ptr, size_t old_size, size_t new_size)
+{
+    if(alloc == NULL)
+    {
+	return realloc(ptr, new_size);
+    }
+
+    return alloc->realloc(alloc->opaque, ptr, old_size, new_size);
+}
+
+static void io_alloc_free(const struct utk_io_allocator *alloc, void *ptr)
+{
+    if(alloc == NULL)
+    {
+	free(ptr);
+    }
+    else if(alloc->free != NULL)
+    {
+	alloc->free(alloc->opaque, ptr);
+    }
+}
+
+ssize_t utk_io_read_all(int fd, void **dst,
+			const struct utk_io_allocator *alloc)
+{
+    struct stat st;
+    char *buf = NULL,
+	*newbuf = NULL;
+    size_t size,
+	capacity,
+	want;
+    ssize_t cc;
+
+    if(fstat(fd, &st) != 0)
+    {
+	return -1;
+    }
+
+    /* capacity always keeps one byte for the \0 caracter. For regular
+     * files, room is left after st_size bytes: the read(2) seeing the end
+     * of file doesn't need a bigger buffer, and a file growing meanwhile
+     * is read up to its new end */
+    if(S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+	if((uintmax_t)st.st_size
+	   >= (uintmax_t)SSIZE_MAX - UTK_IO_READ_ALL_MIN_SIZE)
+	{
+	    errno = EFBIG;
+	    return -1;
+	}
+	capacity = (size_t)st.st_size + UTK_IO_READ_ALL_MIN_SIZE;
+    }
+    else
+    {
+	capacity = UTK_IO_READ_ALL_MIN_SIZE;
+    }
+
+    buf = io_alloc_realloc(alloc, NULL, 0, capacity);
+    if(buf == NULL)
+    {
+	return -1;
+    }
+
+    size = 0;
+    for(;;)
+    {
+	want = capacity - 1 - size;
+
+	cc = utk_io_read(fd, buf + size, want);
+	if(cc < 0)
+	{
+	    goto ex_on_error;
+	}
+
+	size += (size_t)cc;
+
+	/* short read means end of file */
+	if((size_t)cc < want)
+	{
+	    break;
+	}
+
+	if(capacity > SSIZE_MAX / 2)
+	{
+	    errno = EFBIG;
+	    goto ex_on_error;
+	}
+
+	newbuf = io_alloc_realloc(alloc, buf, capacity, capacity * 2);
+	if(newbuf == NULL)
+	{
+	    goto ex_on_error;
+	}
+	buf = newbuf;
+	capacity *= 2;
+    }
+
+    buf[size] = '\0';
+    *dst = buf;
+
+    return (ssize_t)size;
+
+ex_on_error:
+    io_alloc_free(alloc, buf);
+
+    return -1;
+}
+
+ssize_t utk_io_file_read_all(const char *filename, void **dst,
+			     const struct utk_io_allocator *alloc)
+{
+    int fd;
+    ssize_t count;
+
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    count = utk_io_read_all(fd, dst, alloc);
+
+    close(fd);
+
+    return count;
+}
+
+/*
+ * Sync the filesystem of the group commit context. Each caller waits for
+ * a syncfs(2) round started after its call, rounds are shared by all the
+ * threads waiting at the same time.
+ */
+static int io_group_commit_sync(struct utk_io_group_commit *gc)
+{
+    unsigned long ticket,
+	round;
+    int ret;
+
+    pthread_mutex_lock(&gc->lock);
+
+    ticket = gc->started + 1;
+    while(gc->completed < ticket)
+    {
+	if(gc->syncing)
+	{
+	    pthread_cond_wait(&gc->cond, &gc->lock);
+	    continue;
+	}
+
+	gc->syncing = 1;
+	round = ++gc->started;
+	pthread_mutex_unlock(&gc->lock);
+
+	ret = syncfs(gc->fd);
+
+	pthread_mutex_lock(&gc->lock);
+	if(ret != 0)
+	{
+	    gc->failed = round;
+	    gc->failed_errno = errno;
+	}
+	gc->completed = round;
+	gc->syncing = 0;
+	pthread_cond_broadcast(&gc->cond);
+    }
+
+    /* be conservative: a failed round may have lost our data even if a
+     * later round succeeded */
+    ret = 0;
+    if(gc->failed >= ticket)
+    {
+	errno = gc->failed_errno;
+	ret = -1;
+    }
+
+    pthread_mutex_unlock(&gc->lock);
+
+    return ret;
+}
+
+static int io_sync_dir(const char *filename)
+{
+    char dirname[PATH_MAX];
+    const char *slash = NULL;
+    int fd,
+	ret;
+
+    slash = strrchr(filename, '/');
+    if(slash == NULL)
+    {
+	utk_str_copy(dirname, sizeof(dirname), ".");
+    }
+    else if(slash == filename)
+    {
+	utk_str_copy(dirname, sizeof(dirname), "/");
+    }
+    else
+    {
+	if((size_t)(slash - filename) >= sizeof(dirname))
+	{
+	    errno = ENAMETOOLONG;
+	    return -1;
+	}
+	memcpy(dirname, filename, (size_t)(slash - filename));
+	dirname[slash - filename] = '\0';
+    }
+
+    fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    ret = fsync(fd);
+
+    close(fd);
+
+    return ret;
+}
+
+static ssize_t io_file_replace(struct utk_io_group_commit *gc,
+			       const char *filename,
+			       const void *buf, size_t len)
+{
+    static unsigned int tmp_counter = 0;
+    char tmpname[PATH_MAX];
+    struct stat st;
+    mode_t mode;
+    int fd,
+	saved_errno,
+	ret;
+    ssize_t count;
+
+    mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    if(stat(filename, &st) == 0)
+    {
+	mode = st.st_mode & 07777;
+    }
+
+    /* temporary file must be on the same filesystem for rename(2) */
+    ret = utk_str_printf(tmpname, sizeof(tmpname), "%s.tmp.%ld.%u",
+			 filename, (long)getpid(),
+			 __atomic_fetch_add(&tmp_counter, 1, __ATOMIC_RELAXED));
+    if(ret < 0 || (size_t)ret >= sizeof(tmpname))
+    {
+	errno = ENAMETOOLONG;
+	return -1;
+    }
+
+    fd = open(tmpname, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, mode);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    count = utk_io_write(fd, buf, len);
+    if(count < 0)
+    {
+	goto ex_on_error;
+    }
+
+    if(gc == NULL)
+    {
+	ret = fdatasync(fd);
+    }
+    else
+    {
+	ret = io_group_commit_sync(gc);
+    }
+    if(ret != 0)
+    {
+	goto ex_on_error;
+    }
+
+    if(close(fd) != 0)
+    {
+	fd = -1;
+	goto ex_on_error;
+    }
+    fd = -1;
+
+    if(rename(tmpname, filename) != 0)
+    {
+	goto ex_on_error;
+    }
+
+    /* make the rename durable */
+    if(gc == NULL)
+    {
+	ret = io_sync_dir(filename);
+    }
+    else
+    {
+	ret = io_group_commit_sync(gc);
+    }
+    if(ret != 0)
+    {
+	return -1;
+    }
+
+    return count;
+
+ex_on_error:
+    saved_errno = errno;
+    if(fd >= 0)
+    {
+	close(fd);
+    }
+    unlink(tmpname);
+    errno = saved_errno;
+
+    return -1;
+}
+
+ssize_t utk_io_file_replace(const char *filename, const void *buf, size_t len)
+{
+    return io_file_replace(NULL, filename, buf, len);
+}
+
+int utk_io_group_commit_init(struct utk_io_group_commit *gc, const char *path)
+{
+    gc->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(gc->fd < 0)
+    {
+	return -1;
+    }
+
+    pthread_mutex_init(&gc->lock, NULL);
+    pthread_cond_init(&gc->cond, NULL);
+    gc->syncing = 0;
+    gc->started = 0;
+    gc->completed = 0;
+    gc->failed = 0;
+    gc->failed_errno = 0;
+
+    return 0;
+}
+
+void utk_io_group_commit_cleanup(struct utk_io_group_commit *gc)
+{
+    pthread_cond_destroy(&gc->cond);
+    pthread_mutex_destroy(&gc->lock);
+    close(gc->fd);
+    gc->fd = -1;
+}
+
+ssize_t utk_io_group_commit_replace(struct utk_io_group_commit *gc,
+				    const char *filename,
+				    const void *buf, size_t len)
+{
+    return io_file_replace(gc, filename, buf, len);
+}
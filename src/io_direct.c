@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/io.h"
+#include "utk/math.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+/*
+ * Get the direct I/O alignment of a file: use statx(2) when the kernel
+ * reports it, a page otherwise (safe for all usual block devices).
+ */
+static size_t io_direct_align(int fd)
+{
+    long page;
+    size_t align;
+
+    page = sysconf(_SC_PAGESIZE);
+    align = (page > 0 ? (size_t)page : 4096);
+
+#ifdef STATX_DIOALIGN
+    {
+	struct statx stx;
+
+	if(statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0
+	   && (stx.stx_mask & STATX_DIOALIGN)
+	   && stx.stx_dio_offset_align != 0)
+	{
+	    align = utk_math_max(stx.stx_dio_mem_align,
+				 stx.stx_dio_offset_align);
+	}
+    }
+#else
+    (void)fd;
+#endif
+
+    return align;
+}
+
+static int io_direct_aligned(const struct utk_io_direct *dio,
+			     const void *buf)
+{
+    return ((uintptr_t)buf & (dio->align - 1)) == 0
+	&& ((size_t)dio->offset & (dio->align - 1)) == 0;
+}
+
+int utk_io_direct_open(struct utk_io_direct *dio, const char *filename,
+		       int flags, mode_t mode)
+{
+    int error;
+
+    dio->fd = open(filename, flags | O_DIRECT | O_CLOEXEC, mode);
+    if(dio->fd < 0)
+    {
+	return -1;
+    }
+
+    /* unaligned transfers: the file exists now */
+    dio->tail_fd = open(filename,
+			(flags & ~(O_CREAT | O_EXCL | O_TRUNC)) | O_CLOEXEC);
+    if(dio->tail_fd < 0)
+    {
+	error = errno;
+	close(dio->fd);
+	errno = error;
+	return -1;
+    }
+
+    dio->align = io_direct_align(dio->fd);
+    dio->offset = 0;
+
+    return 0;
+}
+
+int utk_io_direct_close(struct utk_io_direct *dio)
+{
+    int ret;
+
+    ret = close(dio->fd);
+    if(close(dio->tail_fd) != 0)
+    {
+	ret = -1;
+    }
+    dio->fd = -1;
+    dio->tail_fd = -1;
+
+    return ret;
+}
+
+void *utk_io_direct_alloc(const struct utk_io_direct *dio, size_t size)
+{
+    void *buf = NULL;
+
+    if(size > SIZE_MAX - dio->align)
+    {
+	errno = ENOMEM;
+	return NULL;
+    }
+    size = (size + dio->align - 1) & ~(dio->align - 1);
+
+    errno = posix_memalign(&buf, dio->align, size);
+    if(errno != 0)
+    {
+	return NULL;
+    }
+
+    return buf;
+}
+
+ssize_t utk_io_direct_write(struct utk_io_direct *dio,
+			    const void *buf, size_t len)
+{
+    size_t direct_len;
+    ssize_t cc,
+	total;
+
+    total = 0;
+
+    direct_len = 0;
+    if(io_direct_aligned(dio, buf))
+    {
+	direct_len = len & ~(dio->align - 1);
+    }
+
+    if(direct_len != 0)
+    {
+	cc = utk_io_pwrite(dio->fd, buf, direct_len, dio->offset);
+	if(cc < 0)
+	{
+	    return cc;
+	}
+
+	dio->offset += cc;
+	total += cc;
+	buf = ((const char *)buf) + cc;
+	len -= (size_t)cc;
+    }
+
+    /* unaligned tail goes through the page cache */
+    if(len != 0)
+    {
+	cc = utk_io_pwrite(dio->tail_fd, buf, len, dio->offset);
+	if(cc < 0)
+	{
+	    return -1;
+	}
+
+	dio->offset += cc;
+	total += cc;
+    }
+
+    return total;
+}
+
+ssize_t utk_io_direct_read(struct utk_io_direct *dio, void *dst, size_t len)
+{
+    size_t direct_len;
+    ssize_t cc,
+	total;
+
+    total = 0;
+
+    direct_len = 0;
+    if(io_direct_aligned(dio, dst))
+    {
+	direct_len = len & ~(dio->align - 1);
+    }
+
+    if(direct_len != 0)
+    {
+	cc = utk_io_pread(dio->fd, dst, direct_len, dio->offset);
+	if(cc < 0)
+	{
+	    return cc;
+	}
+
+	dio->offset += cc;
+	total += cc;
+	dst = ((char *)dst) + cc;
+	len -= (size_t)cc;
+
+	if((size_t)cc < direct_len)
+	{
+	    /* end of file */
+	    return total;
+	}
+    }
+
+    if(len != 0)
+    {
+	cc = utk_io_pread(dio->tail_fd, dst, len, dio->offset);
+	if(cc < 0)
+	{
+	    return -1;
+	}
+
+	dio->offset += cc;
+	total += cc;
+    }
+
+    return total;
+}
+
+static void *io_direct_writer_thread(void *data)
+{
+    struct utk_io_direct_writer *w = data;
+    const char *buf = NULL;
+    ssize_t cc;
+
+    pthread_mutex_lock(&w->lock);
+    for(;;)
+    {
+	while(w->pending == NULL && !w->stop)
+	{
+	    pthread_cond_wait(&w->cond, &w->lock);
+	}
+
+	if(w->pending == NULL)
+	{
+	    break;
+	}
+
+	buf = w->pending;
+	pthread_mutex_unlock(&w->lock);
+
+	cc = utk_io_direct_write(w->dio, buf, w->size);
+
+	pthread_mutex_lock(&w->lock);
+	if(cc != (ssize_t)w->size)
+	{
+	    w->error = 1;
+	}
+	w->pending = NULL;
+	pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+/*
+ * Wait the background write to complete
+ */
+static int io_direct_writer_wait(struct utk_io_direct_writer *w)
+{
+    int error;
+
+    pthread_mutex_lock(&w->lock);
+    while(w->pending != NULL)
+    {
+	pthread_cond_wait(&w->cond, &w->lock);
+    }
+    error = w->error;
+    pthread_mutex_unlock(&w->lock);
+
+    return (error ? -1 : 0);
+}
+
+int utk_io_direct_writer_init(struct utk_io_direct_writer *w,
+			      struct utk_io_direct *dio, size_t size)
+{
+    /* size is written with O_DIRECT */
+    if(size < dio->align || size > SIZE_MAX - dio->align)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    w->dio = dio;
+    w->size = (size + dio->align - 1) & ~(dio->align - 1);
+    w->fill = 0;
+    w->cur = 0;
+    w->pending = NULL;
+    w->stop = 0;
+    w->error = 0;
+
+    w->buf[0] = utk_io_direct_alloc(dio, w->size);
+    w->buf[1] = utk_io_direct_alloc(dio, w->size);
+    if(w->buf[0] == NULL || w->buf[1] == NULL)
+    {
+	goto ex_on_error;
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    errno = pthread_create(&w->thread, NULL, io_direct_writer_thread, w);
+    if(errno != 0)
+    {
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->lock);
+	goto ex_on_error;
+    }
+
+    return 0;
+
+ex_on_error:
+    free(w->buf[0]);
+    free(w->buf[1]);
+
+    return -1;
+}
+
+ssize_t utk_io_direct_writer_write(struct utk_io_direct_writer *w,
+				   const void *buf, size_t len)
+{
+    size_t n;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	n = utk_math_min(len, w->size - w->fill);
+
+	memcpy(w->buf[w->cur] + w->fill, buf, n);
+	w->fill += n;
+	buf = ((const char *)buf) + n;
+	len -= n;
+	total += (ssize_t)n;
+
+	if(w->fill == w->size)
+	{
+	    /* hand the full buffer to the background thread once the
+	     * previous one is written, then fill the other one */
+	    if(io_direct_writer_wait(w) != 0)
+	    {
+		return -1;
+	    }
+
+	    pthread_mutex_lock(&w->lock);
+	    w->pending = w->buf[w->cur];
+	    pthread_cond_broadcast(&w->cond);
+	    pthread_mutex_unlock(&w->lock);
+
+	    w->cur ^= 1;
+	    w->fill = 0;
+	}
+    }
+
+    return total;
+}
+
+int utk_io_direct_writer_cleanup(struct utk_io_direct_writer *w)
+{
+    int ret;
+    ssize_t cc;
+
+    ret = io_direct_writer_wait(w);
+
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    if(ret == 0 && w->fill != 0)
+    {
+	cc = utk_io_direct_write(w->dio, w->buf[w->cur], w->fill);
+	if(cc != (ssize_t)w->fill)
+	{
+	    ret = -1;
+	}
+    }
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w->buf[0]);
+    free(w->buf[1]);
+
+    return ret;
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/io.h"
+#include "utk/list.h"
+#include "utk/array.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+/*
+ * A cached descriptor.
+ *
+ * - refs counts the users of fd (the cache itself and the threads doing
+ *   I/O on it) so an entry evicted while in use is closed by its last user.
+ */
+struct io_fdcache_entry {
+    struct utk_list_head hnode;
+    struct utk_list_head lru;
+    int fd;
+    int mode;
+    dev_t dev;
+    ino_t ino;
+    unsigned int refs;
+    unsigned int hash;
+    char filename[];
+};
+
+/* FNV-1a */
+static unsigned int io_fdcache_hash(const char *filename, int mode)
+{
+    uint32_t h = 2166136261u;
+
+    while(*filename != '\0')
+    {
+	h ^= (unsigned char)*filename++;
+	h *= 16777619u;
+    }
+    h ^= (uint32_t)mode;
+    h *= 16777619u;
+
+    return h;
+}
+
+static void io_fdcache_entry_put(struct io_fdcache_entry *entry)
+{
+    if(--entry->refs == 0)
+    {
+	close(entry->fd);
+	free(entry);
+    }
+}
+
+/* must be called with cache->lock held */
+static void io_fdcache_remove(struct utk_io_fdcache *cache,
+			      struct io_fdcache_entry *entry)
+{
+    utk_list_del(&entry->hnode);
+    utk_list_del(&entry->lru);
+    cache->count--;
+    io_fdcache_entry_put(entry);
+}
+
+/* must be called with cache->lock held */
+static struct io_fdcache_entry *io_fdcache_lookup(struct utk_io_fdcache *cache,
+						  const char *filename,
+						  int mode, unsigned int hash)
+{
+    struct utk_list_head *bucket = NULL;
+    struct io_fdcache_entry *entry = NULL;
+
+    bucket = &cache->buckets[hash & (cache->nb_buckets - 1)];
+    utk_list_for_each_entry(entry, bucket, hnode)
+    {
+	if(entry->hash == hash && entry->mode == mode
+	   && strcmp(entry->filename, filename) == 0)
+	{
+	    return entry;
+	}
+    }
+
+    return NULL;
+}
+
+/*
+ * Get a referenced entry for filename, open it if it isn't in cache
+ */
+static struct io_fdcache_entry *io_fdcache_get(struct utk_io_fdcache *cache,
+					       const char *filename, int mode)
+{
+    struct io_fdcache_entry *entry = NULL;
+    struct stat st;
+    unsigned int hash;
+    size_t len;
+    int fd,
+	revalidate,
+	exists,
+	stat_errno;
+
+    hash = io_fdcache_hash(filename, mode);
+
+    revalidate = (cache->flags & UTK_IO_FDCACHE_REVALIDATE);
+    exists = 0;
+    stat_errno = 0;
+    if(revalidate)
+    {
+	exists = (stat(filename, &st) == 0);
+	stat_errno = errno;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = io_fdcache_lookup(cache, filename, mode, hash);
+    if(entry != NULL && revalidate
+       && (!exists || entry->dev != st.st_dev || entry->ino != st.st_ino))
+    {
+	/* file was removed or replaced */
+	io_fdcache_remove(cache, entry);
+	entry = NULL;
+    }
+
+    if(revalidate && !exists && !(mode & O_CREAT))
+    {
+	pthread_mutex_unlock(&cache->lock);
+	errno = stat_errno;
+	return NULL;
+    }
+
+    if(entry != NULL)
+    {
+	utk_list_move(&entry->lru, &cache->lru);
+	entry->refs++;
+	pthread_mutex_unlock(&cache->lock);
+
+	return entry;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    /* miss: open without the lock held */
+    fd = open(filename, mode | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fd < 0)
+    {
+	return NULL;
+    }
+
+    len = strlen(filename);
+    entry = malloc(sizeof(*entry) + len + 1);
+    if(entry == NULL || fstat(fd, &st) != 0)
+    {
+	free(entry);
+	close(fd);
+	return NULL;
+    }
+
+    entry->fd = fd;
+    entry->mode = mode;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->hash = hash;
+    memcpy(entry->filename, filename, len + 1);
+
+    /* one reference for the cache, one for the caller */
+    entry->refs = 2;
+
+    pthread_mutex_lock(&cache->lock);
+
+    if(io_fdcache_lookup(cache, filename, mode, hash) != NULL
+       || cache->max == 0)
+    {
+	/* another thread cached it meanwhile: keep this one uncached */
+	entry->refs = 1;
+	utk_list_head_init(&entry->hnode);
+	utk_list_head_init(&entry->lru);
+    }
+    else
+    {
+	if(cache->count >= cache->max)
+	{
+	    io_fdcache_remove(cache,
+			      utk_list_entry(cache->lru.prev,
+					     struct io_fdcache_entry, lru));
+	}
+
+	utk_list_add(&entry->hnode,
+		     &cache->buckets[hash & (cache->nb_buckets - 1)]);
+	utk_list_add(&entry->lru, &cache->lru);
+	cache->count++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return entry;
+}
+
+static void io_fdcache_release(struct utk_io_fdcache *cache,
+			       struct io_fdcache_entry *entry)
+{
+    pthread_mutex_lock(&cache->lock);
+    io_fdcache_entry_put(entry);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int utk_io_fdcache_init(struct utk_io_fdcache *cache,
+			unsigned int max, int flags)
+{
+    unsigned int i;
+
+    /* power of two, at least twice max */
+    cache->nb_buckets = 16;
+    while(cache->nb_buckets < 2 * max && cache->nb_buckets < (1u << 20))
+    {
+	cache->nb_buckets *= 2;
+    }
+
+    cache->buckets = malloc(cache->nb_buckets * sizeof(*cache->buckets));
+    if(cache->buckets == NULL)
+    {
+	return -1;
+    }
+
+    for(i = 0; i < cache->nb_buckets; ++i)
+    {
+	utk_list_head_init(&cache->buckets[i]);
+    }
+
+    utk_list_head_init(&cache->lru);
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->count = 0;
+    cache->max = max;
+    cache->flags = flags;
+
+    return 0;
+}
+
+void utk_io_fdcache_cleanup(struct utk_io_fdcache *cache)
+{
+    utk_io_fdcache_invalidate_all(cache);
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    cache->buckets = NULL;
+}
+
+ssize_t utk_io_fdcache_read(struct utk_io_fdcache *cache,
+			    const char *filename, void *dst, size_t len)
+{
+    struct io_fdcache_entry *entry = NULL;
+    ssize_t count;
+    int saved_errno;
+
+    entry = io_fdcache_get(cache, filename, O_RDONLY);
+    if(entry == NULL)
+    {
+	return -1;
+    }
+
+    count = utk_io_pread(entry->fd, dst, len, 0);
+
+    saved_errno = errno;
+    io_fdcache_release(cache, entry);
+    errno = saved_errno;
+
+    return count;
+}
+
+ssize_t utk_io_fdcache_write(struct utk_io_fdcache *cache,
+			     const char *filename, const void *buf, size_t len)
+{
+    struct io_fdcache_entry *entry = NULL;
+    ssize_t count;
+    int saved_errno;
+
+    entry = io_fdcache_get(cache, filename, O_CREAT | O_WRONLY);
+    if(entry == NULL)
+    {
+	return -1;
+    }
+
+    count = utk_io_pwrite(entry->fd, buf, len, 0);
+
+    saved_errno = errno;
+    io_fdcache_release(cache, entry);
+    errno = saved_errno;
+
+    return count;
+}
+
+void utk_io_fdcache_invalidate(struct utk_io_fdcache *cache,
+			       const char *filename)
+{
+    struct io_fdcache_entry *entry = NULL;
+    const int modes[] = { O_RDONLY, O_CREAT | O_WRONLY };
+    unsigned int i,
+	hash;
+
+    pthread_mutex_lock(&cache->lock);
+
+    for(i = 0; i < UTK_ARRAY_SIZE(modes); ++i)
+    {
+	hash = io_fdcache_hash(filename, modes[i]);
+	entry = io_fdcache_lookup(cache, filename, modes[i], hash);
+	if(entry != NULL)
+	{
+	    io_fdcache_remove(cache, entry);
+	}
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void utk_io_fdcache_invalidate_all(struct utk_io_fdcache *cache)
+{
+    struct io_fdcache_entry *entry = NULL,
+	*n = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+
+    utk_list_for_each_entry_safe(entry, n, &cache->lru, lru)
+    {
+	io_fdcache_remove(cache, entry);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
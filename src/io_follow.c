@@ -0,0 +1,564 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/io.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
+
+#define IO_FOLLOW_DEFAULT_BUF_SIZE (64 * 1024)
+
+/* the file itself: writes, truncation (IN_MODIFY) and rename/unlink */
+#define IO_FOLLOW_FILE_MASK (IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF)
+/* its directory: a new file takes the name */
+#define IO_FOLLOW_DIR_MASK (IN_CREATE | IN_MOVED_TO)
+
+/*
+ * Remove a watch unless another followed file still uses it
+ */
+static void io_follow_unwatch(struct utk_io_follow *follow,
+			      struct utk_io_follow_file *file, int wd)
+{
+    struct utk_io_follow_file *other = NULL;
+
+    if(wd < 0)
+    {
+	return;
+    }
+
+    utk_list_for_each_entry(other, &follow->files, list)
+    {
+	if(other != file && (other->wd == wd || other->dir_wd == wd))
+	{
+	    return;
+	}
+    }
+
+    /* fails if the inode is gone, the watch is already removed then */
+    inotify_rm_watch(follow->fd, wd);
+}
+
+static void io_follow_close(struct utk_io_follow *follow,
+			    struct utk_io_follow_file *file)
+{
+    int wd = file->wd;
+
+    file->wd = -1;
+    io_follow_unwatch(follow, file, wd);
+
+    if(file->fd >= 0)
+    {
+	close(file->fd);
+	file->fd = -1;
+    }
+}
+
+/*
+ * Open the file which currently has the name, return 0 if it doesn't exist
+ */
+static int io_follow_open(struct utk_io_follow *follow,
+			  struct utk_io_follow_file *file)
+{
+    struct stat st;
+
+    file->fd = open(file->filename, O_RDONLY | O_CLOEXEC);
+    if(file->fd < 0)
+    {
+	return (errno == ENOENT ? 0 : -1);
+    }
+
+    if(fstat(file->fd, &st) != 0)
+    {
+	goto ex_on_error;
+    }
+
+    /* watch the inode we have opened: events of a file created meanwhile
+     * will be seen through the directory */
+    file->wd = inotify_add_watch(follow->fd, file->filename,
+				 IO_FOLLOW_FILE_MASK);
+    if(file->wd < 0 && errno != ENOENT)
+    {
+	goto ex_on_error;
+    }
+
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->offset = 0;
+
+    return 0;
+
+ex_on_error:
+    close(file->fd);
+    file->fd = -1;
+
+    return -1;
+}
+
+/*
+ * Tell if the name now points to another file than the opened one
+ */
+static int io_follow_rotated(const struct utk_io_follow_file *file)
+{
+    struct stat st;
+
+    if(stat(file->filename, &st) != 0)
+    {
+	return 0;
+    }
+
+    return (st.st_dev != file->dev || st.st_ino != file->ino);
+}
+
+/*
+ * Read new data of the file, handling truncation and rotation
+ *
+ * \return The number of byte read, 0 if there is no new data or -1 to
+ *         indicate error
+ */
+static ssize_t io_follow_file_read(struct utk_io_follow *follow,
+				   struct utk_io_follow_file *file,
+				   void *dst, size_t len)
+{
+    struct stat st;
+    ssize_t cc;
+
+    for(;;)
+    {
+	if(file->fd < 0)
+	{
+	    if(io_follow_open(follow, file) != 0)
+	    {
+		return -1;
+	    }
+	    if(file->fd < 0)
+	    {
+		return 0;
+	    }
+	}
+
+	if(fstat(file->fd, &st) != 0)
+	{
+	    return -1;
+	}
+	if(st.st_size < file->offset)
+	{
+	    /* truncated, the writer starts again from the beginning */
+	    file->offset = 0;
+	}
+
+	cc = utk_io_pread(file->fd, dst, len, file->offset);
+	if(cc != 0)
+	{
+	    if(cc > 0)
+	    {
+		file->offset += cc;
+	    }
+	    return cc;
+	}
+
+	/* end of the opened file: switch to the new one if it was rotated */
+	if(!io_follow_rotated(file))
+	{
+	    return 0;
+	}
+
+	io_follow_close(follow, file);
+    }
+}
+
+int utk_io_follow_init(struct utk_io_follow *follow, size_t buf_size)
+{
+    follow->buf_size = (buf_size == 0 ? IO_FOLLOW_DEFAULT_BUF_SIZE
+			: buf_size);
+    follow->buf = malloc(follow->buf_size);
+    if(follow->buf == NULL)
+    {
+	return -1;
+    }
+
+    follow->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(follow->fd < 0)
+    {
+	free(follow->buf);
+	return -1;
+    }
+
+    utk_list_head_init(&follow->files);
+
+    return 0;
+}
+
+void utk_io_follow_cleanup(struct utk_io_follow *follow)
+{
+    struct utk_io_follow_file *file = NULL,
+	*n = NULL;
+
+    utk_list_for_each_entry_safe(file, n, &follow->files, list)
+    {
+	utk_list_del(&file->list);
+	if(file->fd >= 0)
+	{
+	    close(file->fd);
+	}
+	free(file);
+    }
+
+    /* watches go away with the inotify descriptor */
+    close(follow->fd);
+    free(follow->buf);
+}
+
+struct utk_io_follow_file *utk_io_follow_add(struct utk_io_follow *follow,
+					     const char *filename, int flags,
+					     utk_io_follow_cb_t cb,
+					     void *opaque)
+{
+    struct utk_io_follow_file *file = NULL;
+    const char *slash = NULL;
+    char *dir = NULL;
+    size_t len;
+    struct stat st;
+
+    len = strlen(filename);
+    file = malloc(sizeof(*file) + len + 1);
+    if(file == NULL)
+    {
+	return NULL;
+    }
+    memcpy(file->filename, filename, len + 1);
+    file->cb = cb;
+    file->opaque = opaque;
+    file->fd = -1;
+    file->wd = -1;
+    file->dir_wd = -1;
+    file->pending = 0;
+
+    slash = strrchr(file->filename, '/');
+    if(slash == NULL)
+    {
+	file->basename = file->filename;
+	dir = strdup(".");
+    }
+    else
+    {
+	file->basename = slash + 1;
+	dir = strndup(file->filename,
+		      slash == file->filename ? 1
+		      : (size_t)(slash - file->filename));
+    }
+    if(dir == NULL)
+    {
+	goto ex_on_error;
+    }
+
+    file->dir_wd = inotify_add_watch(follow->fd, dir, IO_FOLLOW_DIR_MASK);
+    free(dir);
+    if(file->dir_wd < 0)
+    {
+	goto ex_on_error;
+    }
+
+    if(io_follow_open(follow, file) != 0)
+    {
+	goto ex_on_error;
+    }
+
+    if(file->fd >= 0 && (flags & UTK_IO_FOLLOW_FROM_START) == 0)
+    {
+	if(fstat(file->fd, &st) != 0)
+	{
+	    goto ex_on_error;
+	}
+	file->offset = st.st_size;
+    }
+
+    /* deliver what is already there at the next dispatch */
+    file->pending = (file->fd >= 0 && (flags & UTK_IO_FOLLOW_FROM_START));
+
+    utk_list_add_tail(&file->list, &follow->files);
+
+    return file;
+
+ex_on_error:
+    /* file isn't in the list yet: shared watches are kept */
+    io_follow_close(follow, file);
+    io_follow_unwatch(follow, file, file->dir_wd);
+    free(file);
+
+    return NULL;
+}
+
+void utk_io_follow_remove(struct utk_io_follow *follow,
+			  struct utk_io_follow_file *file)
+{
+    utk_list_del(&file->list);
+
+    io_follow_close(follow, file);
+    io_follow_unwatch(follow, file, file->dir_wd);
+
+    free(file);
+}
+
+/*
+ * Read the pending inotify events and flag the files they concern
+ *
+ * \return 0 on success or -1 to indicate error
+ */
+static int io_follow_read_events(struct utk_io_follow *follow)
+{
+    char events[4096]
+	__attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev = NULL;
+    struct utk_io_follow_file *file = NULL;
+    ssize_t cc;
+    size_t pos;
+
+    for(;;)
+    {
+	cc = read(follow->fd, events, sizeof(events));
+	if(cc < 0)
+	{
+	    if(errno == EINTR)
+	    {
+		continue;
+	    }
+	    return (errno == EAGAIN ? 0 : -1);
+	}
+
+	for(pos = 0; pos < (size_t)cc; pos += sizeof(*ev) + ev->len)
+	{
+	    ev = (const struct inotify_event *)(events + pos);
+
+	    utk_list_for_each_entry(file, &follow->files, list)
+	    {
+		if(ev->mask & IN_IGNORED)
+		{
+		    /* the inode is gone with its watch: the number may be
+		     * given again to another watch */
+		    file->wd = (file->wd == ev->wd ? -1 : file->wd);
+		    file->dir_wd = (file->dir_wd == ev->wd ? -1
+				    : file->dir_wd);
+		}
+
+		if(ev->mask & IN_Q_OVERFLOW
+		   || (ev->wd == file->wd && file->wd >= 0)
+		   || (ev->wd == file->dir_wd && ev->len != 0
+		       && strcmp(ev->name, file->basename) == 0))
+		{
+		    file->pending = 1;
+		}
+	    }
+	}
+    }
+}
+
+/*
+ * Deliver new data of the pending files with a callback
+ *
+ * \return The number of pending files or -1 to indicate error
+ */
+static int io_follow_deliver(struct utk_io_follow *follow)
+{
+    struct utk_io_follow_file *file = NULL,
+	*n = NULL;
+    ssize_t cc;
+    int count = 0;
+
+    /* a callback may remove its own file */
+    utk_list_for_each_entry_safe(file, n, &follow->files, list)
+    {
+	if(!file->pending)
+	{
+	    continue;
+	}
+
+	count++;
+	file->pending = 0;
+	if(file->cb == NULL)
+	{
+	    /* read by utk_io_follow_read() */
+	    continue;
+	}
+
+	for(;;)
+	{
+	    cc = io_follow_file_read(follow, file, follow->buf,
+				     follow->buf_size);
+	    if(cc <= 0)
+	    {
+		break;
+	    }
+
+	    if(file->cb(file->opaque, follow->buf, (size_t)cc) != 0)
+	    {
+		errno = ECANCELED;
+		return -1;
+	    }
+	}
+
+	if(cc < 0)
+	{
+	    return -1;
+	}
+    }
+
+    return count;
+}
+
+/*
+ * Wait for the inotify descriptor until deadline (NULL: forever, zero
+ * timespec: don't wait)
+ *
+ * \return 1 if there are events, 0 on timeout or -1 to indicate error
+ */
+static int io_follow_wait(struct utk_io_follow *follow,
+			  const struct timespec *deadline)
+{
+    struct pollfd pfd;
+    struct timespec now;
+    int64_t timeout;
+    int ret;
+
+    pfd.fd = follow->fd;
+    pfd.events = POLLIN;
+
+    do
+    {
+	timeout = -1;
+	if(deadline != NULL)
+	{
+	    clock_gettime(CLOCK_MONOTONIC, &now);
+	    timeout = ((int64_t)(deadline->tv_sec - now.tv_sec) * 1000
+		       + (deadline->tv_nsec - now.tv_nsec) / 1000000);
+	    if(timeout < 0)
+	    {
+		timeout = 0;
+	    }
+	    if(timeout > INT_MAX)
+	    {
+		timeout = INT_MAX;
+	    }
+	}
+
+	ret = poll(&pfd, 1, (int)timeout);
+    }
+    while(ret < 0 && errno == EINTR);
+
+    return ret;
+}
+
+static void io_follow_deadline(struct timespec *deadline, int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if(deadline->tv_nsec >= 1000000000)
+    {
+	deadline->tv_sec++;
+	deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/*
+ * Dispatch until deadline or until files had events
+ */
+static int io_follow_dispatch(struct utk_io_follow *follow,
+			      const struct timespec *deadline)
+{
+    int ret;
+
+    ret = io_follow_deliver(follow);
+    while(ret == 0)
+    {
+	ret = io_follow_wait(follow, deadline);
+	if(ret <= 0)
+	{
+	    return ret;
+	}
+
+	if(io_follow_read_events(follow) != 0)
+	{
+	    return -1;
+	}
+
+	ret = io_follow_deliver(follow);
+    }
+
+    return ret;
+}
+
+int utk_io_follow_dispatch(struct utk_io_follow *follow, int timeout_ms)
+{
+    struct timespec deadline;
+
+    if(timeout_ms >= 0)
+    {
+	io_follow_deadline(&deadline, timeout_ms);
+    }
+
+    return io_follow_dispatch(follow, timeout_ms >= 0 ? &deadline : NULL);
+}
+
+ssize_t utk_io_follow_read(struct utk_io_follow *follow,
+			   struct utk_io_follow_file *file,
+			   void *dst, size_t len, int timeout_ms)
+{
+    struct timespec deadline;
+    ssize_t cc;
+    int ret;
+
+    if(timeout_ms >= 0)
+    {
+	io_follow_deadline(&deadline, timeout_ms);
+    }
+
+    for(;;)
+    {
+	file->pending = 0;
+	cc = io_follow_file_read(follow, file, dst, len);
+	if(cc != 0)
+	{
+	    return cc;
+	}
+
+	ret = io_follow_dispatch(follow,
+				 timeout_ms >= 0 ? &deadline : NULL);
+	if(ret < 0)
+	{
+	    return -1;
+	}
+	if(ret == 0)
+	{
+	    errno = (timeout_ms == 0 ? EAGAIN : ETIMEDOUT);
+	    return -1;
+	}
+    }
+}
@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/io.h"
+#include "utk/crc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define UTK_IO_LOG_BUF_SIZE (256 * 1024)
+
+static void io_log_put_le32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t io_log_get_le32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8
+	| (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void io_log_header(unsigned char *header, const void *data, size_t len)
+{
+    uint32_t crc;
+
+    io_log_put_le32(header, (uint32_t)len);
+    crc = utk_crc32c(0, header, 4);
+    crc = utk_crc32c(crc, data, len);
+    io_log_put_le32(header + 4, crc);
+}
+
+/*
+ * Walk over records in memory, return the end of the last valid one
+ */
+static size_t io_log_parse(const unsigned char *p, size_t size,
+			   utk_io_log_cb_t cb, void *opaque)
+{
+    size_t offset,
+	len;
+    uint32_t crc;
+
+    offset = 0;
+    while(size - offset >= UTK_IO_LOG_HEADER_SIZE)
+    {
+	len = io_log_get_le32(p + offset);
+	if(len > size - offset - UTK_IO_LOG_HEADER_SIZE)
+	{
+	    /* torn record */
+	    break;
+	}
+
+	crc = utk_crc32c(0, p + offset, 4);
+	crc = utk_crc32c(crc, p + offset + UTK_IO_LOG_HEADER_SIZE, len);
+	if(crc != io_log_get_le32(p + offset + 4))
+	{
+	    break;
+	}
+
+	if(cb != NULL
+	   && cb(opaque, p + offset + UTK_IO_LOG_HEADER_SIZE, len,
+		 (off_t)offset) != 0)
+	{
+	    offset += UTK_IO_LOG_HEADER_SIZE + len;
+	    break;
+	}
+
+	offset += UTK_IO_LOG_HEADER_SIZE + len;
+    }
+
+    return offset;
+}
+
+static off_t io_log_scan_fd(int fd, utk_io_log_cb_t cb, void *opaque)
+{
+    struct stat st;
+    void *map = NULL;
+    size_t end;
+    ssize_t size;
+
+    if(fstat(fd, &st) != 0)
+    {
+	return -1;
+    }
+
+    if(st.st_size == 0)
+    {
+	return 0;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED)
+    {
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+	end = io_log_parse(map, (size_t)st.st_size, cb, opaque);
+	munmap(map, (size_t)st.st_size);
+
+	return (off_t)end;
+    }
+
+    /* filesystem without mmap support */
+    size = utk_io_read_all(fd, &map, NULL);
+    if(size < 0)
+    {
+	return -1;
+    }
+
+    end = io_log_parse(map, (size_t)size, cb, opaque);
+    free(map);
+
+    return (off_t)end;
+}
+
+off_t utk_io_log_scan(const char *filename, utk_io_log_cb_t cb, void *opaque)
+{
+    int fd;
+    off_t end;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    end = io_log_scan_fd(fd, cb, opaque);
+
+    close(fd);
+
+    return end;
+}
+
+/* must be called with log->lock held */
+static int io_log_flush(struct utk_io_log *log)
+{
+    ssize_t cc;
+
+    if(log->buf_fill == 0)
+    {
+	return 0;
+    }
+
+    cc = utk_io_write(log->fd, log->buf, log->buf_fill);
+    if(cc < 0)
+    {
+	log->error = errno;
+	return -1;
+    }
+
+    log->buf_fill = 0;
+    log->written++;
+
+    return 0;
+}
+
+/*
+ * Write pending records and sync them. Threads syncing at the same time
+ * share fdatasync(2) calls, which are done without the lock so appends
+ * can go on meanwhile.
+ */
+static int io_log_sync(struct utk_io_log *log)
+{
+    unsigned long target;
+    int ret;
+
+    pthread_mutex_lock(&log->lock);
+
+    ret = -1;
+    if(log->error != 0 || io_log_flush(log) != 0)
+    {
+	errno = log->error;
+	goto ex_unlock;
+    }
+
+    target = log->written;
+    while(log->synced < target)
+    {
+	if(log->syncing)
+	{
+	    pthread_cond_wait(&log->cond, &log->lock);
+	    continue;
+	}
+
+	/* the sync we waited for failed: records may be lost */
+	if(log->error != 0)
+	{
+	    ret = -1;
+	    errno = log->error;
+	    goto ex_unlock;
+	}
+
+	log->syncing = 1;
+	target = log->written;
+	pthread_mutex_unlock(&log->lock);
+
+	ret = fdatasync(log->fd);
+
+	pthread_mutex_lock(&log->lock);
+	log->syncing = 0;
+	pthread_cond_broadcast(&log->cond);
+	if(ret != 0)
+	{
+	    log->error = errno;
+	    goto ex_unlock;
+	}
+	log->synced = target;
+    }
+
+    ret = 0;
+
+ex_unlock:
+    pthread_mutex_unlock(&log->lock);
+
+    return ret;
+}
+
+static void *io_log_sync_thread(void *data)
+{
+    struct utk_io_log *log = data;
+    struct timespec ts;
+
+    pthread_mutex_lock(&log->lock);
+    while(!log->stop)
+    {
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += log->sync_interval_ms / 1000;
+	ts.tv_nsec += (long)(log->sync_interval_ms % 1000) * 1000000;
+	if(ts.tv_nsec >= 1000000000)
+	{
+	    ts.tv_sec++;
+	    ts.tv_nsec -= 1000000000;
+	}
+
+	while(!log->stop
+	      && pthread_cond_timedwait(&log->cond, &log->lock, &ts) == 0)
+	{
+	    ;
+	}
+
+	if(log->buf_fill != 0 || log->written != log->synced)
+	{
+	    pthread_mutex_unlock(&log->lock);
+	    io_log_sync(log);
+	    pthread_mutex_lock(&log->lock);
+	}
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return NULL;
+}
+
+int utk_io_log_open(struct utk_io_log *log, const char *filename,
+		    int sync_policy, unsigned int sync_interval_ms,
+		    size_t buf_size)
+{
+    pthread_condattr_t attr;
+    off_t end;
+
+    log->fd = open(filename, O_CREAT | O_RDWR | O_CLOEXEC,
+		   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(log->fd < 0)
+    {
+	return -1;
+    }
+
+    /* recovery: drop the torn tail */
+    end = io_log_scan_fd(log->fd, NULL, NULL);
+    if(end < 0
+       || ftruncate(log->fd, end) != 0
+       || lseek(log->fd, end, SEEK_SET) != end)
+    {
+	goto ex_on_error;
+    }
+
+    log->sync_policy = sync_policy;
+    log->sync_interval_ms = (sync_interval_ms != 0 ? sync_interval_ms : 1);
+    log->buf_size = (buf_size != 0 ? buf_size : UTK_IO_LOG_BUF_SIZE);
+    log->buf_fill = 0;
+    log->written = 0;
+    log->synced = 0;
+    log->syncing = 0;
+    log->stop = 0;
+    log->error = 0;
+
+    log->buf = malloc(log->buf_size);
+    if(log->buf == NULL)
+    {
+	goto ex_on_error;
+    }
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if(sync_policy == UTK_IO_LOG_SYNC_INTERVAL)
+    {
+	errno = pthread_create(&log->thread, NULL, io_log_sync_thread, log);
+	if(errno != 0)
+	{
+	    pthread_cond_destroy(&log->cond);
+	    pthread_mutex_destroy(&log->lock);
+	    free(log->buf);
+	    goto ex_on_error;
+	}
+    }
+
+    return 0;
+
+ex_on_error:
+    close(log->fd);
+
+    return -1;
+}
+
+int utk_io_log_append(struct utk_io_log *log, const void *data, size_t len)
+{
+    unsigned char header[UTK_IO_LOG_HEADER_SIZE];
+    size_t total;
+    int ret;
+
+    if(len > UINT32_MAX)
+    {
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    /* crc is computed out of the lock */
+    io_log_header(header, data, len);
+    total = UTK_IO_LOG_HEADER_SIZE + len;
+
+    pthread_mutex_lock(&log->lock);
+
+    ret = -1;
+    if(log->error != 0)
+    {
+	errno = log->error;
+	goto ex_unlock;
+    }
+
+    if(total > log->buf_size - log->buf_fill && io_log_flush(log) != 0)
+    {
+	goto ex_unlock;
+    }
+
+    if(total > log->buf_size)
+    {
+	/* big record: bypass the buffer */
+	if(utk_io_write(log->fd, header, sizeof(header)) < 0
+	   || utk_io_write(log->fd, data, len) < 0)
+	{
+	    log->error = errno;
+	    goto ex_unlock;
+	}
+	log->written++;
+    }
+    else
+    {
+	memcpy(log->buf + log->buf_fill, header, sizeof(header));
+	memcpy(log->buf + log->buf_fill + sizeof(header), data, len);
+	log->buf_fill += total;
+    }
+
+    ret = 0;
+
+ex_unlock:
+    pthread_mutex_unlock(&log->lock);
+
+    if(ret == 0 && log->sync_policy == UTK_IO_LOG_SYNC_ALWAYS)
+    {
+	ret = io_log_sync(log);
+    }
+
+    return ret;
+}
+
+int utk_io_log_sync(struct utk_io_log *log)
+{
+    return io_log_sync(log);
+}
+
+int utk_io_log_close(struct utk_io_log *log)
+{
+    int ret;
+
+    if(log->sync_policy == UTK_IO_LOG_SYNC_INTERVAL)
+    {
+	pthread_mutex_lock(&log->lock);
+	log->stop = 1;
+	pthread_cond_broadcast(&log->cond);
+	pthread_mutex_unlock(&log->lock);
+
+	pthread_join(log->thread, NULL);
+    }
+
+    ret = io_log_sync(log);
+
+    if(close(log->fd) != 0)
+    {
+	ret = -1;
+    }
+    log->fd = -1;
+
+    pthread_cond_destroy(&log->cond);
+    pthread_mutex_destroy(&log->lock);
+    free(log->buf);
+    log->buf = NULL;
+
+    return ret;
+}
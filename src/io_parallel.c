@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/io.h"
+#include "utk/math.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define UTK_IO_PARALLEL_CHUNK_SIZE (1024 * 1024)
+
+struct io_parallel_ctx {
+    int fd;
+    char *dst;
+    size_t len;
+    size_t chunk_size;
+    size_t nb_chunks;
+    utk_io_chunk_cb_t cb;
+    void *opaque;
+
+    /* shared between workers */
+    size_t next_chunk;
+    size_t end;
+    int error;
+};
+
+static void *io_parallel_worker(void *data)
+{
+    struct io_parallel_ctx *ctx = data;
+    size_t chunk,
+	offset,
+	len,
+	end;
+    ssize_t cc;
+
+    for(;;)
+    {
+	chunk = __atomic_fetch_add(&ctx->next_chunk, 1, __ATOMIC_RELAXED);
+	if(chunk >= ctx->nb_chunks
+	   || __atomic_load_n(&ctx->error, __ATOMIC_RELAXED) != 0)
+	{
+	    break;
+	}
+
+	offset = chunk * ctx->chunk_size;
+	len = utk_math_min(ctx->chunk_size, ctx->len - offset);
+
+	cc = utk_io_pread(ctx->fd, ctx->dst + offset, len, (off_t)offset);
+	if(cc < 0)
+	{
+	    __atomic_store_n(&ctx->error, errno, __ATOMIC_RELAXED);
+	    break;
+	}
+
+	if((size_t)cc < len)
+	{
+	    /* file has been truncated meanwhile: keep the smallest end */
+	    end = offset + (size_t)cc;
+	    len = __atomic_load_n(&ctx->end, __ATOMIC_RELAXED);
+	    while(end < len
+		  && !__atomic_compare_exchange_n(&ctx->end, &len, end, 0,
+						  __ATOMIC_RELAXED,
+						  __ATOMIC_RELAXED))
+	    {
+		;
+	    }
+	}
+
+	if(ctx->cb != NULL && cc > 0
+	   && ctx->cb(ctx->opaque, ctx->dst + offset,
+		      (off_t)offset, (size_t)cc) != 0)
+	{
+	    __atomic_store_n(&ctx->error, ECANCELED, __ATOMIC_RELAXED);
+	    break;
+	}
+    }
+
+    return NULL;
+}
+
+ssize_t utk_io_file_read_parallel(const char *filename, void *dst, size_t len,
+				  unsigned int nb_threads, size_t chunk_size,
+				  utk_io_chunk_cb_t cb, void *opaque)
+{
+    struct io_parallel_ctx ctx;
+    struct stat st;
+    pthread_t *threads = NULL;
+    unsigned int i,
+	nb_started;
+    long nb_cpus;
+
+    ctx.fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(ctx.fd < 0)
+    {
+	return -1;
+    }
+
+    if(fstat(ctx.fd, &st) != 0)
+    {
+	goto ex_on_error;
+    }
+
+    if(S_ISREG(st.st_mode))
+    {
+	len = utk_math_min(len, (size_t)st.st_size);
+    }
+
+    if(len > SSIZE_MAX)
+    {
+	errno = EFBIG;
+	goto ex_on_error;
+    }
+
+    if(chunk_size == 0)
+    {
+	chunk_size = UTK_IO_PARALLEL_CHUNK_SIZE;
+    }
+
+    if(nb_threads == 0)
+    {
+	nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	nb_threads = (nb_cpus > 0 ? (unsigned int)nb_cpus : 1);
+    }
+
+    ctx.dst = dst;
+    ctx.len = len;
+    ctx.chunk_size = chunk_size;
+    ctx.nb_chunks = len / chunk_size + (len % chunk_size != 0);
+    ctx.cb = cb;
+    ctx.opaque = opaque;
+    ctx.next_chunk = 0;
+    ctx.end = len;
+    ctx.error = 0;
+
+    nb_threads = (unsigned int)utk_math_min((size_t)nb_threads, ctx.nb_chunks);
+
+    nb_started = 0;
+    if(nb_threads > 1)
+    {
+	threads = malloc((nb_threads - 1) * sizeof(*threads));
+	if(threads != NULL)
+	{
+	    for(i = 0; i < nb_threads - 1; ++i)
+	    {
+		if(pthread_create(&threads[i], NULL,
+				  io_parallel_worker, &ctx) != 0)
+		{
+		    /* go on with the threads already started */
+		    break;
+		}
+		++nb_started;
+	    }
+	}
+    }
+
+    /* the caller is a worker too */
+    io_parallel_worker(&ctx);
+
+    for(i = 0; i < nb_started; ++i)
+    {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    close(ctx.fd);
+
+    if(ctx.error != 0)
+    {
+	errno = ctx.error;
+	return -1;
+    }
+
+    return (ssize_t)ctx.end;
+
+ex_on_error:
+    close(ctx.fd);
+
+    return -1;
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/io.h"
+#include "utk/math.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define IO_PREFETCH_DEFAULT_CHUNK (1024 * 1024)
+#define IO_PREFETCH_DEFAULT_WINDOW_CHUNKS 64
+/* times the reader finds the ring full before the window is halved */
+#define IO_PREFETCH_SHRINK_WAITS 4
+
+/*
+ * Ask the kernel to read [pos, pos + window) if not already asked
+ */
+static void io_prefetch_advise(struct utk_io_prefetch *pf, off_t pos,
+			       size_t window)
+{
+    off_t end = pos + (off_t)window;
+
+    if(pf->advised < pos)
+    {
+	pf->advised = pos;
+    }
+
+    if(end > pf->advised)
+    {
+	posix_fadvise(pf->fd, pf->advised, end - pf->advised,
+		      POSIX_FADV_WILLNEED);
+	pf->advised = end;
+    }
+}
+
+static void *io_prefetch_thread(void *data)
+{
+    struct utk_io_prefetch *pf = data;
+    struct utk_io_prefetch_chunk *chunk = NULL;
+    size_t window;
+    off_t offset;
+    ssize_t cc;
+
+    pthread_mutex_lock(&pf->lock);
+    for(;;)
+    {
+	chunk = &pf->chunks[pf->tail];
+	if(chunk->state != UTK_IO_PREFETCH_FREE && !pf->stop)
+	{
+	    /* consumer is slower than the disk */
+	    if(++pf->full_waits >= IO_PREFETCH_SHRINK_WAITS)
+	    {
+		pf->full_waits = 0;
+		pf->window = utk_math_max(pf->window / 2, pf->chunk_size);
+	    }
+
+	    do
+	    {
+		pthread_cond_wait(&pf->cond, &pf->lock);
+	    }
+	    while(chunk->state != UTK_IO_PREFETCH_FREE && !pf->stop);
+	}
+	if(pf->stop)
+	{
+	    break;
+	}
+
+	offset = pf->offset;
+	window = pf->window;
+	pthread_mutex_unlock(&pf->lock);
+
+	/* the kernel fetches the next window while we read this chunk */
+	io_prefetch_advise(pf, offset + (off_t)pf->chunk_size, window);
+
+	cc = utk_io_pread(pf->fd, chunk->data, pf->chunk_size, offset);
+
+	pthread_mutex_lock(&pf->lock);
+	chunk->len = (cc > 0 ? (size_t)cc : 0);
+	chunk->error = (cc < 0 ? errno : 0);
+	chunk->state = UTK_IO_PREFETCH_FILLED;
+	pf->offset += (cc > 0 ? cc : 0);
+	pf->tail = (pf->tail + 1) % pf->nb_chunks;
+	pthread_cond_broadcast(&pf->cond);
+
+	/* end of file or error: nothing more to read */
+	if(cc <= 0)
+	{
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&pf->lock);
+
+    return NULL;
+}
+
+int utk_io_prefetch_open(struct utk_io_prefetch *pf, int fd,
+			 unsigned int nb_chunks, size_t chunk_size,
+			 size_t max_window)
+{
+    long page_size;
+    unsigned int i;
+    void *data = NULL;
+
+    if(nb_chunks < 2)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    memset(pf, 0, sizeof(*pf));
+    pf->fd = fd;
+    pf->nb_chunks = nb_chunks;
+    pf->chunk_size = (chunk_size == 0 ? IO_PREFETCH_DEFAULT_CHUNK
+		      : chunk_size);
+    pf->max_window = (max_window == 0
+		      ? pf->chunk_size * IO_PREFETCH_DEFAULT_WINDOW_CHUNKS
+		      : utk_math_max(max_window, pf->chunk_size));
+    pf->window = utk_math_min(pf->chunk_size * nb_chunks, pf->max_window);
+
+    pf->offset = lseek(fd, 0, SEEK_CUR);
+    if(pf->offset < 0)
+    {
+	return -1;
+    }
+    pf->advised = pf->offset;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    pf->chunks = calloc(nb_chunks, sizeof(*pf->chunks));
+    if(pf->chunks == NULL)
+    {
+	return -1;
+    }
+    for(i = 0; i < nb_chunks; ++i)
+    {
+	errno = posix_memalign(&data, (size_t)page_size, pf->chunk_size);
+	if(errno != 0)
+	{
+	    goto ex_on_error;
+	}
+	pf->chunks[i].data = data;
+    }
+
+    /* doubles the readahead of the kernel too */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->cond, NULL);
+
+    errno = pthread_create(&pf->thread, NULL, io_prefetch_thread, pf);
+    if(errno != 0)
+    {
+	pthread_mutex_destroy(&pf->lock);
+	pthread_cond_destroy(&pf->cond);
+	goto ex_on_error;
+    }
+
+    return 0;
+
+ex_on_error:
+    for(i = 0; i < nb_chunks; ++i)
+    {
+	free(pf->chunks[i].data);
+    }
+    free(pf->chunks);
+
+    return -1;
+}
+
+ssize_t utk_io_prefetch_next(struct utk_io_prefetch *pf, const void **data)
+{
+    struct utk_io_prefetch_chunk *chunk = NULL;
+    ssize_t ret;
+
+    pthread_mutex_lock(&pf->lock);
+
+    /* give back the previous chunk */
+    if(pf->held)
+    {
+	pf->chunks[pf->head].state = UTK_IO_PREFETCH_FREE;
+	pf->head = (pf->head + 1) % pf->nb_chunks;
+	pf->held = 0;
+	pthread_cond_broadcast(&pf->cond);
+    }
+
+    chunk = &pf->chunks[pf->head];
+    if(chunk->state != UTK_IO_PREFETCH_FILLED)
+    {
+	/* the disk is late (the first chunk is always waited for) */
+	if(pf->consumed != 0)
+	{
+	    pf->window = utk_math_min(pf->window * 2, pf->max_window);
+	    pf->full_waits = 0;
+	}
+
+	do
+	{
+	    pthread_cond_wait(&pf->cond, &pf->lock);
+	}
+	while(chunk->state != UTK_IO_PREFETCH_FILLED);
+    }
+
+    if(chunk->error != 0)
+    {
+	errno = chunk->error;
+	ret = -1;
+    }
+    else if(chunk->len == 0)
+    {
+	ret = 0;
+    }
+    else
+    {
+	pf->held = 1;
+	pf->consumed++;
+	*data = chunk->data;
+	ret = (ssize_t)chunk->len;
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+
+    return ret;
+}
+
+void utk_io_prefetch_close(struct utk_io_prefetch *pf)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->lock);
+
+    pthread_join(pf->thread, NULL);
+
+    pthread_mutex_destroy(&pf->lock);
+    pthread_cond_destroy(&pf->cond);
+
+    for(i = 0; i < pf->nb_chunks; ++i)
+    {
+	free(pf->chunks[i].data);
+    }
+    free(pf->chunks);
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/io.h"
+#include "io_stats.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * Counters of a thread: only the owner thread writes them (relaxed
+ * stores), readers sum them with relaxed loads. The block of an exited
+ * thread is kept in the list, with its counts, for the next new thread.
+ */
+struct io_stats_thread {
+    struct io_stats_thread *next;
+    int in_use;
+    struct utk_io_stats ops[UTK_IO_STATS_NB_OPS];
+};
+
+#ifdef UTK_IO_STATS
+int io_stats_on = 1;
+#else
+int io_stats_on = 0;
+#endif
+
+static struct io_stats_thread *io_stats_threads = NULL;
+static __thread struct io_stats_thread *io_stats_self = NULL;
+static pthread_once_t io_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t io_stats_key;
+
+/* counts at the last utk_io_stats_reset() */
+static pthread_mutex_t io_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct utk_io_stats io_stats_base[UTK_IO_STATS_NB_OPS];
+
+#define IO_STATS_ADD(counter, value)					\
+    __atomic_store_n(&(counter),					\
+		     __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (value), \
+		     __ATOMIC_RELAXED)
+
+static void io_stats_thread_exit(void *data)
+{
+    struct io_stats_thread *self = data;
+
+    __atomic_store_n(&self->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void io_stats_init(void)
+{
+    pthread_key_create(&io_stats_key, io_stats_thread_exit);
+}
+
+static struct io_stats_thread *io_stats_attach(void)
+{
+    struct io_stats_thread *self = NULL;
+    int unused;
+
+    pthread_once(&io_stats_once, io_stats_init);
+
+    /* reuse the block of an exited thread */
+    for(self = __atomic_load_n(&io_stats_threads, __ATOMIC_ACQUIRE);
+	self != NULL;
+	self = self->next)
+    {
+	unused = 0;
+	if(__atomic_compare_exchange_n(&self->in_use, &unused, 1, 0,
+				       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+	    break;
+	}
+    }
+
+    if(self == NULL)
+    {
+	self = calloc(1, sizeof(*self));
+	if(self == NULL)
+	{
+	    return NULL;
+	}
+	self->in_use = 1;
+
+	self->next = __atomic_load_n(&io_stats_threads, __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&io_stats_threads, &self->next,
+					   self, 1, __ATOMIC_RELEASE,
+					   __ATOMIC_RELAXED))
+	{
+	}
+    }
+
+    pthread_setspecific(io_stats_key, self);
+    io_stats_self = self;
+
+    return self;
+}
+
+static unsigned int io_stats_bucket(uint64_t ns)
+{
+    unsigned int msb;
+
+    if(ns < 4)
+    {
+	return (unsigned int)ns;
+    }
+
+    msb = 63 - (unsigned int)__builtin_clzll(ns);
+
+    return (msb - 1) * 4 + (unsigned int)((ns >> (msb - 2)) & 3);
+}
+
+void io_stats_record(enum utk_io_stats_op op,
+		     const struct io_stats_probe *probe, ssize_t ret)
+{
+    struct io_stats_thread *self = io_stats_self;
+    struct utk_io_stats *stats = NULL;
+    struct timespec ts;
+    uint64_t now;
+    int saved_errno = errno;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+
+    if(self == NULL)
+    {
+	self = io_stats_attach();
+	if(self == NULL)
+	{
+	    errno = saved_errno;
+	    return;
+	}
+    }
+
+    stats = &self->ops[op];
+    IO_STATS_ADD(stats->calls, 1);
+    IO_STATS_ADD(stats->syscalls, probe->syscalls);
+    IO_STATS_ADD(stats->eintr, probe->eintr);
+    IO_STATS_ADD(stats->short_transfers, probe->short_transfers);
+    if(ret < 0)
+    {
+	IO_STATS_ADD(stats->errors, 1);
+    }
+    else
+    {
+	IO_STATS_ADD(stats->bytes, (uint64_t)ret);
+    }
+    IO_STATS_ADD(stats->latency[io_stats_bucket(now - probe->start)], 1);
+
+    errno = saved_errno;
+}
+
+void utk_io_stats_enable(int enable)
+{
+    __atomic_store_n(&io_stats_on, enable != 0, __ATOMIC_RELAXED);
+}
+
+int utk_io_stats_enabled(void)
+{
+    return __atomic_load_n(&io_stats_on, __ATOMIC_RELAXED);
+}
+
+/*
+ * Sum counters of all threads
+ */
+static void io_stats_sum(enum utk_io_stats_op op, struct utk_io_stats *stats)
+{
+    struct io_stats_thread *thread = NULL;
+    const struct utk_io_stats *src = NULL;
+    unsigned int i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for(thread = __atomic_load_n(&io_stats_threads, __ATOMIC_ACQUIRE);
+	thread != NULL;
+	thread = thread->next)
+    {
+	src = &thread->ops[op];
+	stats->calls += __atomic_load_n(&src->calls, __ATOMIC_RELAXED);
+	stats->bytes += __atomic_load_n(&src->bytes, __ATOMIC_RELAXED);
+	stats->syscalls += __atomic_load_n(&src->syscalls, __ATOMIC_RELAXED);
+	stats->eintr += __atomic_load_n(&src->eintr, __ATOMIC_RELAXED);
+	stats->short_transfers += __atomic_load_n(&src->short_transfers,
+						  __ATOMIC_RELAXED);
+	stats->errors += __atomic_load_n(&src->errors, __ATOMIC_RELAXED);
+	for(i = 0; i < UTK_IO_STATS_NB_BUCKETS; ++i)
+	{
+	    stats->latency[i] += __atomic_load_n(&src->latency[i],
+						 __ATOMIC_RELAXED);
+	}
+    }
+}
+
+void utk_io_stats_get(enum utk_io_stats_op op, struct utk_io_stats *stats)
+{
+    const struct utk_io_stats *base = &io_stats_base[op];
+    unsigned int i;
+
+    io_stats_sum(op, stats);
+
+    pthread_mutex_lock(&io_stats_lock);
+    stats->calls -= base->calls;
+    stats->bytes -= base->bytes;
+    stats->syscalls -= base->syscalls;
+    stats->eintr -= base->eintr;
+    stats->short_transfers -= base->short_transfers;
+    stats->errors -= base->errors;
+    for(i = 0; i < UTK_IO_STATS_NB_BUCKETS; ++i)
+    {
+	stats->latency[i] -= base->latency[i];
+    }
+    pthread_mutex_unlock(&io_stats_lock);
+}
+
+void utk_io_stats_reset(void)
+{
+    unsigned int op;
+
+    /* counters can't be cleared under the feet of their owner: remember
+     * where they were */
+    pthread_mutex_lock(&io_stats_lock);
+    for(op = 0; op < UTK_IO_STATS_NB_OPS; ++op)
+    {
+	io_stats_sum((enum utk_io_stats_op)op, &io_stats_base[op]);
+    }
+    pthread_mutex_unlock(&io_stats_lock);
+}
+
+uint64_t utk_io_stats_bucket_ns(unsigned int bucket)
+{
+    if(bucket < 4)
+    {
+	return bucket;
+    }
+
+    return (uint64_t)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+uint64_t utk_io_stats_percentile(const struct utk_io_stats *stats,
+				 double percentile)
+{
+    uint64_t rank,
+	count,
+	total;
+    unsigned int i;
+
+    total = 0;
+    for(i = 0; i < UTK_IO_STATS_NB_BUCKETS; ++i)
+    {
+	total += stats->latency[i];
+    }
+    if(total == 0)
+    {
+	return 0;
+    }
+
+    rank = (uint64_t)((double)total * percentile / 100.0);
+    if(rank == 0)
+    {
+	rank = 1;
+    }
+    if(rank > total)
+    {
+	rank = total;
+    }
+
+    count = 0;
+    for(i = 0; i < UTK_IO_STATS_NB_BUCKETS - 1; ++i)
+    {
+	count += stats->latency[i];
+	if(count >= rank)
+	{
+	    break;
+	}
+    }
+
+    return (i == UTK_IO_STATS_NB_BUCKETS - 1 ? UINT64_MAX
+	    : utk_io_stats_bucket_ns(i + 1));
+}
+
+int utk_io_stats_dump(int fd)
+{
+    static const char *names[UTK_IO_STATS_NB_OPS] = {
+	"read", "write", "pread", "pwrite"
+    };
+    struct utk_io_stats stats;
+    unsigned int op;
+
+    if(dprintf(fd, "%-7s %12s %14s %12s %8s %10s %8s %10s %10s %10s\n",
+	       "op", "calls", "bytes", "syscalls", "eintr", "short",
+	       "errors", "p50(ns)", "p99(ns)", "p99.9(ns)") < 0)
+    {
+	return -1;
+    }
+
+    for(op = 0; op < UTK_IO_STATS_NB_OPS; ++op)
+    {
+	utk_io_stats_get((enum utk_io_stats_op)op, &stats);
+	if(dprintf(fd, "%-7s %12llu %14llu %12llu %8llu %10llu %8llu "
+		   "%10llu %10llu %10llu\n",
+		   names[op],
+		   (unsigned long long)stats.calls,
+		   (unsigned long long)stats.bytes,
+		   (unsigned long long)stats.syscalls,
+		   (unsigned long long)stats.eintr,
+		   (unsigned long long)stats.short_transfers,
+		   (unsigned long long)stats.errors,
+		   (unsigned long long)utk_io_stats_percentile(&stats, 50),
+		   (unsigned long long)utk_io_stats_percentile(&stats, 99),
+		   (unsigned long long)utk_io_stats_percentile(&stats, 99.9))
+	   < 0)
+	{
+	    return -1;
+	}
+    }
+
+    return 0;
+}
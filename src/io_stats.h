@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UTK_IO_STATS_H_
+#define _UTK_IO_STATS_H_
+
+#include "utk/io.h"
+
+#include <errno.h>
+#include <time.h>
+
+/**
+ * io_stats.h - private helpers to instrument utk_io calls
+ *
+ * A probe lives on the stack of the instrumented call: syscall, EINTR and
+ * short transfer counts are always kept in it (register increments), the
+ * clock is only read and the per-thread counters only updated when
+ * statistics are enabled.
+ */
+
+extern int io_stats_on __attribute__((visibility("hidden")));
+
+struct io_stats_probe {
+    uint64_t start;
+    unsigned int syscalls;
+    unsigned int eintr;
+    unsigned int short_transfers;
+    int on;
+};
+
+__attribute__((visibility("hidden")))
+void io_stats_record(enum utk_io_stats_op op,
+		     const struct io_stats_probe *probe, ssize_t ret);
+
+static inline void io_stats_begin(struct io_stats_probe *probe)
+{
+    struct timespec ts;
+
+    probe->syscalls = 0;
+    probe->eintr = 0;
+    probe->short_transfers = 0;
+    probe->on = __atomic_load_n(&io_stats_on, __ATOMIC_RELAXED);
+    if(__builtin_expect(probe->on, 0))
+    {
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	probe->start = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    }
+}
+
+/*
+ * Account a syscall which returned cc while len bytes were asked (end of
+ * file isn't a short transfer)
+ */
+static inline void io_stats_syscall(struct io_stats_probe *probe, ssize_t cc,
+				    size_t len)
+{
+    probe->syscalls++;
+    if(cc < 0)
+    {
+	probe->eintr += (errno == EINTR);
+    }
+    else if(cc != 0 && (size_t)cc < len)
+    {
+	probe->short_transfers++;
+    }
+}
+
+/*
+ * Return ret after having recorded the call (errno is kept)
+ */
+static inline ssize_t io_stats_end(struct io_stats_probe *probe,
+				   enum utk_io_stats_op op, ssize_t ret)
+{
+    if(__builtin_expect(probe->on, 0))
+    {
+	io_stats_record(op, probe, ret);
+    }
+
+    return ret;
+}
+
+#endif
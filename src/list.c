@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/list.h"
+
+/* a pending run of 2^i nodes per bit of a size_t */
+#define UTK_LIST_SORT_LEVELS (sizeof(size_t) * 8)
+
+/*
+ * Merge two sorted NULL terminated lists (prev links ignored), a first
+ * on equality
+ */
+static struct utk_list_head *list_merge(void *priv, utk_list_cmp_cb_t cmp,
+					struct utk_list_head *a,
+					struct utk_list_head *b)
+{
+    struct utk_list_head *head = NULL;
+    struct utk_list_head **tail = &head;
+
+    for(;;)
+    {
+	if(cmp(priv, a, b) <= 0)
+	{
+	    *tail = a;
+	    tail = &a->next;
+	    a = a->next;
+	    if(a == NULL)
+	    {
+		*tail = b;
+		break;
+	    }
+	}
+	else
+	{
+	    *tail = b;
+	    tail = &b->next;
+	    b = b->next;
+	    if(b == NULL)
+	    {
+		*tail = a;
+		break;
+	    }
+	}
+    }
+
+    return head;
+}
+
+/*
+ * Last merge: link the result behind head and restore prev links
+ */
+static void list_merge_final(void *priv, utk_list_cmp_cb_t cmp,
+			     struct utk_list_head *head,
+			     struct utk_list_head *a,
+			     struct utk_list_head *b)
+{
+    struct utk_list_head *tail = head;
+
+    while(a != NULL && b != NULL)
+    {
+	if(cmp(priv, a, b) <= 0)
+	{
+	    tail->next = a;
+	    a->prev = tail;
+	    tail = a;
+	    a = a->next;
+	}
+	else
+	{
+	    tail->next = b;
+	    b->prev = tail;
+	    tail = b;
+	    b = b->next;
+	}
+    }
+
+    for(a = a != NULL ? a : b; a != NULL; a = a->next)
+    {
+	tail->next = a;
+	a->prev = tail;
+	tail = a;
+    }
+
+    tail->next = head;
+    head->prev = tail;
+}
+
+void utk_list_sort(void *priv, struct utk_list_head *head,
+		   utk_list_cmp_cb_t cmp)
+{
+    /* pending[i] is NULL or a sorted run of 2^i nodes */
+    struct utk_list_head *pending[UTK_LIST_SORT_LEVELS];
+    struct utk_list_head *list = NULL;
+    struct utk_list_head *run = NULL;
+    size_t max_level = 0,
+	level;
+
+    /* 0 or 1 entry */
+    if(head->next == head->prev)
+    {
+	return;
+    }
+
+    for(level = 0; level < UTK_LIST_SORT_LEVELS; ++level)
+    {
+	pending[level] = NULL;
+    }
+
+    head->prev->next = NULL;
+    list = head->next;
+
+    /*
+     * Each node is a run of 1 which is merged with the pending runs of
+     * the same size, like a carry in a binary counter. Pending runs hold
+     * older nodes: they are given first to keep the sort stable.
+     */
+    while(list != NULL)
+    {
+	run = list;
+	list = list->next;
+	run->next = NULL;
+
+	for(level = 0; pending[level] != NULL; ++level)
+	{
+	    run = list_merge(priv, cmp, pending[level], run);
+	    pending[level] = NULL;
+	}
+	pending[level] = run;
+	if(level > max_level)
+	{
+	    max_level = level;
+	}
+    }
+
+    /* merge the remaining runs, smallest (newest) first */
+    run = NULL;
+    for(level = 0; level < max_level; ++level)
+    {
+	if(pending[level] != NULL)
+	{
+	    run = run == NULL ? pending[level]
+		: list_merge(priv, cmp, pending[level], run);
+	}
+    }
+
+    list_merge_final(priv, cmp, head, pending[max_level], run);
+}
@@ -0,0 +1,739 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/lz.h"
+#include "utk/io.h"
+#include "utk/crc.h"
+#include "utk/math.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UTK_LZ_HASH_LOG 12
+#define UTK_LZ_MIN_MATCH 4
+#define UTK_LZ_MAX_OFFSET 65535
+/* a match can't start in the last 12 bytes, last 5 bytes are literals */
+#define UTK_LZ_MF_LIMIT 12
+#define UTK_LZ_LAST_LITERALS 5
+
+#define UTK_LZ_FRAME_MAGIC "UTKZ"
+#define UTK_LZ_BLOCK_SIZE (64 * 1024)
+#define UTK_LZ_BLOCK_SIZE_MAX (4 * 1024 * 1024)
+#define UTK_LZ_BLOCK_STORED 0x80000000u
+
+static inline uint32_t lz_read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline unsigned int lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - UTK_LZ_HASH_LOG);
+}
+
+/*
+ * Count equal bytes of p and ref, without reading at or after limit
+ */
+static inline size_t lz_count(const unsigned char *p,
+			      const unsigned char *ref,
+			      const unsigned char *limit)
+{
+    const unsigned char *start = p;
+    uint64_t a,
+	b;
+
+    while(p + 8 <= limit)
+    {
+	memcpy(&a, p, 8);
+	memcpy(&b, ref, 8);
+	if(a != b)
+	{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	    return (size_t)(p - start) + (size_t)__builtin_ctzll(a ^ b) / 8;
+#else
+	    break;
+#endif
+	}
+	p += 8;
+	ref += 8;
+    }
+
+    while(p < limit && *p == *ref)
+    {
+	p++;
+	ref++;
+    }
+
+    return (size_t)(p - start);
+}
+
+static inline unsigned char *lz_put_length(unsigned char *op, size_t len)
+{
+    while(len >= 255)
+    {
+	*op++ = 255;
+	len -= 255;
+    }
+    *op++ = (unsigned char)len;
+
+    return op;
+}
+
+/*
+ * Emit a sequence, return NULL if dst is too small
+ */
+static unsigned char *lz_put_sequence(unsigned char *op,
+				      const unsigned char *oend,
+				      const unsigned char *literals,
+				      size_t lit_len,
+				      size_t offset, size_t match_len)
+{
+    unsigned char *token = NULL;
+
+    /* token + lengths + literals + offset */
+    if((size_t)(oend - op) < 1 + lit_len / 255 + 1 + lit_len + 2
+       + match_len / 255 + 1)
+    {
+	return NULL;
+    }
+
+    token = op++;
+
+    if(lit_len >= 15)
+    {
+	*token = 15 << 4;
+	op = lz_put_length(op, lit_len - 15);
+    }
+    else
+    {
+	*token = (unsigned char)(lit_len << 4);
+    }
+
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if(match_len == 0)
+    {
+	/* last sequence */
+	return op;
+    }
+
+    *op++ = (unsigned char)offset;
+    *op++ = (unsigned char)(offset >> 8);
+
+    match_len -= UTK_LZ_MIN_MATCH;
+    if(match_len >= 15)
+    {
+	*token |= 15;
+	op = lz_put_length(op, match_len - 15);
+    }
+    else
+    {
+	*token |= (unsigned char)match_len;
+    }
+
+    return op;
+}
+
+ssize_t utk_lz_compress(const void *src, size_t src_len,
+			void *dst, size_t dst_size)
+{
+    uint32_t table[1 << UTK_LZ_HASH_LOG];
+    const unsigned char *base = src,
+	*ip = src,
+	*anchor = src,
+	*iend = base + src_len,
+	*ref = NULL,
+	*mflimit = NULL,
+	*matchlimit = NULL;
+    unsigned char *op = dst,
+	*oend = op + dst_size;
+    unsigned int h;
+    size_t match_len;
+
+    /* positions are stored on 32 bits */
+    if(src_len > UINT32_MAX || src_len > SSIZE_MAX / 2)
+    {
+	errno = EFBIG;
+	return -1;
+    }
+
+    if(src_len > UTK_LZ_MF_LIMIT)
+    {
+	memset(table, 0, sizeof(table));
+
+	mflimit = iend - UTK_LZ_MF_LIMIT;
+	matchlimit = iend - UTK_LZ_LAST_LITERALS;
+
+	while(ip < mflimit)
+	{
+	    h = lz_hash(lz_read32(ip));
+	    ref = base + table[h];
+	    table[h] = (uint32_t)(ip - base);
+
+	    if(ref >= ip
+	       || ip - ref > UTK_LZ_MAX_OFFSET
+	       || lz_read32(ref) != lz_read32(ip))
+	    {
+		/* skip faster in incompressible data */
+		ip += 1 + ((size_t)(ip - anchor) >> 6);
+		continue;
+	    }
+
+	    match_len = UTK_LZ_MIN_MATCH
+		+ lz_count(ip + UTK_LZ_MIN_MATCH, ref + UTK_LZ_MIN_MATCH,
+			   matchlimit);
+
+	    /* extend backward */
+	    while(ip > anchor && ref > base && ip[-1] == ref[-1])
+	    {
+		ip--;
+		ref--;
+		match_len++;
+	    }
+
+	    op = lz_put_sequence(op, oend, anchor, (size_t)(ip - anchor),
+				 (size_t)(ip - ref), match_len);
+	    if(op == NULL)
+	    {
+		return -1;
+	    }
+
+	    ip += match_len;
+	    anchor = ip;
+
+	    if(ip < mflimit)
+	    {
+		table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+	    }
+	}
+    }
+
+    op = lz_put_sequence(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+    if(op == NULL)
+    {
+	return -1;
+    }
+
+    return (ssize_t)(op - (unsigned char *)dst);
+}
+
+/*
+ * Read a length extension, return 0 on overflow or truncated input
+ */
+static inline int lz_get_length(const unsigned char **ip,
+				const unsigned char *iend, size_t *len)
+{
+    unsigned char c;
+
+    do
+    {
+	if(*ip >= iend)
+	{
+	    return 0;
+	}
+	c = *(*ip)++;
+	if(*len > SIZE_MAX - 255)
+	{
+	    return 0;
+	}
+	*len += c;
+    }
+    while(c == 255);
+
+    return 1;
+}
+
+ssize_t utk_lz_decompress(const void *src, size_t src_len,
+			  void *dst, size_t dst_size)
+{
+    const unsigned char *ip = src,
+	*iend = ip + src_len,
+	*match = NULL;
+    unsigned char *ostart = dst,
+	*op = dst,
+	*oend = op + dst_size,
+	*end = NULL;
+    unsigned int token;
+    size_t lit_len,
+	match_len,
+	offset,
+	n;
+
+    if(dst_size > SSIZE_MAX)
+    {
+	dst_size = SSIZE_MAX;
+	oend = op + dst_size;
+    }
+
+    while(ip < iend)
+    {
+	token = *ip++;
+	lit_len = token >> 4;
+	match_len = token & 15;
+
+	/* shortcut for the common short sequence far from buffers end:
+	 * fixed size copies of 16 bytes of literals and 18 bytes of match */
+	if(lit_len < 15 && match_len < 15
+	   && iend - ip >= 16 + 2 && oend - op >= 16 + 18)
+	{
+	    memcpy(op, ip, 16);
+	    ip += lit_len;
+	    op += lit_len;
+
+	    offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+	    ip += 2;
+	    match_len += UTK_LZ_MIN_MATCH;
+
+	    if(offset >= 8 && offset <= (size_t)(op - ostart))
+	    {
+		match = op - offset;
+		memcpy(op, match, 8);
+		memcpy(op + 8, match + 8, 8);
+		memcpy(op + 16, match + 16, 2);
+		op += match_len;
+		continue;
+	    }
+
+	    goto copy_match;
+	}
+
+	if(lit_len == 15 && !lz_get_length(&ip, iend, &lit_len))
+	{
+	    goto ex_on_corrupted;
+	}
+
+	if(lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op))
+	{
+	    goto ex_on_corrupted;
+	}
+
+	if((size_t)(iend - ip) >= lit_len + 16
+	   && (size_t)(oend - op) >= lit_len + 16)
+	{
+	    /* copy by chunks of 16 bytes, extra bytes are overwritten
+	     * later */
+	    end = op + lit_len;
+	    do
+	    {
+		memcpy(op, ip, 16);
+		op += 16;
+		ip += 16;
+	    }
+	    while(op < end);
+	    ip -= op - end;
+	    op = end;
+	}
+	else
+	{
+	    memcpy(op, ip, lit_len);
+	    ip += lit_len;
+	    op += lit_len;
+	}
+
+	if(ip == iend)
+	{
+	    /* last sequence */
+	    break;
+	}
+
+	if(iend - ip < 2)
+	{
+	    goto ex_on_corrupted;
+	}
+	offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+	ip += 2;
+
+	if(match_len == 15 && !lz_get_length(&ip, iend, &match_len))
+	{
+	    goto ex_on_corrupted;
+	}
+	match_len += UTK_LZ_MIN_MATCH;
+
+    copy_match:
+	if(offset == 0 || offset > (size_t)(op - ostart)
+	   || match_len > (size_t)(oend - op))
+	{
+	    goto ex_on_corrupted;
+	}
+
+	match = op - offset;
+
+	/* copy by chunks of 16 or 8 bytes when they don't overlap: can
+	 * write up to 15 bytes after the match but never after oend */
+	if(offset >= 16 && (size_t)(oend - op) >= match_len + 16)
+	{
+	    end = op + match_len;
+	    do
+	    {
+		memcpy(op, match, 16);
+		op += 16;
+		match += 16;
+	    }
+	    while(op < end);
+	    op = end;
+	    continue;
+	}
+
+	if(offset >= 8 && (size_t)(oend - op) >= match_len + 8)
+	{
+	    end = op + match_len;
+	    do
+	    {
+		memcpy(op, match, 8);
+		op += 8;
+		match += 8;
+	    }
+	    while(op < end);
+	    op = end;
+	    continue;
+	}
+
+	/* overlapping copy: each memcpy doubles the copied period */
+	while(match_len != 0)
+	{
+	    n = utk_math_min(match_len, (size_t)(op - match));
+	    memcpy(op, match, n);
+	    op += n;
+	    match_len -= n;
+	}
+    }
+
+    return (ssize_t)(op - ostart);
+
+ex_on_corrupted:
+    errno = EBADMSG;
+
+    return -1;
+}
+
+static void lz_put_le32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t lz_get_le32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8
+	| (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int utk_lz_writer_init(struct utk_lz_writer *w, int fd, size_t block_size)
+{
+    unsigned char header[8];
+
+    if(block_size == 0)
+    {
+	block_size = UTK_LZ_BLOCK_SIZE;
+    }
+
+    if(block_size > UTK_LZ_BLOCK_SIZE_MAX)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    w->fd = fd;
+    w->block_size = block_size;
+    w->fill = 0;
+
+    /* room for the block header before compressed data */
+    w->buf = malloc(block_size);
+    w->cbuf = malloc(8 + utk_lz_compress_bound(block_size));
+    if(w->buf == NULL || w->cbuf == NULL)
+    {
+	goto ex_on_error;
+    }
+
+    memcpy(header, UTK_LZ_FRAME_MAGIC, 4);
+    lz_put_le32(header + 4, (uint32_t)block_size);
+    if(utk_io_write(fd, header, sizeof(header)) < 0)
+    {
+	goto ex_on_error;
+    }
+
+    return 0;
+
+ex_on_error:
+    free(w->buf);
+    free(w->cbuf);
+
+    return -1;
+}
+
+static int lz_writer_flush(struct utk_lz_writer *w)
+{
+    ssize_t clen;
+    uint32_t size;
+
+    if(w->fill == 0)
+    {
+	return 0;
+    }
+
+    clen = utk_lz_compress(w->buf, w->fill, w->cbuf + 8, w->block_size);
+    if(clen < 0)
+    {
+	/* incompressible: store it */
+	memcpy(w->cbuf + 8, w->buf, w->fill);
+	size = (uint32_t)w->fill | UTK_LZ_BLOCK_STORED;
+	clen = (ssize_t)w->fill;
+    }
+    else
+    {
+	size = (uint32_t)clen;
+    }
+
+    lz_put_le32(w->cbuf, size);
+    lz_put_le32(w->cbuf + 4, utk_crc32c(0, w->buf, w->fill));
+
+    if(utk_io_write(w->fd, w->cbuf, (size_t)clen + 8) < 0)
+    {
+	return -1;
+    }
+
+    w->fill = 0;
+
+    return 0;
+}
+
+ssize_t utk_lz_writer_write(struct utk_lz_writer *w,
+			    const void *buf, size_t len)
+{
+    size_t n;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	n = utk_math_min(len, w->block_size - w->fill);
+	memcpy(w->buf + w->fill, buf, n);
+	w->fill += n;
+	buf = ((const char *)buf) + n;
+	len -= n;
+	total += (ssize_t)n;
+
+	if(w->fill == w->block_size && lz_writer_flush(w) != 0)
+	{
+	    return -1;
+	}
+    }
+
+    return total;
+}
+
+int utk_lz_writer_finish(struct utk_lz_writer *w)
+{
+    unsigned char end[4];
+    int ret;
+
+    ret = lz_writer_flush(w);
+    if(ret == 0)
+    {
+	lz_put_le32(end, 0);
+	if(utk_io_write(w->fd, end, sizeof(end)) < 0)
+	{
+	    ret = -1;
+	}
+    }
+
+    free(w->buf);
+    free(w->cbuf);
+    w->buf = NULL;
+    w->cbuf = NULL;
+
+    return ret;
+}
+
+int utk_lz_reader_init(struct utk_lz_reader *r, int fd)
+{
+    unsigned char header[8];
+    ssize_t cc;
+
+    cc = utk_io_read(fd, header, sizeof(header));
+    if(cc < 0)
+    {
+	return -1;
+    }
+
+    if(cc != sizeof(header) || memcmp(header, UTK_LZ_FRAME_MAGIC, 4) != 0)
+    {
+	errno = EBADMSG;
+	return -1;
+    }
+
+    r->block_size = lz_get_le32(header + 4);
+    if(r->block_size == 0 || r->block_size > UTK_LZ_BLOCK_SIZE_MAX)
+    {
+	errno = EBADMSG;
+	return -1;
+    }
+
+    r->fd = fd;
+    r->len = 0;
+    r->pos = 0;
+    r->eof = 0;
+
+    r->buf = malloc(r->block_size);
+    r->cbuf = malloc(utk_lz_compress_bound(r->block_size));
+    if(r->buf == NULL || r->cbuf == NULL)
+    {
+	free(r->buf);
+	free(r->cbuf);
+	return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Read and decompress next block, set eof at end of frame
+ */
+static int lz_reader_fill(struct utk_lz_reader *r)
+{
+    unsigned char header[8];
+    uint32_t size;
+    size_t clen;
+    ssize_t cc;
+
+    cc = utk_io_read(r->fd, header, 4);
+    if(cc < 0)
+    {
+	return -1;
+    }
+    if(cc != 4)
+    {
+	goto ex_on_corrupted;
+    }
+
+    size = lz_get_le32(header);
+    if(size == 0)
+    {
+	r->eof = 1;
+	return 0;
+    }
+
+    clen = size & ~UTK_LZ_BLOCK_STORED;
+    if(((size & UTK_LZ_BLOCK_STORED) && clen > r->block_size)
+       || clen > utk_lz_compress_bound(r->block_size))
+    {
+	goto ex_on_corrupted;
+    }
+
+    cc = utk_io_read(r->fd, header + 4, 4);
+    if(cc < 0)
+    {
+	return -1;
+    }
+    if(cc != 4)
+    {
+	goto ex_on_corrupted;
+    }
+
+    cc = utk_io_read(r->fd, r->cbuf, clen);
+    if(cc < 0)
+    {
+	return -1;
+    }
+    if((size_t)cc != clen)
+    {
+	goto ex_on_corrupted;
+    }
+
+    if(size & UTK_LZ_BLOCK_STORED)
+    {
+	memcpy(r->buf, r->cbuf, clen);
+	cc = (ssize_t)clen;
+    }
+    else
+    {
+	cc = utk_lz_decompress(r->cbuf, clen, r->buf, r->block_size);
+	if(cc < 0)
+	{
+	    goto ex_on_corrupted;
+	}
+    }
+
+    if(utk_crc32c(0, r->buf, (size_t)cc) != lz_get_le32(header + 4))
+    {
+	goto ex_on_corrupted;
+    }
+
+    r->len = (size_t)cc;
+    r->pos = 0;
+
+    return 0;
+
+ex_on_corrupted:
+    errno = EBADMSG;
+
+    return -1;
+}
+
+ssize_t utk_lz_reader_read(struct utk_lz_reader *r, void *dst, size_t len)
+{
+    size_t n;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	if(r->pos == r->len)
+	{
+	    if(r->eof)
+	    {
+		break;
+	    }
+
+	    if(lz_reader_fill(r) != 0)
+	    {
+		return -1;
+	    }
+	    continue;
+	}
+
+	n = utk_math_min(len, r->len - r->pos);
+	memcpy(dst, r->buf + r->pos, n);
+	r->pos += n;
+	dst = ((char *)dst) + n;
+	len -= n;
+	total += (ssize_t)n;
+    }
+
+    return total;
+}
+
+void utk_lz_reader_cleanup(struct utk_lz_reader *r)
+{
+    free(r->buf);
+    free(r->cbuf);
+    r->buf = NULL;
+    r->cbuf = NULL;
+}
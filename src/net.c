@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/net.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+static int net_batch_alloc(struct utk_net_batch *batch, unsigned int max_msgs,
+			   unsigned int max_iov)
+{
+    memset(batch, 0, sizeof(*batch));
+
+    batch->msgs = calloc(max_msgs, sizeof(*batch->msgs));
+    batch->iov = calloc(max_iov, sizeof(*batch->iov));
+    batch->addrs = calloc(max_msgs, sizeof(*batch->addrs));
+    if(batch->msgs == NULL || batch->iov == NULL || batch->addrs == NULL)
+    {
+	utk_net_batch_cleanup(batch);
+	return -1;
+    }
+
+    batch->max_msgs = max_msgs;
+    batch->max_iov = max_iov;
+
+    return 0;
+}
+
+int utk_net_batch_init(struct utk_net_batch *batch, unsigned int max_msgs,
+		       unsigned int max_iov)
+{
+    return net_batch_alloc(batch, max_msgs, max_iov);
+}
+
+int utk_net_batch_init_recv(struct utk_net_batch *batch,
+			    unsigned int max_msgs, size_t msg_size)
+{
+    struct msghdr *hdr = NULL;
+    unsigned int i;
+
+    if(msg_size != 0 && max_msgs > SIZE_MAX / msg_size)
+    {
+	errno = ENOMEM;
+	return -1;
+    }
+
+    if(net_batch_alloc(batch, max_msgs, max_msgs) != 0)
+    {
+	return -1;
+    }
+
+    batch->buf = malloc(max_msgs * msg_size);
+    if(batch->buf == NULL)
+    {
+	utk_net_batch_cleanup(batch);
+	return -1;
+    }
+    batch->msg_size = msg_size;
+
+    for(i = 0; i < max_msgs; ++i)
+    {
+	batch->iov[i].iov_base = batch->buf + i * msg_size;
+	batch->iov[i].iov_len = msg_size;
+
+	hdr = &batch->msgs[i].msg_hdr;
+	hdr->msg_iov = &batch->iov[i];
+	hdr->msg_iovlen = 1;
+	hdr->msg_name = &batch->addrs[i];
+    }
+
+    return 0;
+}
+
+void utk_net_batch_cleanup(struct utk_net_batch *batch)
+{
+    free(batch->msgs);
+    free(batch->iov);
+    free(batch->addrs);
+    free(batch->buf);
+    batch->msgs = NULL;
+    batch->iov = NULL;
+    batch->addrs = NULL;
+    batch->buf = NULL;
+}
+
+void utk_net_batch_reset(struct utk_net_batch *batch)
+{
+    batch->nb_msgs = 0;
+    batch->nb_iov = 0;
+}
+
+int utk_net_batch_begin(struct utk_net_batch *batch,
+			const struct sockaddr *addr, socklen_t addrlen)
+{
+    struct msghdr *hdr = NULL;
+
+    if(batch->nb_msgs == batch->max_msgs
+       || addrlen > sizeof(batch->addrs[0]))
+    {
+	errno = (addrlen > sizeof(batch->addrs[0]) ? EINVAL : ENOBUFS);
+	return -1;
+    }
+
+    hdr = &batch->msgs[batch->nb_msgs].msg_hdr;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->msg_iov = &batch->iov[batch->nb_iov];
+    if(addr != NULL)
+    {
+	memcpy(&batch->addrs[batch->nb_msgs], addr, addrlen);
+	hdr->msg_name = &batch->addrs[batch->nb_msgs];
+	hdr->msg_namelen = addrlen;
+    }
+
+    batch->nb_msgs++;
+
+    return 0;
+}
+
+int utk_net_batch_append(struct utk_net_batch *batch, const void *buf,
+			 size_t len)
+{
+    struct msghdr *hdr = NULL;
+
+    if(batch->nb_msgs == 0 || batch->nb_iov == batch->max_iov)
+    {
+	errno = (batch->nb_msgs == 0 ? EINVAL : ENOBUFS);
+	return -1;
+    }
+
+    batch->iov[batch->nb_iov].iov_base = (void *)buf;
+    batch->iov[batch->nb_iov].iov_len = len;
+    batch->nb_iov++;
+
+    hdr = &batch->msgs[batch->nb_msgs - 1].msg_hdr;
+    hdr->msg_iovlen++;
+
+    return 0;
+}
+
+int utk_net_batch_add(struct utk_net_batch *batch, const void *buf,
+		      size_t len)
+{
+    if(batch->nb_iov == batch->max_iov)
+    {
+	errno = ENOBUFS;
+	return -1;
+    }
+
+    if(utk_net_batch_begin(batch, NULL, 0) != 0)
+    {
+	return -1;
+    }
+
+    return utk_net_batch_append(batch, buf, len);
+}
+
+const void *utk_net_batch_msg(const struct utk_net_batch *batch,
+			      unsigned int index, size_t *len)
+{
+    const struct mmsghdr *msg = &batch->msgs[index];
+
+    *len = msg->msg_len;
+    if(*len > batch->msg_size)
+    {
+	/* truncated */
+	*len = batch->msg_size;
+    }
+
+    return msg->msg_hdr.msg_iov[0].iov_base;
+}
+
+int utk_net_send_batch(int fd, struct utk_net_batch *batch, int flags)
+{
+    unsigned int sent;
+    int cc;
+
+    sent = 0;
+    while(sent < batch->nb_msgs)
+    {
+	do
+	{
+	    cc = sendmmsg(fd, batch->msgs + sent, batch->nb_msgs - sent,
+			  flags | MSG_NOSIGNAL);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return (sent != 0 ? (int)sent : cc);
+	}
+
+	sent += (unsigned int)cc;
+    }
+
+    return (int)sent;
+}
+
+int utk_net_recv_batch(int fd, struct utk_net_batch *batch, int flags)
+{
+    unsigned int i;
+    int cc;
+
+    /* overwritten by the kernel */
+    for(i = 0; i < batch->max_msgs; ++i)
+    {
+	batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    }
+
+    do
+    {
+	cc = recvmmsg(fd, batch->msgs, batch->max_msgs,
+		      flags | MSG_WAITFORONE, NULL);
+    }
+    while(cc < 0 && errno == EINTR);
+
+    batch->nb_msgs = (cc > 0 ? (unsigned int)cc : 0);
+
+    return cc;
+}
+
+ssize_t utk_net_send_all(int fd, const void *buf, size_t len)
+{
+    ssize_t cc;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	do
+	{
+	    cc = send(fd, buf, len, MSG_NOSIGNAL);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return cc;
+	}
+
+	total += cc;
+	buf = ((const char *)buf) + cc;
+	len -= (size_t)cc;
+    }
+
+    return total;
+}
+
+ssize_t utk_net_sendv_all(int fd, struct iovec *iov, int iovcnt)
+{
+    struct msghdr hdr;
+    ssize_t cc;
+    ssize_t total;
+    size_t n;
+
+    total = 0;
+    while(iovcnt > 0)
+    {
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = (size_t)iovcnt;
+
+	do
+	{
+	    cc = sendmsg(fd, &hdr, MSG_NOSIGNAL);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return cc;
+	}
+
+	total += cc;
+
+	/* skip what was sent */
+	n = (size_t)cc;
+	while(iovcnt > 0 && n >= iov->iov_len)
+	{
+	    n -= iov->iov_len;
+	    iov++;
+	    iovcnt--;
+	}
+	if(iovcnt > 0)
+	{
+	    iov->iov_base = (char *)iov->iov_base + n;
+	    iov->iov_len -= n;
+	}
+    }
+
+    return total;
+}
+
+ssize_t utk_net_recv_all(int fd, void *dst, size_t len)
+{
+    ssize_t cc;
+    ssize_t total;
+
+    total = 0;
+    while(len != 0)
+    {
+	do
+	{
+	    cc = recv(fd, dst, len, 0);
+	}
+	while(cc < 0 && errno == EINTR);
+
+	if(cc < 0)
+	{
+	    return cc;
+	}
+
+	if(cc == 0)
+	{
+	    break;
+	}
+
+	dst = ((char *)dst) + cc;
+	total += cc;
+	len -= (size_t)cc;
+    }
+
+    return total;
+}
+
+int utk_net_set_busy_poll(int fd, int usec)
+{
+    return setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec));
+}
+
+int utk_net_set_gro(int fd, int enable)
+{
+    return setsockopt(fd, IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable));
+}
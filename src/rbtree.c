@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/rbtree.h"
+
+#define UTK_RBTREE_RED 0
+#define UTK_RBTREE_BLACK 1
+
+static inline int rbtree_is_black(const struct utk_rbtree_node *node)
+{
+    /* NULL leaves are black */
+    return node == NULL || node->color == UTK_RBTREE_BLACK;
+}
+
+/*
+ * Replace the child old of parent (the root if parent is NULL) by new
+ */
+static inline void rbtree_set_child(struct utk_rbtree *tree,
+				    struct utk_rbtree_node *parent,
+				    struct utk_rbtree_node *old,
+				    struct utk_rbtree_node *new)
+{
+    if(parent == NULL)
+    {
+	tree->root = new;
+    }
+    else if(parent->left == old)
+    {
+	parent->left = new;
+    }
+    else
+    {
+	parent->right = new;
+    }
+}
+
+static void rbtree_rotate_left(struct utk_rbtree *tree,
+			       struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *right = node->right;
+
+    node->right = right->left;
+    if(right->left != NULL)
+    {
+	right->left->parent = node;
+    }
+    right->parent = node->parent;
+    rbtree_set_child(tree, node->parent, node, right);
+    right->left = node;
+    node->parent = right;
+}
+
+static void rbtree_rotate_right(struct utk_rbtree *tree,
+				struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *left = node->left;
+
+    node->left = left->right;
+    if(left->right != NULL)
+    {
+	left->right->parent = node;
+    }
+    left->parent = node->parent;
+    rbtree_set_child(tree, node->parent, node, left);
+    left->right = node;
+    node->parent = left;
+}
+
+static void rbtree_insert_fixup(struct utk_rbtree *tree,
+				struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *parent = NULL;
+    struct utk_rbtree_node *gparent = NULL;
+    struct utk_rbtree_node *uncle = NULL;
+
+    while((parent = node->parent) != NULL
+	  && parent->color == UTK_RBTREE_RED)
+    {
+	/* a red node isn't the root: gparent exists */
+	gparent = parent->parent;
+
+	if(parent == gparent->left)
+	{
+	    uncle = gparent->right;
+	    if(!rbtree_is_black(uncle))
+	    {
+		parent->color = UTK_RBTREE_BLACK;
+		uncle->color = UTK_RBTREE_BLACK;
+		gparent->color = UTK_RBTREE_RED;
+		node = gparent;
+		continue;
+	    }
+
+	    if(node == parent->right)
+	    {
+		rbtree_rotate_left(tree, parent);
+		node = parent;
+		parent = node->parent;
+	    }
+	    parent->color = UTK_RBTREE_BLACK;
+	    gparent->color = UTK_RBTREE_RED;
+	    rbtree_rotate_right(tree, gparent);
+	}
+	else
+	{
+	    uncle = gparent->left;
+	    if(!rbtree_is_black(uncle))
+	    {
+		parent->color = UTK_RBTREE_BLACK;
+		uncle->color = UTK_RBTREE_BLACK;
+		gparent->color = UTK_RBTREE_RED;
+		node = gparent;
+		continue;
+	    }
+
+	    if(node == parent->left)
+	    {
+		rbtree_rotate_right(tree, parent);
+		node = parent;
+		parent = node->parent;
+	    }
+	    parent->color = UTK_RBTREE_BLACK;
+	    gparent->color = UTK_RBTREE_RED;
+	    rbtree_rotate_left(tree, gparent);
+	}
+    }
+
+    tree->root->color = UTK_RBTREE_BLACK;
+}
+
+static void rbtree_link(struct utk_rbtree *tree, struct utk_rbtree_node *node,
+			struct utk_rbtree_node *parent,
+			struct utk_rbtree_node **link, int leftmost)
+{
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->color = UTK_RBTREE_RED;
+    *link = node;
+
+    if(leftmost)
+    {
+	tree->leftmost = node;
+    }
+    tree->count++;
+
+    rbtree_insert_fixup(tree, node);
+}
+
+void utk_rbtree_insert(struct utk_rbtree *tree, struct utk_rbtree_node *node,
+		       utk_rbtree_cmp_cb_t cmp)
+{
+    struct utk_rbtree_node **link = &tree->root;
+    struct utk_rbtree_node *parent = NULL;
+    int leftmost = 1;
+
+    while(*link != NULL)
+    {
+	parent = *link;
+	if(cmp(node, parent) < 0)
+	{
+	    link = &parent->left;
+	}
+	else
+	{
+	    link = &parent->right;
+	    leftmost = 0;
+	}
+    }
+
+    rbtree_link(tree, node, parent, link, leftmost);
+}
+
+struct utk_rbtree_node *utk_rbtree_insert_unique(struct utk_rbtree *tree,
+						 struct utk_rbtree_node *node,
+						 utk_rbtree_cmp_cb_t cmp)
+{
+    struct utk_rbtree_node **link = &tree->root;
+    struct utk_rbtree_node *parent = NULL;
+    int leftmost = 1;
+    int ret;
+
+    while(*link != NULL)
+    {
+	parent = *link;
+	ret = cmp(node, parent);
+	if(ret < 0)
+	{
+	    link = &parent->left;
+	}
+	else if(ret > 0)
+	{
+	    link = &parent->right;
+	    leftmost = 0;
+	}
+	else
+	{
+	    return parent;
+	}
+    }
+
+    rbtree_link(tree, node, parent, link, leftmost);
+
+    return NULL;
+}
+
+/*
+ * Restore the black height after a black node was removed above node
+ * (which may be a NULL leaf, hence parent)
+ */
+static void rbtree_erase_fixup(struct utk_rbtree *tree,
+			       struct utk_rbtree_node *node,
+			       struct utk_rbtree_node *parent)
+{
+    struct utk_rbtree_node *sibling = NULL;
+
+    while(node != tree->root && rbtree_is_black(node))
+    {
+	/* the sibling has a black height >= 1: it exists */
+	if(node == parent->left)
+	{
+	    sibling = parent->right;
+	    if(!rbtree_is_black(sibling))
+	    {
+		sibling->color = UTK_RBTREE_BLACK;
+		parent->color = UTK_RBTREE_RED;
+		rbtree_rotate_left(tree, parent);
+		sibling = parent->right;
+	    }
+
+	    if(rbtree_is_black(sibling->left)
+	       && rbtree_is_black(sibling->right))
+	    {
+		sibling->color = UTK_RBTREE_RED;
+		node = parent;
+		parent = node->parent;
+		continue;
+	    }
+
+	    if(rbtree_is_black(sibling->right))
+	    {
+		sibling->left->color = UTK_RBTREE_BLACK;
+		sibling->color = UTK_RBTREE_RED;
+		rbtree_rotate_right(tree, sibling);
+		sibling = parent->right;
+	    }
+	    sibling->color = parent->color;
+	    parent->color = UTK_RBTREE_BLACK;
+	    sibling->right->color = UTK_RBTREE_BLACK;
+	    rbtree_rotate_left(tree, parent);
+	}
+	else
+	{
+	    sibling = parent->left;
+	    if(!rbtree_is_black(sibling))
+	    {
+		sibling->color = UTK_RBTREE_BLACK;
+		parent->color = UTK_RBTREE_RED;
+		rbtree_rotate_right(tree, parent);
+		sibling = parent->left;
+	    }
+
+	    if(rbtree_is_black(sibling->left)
+	       && rbtree_is_black(sibling->right))
+	    {
+		sibling->color = UTK_RBTREE_RED;
+		node = parent;
+		parent = node->parent;
+		continue;
+	    }
+
+	    if(rbtree_is_black(sibling->left))
+	    {
+		sibling->right->color = UTK_RBTREE_BLACK;
+		sibling->color = UTK_RBTREE_RED;
+		rbtree_rotate_left(tree, sibling);
+		sibling = parent->left;
+	    }
+	    sibling->color = parent->color;
+	    parent->color = UTK_RBTREE_BLACK;
+	    sibling->left->color = UTK_RBTREE_BLACK;
+	    rbtree_rotate_right(tree, parent);
+	}
+
+	node = tree->root;
+	break;
+    }
+
+    if(node != NULL)
+    {
+	node->color = UTK_RBTREE_BLACK;
+    }
+}
+
+void utk_rbtree_erase(struct utk_rbtree *tree, struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *spliced = node;
+    struct utk_rbtree_node *child = NULL;
+    struct utk_rbtree_node *parent = NULL;
+    int color;
+
+    if(tree->leftmost == node)
+    {
+	tree->leftmost = utk_rbtree_next(node);
+    }
+
+    /* the node spliced out has at most one child */
+    if(node->left != NULL && node->right != NULL)
+    {
+	spliced = node->right;
+	while(spliced->left != NULL)
+	{
+	    spliced = spliced->left;
+	}
+    }
+
+    child = spliced->left != NULL ? spliced->left : spliced->right;
+    parent = spliced->parent;
+    color = spliced->color;
+
+    if(child != NULL)
+    {
+	child->parent = parent;
+    }
+    rbtree_set_child(tree, parent, spliced, child);
+
+    /* the successor takes the place of node */
+    if(spliced != node)
+    {
+	if(parent == node)
+	{
+	    parent = spliced;
+	}
+
+	spliced->left = node->left;
+	spliced->right = node->right;
+	spliced->parent = node->parent;
+	spliced->color = node->color;
+	if(spliced->left != NULL)
+	{
+	    spliced->left->parent = spliced;
+	}
+	if(spliced->right != NULL)
+	{
+	    spliced->right->parent = spliced;
+	}
+	rbtree_set_child(tree, node->parent, node, spliced);
+    }
+
+    if(color == UTK_RBTREE_BLACK)
+    {
+	rbtree_erase_fixup(tree, child, parent);
+    }
+
+    tree->count--;
+    utk_rbtree_node_init(node);
+}
+
+struct utk_rbtree_node *utk_rbtree_lower_bound(const struct utk_rbtree *tree,
+					       const void *key,
+					       utk_rbtree_key_cb_t cmp)
+{
+    struct utk_rbtree_node *node = tree->root;
+    struct utk_rbtree_node *bound = NULL;
+
+    while(node != NULL)
+    {
+	if(cmp(node, key) >= 0)
+	{
+	    bound = node;
+	    node = node->left;
+	}
+	else
+	{
+	    node = node->right;
+	}
+    }
+
+    return bound;
+}
+
+struct utk_rbtree_node *utk_rbtree_upper_bound(const struct utk_rbtree *tree,
+					       const void *key,
+					       utk_rbtree_key_cb_t cmp)
+{
+    struct utk_rbtree_node *node = tree->root;
+    struct utk_rbtree_node *bound = NULL;
+
+    while(node != NULL)
+    {
+	if(cmp(node, key) > 0)
+	{
+	    bound = node;
+	    node = node->left;
+	}
+	else
+	{
+	    node = node->right;
+	}
+    }
+
+    return bound;
+}
+
+struct utk_rbtree_node *utk_rbtree_find(const struct utk_rbtree *tree,
+					const void *key,
+					utk_rbtree_key_cb_t cmp)
+{
+    struct utk_rbtree_node *node = utk_rbtree_lower_bound(tree, key, cmp);
+
+    if(node != NULL && cmp(node, key) == 0)
+    {
+	return node;
+    }
+
+    return NULL;
+}
+
+struct utk_rbtree_node *utk_rbtree_last(const struct utk_rbtree *tree)
+{
+    struct utk_rbtree_node *node = tree->root;
+
+    if(node == NULL)
+    {
+	return NULL;
+    }
+
+    while(node->right != NULL)
+    {
+	node = node->right;
+    }
+
+    return node;
+}
+
+struct utk_rbtree_node *utk_rbtree_next(const struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *parent = NULL;
+
+    if(node->right != NULL)
+    {
+	node = node->right;
+	while(node->left != NULL)
+	{
+	    node = node->left;
+	}
+	return (struct utk_rbtree_node *)node;
+    }
+
+    while((parent = node->parent) != NULL && node == parent->right)
+    {
+	node = parent;
+    }
+
+    return parent;
+}
+
+struct utk_rbtree_node *utk_rbtree_prev(const struct utk_rbtree_node *node)
+{
+    struct utk_rbtree_node *parent = NULL;
+
+    if(node->left != NULL)
+    {
+	node = node->left;
+	while(node->right != NULL)
+	{
+	    node = node->right;
+	}
+	return (struct utk_rbtree_node *)node;
+    }
+
+    while((parent = node->parent) != NULL && node == parent->left)
+    {
+	node = parent;
+    }
+
+    return parent;
+}
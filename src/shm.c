@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "utk/shm.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+
+#define UTK_SHM_RING_MAGIC 0x75746b72u
+#define UTK_SHM_RING_VERSION 1
+#define UTK_SHM_CACHELINE 64
+/* data start on their own page */
+#define UTK_SHM_RING_DATA_OFFSET 4096
+#define UTK_SHM_RING_MIN_SIZE 4096
+/* times the other side is given a chance to run before sleeping */
+#define UTK_SHM_RING_SPIN 16
+
+/*
+ * Records are aligned on 8 bytes and start with a 64 bits header:
+ * length in low 32 bits, flags in high 32 bits. A zero header means the
+ * record isn't committed yet: the consumer zeroes consumed records.
+ */
+#define UTK_SHM_REC_HEADER 8
+#define UTK_SHM_REC_COMMIT ((uint64_t)1 << 32)
+#define UTK_SHM_REC_PAD ((uint64_t)2 << 32)
+
+struct utk_shm_ring_shared {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+
+    /* producers reserve space at head */
+    uint64_t head __attribute__((aligned(UTK_SHM_CACHELINE)));
+
+    /* consumer releases space at tail */
+    uint64_t tail __attribute__((aligned(UTK_SHM_CACHELINE)));
+
+    uint32_t consumer_futex __attribute__((aligned(UTK_SHM_CACHELINE)));
+    uint32_t consumer_waiting;
+
+    uint32_t producer_futex __attribute__((aligned(UTK_SHM_CACHELINE)));
+    uint32_t producer_waiting;
+};
+
+static long shm_futex(uint32_t *uaddr, int op, uint32_t val,
+		      const struct timespec *timeout)
+{
+    /* not private: the word is shared between processes */
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+static void shm_deadline(struct timespec *deadline, int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if(deadline->tv_nsec >= 1000000000)
+    {
+	deadline->tv_sec++;
+	deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/*
+ * Sleep on a futex word until woken up or deadline (NULL for no deadline)
+ * is reached, return -1 with ETIMEDOUT when deadline is reached
+ */
+static int shm_wait(uint32_t *futex, uint32_t seq,
+		    const struct timespec *deadline)
+{
+    struct timespec now,
+	rel;
+
+    if(deadline == NULL)
+    {
+	shm_futex(futex, FUTEX_WAIT, seq, NULL);
+	return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    rel.tv_sec = deadline->tv_sec - now.tv_sec;
+    rel.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if(rel.tv_nsec < 0)
+    {
+	rel.tv_sec--;
+	rel.tv_nsec += 1000000000;
+    }
+    if(rel.tv_sec < 0)
+    {
+	errno = ETIMEDOUT;
+	return -1;
+    }
+
+    shm_futex(futex, FUTEX_WAIT, seq, &rel);
+
+    return 0;
+}
+
+static void shm_wake(uint32_t *futex, uint32_t *waiting)
+{
+    /* pairs with the fence of the waiter between setting waiting and
+     * checking the ring again */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(waiting, __ATOMIC_RELAXED) != 0)
+    {
+	__atomic_fetch_add(futex, 1, __ATOMIC_RELEASE);
+	shm_futex(futex, FUTEX_WAKE, INT_MAX, NULL);
+    }
+}
+
+static int shm_map(struct utk_shm_ring *ring, int fd, size_t map_size)
+{
+    void *map = NULL;
+
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+	return -1;
+    }
+
+    ring->shared = map;
+    ring->data = (unsigned char *)map + UTK_SHM_RING_DATA_OFFSET;
+    ring->map_size = map_size;
+    ring->peek_span = 0;
+    ring->fd = fd;
+
+    return 0;
+}
+
+int utk_shm_ring_create(struct utk_shm_ring *ring, const char *name,
+			size_t size)
+{
+    size_t capacity;
+    int fd;
+
+    capacity = UTK_SHM_RING_MIN_SIZE;
+    while(capacity < size)
+    {
+	if(capacity > (SIZE_MAX >> 2))
+	{
+	    errno = EINVAL;
+	    return -1;
+	}
+	capacity <<= 1;
+    }
+
+    if(name == NULL)
+    {
+	fd = memfd_create("utk_shm_ring", MFD_CLOEXEC);
+    }
+    else
+    {
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC,
+		      S_IRUSR | S_IWUSR);
+    }
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    /* new pages are zeroed: no record is committed */
+    if(ftruncate(fd, (off_t)(UTK_SHM_RING_DATA_OFFSET + capacity)) != 0
+       || shm_map(ring, fd, UTK_SHM_RING_DATA_OFFSET + capacity) != 0)
+    {
+	goto ex_on_error;
+    }
+
+    ring->size = capacity;
+    ring->shared->size = capacity;
+    ring->shared->version = UTK_SHM_RING_VERSION;
+    __atomic_store_n(&ring->shared->magic, UTK_SHM_RING_MAGIC,
+		     __ATOMIC_RELEASE);
+
+    return 0;
+
+ex_on_error:
+    close(fd);
+    if(name != NULL)
+    {
+	shm_unlink(name);
+    }
+
+    return -1;
+}
+
+static int shm_ring_attach(struct utk_shm_ring *ring, int fd)
+{
+    struct stat st;
+
+    if(fstat(fd, &st) != 0)
+    {
+	return -1;
+    }
+
+    if((size_t)st.st_size <= UTK_SHM_RING_DATA_OFFSET
+       || shm_map(ring, fd, (size_t)st.st_size) != 0)
+    {
+	errno = (errno == 0 ? EINVAL : errno);
+	return -1;
+    }
+
+    ring->size = (size_t)ring->shared->size;
+    if(__atomic_load_n(&ring->shared->magic, __ATOMIC_ACQUIRE)
+       != UTK_SHM_RING_MAGIC
+       || ring->shared->version != UTK_SHM_RING_VERSION
+       || ring->size + UTK_SHM_RING_DATA_OFFSET != ring->map_size)
+    {
+	munmap(ring->shared, ring->map_size);
+	errno = EINVAL;
+	return -1;
+    }
+
+    return 0;
+}
+
+int utk_shm_ring_open(struct utk_shm_ring *ring, const char *name)
+{
+    int fd;
+
+    fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    if(shm_ring_attach(ring, fd) != 0)
+    {
+	close(fd);
+	return -1;
+    }
+
+    return 0;
+}
+
+int utk_shm_ring_open_fd(struct utk_shm_ring *ring, int fd)
+{
+    fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if(fd < 0)
+    {
+	return -1;
+    }
+
+    if(shm_ring_attach(ring, fd) != 0)
+    {
+	close(fd);
+	return -1;
+    }
+
+    return 0;
+}
+
+void utk_shm_ring_close(struct utk_shm_ring *ring)
+{
+    munmap(ring->shared, ring->map_size);
+    close(ring->fd);
+    ring->shared = NULL;
+    ring->data = NULL;
+    ring->fd = -1;
+}
+
+int utk_shm_ring_unlink(const char *name)
+{
+    return shm_unlink(name);
+}
+
+size_t utk_shm_ring_max_record(const struct utk_shm_ring *ring)
+{
+    /* a record with its padding must fit in an empty ring */
+    return ring->size / 2 - UTK_SHM_REC_HEADER;
+}
+
+int utk_shm_ring_push(struct utk_shm_ring *ring, const void *data, size_t len,
+		      int timeout_ms)
+{
+    struct utk_shm_ring_shared *shared = ring->shared;
+    struct timespec deadline;
+    uint64_t head,
+	tail,
+	need,
+	pad,
+	pos,
+	mask;
+    uint32_t seq;
+    unsigned int spin = 0;
+
+    if(len > utk_shm_ring_max_record(ring))
+    {
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    if(timeout_ms > 0)
+    {
+	shm_deadline(&deadline, timeout_ms);
+    }
+
+    mask = ring->size - 1;
+    need = (UTK_SHM_REC_HEADER + len + 7) & ~(uint64_t)7;
+
+    head = __atomic_load_n(&shared->head, __ATOMIC_RELAXED);
+    for(;;)
+    {
+	/* a record never wraps: pad the end of the ring */
+	pos = head & mask;
+	pad = (need > ring->size - pos ? ring->size - pos : 0);
+
+	tail = __atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE);
+	if(head + pad + need - tail <= ring->size)
+	{
+	    if(__atomic_compare_exchange_n(&shared->head, &head,
+					   head + pad + need, 1,
+					   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    {
+		break;
+	    }
+	    continue;
+	}
+
+	/* full */
+	if(timeout_ms == 0)
+	{
+	    errno = EAGAIN;
+	    return -1;
+	}
+
+	if(spin++ < UTK_SHM_RING_SPIN)
+	{
+	    sched_yield();
+	    head = __atomic_load_n(&shared->head, __ATOMIC_RELAXED);
+	    continue;
+	}
+
+	seq = __atomic_load_n(&shared->producer_futex, __ATOMIC_ACQUIRE);
+	__atomic_fetch_add(&shared->producer_waiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE) == tail
+	   && shm_wait(&shared->producer_futex, seq,
+		       timeout_ms > 0 ? &deadline : NULL) != 0)
+	{
+	    __atomic_fetch_sub(&shared->producer_waiting, 1, __ATOMIC_RELAXED);
+	    return -1;
+	}
+	__atomic_fetch_sub(&shared->producer_waiting, 1, __ATOMIC_RELAXED);
+
+	head = __atomic_load_n(&shared->head, __ATOMIC_RELAXED);
+    }
+
+    if(pad != 0)
+    {
+	__atomic_store_n((uint64_t *)(ring->data + pos),
+			 UTK_SHM_REC_COMMIT | UTK_SHM_REC_PAD | pad,
+			 __ATOMIC_RELEASE);
+	pos = 0;
+    }
+
+    memcpy(ring->data + pos + UTK_SHM_REC_HEADER, data, len);
+    __atomic_store_n((uint64_t *)(ring->data + pos),
+		     UTK_SHM_REC_COMMIT | (uint64_t)len, __ATOMIC_RELEASE);
+
+    shm_wake(&shared->consumer_futex, &shared->consumer_waiting);
+
+    return 0;
+}
+
+/*
+ * Release span bytes at tail
+ */
+static void shm_ring_release(struct utk_shm_ring *ring, uint64_t tail,
+			     size_t span)
+{
+    memset(ring->data + (tail & (ring->size - 1)), 0, span);
+    __atomic_store_n(&ring->shared->tail, tail + span, __ATOMIC_RELEASE);
+
+    shm_wake(&ring->shared->producer_futex, &ring->shared->producer_waiting);
+}
+
+ssize_t utk_shm_ring_peek(struct utk_shm_ring *ring, const void **data,
+			  int timeout_ms)
+{
+    struct utk_shm_ring_shared *shared = ring->shared;
+    struct timespec deadline;
+    uint64_t tail,
+	header;
+    uint32_t seq;
+    unsigned int spin = 0;
+    size_t len;
+
+    if(timeout_ms > 0)
+    {
+	shm_deadline(&deadline, timeout_ms);
+    }
+
+    for(;;)
+    {
+	tail = __atomic_load_n(&shared->tail, __ATOMIC_RELAXED);
+	header = __atomic_load_n((uint64_t *)(ring->data
+					      + (tail & (ring->size - 1))),
+				 __ATOMIC_ACQUIRE);
+
+	if(header & UTK_SHM_REC_PAD)
+	{
+	    shm_ring_release(ring, tail, (size_t)(header & UINT32_MAX));
+	    continue;
+	}
+
+	if(header & UTK_SHM_REC_COMMIT)
+	{
+	    len = (size_t)(header & UINT32_MAX);
+	    ring->peek_span = (UTK_SHM_REC_HEADER + len + 7) & ~(size_t)7;
+	    *data = ring->data + (tail & (ring->size - 1)) + UTK_SHM_REC_HEADER;
+
+	    return (ssize_t)len;
+	}
+
+	/* empty */
+	if(timeout_ms == 0)
+	{
+	    errno = EAGAIN;
+	    return -1;
+	}
+
+	if(spin++ < UTK_SHM_RING_SPIN)
+	{
+	    sched_yield();
+	    continue;
+	}
+
+	seq = __atomic_load_n(&shared->consumer_futex, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&shared->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	header = __atomic_load_n((uint64_t *)(ring->data
+					      + (tail & (ring->size - 1))),
+				 __ATOMIC_ACQUIRE);
+	if(header == 0
+	   && shm_wait(&shared->consumer_futex, seq,
+		       timeout_ms > 0 ? &deadline : NULL) != 0)
+	{
+	    __atomic_store_n(&shared->consumer_waiting, 0, __ATOMIC_RELAXED);
+	    return -1;
+	}
+	__atomic_store_n(&shared->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void utk_shm_ring_consume(struct utk_shm_ring *ring)
+{
+    uint64_t tail;
+
+    tail = __atomic_load_n(&ring->shared->tail, __ATOMIC_RELAXED);
+    shm_ring_release(ring, tail, ring->peek_span);
+    ring->peek_span = 0;
+}
+
+ssize_t utk_shm_ring_pop(struct utk_shm_ring *ring, void *dst, size_t size,
+			 int timeout_ms)
+{
+    const void *data = NULL;
+    ssize_t len;
+
+    len = utk_shm_ring_peek(ring, &data, timeout_ms);
+    if(len < 0)
+    {
+	return -1;
+    }
+
+    if((size_t)len > size)
+    {
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    memcpy(dst, data, (size_t)len);
+    utk_shm_ring_consume(ring);
+
+    return len;
+}
@@ -342,3 +342,28 @@ unsigned int utk_str_list_toarray(struct utk_str_list *list,
 
     return count;
 }
+
+struct str_list_sort_ctx {
+    int (*cmp)(const char *, const char *);
+};
+
+static int str_list_sort_cmp(void *priv, const struct utk_list_head *a,
+			     const struct utk_list_head *b)
+{
+    const struct str_list_sort_ctx *ctx = priv;
+
+    return ctx->cmp(utk_list_entry(a, const struct utk_str_list_item,
+				   node)->value,
+		    utk_list_entry(b, const struct utk_str_list_item,
+				   node)->value);
+}
+
+void utk_str_list_sort(struct utk_str_list *list,
+		       int (*cmp)(const char *, const char *))
+{
+    struct str_list_sort_ctx ctx;
+
+    ctx.cmp = cmp != NULL ? cmp : strcmp;
+
+    utk_list_sort(&ctx, &list->head, str_list_sort_cmp);
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utk/timer.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+#define UTK_TIMER_WHEEL_LVL0_MASK (UTK_TIMER_WHEEL_LVL0_SIZE - 1)
+#define UTK_TIMER_WHEEL_LVL_MASK (UTK_TIMER_WHEEL_LVL_SIZE - 1)
+/* ticks covered by the levels */
+#define UTK_TIMER_WHEEL_MAX_DELTA					\
+    ((((uint64_t)1) << (UTK_TIMER_WHEEL_LVL0_BITS			\
+			+ UTK_TIMER_WHEEL_NB_LVLS			\
+			* UTK_TIMER_WHEEL_LVL_BITS)) - 1)
+
+static inline unsigned int timer_wheel_shift(unsigned int lvl)
+{
+    return UTK_TIMER_WHEEL_LVL0_BITS + lvl * UTK_TIMER_WHEEL_LVL_BITS;
+}
+
+/*
+ * Slot of a timer: the first level where it expires in less than a turn
+ */
+static struct utk_list_head *timer_wheel_slot(struct utk_timer_wheel *wheel,
+					      uint64_t expires)
+{
+    uint64_t delta;
+    unsigned int lvl;
+
+    if(expires < wheel->tick)
+    {
+	expires = wheel->tick;
+    }
+
+    delta = expires - wheel->tick;
+    if(delta < UTK_TIMER_WHEEL_LVL0_SIZE)
+    {
+	return &wheel->lvl0[expires & UTK_TIMER_WHEEL_LVL0_MASK];
+    }
+
+    /* cascaded until it expires */
+    if(delta > UTK_TIMER_WHEEL_MAX_DELTA)
+    {
+	expires = wheel->tick + UTK_TIMER_WHEEL_MAX_DELTA;
+    }
+
+    for(lvl = 0; lvl < UTK_TIMER_WHEEL_NB_LVLS - 1; ++lvl)
+    {
+	if(delta < ((uint64_t)1 << timer_wheel_shift(lvl + 1)))
+	{
+	    break;
+	}
+    }
+
+    return &wheel->lvl[lvl][(expires >> timer_wheel_shift(lvl))
+			    & UTK_TIMER_WHEEL_LVL_MASK];
+}
+
+/*
+ * Move the timers of a slot to lower levels
+ */
+static void timer_wheel_cascade(struct utk_timer_wheel *wheel,
+				struct utk_list_head *slot)
+{
+    struct utk_timer *timer = NULL;
+    struct utk_timer *n = NULL;
+    UTK_LIST_HEAD(list);
+
+    utk_list_splice_init(slot, &list);
+    utk_list_for_each_entry_safe(timer, n, &list, node)
+    {
+	utk_list_add_tail(&timer->node,
+			  timer_wheel_slot(wheel, timer->expires));
+    }
+}
+
+/*
+ * First tick from tick where a slot expires or a non empty slot is
+ * cascaded: ticks before it have nothing to do and are skipped
+ */
+static uint64_t timer_wheel_next(const struct utk_timer_wheel *wheel,
+				 uint64_t tick)
+{
+    unsigned int shift,
+	lvl,
+	i,
+	j;
+
+    i = (unsigned int)(tick & UTK_TIMER_WHEEL_LVL0_MASK);
+    for(j = i; j < UTK_TIMER_WHEEL_LVL0_SIZE; ++j)
+    {
+	if(!utk_list_empty(&wheel->lvl0[j]))
+	{
+	    /* at a turn, the cascade of tick can fill the slots before j */
+	    return i == 0 ? tick : tick - i + j;
+	}
+    }
+
+    if(i != 0)
+    {
+	tick = ((tick >> UTK_TIMER_WHEEL_LVL0_BITS) + 1)
+	    << UTK_TIMER_WHEEL_LVL0_BITS;
+
+	/* slots of the next turn */
+	for(j = 0; j < i; ++j)
+	{
+	    if(!utk_list_empty(&wheel->lvl0[j]))
+	    {
+		return tick;
+	    }
+	}
+    }
+
+    /* the levels below lvl are empty, tick is a multiple of 2^shift */
+    for(lvl = 0; lvl < UTK_TIMER_WHEEL_NB_LVLS; ++lvl)
+    {
+	shift = timer_wheel_shift(lvl);
+	i = (unsigned int)((tick >> shift) & UTK_TIMER_WHEEL_LVL_MASK);
+
+	for(j = i; j < UTK_TIMER_WHEEL_LVL_SIZE; ++j)
+	{
+	    if(!utk_list_empty(&wheel->lvl[lvl][j]))
+	    {
+		/* at a turn, the cascade of tick can fill the slots before j */
+		return i == 0 ? tick : tick + ((uint64_t)(j - i) << shift);
+	    }
+	}
+	if(i == 0)
+	{
+	    /* the next level is cascaded at tick too */
+	    continue;
+	}
+
+	tick = ((tick >> (shift + UTK_TIMER_WHEEL_LVL_BITS)) + 1)
+	    << (shift + UTK_TIMER_WHEEL_LVL_BITS);
+	for(j = 0; j < i; ++j)
+	{
+	    if(!utk_list_empty(&wheel->lvl[lvl][j]))
+	    {
+		return tick;
+	    }
+	}
+    }
+
+    return tick;
+}
+
+int utk_timer_wheel_init(struct utk_timer_wheel *wheel, uint64_t tick_size,
+			 uint64_t now, utk_timer_wheel_cb_t cb, void *opaque)
+{
+    unsigned int i,
+	j;
+
+    if(tick_size == 0 || cb == NULL)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    for(i = 0; i < UTK_TIMER_WHEEL_LVL0_SIZE; ++i)
+    {
+	utk_list_head_init(&wheel->lvl0[i]);
+    }
+    for(i = 0; i < UTK_TIMER_WHEEL_NB_LVLS; ++i)
+    {
+	for(j = 0; j < UTK_TIMER_WHEEL_LVL_SIZE; ++j)
+	{
+	    utk_list_head_init(&wheel->lvl[i][j]);
+	}
+    }
+    utk_list_head_init(&wheel->expired);
+
+    /* ticks up to now are over */
+    wheel->tick = now / tick_size + 1;
+    wheel->tick_size = tick_size;
+    wheel->now = now;
+    wheel->count = 0;
+    wheel->cb = cb;
+    wheel->opaque = opaque;
+
+    return 0;
+}
+
+void utk_timer_wheel_start(struct utk_timer_wheel *wheel,
+			   struct utk_timer *timer, uint64_t timeout)
+{
+    uint64_t expires;
+
+    if(timeout > UINT64_MAX - wheel->now - (wheel->tick_size - 1))
+    {
+	expires = UINT64_MAX / wheel->tick_size;
+    }
+    else
+    {
+	/* rounded up: never early */
+	expires = (wheel->now + timeout + wheel->tick_size - 1)
+	    / wheel->tick_size;
+    }
+
+    if(utk_timer_pending(timer))
+    {
+	utk_list_del(&timer->node);
+    }
+    else
+    {
+	wheel->count++;
+    }
+
+    timer->expires = expires;
+    utk_list_add_tail(&timer->node, timer_wheel_slot(wheel, expires));
+}
+
+void utk_timer_wheel_cancel(struct utk_timer_wheel *wheel,
+			    struct utk_timer *timer)
+{
+    if(utk_timer_pending(timer))
+    {
+	utk_list_del_init(&timer->node);
+	wheel->count--;
+    }
+}
+
+size_t utk_timer_wheel_advance(struct utk_timer_wheel *wheel, uint64_t now)
+{
+    struct utk_timer *timer = NULL;
+    struct utk_timer *n = NULL;
+    uint64_t target,
+	tick;
+    size_t expired = 0;
+    unsigned int index,
+	lvl;
+
+    if(now < wheel->now)
+    {
+	return 0;
+    }
+    wheel->now = now;
+    target = now / wheel->tick_size;
+
+    while(wheel->tick <= target)
+    {
+	tick = wheel->count > 0 ? timer_wheel_next(wheel, wheel->tick)
+	    : target + 1;
+	if(tick > target)
+	{
+	    wheel->tick = target + 1;
+	    break;
+	}
+	wheel->tick = tick;
+
+	index = (unsigned int)(wheel->tick & UTK_TIMER_WHEEL_LVL0_MASK);
+
+	/* the first level wraps: move down the next slot of each level */
+	for(lvl = 0; index == 0 && lvl < UTK_TIMER_WHEEL_NB_LVLS; ++lvl)
+	{
+	    index = (unsigned int)((wheel->tick >> timer_wheel_shift(lvl))
+				   & UTK_TIMER_WHEEL_LVL_MASK);
+	    timer_wheel_cascade(wheel, &wheel->lvl[lvl][index]);
+	}
+
+	/* appended to the expired timers */
+	utk_list_splice_init(
+	    &wheel->lvl0[wheel->tick & UTK_TIMER_WHEEL_LVL0_MASK],
+	    wheel->expired.prev);
+	wheel->tick++;
+    }
+
+    if(utk_list_empty(&wheel->expired))
+    {
+	return 0;
+    }
+
+    utk_list_for_each_entry(timer, &wheel->expired, node)
+    {
+	expired++;
+    }
+
+    wheel->cb(wheel->opaque, &wheel->expired);
+
+    /* not restarted: stopped */
+    utk_list_for_each_entry_safe(timer, n, &wheel->expired, node)
+    {
+	utk_list_del_init(&timer->node);
+	wheel->count--;
+    }
+
+    return expired;
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/array.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define TEST_ARRAY_REF_SIZE 1024
+#define TEST_ARRAY_NB_MSGS 1000000
+
+UTK_VEC_DEFINE(test_int_vec, int)
+UTK_VEC_SMALL_DEFINE(test_small_vec, int, 4)
+UTK_SPSC_DEFINE(test_spsc, uint64_t)
+
+struct test_array_alloc_stats {
+    size_t reallocs;
+    size_t frees;
+    size_t bytes;
+};
+
+static void *test_array_realloc(void *opaque, void *ptr,
+				size_t old_size, size_t new_size)
+{
+    struct test_array_alloc_stats *stats = opaque;
+
+    stats->reallocs++;
+    stats->bytes = stats->bytes - old_size + new_size;
+
+    return realloc(ptr, new_size);
+}
+
+static void test_array_free(void *opaque, void *ptr)
+{
+    struct test_array_alloc_stats *stats = opaque;
+
+    stats->frees++;
+    free(ptr);
+}
+
+UTK_TEST_DEF(test_array_vec)
+{
+    struct test_int_vec vec;
+    int ref[TEST_ARRAY_REF_SIZE];
+    unsigned int seed = 1,
+	r;
+    size_t count = 0,
+	index,
+	nb,
+	i,
+	j;
+    int *pos = NULL;
+    int value;
+
+    test_int_vec_init(&vec, NULL);
+    UTK_TEST_ASSERT(test_int_vec_count(&vec) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(test_int_vec_pop(&vec, &value) == -1);
+    UTK_TEST_ASSERT(errno == ENOENT);
+    errno = 0;
+    UTK_TEST_ASSERT(test_int_vec_insert(&vec, 1, 0) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    /* random operations checked against a plain array */
+    for(i = 0; i < 20000; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	r = seed >> 16;
+	switch(r % 8)
+	{
+	case 0:
+	case 1:
+	case 2:
+	    if(count < TEST_ARRAY_REF_SIZE)
+	    {
+		UTK_TEST_ASSERT(test_int_vec_push(&vec, (int)i) == 0);
+		ref[count++] = (int)i;
+	    }
+	    break;
+	case 3:
+	case 4:
+	    if(count < TEST_ARRAY_REF_SIZE)
+	    {
+		index = (r >> 3) % (count + 1);
+		UTK_TEST_ASSERT(test_int_vec_insert(&vec, index, (int)i) == 0);
+		memmove(ref + index + 1, ref + index,
+			(count - index) * sizeof(int));
+		ref[index] = (int)i;
+		count++;
+	    }
+	    break;
+	case 5:
+	    if(count > 0)
+	    {
+		UTK_TEST_ASSERT(test_int_vec_pop(&vec, &value) == 0);
+		UTK_TEST_ASSERT(value == ref[--count]);
+	    }
+	    break;
+	case 6:
+	    index = (r >> 3) % (count + 1);
+	    nb = (r >> 13) % 4;
+	    if(nb > count - index)
+	    {
+		errno = 0;
+		UTK_TEST_ASSERT(test_int_vec_erase(&vec, index, nb) == -1);
+		UTK_TEST_ASSERT(errno == EINVAL);
+		break;
+	    }
+	    UTK_TEST_ASSERT(test_int_vec_erase(&vec, index, nb) == 0);
+	    memmove(ref + index, ref + index + nb,
+		    (count - index - nb) * sizeof(int));
+	    count -= nb;
+	    break;
+	default:
+	    UTK_TEST_ASSERT(test_int_vec_shrink(&vec) == 0);
+	    UTK_TEST_ASSERT(vec.capacity == count);
+	    break;
+	}
+
+	UTK_TEST_ASSERT(vec.count == count);
+	UTK_TEST_ASSERT(vec.capacity >= count);
+	if(i % 100 == 0)
+	{
+	    j = 0;
+	    utk_vec_for_each(pos, &vec)
+	    {
+		UTK_TEST_ASSERT(*pos == ref[j]);
+		j++;
+	    }
+	    UTK_TEST_ASSERT(j == count);
+	}
+    }
+
+    test_int_vec_clear(&vec);
+    UTK_TEST_ASSERT(test_int_vec_count(&vec) == 0);
+    UTK_TEST_ASSERT(test_int_vec_shrink(&vec) == 0);
+    UTK_TEST_ASSERT(vec.data == NULL && vec.capacity == 0);
+
+    test_int_vec_cleanup(&vec);
+}
+
+UTK_TEST_DEF(test_array_vec_growth)
+{
+    struct test_array_alloc_stats stats = { 0, 0, 0 };
+    struct utk_array_allocator alloc = {
+	test_array_realloc, test_array_free, &stats
+    };
+    struct test_int_vec vec;
+    size_t i;
+
+    test_int_vec_init(&vec, &alloc);
+
+    /* amortized growth: few reallocations */
+    for(i = 0; i < 100000; ++i)
+    {
+	UTK_TEST_ASSERT(test_int_vec_push(&vec, (int)i) == 0);
+    }
+    UTK_TEST_ASSERT(stats.reallocs < 20);
+    UTK_TEST_ASSERT(stats.bytes == vec.capacity * sizeof(int));
+
+    UTK_TEST_ASSERT(test_int_vec_reserve(&vec, 200000) == 0);
+    UTK_TEST_ASSERT(vec.capacity == 200000);
+    UTK_TEST_ASSERT(test_int_vec_reserve(&vec, 10) == 0);
+    UTK_TEST_ASSERT(vec.capacity == 200000);
+    UTK_TEST_ASSERT(vec.data[99999] == 99999);
+
+    /* overflowing sizes fail without calling the allocator */
+    i = stats.reallocs;
+    errno = 0;
+    UTK_TEST_ASSERT(test_int_vec_reserve(&vec, SIZE_MAX / 2) == -1);
+    UTK_TEST_ASSERT(errno == ENOMEM);
+    errno = 0;
+    UTK_TEST_ASSERT(test_int_vec_grow(&vec, SIZE_MAX - 10) == -1);
+    UTK_TEST_ASSERT(errno == ENOMEM);
+    UTK_TEST_ASSERT(stats.reallocs == i);
+    UTK_TEST_ASSERT(vec.count == 100000);
+
+    UTK_TEST_ASSERT(utk_array_grow(0, 1, sizeof(int)) == UTK_VEC_MIN_CAPACITY);
+    UTK_TEST_ASSERT(utk_array_grow(8, 9, sizeof(int)) == 16);
+    UTK_TEST_ASSERT(utk_array_grow(8, 100, sizeof(int)) == 100);
+    UTK_TEST_ASSERT(utk_array_grow(SIZE_MAX / 8 + 1, SIZE_MAX / 8 + 2,
+				   4) == SIZE_MAX / 4);
+    UTK_TEST_ASSERT(utk_array_grow(0, SIZE_MAX / 4 + 1, 4) == 0);
+
+    UTK_TEST_ASSERT(test_int_vec_shrink(&vec) == 0);
+    UTK_TEST_ASSERT(stats.bytes == 100000 * sizeof(int));
+
+    test_int_vec_cleanup(&vec);
+    UTK_TEST_ASSERT(stats.frees == 1);
+}
+
+UTK_TEST_DEF(test_array_vec_small)
+{
+    struct test_array_alloc_stats stats = { 0, 0, 0 };
+    struct utk_array_allocator alloc = {
+	test_array_realloc, test_array_free, &stats
+    };
+    struct test_small_vec vec;
+    int value;
+    int i;
+
+    test_small_vec_init(&vec, &alloc);
+    UTK_TEST_ASSERT(vec.capacity == 4);
+
+    /* the first elements are inline */
+    for(i = 0; i < 4; ++i)
+    {
+	UTK_TEST_ASSERT(test_small_vec_insert(&vec, 0, i) == 0);
+    }
+    UTK_TEST_ASSERT(vec.data == vec.buf);
+    UTK_TEST_ASSERT(stats.reallocs == 0);
+
+    UTK_TEST_ASSERT(test_small_vec_push(&vec, 4) == 0);
+    UTK_TEST_ASSERT(vec.data != vec.buf);
+    UTK_TEST_ASSERT(stats.reallocs == 1);
+    UTK_TEST_ASSERT(vec.capacity == 8);
+    UTK_TEST_ASSERT(vec.data[0] == 3 && vec.data[3] == 0 && vec.data[4] == 4);
+
+    /* shrinking a small enough vector goes back inline */
+    UTK_TEST_ASSERT(test_small_vec_pop(&vec, &value) == 0);
+    UTK_TEST_ASSERT(value == 4);
+    UTK_TEST_ASSERT(test_small_vec_erase(&vec, 0, 1) == 0);
+    UTK_TEST_ASSERT(test_small_vec_shrink(&vec) == 0);
+    UTK_TEST_ASSERT(vec.data == vec.buf);
+    UTK_TEST_ASSERT(vec.capacity == 4);
+    UTK_TEST_ASSERT(stats.frees == 1);
+    UTK_TEST_ASSERT(vec.count == 3);
+    UTK_TEST_ASSERT(vec.data[0] == 2 && vec.data[2] == 0);
+
+    for(i = 0; i < 1000; ++i)
+    {
+	UTK_TEST_ASSERT(test_small_vec_push(&vec, i) == 0);
+    }
+    UTK_TEST_ASSERT(vec.data[3] == 0 && vec.data[1002] == 999);
+
+    test_small_vec_cleanup(&vec);
+    UTK_TEST_ASSERT(vec.data == vec.buf);
+    UTK_TEST_ASSERT(stats.frees == 2);
+}
+
+UTK_TEST_DEF(test_array_spsc)
+{
+    struct test_spsc ring;
+    uint64_t buf[8];
+    uint64_t value;
+    size_t i;
+
+    errno = 0;
+    UTK_TEST_ASSERT(test_spsc_init(&ring, SIZE_MAX, NULL) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    UTK_TEST_ASSERT(test_spsc_init(&ring, 5, NULL) == 0);
+    UTK_TEST_ASSERT(test_spsc_capacity(&ring) == 8);
+
+    errno = 0;
+    UTK_TEST_ASSERT(test_spsc_pop(&ring, &value) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* indexes wrap several times */
+    for(i = 0; i < 100; ++i)
+    {
+	UTK_TEST_ASSERT(test_spsc_push(&ring, i) == 0);
+	UTK_TEST_ASSERT(test_spsc_push(&ring, i + 1000) == 0);
+	UTK_TEST_ASSERT(test_spsc_count(&ring) == 2);
+	UTK_TEST_ASSERT(test_spsc_pop(&ring, &value) == 0 && value == i);
+	UTK_TEST_ASSERT(test_spsc_pop(&ring, &value) == 0
+			&& value == i + 1000);
+    }
+
+    for(i = 0; i < 8; ++i)
+    {
+	UTK_TEST_ASSERT(test_spsc_push(&ring, i) == 0);
+    }
+    errno = 0;
+    UTK_TEST_ASSERT(test_spsc_push(&ring, 8) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    UTK_TEST_ASSERT(test_spsc_pop_batch(&ring, buf, 3) == 3);
+    UTK_TEST_ASSERT(buf[0] == 0 && buf[2] == 2);
+    buf[0] = 8;
+    buf[1] = 9;
+    buf[2] = 10;
+    buf[3] = 11;
+    UTK_TEST_ASSERT(test_spsc_push_batch(&ring, buf, 4) == 3);
+    UTK_TEST_ASSERT(test_spsc_pop_batch(&ring, buf, 8) == 8);
+    for(i = 0; i < 8; ++i)
+    {
+	UTK_TEST_ASSERT(buf[i] == i + 3);
+    }
+    UTK_TEST_ASSERT(test_spsc_pop_batch(&ring, buf, 8) == 0);
+
+    test_spsc_cleanup(&ring);
+}
+
+static void *test_array_spsc_producer(void *arg)
+{
+    struct test_spsc *ring = arg;
+    uint64_t buf[16];
+    uint64_t next = 0;
+    size_t nb,
+	i;
+
+    while(next < TEST_ARRAY_NB_MSGS)
+    {
+	/* alternate single and batch pushes */
+	if(next % 3 == 0)
+	{
+	    if(test_spsc_push(ring, next) == 0)
+	    {
+		next++;
+		continue;
+	    }
+	}
+	else
+	{
+	    nb = next % 16 + 1;
+	    for(i = 0; i < nb; ++i)
+	    {
+		buf[i] = next + i;
+	    }
+	    nb = test_spsc_push_batch(ring, buf, nb);
+	    next += nb;
+	    if(nb > 0)
+	    {
+		continue;
+	    }
+	}
+	sched_yield();
+    }
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_array_spsc_threads)
+{
+    struct test_spsc ring;
+    pthread_t thread;
+    uint64_t buf[16];
+    uint64_t next = 0;
+    size_t nb,
+	i;
+    int ok = 1;
+
+    UTK_TEST_ASSERT(test_spsc_init(&ring, 64, NULL) == 0);
+    UTK_TEST_ASSERT(pthread_create(&thread, NULL, test_array_spsc_producer,
+				   &ring) == 0);
+
+    while(next < TEST_ARRAY_NB_MSGS)
+    {
+	if(next % 2 == 0)
+	{
+	    nb = test_spsc_pop(&ring, buf) == 0 ? 1 : 0;
+	}
+	else
+	{
+	    nb = test_spsc_pop_batch(&ring, buf, next % 16 + 1);
+	}
+	if(nb == 0)
+	{
+	    sched_yield();
+	    continue;
+	}
+	for(i = 0; i < nb; ++i)
+	{
+	    ok &= (buf[i] == next++);
+	}
+    }
+
+    UTK_TEST_ASSERT(pthread_join(thread, NULL) == 0);
+    UTK_TEST_ASSERT(ok);
+    UTK_TEST_ASSERT(test_spsc_count(&ring) == 0);
+
+    test_spsc_cleanup(&ring);
+}
+
+UTK_TEST_DEF(test_array_spsc_ring)
+{
+    struct utk_spsc_ring ring;
+    const void *data = NULL;
+    char buf[64];
+    char *dst = NULL;
+    size_t i;
+
+    UTK_TEST_ASSERT(utk_spsc_ring_init(&ring, 100, NULL) == 0);
+    UTK_TEST_ASSERT(ring.size == 128);
+    UTK_TEST_ASSERT(utk_spsc_ring_max_record(&ring) == 56);
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, buf, 57) == -1);
+    UTK_TEST_ASSERT(errno == EMSGSIZE);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_spsc_ring_peek(&ring, &data) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* 3 records of 40 bytes (48 with header) don't fit */
+    memset(buf, 'a', sizeof(buf));
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, buf, 40) == 0);
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, "hello", 5) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, buf, 64) == -1);
+    UTK_TEST_ASSERT(errno == EMSGSIZE);
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, buf, 40) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, buf, 40) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* peek several records, consume them together */
+    UTK_TEST_ASSERT(utk_spsc_ring_peek(&ring, &data) == 40);
+    UTK_TEST_ASSERT(memcmp(data, buf, 40) == 0);
+    UTK_TEST_ASSERT(utk_spsc_ring_peek(&ring, &data) == 5);
+    UTK_TEST_ASSERT(memcmp(data, "hello", 5) == 0);
+    utk_spsc_ring_consume(&ring);
+
+    /* the end of the ring is padded */
+    dst = utk_spsc_ring_reserve(&ring, 48);
+    UTK_TEST_ASSERT(dst == (char *)ring.data + 8);
+    memcpy(dst, "world", 5);
+    utk_spsc_ring_commit(&ring, 5);
+
+    UTK_TEST_ASSERT(utk_spsc_ring_pop(&ring, buf, 2) == -1);
+    UTK_TEST_ASSERT(errno == EMSGSIZE);
+    UTK_TEST_ASSERT(utk_spsc_ring_pop(&ring, buf, sizeof(buf)) == 40);
+    UTK_TEST_ASSERT(utk_spsc_ring_pop(&ring, buf, sizeof(buf)) == 5);
+    UTK_TEST_ASSERT(memcmp(buf, "world", 5) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_spsc_ring_pop(&ring, buf, sizeof(buf)) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* empty records */
+    for(i = 0; i < 100; ++i)
+    {
+	UTK_TEST_ASSERT(utk_spsc_ring_push(&ring, NULL, 0) == 0);
+	UTK_TEST_ASSERT(utk_spsc_ring_peek(&ring, &data) == 0);
+	utk_spsc_ring_consume(&ring);
+    }
+
+    utk_spsc_ring_cleanup(&ring);
+}
+
+static void *test_array_spsc_ring_producer(void *arg)
+{
+    struct utk_spsc_ring *ring = arg;
+    unsigned char buf[256];
+    size_t i,
+	len;
+
+    for(i = 0; i < TEST_ARRAY_NB_MSGS; ++i)
+    {
+	len = i % 200;
+	memset(buf, (int)(i & 0xff), len);
+	while(utk_spsc_ring_push(ring, buf, len) != 0)
+	{
+	    sched_yield();
+	}
+    }
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_array_spsc_ring_threads)
+{
+    struct utk_spsc_ring ring;
+    const unsigned char *data = NULL;
+    pthread_t thread;
+    ssize_t len;
+    size_t i = 0,
+	j;
+    int ok = 1;
+
+    UTK_TEST_ASSERT(utk_spsc_ring_init(&ring, 4096, NULL) == 0);
+    UTK_TEST_ASSERT(pthread_create(&thread, NULL,
+				   test_array_spsc_ring_producer, &ring) == 0);
+
+    while(i < TEST_ARRAY_NB_MSGS)
+    {
+	len = utk_spsc_ring_peek(&ring, (const void **)&data);
+	if(len < 0)
+	{
+	    utk_spsc_ring_consume(&ring);
+	    sched_yield();
+	    continue;
+	}
+
+	ok &= ((size_t)len == i % 200);
+	for(j = 0; j < (size_t)len; ++j)
+	{
+	    ok &= (data[j] == (i & 0xff));
+	}
+	i++;
+	/* release in batches of 8 */
+	if(i % 8 == 0)
+	{
+	    utk_spsc_ring_consume(&ring);
+	}
+    }
+
+    UTK_TEST_ASSERT(pthread_join(thread, NULL) == 0);
+    UTK_TEST_ASSERT(ok);
+
+    utk_spsc_ring_cleanup(&ring);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/array");
+
+    UTK_TEST_RUN(test_array_vec);
+
+    UTK_TEST_RUN(test_array_vec_growth);
+
+    UTK_TEST_RUN(test_array_vec_small);
+
+    UTK_TEST_RUN(test_array_spsc);
+
+    UTK_TEST_RUN(test_array_spsc_threads);
+
+    UTK_TEST_RUN(test_array_spsc_ring);
+
+    UTK_TEST_RUN(test_array_spsc_ring_threads);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/crc.h>
+#include <utk/array.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char *test_crc32c_impls[] = {
+    "slicing-by-8", "sse4.2", "sse4.2+pclmul",
+};
+
+/*
+ * Bitwise reference implementation
+ */
+static uint32_t test_crc32c_ref(const unsigned char *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    unsigned int i;
+
+    while(len-- != 0)
+    {
+	crc ^= *p++;
+	for(i = 0; i < 8; ++i)
+	{
+	    crc = (crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1);
+	}
+    }
+
+    return ~crc;
+}
+
+UTK_TEST_DEF(test_crc32c)
+{
+    const char *check = "123456789";
+    unsigned char zeros[32];
+    uint32_t crc;
+
+    /* check values of the CRC-32C catalogue and RFC 3720 */
+    UTK_TEST_ASSERT(utk_crc32c(0, check, strlen(check)) == 0xe3069283);
+
+    memset(zeros, 0, sizeof(zeros));
+    UTK_TEST_ASSERT(utk_crc32c(0, zeros, sizeof(zeros)) == 0x8a9136aa);
+
+    memset(zeros, 0xff, sizeof(zeros));
+    UTK_TEST_ASSERT(utk_crc32c(0, zeros, sizeof(zeros)) == 0x62a8ab43);
+
+    UTK_TEST_ASSERT(utk_crc32c(0, NULL, 0) == 0);
+
+    /* computed in several calls */
+    crc = utk_crc32c(0, check, 4);
+    crc = utk_crc32c(crc, check + 4, strlen(check) - 4);
+    UTK_TEST_ASSERT(crc == 0xe3069283);
+}
+
+UTK_TEST_DEF(test_crc32c_big)
+{
+    /* long lanes are 3 * 8KiB, short lanes are 3 * 256 */
+    const size_t lens[] = {
+	1, 7, 8, 9, 63, 64, 767, 768, 769, 1000, 4096,
+	24575, 24576, 24577, 25000, 100000,
+    };
+    unsigned char *buf = NULL;
+    size_t i,
+	impl,
+	offset;
+    unsigned int seed = 42;
+
+    buf = malloc(100000 + 8);
+    UTK_TEST_ASSERT(buf != NULL);
+
+    for(i = 0; i < 100000 + 8; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	buf[i] = (unsigned char)(seed >> 16);
+    }
+
+    /* every implementation, length and alignment gives the same result as
+     * the reference */
+    for(impl = 0; impl < UTK_ARRAY_SIZE(test_crc32c_impls); ++impl)
+    {
+	if(utk_crc32c_set_implementation(test_crc32c_impls[impl]) != 0)
+	{
+	    UTK_TEST_ASSERT(errno == ENOTSUP);
+	    UTK_TEST_PRINT_WARNING("%s not supported, skipped",
+				   test_crc32c_impls[impl]);
+	    continue;
+	}
+	UTK_TEST_ASSERT(strcmp(utk_crc32c_implementation(),
+			       test_crc32c_impls[impl]) == 0);
+
+	for(i = 0; i < UTK_ARRAY_SIZE(lens); ++i)
+	{
+	    for(offset = 0; offset < 8; offset += 3)
+	    {
+		UTK_TEST_RAW_ASSERT(utk_crc32c(0, buf + offset, lens[i])
+				    == test_crc32c_ref(buf + offset, lens[i]),
+				    "len %zu offset %zu (%s)", lens[i], offset,
+				    utk_crc32c_implementation());
+	    }
+	}
+    }
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_crc32c_set_implementation("crc32c") == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+    UTK_TEST_ASSERT(utk_crc32c_set_implementation(NULL) == 0);
+
+    free(buf);
+}
+
+UTK_TEST_DEF(test_crc32c_combine)
+{
+    unsigned char buf[50000];
+    size_t i,
+	cut;
+    uint32_t crc,
+	crc1,
+	crc2;
+
+    for(i = 0; i < sizeof(buf); ++i)
+    {
+	buf[i] = (unsigned char)(i * 31 + (i >> 8));
+    }
+
+    crc = utk_crc32c(0, buf, sizeof(buf));
+
+    for(cut = 0; cut <= sizeof(buf); cut += 4999)
+    {
+	crc1 = utk_crc32c(0, buf, cut);
+	crc2 = utk_crc32c(0, buf + cut, sizeof(buf) - cut);
+	UTK_TEST_ASSERT(utk_crc32c_combine(crc1, crc2, sizeof(buf) - cut) == crc);
+    }
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/crc");
+
+    UTK_TEST_RUN(test_crc32c);
+
+    UTK_TEST_RUN(test_crc32c_big);
+
+    UTK_TEST_RUN(test_crc32c_combine);
+
+    return UTK_TEST_MODULE_RETURN;
+}
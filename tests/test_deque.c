@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/deque.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define TEST_DEQUE_REF_SIZE 4096
+
+/*
+ * Check the elements of a deque of int against a reference ring
+ */
+static void test_deque_check(struct utk_test_result *__tr,
+			     struct utk_deque *dq, const int *ref,
+			     size_t first, size_t count)
+{
+    struct utk_deque_iter it;
+    int *pos = NULL;
+    size_t i = 0;
+
+    UTK_TEST_ASSERT(utk_deque_count(dq) == count);
+
+    utk_deque_for_each(pos, it, dq)
+    {
+	UTK_TEST_ASSERT(*pos == ref[(first + i) % TEST_DEQUE_REF_SIZE]);
+	i++;
+    }
+    UTK_TEST_ASSERT(i == count);
+
+    utk_deque_for_each_reverse(pos, it, dq)
+    {
+	i--;
+	UTK_TEST_ASSERT(*pos == ref[(first + i) % TEST_DEQUE_REF_SIZE]);
+    }
+    UTK_TEST_ASSERT(i == 0);
+}
+
+UTK_TEST_DEF(test_deque_push_pop)
+{
+    struct utk_deque dq;
+    int ref[TEST_DEQUE_REF_SIZE];
+    int *elem = NULL;
+    unsigned int seed = 1,
+	r;
+    size_t block_len,
+	first,
+	count,
+	i;
+    int value;
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_deque_init(&dq, 0, 0) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    for(block_len = 1; block_len <= 7; block_len += 3)
+    {
+	UTK_TEST_ASSERT(utk_deque_init(&dq, sizeof(int), block_len) == 0);
+	UTK_TEST_ASSERT(utk_deque_front(&dq) == NULL);
+	UTK_TEST_ASSERT(utk_deque_back(&dq) == NULL);
+	errno = 0;
+	UTK_TEST_ASSERT(utk_deque_pop_front(&dq, NULL) == -1);
+	UTK_TEST_ASSERT(errno == ENOENT);
+
+	/* ref[first .. first + count) modulo its size */
+	first = TEST_DEQUE_REF_SIZE / 2;
+	count = 0;
+	for(i = 0; i < 20000; ++i)
+	{
+	    seed = seed * 1103515245 + 12345;
+	    r = seed >> 16;
+	    /* grow then shrink */
+	    if(r % 4 < (i < 10000 ? 3u : 1u) && count < TEST_DEQUE_REF_SIZE)
+	    {
+		if(r & 16)
+		{
+		    elem = utk_deque_push_back(&dq);
+		    UTK_TEST_ASSERT(elem != NULL);
+		    *elem = (int)i;
+		    ref[(first + count) % TEST_DEQUE_REF_SIZE] = (int)i;
+		}
+		else
+		{
+		    elem = utk_deque_push_front(&dq);
+		    UTK_TEST_ASSERT(elem != NULL);
+		    *elem = (int)i;
+		    first = (first + TEST_DEQUE_REF_SIZE - 1)
+			% TEST_DEQUE_REF_SIZE;
+		    ref[first] = (int)i;
+		}
+		count++;
+	    }
+	    else if(count > 0)
+	    {
+		if(r & 32)
+		{
+		    UTK_TEST_ASSERT(*(int *)utk_deque_back(&dq)
+				    == ref[(first + count - 1)
+					   % TEST_DEQUE_REF_SIZE]);
+		    UTK_TEST_ASSERT(utk_deque_pop_back(&dq, &value) == 0);
+		    UTK_TEST_ASSERT(value == ref[(first + count - 1)
+						 % TEST_DEQUE_REF_SIZE]);
+		}
+		else
+		{
+		    UTK_TEST_ASSERT(*(int *)utk_deque_front(&dq)
+				    == ref[first]);
+		    UTK_TEST_ASSERT(utk_deque_pop_front(&dq, &value) == 0);
+		    UTK_TEST_ASSERT(value == ref[first]);
+		    first = (first + 1) % TEST_DEQUE_REF_SIZE;
+		}
+		count--;
+	    }
+
+	    if(i % 1000 == 0)
+	    {
+		test_deque_check(__tr, &dq, ref, first, count);
+	    }
+	}
+	test_deque_check(__tr, &dq, ref, first, count);
+
+	utk_deque_cleanup(&dq);
+    }
+}
+
+UTK_TEST_DEF(test_deque_stable)
+{
+    struct utk_deque dq;
+    struct utk_deque_iter it;
+    uint64_t *first = NULL;
+    uint64_t *elem = NULL;
+    uint64_t sum = 0;
+    size_t i;
+
+    UTK_TEST_ASSERT(utk_deque_init(&dq, sizeof(uint64_t), 0) == 0);
+    /* 4KB blocks */
+    UTK_TEST_ASSERT(dq.block_len == (4096 - 16) / 8);
+
+    first = utk_deque_push_back(&dq);
+    UTK_TEST_ASSERT(first != NULL);
+    *first = 0;
+    for(i = 1; i < 100000; ++i)
+    {
+	elem = utk_deque_push_back(&dq);
+	UTK_TEST_ASSERT(elem != NULL);
+	*elem = i;
+    }
+
+    /* elements never move */
+    UTK_TEST_ASSERT(utk_deque_front(&dq) == first);
+
+    utk_deque_for_each(elem, it, &dq)
+    {
+	sum += *elem;
+    }
+    UTK_TEST_ASSERT(sum == 100000ULL * 99999 / 2);
+
+    while(utk_deque_pop_back(&dq, NULL) == 0)
+    {
+    }
+    UTK_TEST_ASSERT(utk_deque_empty(&dq));
+
+    utk_deque_cleanup(&dq);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/deque");
+
+    UTK_TEST_RUN(test_deque_push_pop);
+
+    UTK_TEST_RUN(test_deque_stable);
+
+    return UTK_TEST_MODULE_RETURN;
+}
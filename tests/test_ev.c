@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/ev.h>
+#include <utk/io.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+struct test_ev_conn {
+    struct utk_ev_io io;
+    unsigned int calls;
+    int events;
+    size_t received;
+};
+
+static void test_ev_count_cb(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			     int events)
+{
+    struct test_ev_conn *conn = container_of(io, struct test_ev_conn, io);
+
+    (void)loop;
+
+    conn->calls++;
+    conn->events = events;
+}
+
+static void test_ev_drain_cb(struct utk_ev_loop *loop, struct utk_ev_io *io,
+			     int events)
+{
+    struct test_ev_conn *conn = container_of(io, struct test_ev_conn, io);
+    char buf[3];
+    ssize_t cc;
+
+    (void)loop;
+    (void)events;
+
+    conn->calls++;
+    while((cc = utk_io_read_nonblock(io->fd, buf, sizeof(buf))) > 0)
+    {
+	conn->received += (size_t)cc;
+    }
+}
+
+UTK_TEST_DEF(test_ev_io)
+{
+    struct utk_ev_loop loop;
+    struct test_ev_conn level,
+	edge;
+    int fds[2],
+	efds[2];
+
+    UTK_TEST_ASSERT(utk_ev_loop_init(&loop, 0) == 0);
+    UTK_TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    UTK_TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, efds) == 0);
+    UTK_TEST_ASSERT(utk_io_set_nonblock(fds[0], 1) == 0);
+    UTK_TEST_ASSERT(utk_io_set_nonblock(efds[0], 1) == 0);
+
+    memset(&level, 0, sizeof(level));
+    memset(&edge, 0, sizeof(edge));
+    UTK_TEST_ASSERT(utk_ev_io_start(&loop, &level.io, fds[0], UTK_EV_READ,
+				    test_ev_count_cb) == 0);
+    UTK_TEST_ASSERT(utk_ev_io_start(&loop, &edge.io, efds[0],
+				    UTK_EV_READ | UTK_EV_EDGE,
+				    test_ev_count_cb) == 0);
+
+    /* nothing ready */
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 0) == 0);
+
+    /* level-triggered: reported until read, edge-triggered: once */
+    UTK_TEST_ASSERT(utk_io_write(fds[1], "x", 1) == 1);
+    UTK_TEST_ASSERT(utk_io_write(efds[1], "x", 1) == 1);
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 1000) == 2);
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 0) == 1);
+    UTK_TEST_ASSERT(level.calls == 2 && edge.calls == 1);
+    UTK_TEST_ASSERT(level.events == UTK_EV_READ);
+
+    /* write readiness */
+    UTK_TEST_ASSERT(utk_ev_io_modify(&loop, &level.io, UTK_EV_WRITE) == 0);
+    level.calls = 0;
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 0) == 1);
+    UTK_TEST_ASSERT(level.calls == 1 && level.events == UTK_EV_WRITE);
+
+    /* edge-triggered reader draining until EAGAIN */
+    UTK_TEST_ASSERT(utk_ev_io_stop(&loop, &edge.io) == 0);
+    memset(&edge, 0, sizeof(edge));
+    UTK_TEST_ASSERT(utk_ev_io_start(&loop, &edge.io, efds[0],
+				    UTK_EV_READ | UTK_EV_EDGE,
+				    test_ev_drain_cb) == 0);
+    UTK_TEST_ASSERT(utk_io_write(efds[1], "0123456789", 10) == 10);
+    utk_ev_run_once(&loop, 1000);
+    UTK_TEST_ASSERT(edge.calls == 1 && edge.received == 11);
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 0) == 1);
+    UTK_TEST_ASSERT(edge.calls == 1);
+
+    /* hang up */
+    UTK_TEST_ASSERT(utk_ev_io_modify(&loop, &level.io, UTK_EV_READ) == 0);
+    close(fds[1]);
+    UTK_TEST_ASSERT(utk_ev_run_once(&loop, 1000) >= 1);
+    UTK_TEST_ASSERT(level.events & UTK_EV_READ);
+
+    UTK_TEST_ASSERT(utk_ev_io_stop(&loop, &level.io) == 0);
+    UTK_TEST_ASSERT(utk_ev_io_stop(&loop, &edge.io) == 0);
+    utk_ev_loop_cleanup(&loop);
+
+    close(fds[0]);
+    close(efds[0]);
+    close(efds[1]);
+}
+
+UTK_TEST_DEF(test_io_nonblock)
+{
+    char buf[4096];
+    ssize_t cc;
+    size_t total;
+    int fds[2];
+
+    UTK_TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    UTK_TEST_ASSERT(utk_io_set_nonblock(fds[0], 1) == 0);
+    UTK_TEST_ASSERT(utk_io_set_nonblock(fds[1], 1) == 0);
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_read_nonblock(fds[0], buf, sizeof(buf)) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* fill the socket: partial write then EAGAIN */
+    memset(buf, 'a', sizeof(buf));
+    total = 0;
+    while((cc = utk_io_write_nonblock(fds[1], buf, sizeof(buf)))
+	  == (ssize_t)sizeof(buf))
+    {
+	total += (size_t)cc;
+    }
+    if(cc > 0)
+    {
+	total += (size_t)cc;
+	errno = 0;
+	UTK_TEST_ASSERT(utk_io_write_nonblock(fds[1], buf, sizeof(buf)) == -1);
+    }
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* drain it */
+    while((cc = utk_io_read_nonblock(fds[0], buf, sizeof(buf))) > 0)
+    {
+	total -= (size_t)cc;
+    }
+    UTK_TEST_ASSERT(cc == -1 && errno == EAGAIN);
+    UTK_TEST_ASSERT(total == 0);
+
+    close(fds[1]);
+    UTK_TEST_ASSERT(utk_io_read_nonblock(fds[0], buf, sizeof(buf)) == 0);
+    close(fds[0]);
+}
+
+struct test_ev_timer {
+    struct utk_ev_timer timer;
+    unsigned int calls;
+    int *order;
+    unsigned int *nb_order;
+    int id;
+    struct utk_ev_timer *stop;
+};
+
+static void test_ev_timer_cb(struct utk_ev_loop *loop,
+			     struct utk_ev_timer *timer)
+{
+    struct test_ev_timer *t = container_of(timer, struct test_ev_timer,
+					   timer);
+
+    t->calls++;
+    t->order[(*t->nb_order)++] = t->id;
+    if(t->stop != NULL)
+    {
+	utk_ev_timer_stop(loop, t->stop);
+	utk_ev_stop(loop);
+    }
+}
+
+UTK_TEST_DEF(test_ev_timer)
+{
+    struct utk_ev_loop loop;
+    struct test_ev_timer timers[4];
+    int order[64];
+    unsigned int nb_order = 0,
+	i;
+    uint64_t start;
+
+    UTK_TEST_ASSERT(utk_ev_loop_init(&loop, 0) == 0);
+
+    memset(timers, 0, sizeof(timers));
+    for(i = 0; i < 4; ++i)
+    {
+	timers[i].order = order;
+	timers[i].nb_order = &nb_order;
+	timers[i].id = (int)i;
+	utk_ev_timer_init(&timers[i].timer);
+	UTK_TEST_ASSERT(!utk_ev_timer_active(&timers[i].timer));
+    }
+
+    /* 3 one-shot timers started out of order, a periodic one, and the
+     * last one stopping the periodic one and the loop */
+    UTK_TEST_ASSERT(utk_ev_timer_start(&loop, &timers[0].timer, 30, 0,
+				       test_ev_timer_cb) == 0);
+    UTK_TEST_ASSERT(utk_ev_timer_start(&loop, &timers[1].timer, 10, 0,
+				       test_ev_timer_cb) == 0);
+    UTK_TEST_ASSERT(utk_ev_timer_start(&loop, &timers[2].timer, 5, 5,
+				       test_ev_timer_cb) == 0);
+    timers[3].stop = &timers[2].timer;
+    UTK_TEST_ASSERT(utk_ev_timer_start(&loop, &timers[3].timer, 60, 0,
+				       test_ev_timer_cb) == 0);
+    /* restart with another timeout */
+    UTK_TEST_ASSERT(utk_ev_timer_start(&loop, &timers[0].timer, 20, 0,
+				       test_ev_timer_cb) == 0);
+
+    start = utk_ev_now(&loop);
+    UTK_TEST_ASSERT(utk_ev_run(&loop) == 0);
+    UTK_TEST_ASSERT(utk_ev_now(&loop) - start >= 60);
+
+    UTK_TEST_ASSERT(timers[0].calls == 1 && timers[1].calls == 1
+		    && timers[3].calls == 1);
+    UTK_TEST_ASSERT(timers[2].calls >= 1 && timers[2].calls <= 12);
+    UTK_TEST_ASSERT(!utk_ev_timer_active(&timers[2].timer));
+    UTK_TEST_ASSERT(order[nb_order - 1] == 3);
+
+    /* one-shot timers in expiration order */
+    for(i = 0; i < nb_order && order[i] != 1; ++i)
+    {
+	UTK_TEST_ASSERT(order[i] == 2);
+    }
+    for(++i; i < nb_order && order[i] != 0; ++i)
+    {
+	UTK_TEST_ASSERT(order[i] == 2);
+    }
+    UTK_TEST_ASSERT(i < nb_order);
+
+    utk_ev_loop_cleanup(&loop);
+}
+
+struct test_ev_async {
+    struct utk_ev_async async;
+    struct utk_ev_loop *loop;
+    unsigned int calls;
+};
+
+static void test_ev_async_cb(struct utk_ev_loop *loop,
+			     struct utk_ev_async *async)
+{
+    struct test_ev_async *a = container_of(async, struct test_ev_async,
+					   async);
+
+    a->calls++;
+    utk_ev_stop(loop);
+}
+
+static void *test_ev_async_thread(void *data)
+{
+    struct test_ev_async *a = data;
+
+    usleep(10000);
+    utk_ev_async_send(a->loop, &a->async);
+    utk_ev_async_send(a->loop, &a->async);
+
+    return NULL;
+}
+
+struct test_ev_signal {
+    struct utk_ev_signal sig;
+    unsigned int calls;
+};
+
+static void test_ev_signal_cb(struct utk_ev_loop *loop,
+			      struct utk_ev_signal *sig)
+{
+    struct test_ev_signal *s = container_of(sig, struct test_ev_signal, sig);
+
+    s->calls++;
+    utk_ev_stop(loop);
+}
+
+UTK_TEST_DEF(test_ev_async_and_signal)
+{
+    struct utk_ev_loop loop;
+    struct test_ev_async a;
+    struct test_ev_signal s;
+    pthread_t thread;
+
+    UTK_TEST_ASSERT(utk_ev_loop_init(&loop, 0) == 0);
+
+    memset(&a, 0, sizeof(a));
+    a.loop = &loop;
+    utk_ev_async_start(&loop, &a.async, test_ev_async_cb);
+    UTK_TEST_ASSERT(pthread_create(&thread, NULL, test_ev_async_thread,
+				   &a) == 0);
+    UTK_TEST_ASSERT(utk_ev_run(&loop) == 0);
+    UTK_TEST_ASSERT(pthread_join(thread, NULL) == 0);
+    /* the two sends may be coalesced */
+    utk_ev_run_once(&loop, 0);
+    UTK_TEST_ASSERT(a.calls == 1 || a.calls == 2);
+    utk_ev_async_stop(&loop, &a.async);
+
+    memset(&s, 0, sizeof(s));
+    UTK_TEST_ASSERT(utk_ev_signal_start(&loop, &s.sig, SIGUSR1,
+					test_ev_signal_cb) == 0);
+    UTK_TEST_ASSERT(kill(getpid(), SIGUSR1) == 0);
+    UTK_TEST_ASSERT(utk_ev_run(&loop) == 0);
+    UTK_TEST_ASSERT(s.calls == 1);
+    utk_ev_signal_stop(&loop, &s.sig);
+
+    utk_ev_loop_cleanup(&loop);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/ev");
+
+    UTK_TEST_RUN(test_ev_io);
+
+    UTK_TEST_RUN(test_io_nonblock);
+
+    UTK_TEST_RUN(test_ev_timer);
+
+    UTK_TEST_RUN(test_ev_async_and_signal);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/heap.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TEST_HEAP_NB 2000
+
+struct test_heap_item {
+    struct utk_heap_node hnode;
+    struct utk_pheap_node pnode;
+    unsigned int key;
+    int queued;
+};
+
+static int test_heap_cmp(const struct utk_heap_node *a,
+			 const struct utk_heap_node *b)
+{
+    unsigned int ka = utk_heap_entry(a, const struct test_heap_item,
+				     hnode)->key;
+    unsigned int kb = utk_heap_entry(b, const struct test_heap_item,
+				     hnode)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static int test_pheap_cmp(const struct utk_pheap_node *a,
+			  const struct utk_pheap_node *b)
+{
+    unsigned int ka = utk_pheap_entry(a, const struct test_heap_item,
+				      pnode)->key;
+    unsigned int kb = utk_pheap_entry(b, const struct test_heap_item,
+				      pnode)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Smallest key of the queued items
+ */
+static unsigned int test_heap_min(const struct test_heap_item *items)
+{
+    unsigned int min = UINT32_MAX;
+    size_t i;
+
+    for(i = 0; i < TEST_HEAP_NB; ++i)
+    {
+	if(items[i].queued && items[i].key < min)
+	{
+	    min = items[i].key;
+	}
+    }
+
+    return min;
+}
+
+UTK_TEST_DEF(test_heap_dary)
+{
+    struct utk_heap heap;
+    struct test_heap_item *items = NULL;
+    struct test_heap_item *item = NULL;
+    unsigned int seed = 1,
+	r;
+    size_t arity,
+	count,
+	i;
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_heap_init(&heap, 1, test_heap_cmp) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    items = calloc(TEST_HEAP_NB, sizeof(*items));
+    UTK_TEST_ASSERT(items != NULL);
+
+    for(arity = 2; arity <= 8; arity += 3)
+    {
+	UTK_TEST_ASSERT(utk_heap_init(&heap, arity, test_heap_cmp) == 0);
+	UTK_TEST_ASSERT(utk_heap_pop(&heap) == NULL);
+	memset(items, 0, TEST_HEAP_NB * sizeof(*items));
+	count = 0;
+
+	for(i = 0; i < 100000; ++i)
+	{
+	    seed = seed * 1103515245 + 12345;
+	    r = seed >> 8;
+	    item = &items[r % TEST_HEAP_NB];
+	    seed = seed * 1103515245 + 12345;
+
+	    if(!item->queued)
+	    {
+		item->key = seed >> 20;
+		UTK_TEST_ASSERT(utk_heap_push(&heap, &item->hnode) == 0);
+		item->queued = 1;
+		count++;
+	    }
+	    else if(r % 5 == 0)
+	    {
+		/* decrease or increase */
+		item->key = seed >> 20;
+		utk_heap_update(&heap, &item->hnode);
+	    }
+	    else if(r % 5 == 1)
+	    {
+		utk_heap_remove(&heap, &item->hnode);
+		UTK_TEST_ASSERT(!utk_heap_queued(&item->hnode));
+		item->queued = 0;
+		count--;
+	    }
+	    else
+	    {
+		item = utk_heap_entry(utk_heap_pop(&heap),
+				      struct test_heap_item, hnode);
+		UTK_TEST_ASSERT(item->queued);
+		UTK_TEST_ASSERT(item->key <= test_heap_min(items));
+		item->queued = 0;
+		count--;
+	    }
+
+	    UTK_TEST_ASSERT(utk_heap_count(&heap) == count);
+	    if(count > 0)
+	    {
+		item = utk_heap_entry(utk_heap_top(&heap),
+				      struct test_heap_item, hnode);
+		UTK_TEST_ASSERT(item->key == test_heap_min(items));
+	    }
+	}
+
+	utk_heap_cleanup(&heap);
+    }
+
+    free(items);
+}
+
+UTK_TEST_DEF(test_heap_pairing)
+{
+    struct utk_pheap heap;
+    struct test_heap_item *items = NULL;
+    struct test_heap_item *item = NULL;
+    unsigned int seed = 2,
+	prev,
+	r;
+    size_t count = 0,
+	i;
+
+    items = calloc(TEST_HEAP_NB, sizeof(*items));
+    UTK_TEST_ASSERT(items != NULL);
+
+    utk_pheap_init(&heap, test_pheap_cmp);
+    UTK_TEST_ASSERT(utk_pheap_pop(&heap) == NULL);
+
+    for(i = 0; i < 100000; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	r = seed >> 8;
+	item = &items[r % TEST_HEAP_NB];
+	seed = seed * 1103515245 + 12345;
+
+	if(!item->queued)
+	{
+	    item->key = seed >> 20;
+	    utk_pheap_push(&heap, &item->pnode);
+	    item->queued = 1;
+	    count++;
+	}
+	else if(r % 5 == 0)
+	{
+	    /* decrease only */
+	    item->key /= 2;
+	    utk_pheap_decrease(&heap, &item->pnode);
+	}
+	else if(r % 5 == 1)
+	{
+	    utk_pheap_remove(&heap, &item->pnode);
+	    UTK_TEST_ASSERT(!utk_pheap_queued(&heap, &item->pnode));
+	    item->queued = 0;
+	    count--;
+	}
+	else
+	{
+	    item = utk_pheap_entry(utk_pheap_pop(&heap),
+				   struct test_heap_item, pnode);
+	    UTK_TEST_ASSERT(item->queued);
+	    UTK_TEST_ASSERT(item->key <= test_heap_min(items));
+	    UTK_TEST_ASSERT(!utk_pheap_queued(&heap, &item->pnode));
+	    item->queued = 0;
+	    count--;
+	}
+
+	UTK_TEST_ASSERT(utk_pheap_count(&heap) == count);
+	if(count > 0)
+	{
+	    item = utk_pheap_entry(utk_pheap_top(&heap),
+				   struct test_heap_item, pnode);
+	    UTK_TEST_ASSERT(item->key == test_heap_min(items));
+	}
+    }
+
+    /* drain in order */
+    prev = 0;
+    while((item = utk_pheap_entry_safe(utk_pheap_pop(&heap),
+				       struct test_heap_item, pnode)) != NULL)
+    {
+	UTK_TEST_ASSERT(item->key >= prev);
+	prev = item->key;
+	count--;
+    }
+    UTK_TEST_ASSERT(count == 0);
+
+    free(items);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/heap");
+
+    UTK_TEST_RUN(test_heap_dary);
+
+    UTK_TEST_RUN(test_heap_pairing);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/hmap.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+UTK_HMAP_DEFINE(test_map, uint64_t, uint32_t, utk_hmap_hash_u64, UTK_HMAP_EQ)
+
+/* one home slot per 1024 slots: long runs */
+#define test_hmap_hash_bad(key) ((size_t)(key) << 10)
+
+UTK_HMAP_DEFINE(test_bad_map, uint64_t, int, test_hmap_hash_bad, UTK_HMAP_EQ)
+
+/*
+ * Pseudo random numbers (xorshift)
+ */
+static uint64_t test_hmap_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+UTK_TEST_DEF(test_hmap_put_get_del)
+{
+    struct test_map map;
+    uint32_t *val = NULL;
+    uint64_t i;
+
+    UTK_TEST_ASSERT(test_map_init(&map, 0, 0) == 0);
+    UTK_TEST_ASSERT(map.mask + 1 == UTK_HMAP_MIN_SIZE);
+    UTK_TEST_ASSERT(test_map_get(&map, 1) == NULL);
+
+    for(i = 0; i < 100000; ++i)
+    {
+	UTK_TEST_ASSERT(test_map_put(&map, i * 3, (uint32_t)i) == 0);
+    }
+    UTK_TEST_ASSERT(test_map_count(&map) == 100000);
+    /* 100000 / 0.8 */
+    UTK_TEST_ASSERT(map.mask + 1 == 131072);
+
+    for(i = 0; i < 100000; ++i)
+    {
+	val = test_map_get(&map, i * 3);
+	UTK_TEST_ASSERT(val != NULL && *val == i);
+	UTK_TEST_ASSERT(test_map_get(&map, i * 3 + 1) == NULL);
+    }
+
+    /* replace */
+    UTK_TEST_ASSERT(test_map_put(&map, 3, 42) == 0);
+    UTK_TEST_ASSERT(*test_map_get(&map, 3) == 42);
+    UTK_TEST_ASSERT(test_map_count(&map) == 100000);
+
+    for(i = 0; i < 100000; i += 2)
+    {
+	UTK_TEST_ASSERT(test_map_del(&map, i * 3) == 0);
+    }
+    errno = 0;
+    UTK_TEST_ASSERT(test_map_del(&map, 0) == -1);
+    UTK_TEST_ASSERT(errno == ENOENT);
+    UTK_TEST_ASSERT(test_map_count(&map) == 50000);
+
+    for(i = 0; i < 100000; ++i)
+    {
+	val = test_map_get(&map, i * 3);
+	UTK_TEST_ASSERT(i % 2 == 0 ? val == NULL : val != NULL);
+    }
+
+    test_map_cleanup(&map);
+}
+
+UTK_TEST_DEF(test_hmap_random)
+{
+    struct test_map map;
+    uint32_t ref[4096];
+    uint32_t *val = NULL;
+    uint64_t state = 88172645463325252ULL;
+    uint64_t r;
+    size_t count = 0,
+	i;
+    unsigned int k;
+
+    /* 0 means absent in ref */
+    memset(ref, 0, sizeof(ref));
+    UTK_TEST_ASSERT(test_map_init(&map, 100, 100) == -1);
+    UTK_TEST_ASSERT(test_map_init(&map, 100, 90) == 0);
+
+    for(i = 0; i < 1000000; ++i)
+    {
+	r = test_hmap_rand(&state);
+	k = (unsigned int)(r % 4096);
+	if((r >> 32) % 3 == 0)
+	{
+	    UTK_TEST_ASSERT(test_map_del(&map, k) == (ref[k] != 0 ? 0 : -1));
+	    count -= ref[k] != 0;
+	    ref[k] = 0;
+	}
+	else
+	{
+	    count += ref[k] == 0;
+	    ref[k] = (uint32_t)(r >> 40) | 1;
+	    UTK_TEST_ASSERT(test_map_put(&map, k, ref[k]) == 0);
+	}
+	UTK_TEST_ASSERT(test_map_count(&map) == count);
+	UTK_TEST_ASSERT(map.count <= map.max_count);
+    }
+
+    for(k = 0; k < 4096; ++k)
+    {
+	val = test_map_get(&map, k);
+	UTK_TEST_ASSERT(ref[k] == 0 ? val == NULL : *val == ref[k]);
+    }
+
+    test_map_cleanup(&map);
+}
+
+UTK_TEST_DEF(test_hmap_iterate)
+{
+    struct test_map map;
+    unsigned char seen[1000];
+    size_t count = 0,
+	i;
+
+    memset(seen, 0, sizeof(seen));
+    UTK_TEST_ASSERT(test_map_init(&map, 1000, 50) == 0);
+    UTK_TEST_ASSERT(map.mask + 1 == 2048);
+
+    for(i = 0; i < 1000; ++i)
+    {
+	UTK_TEST_ASSERT(test_map_put(&map, i, (uint32_t)(i * 2)) == 0);
+    }
+    /* no growth: the size was given */
+    UTK_TEST_ASSERT(map.mask + 1 == 2048);
+
+    utk_hmap_for_each(i, &map)
+    {
+	UTK_TEST_ASSERT(utk_hmap_val(&map, i) == utk_hmap_key(&map, i) * 2);
+	seen[utk_hmap_key(&map, i)]++;
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 1000);
+    for(i = 0; i < 1000; ++i)
+    {
+	UTK_TEST_ASSERT(seen[i] == 1);
+    }
+
+    test_map_cleanup(&map);
+}
+
+UTK_TEST_DEF(test_hmap_collisions)
+{
+    struct test_bad_map map;
+    int *val = NULL;
+    uint64_t i;
+
+    UTK_TEST_ASSERT(test_bad_map_init(&map, 0, 0) == 0);
+
+    /* runs longer than UTK_HMAP_MAX_DIST force growths */
+    for(i = 0; i < 600; ++i)
+    {
+	UTK_TEST_ASSERT(test_bad_map_put(&map, i, (int)i) == 0);
+    }
+    UTK_TEST_ASSERT(test_bad_map_count(&map) == 600);
+
+    for(i = 0; i < 600; ++i)
+    {
+	val = test_bad_map_get(&map, i);
+	UTK_TEST_ASSERT(val != NULL && *val == (int)i);
+    }
+    for(i = 0; i < 600; i += 3)
+    {
+	UTK_TEST_ASSERT(test_bad_map_del(&map, i) == 0);
+    }
+    for(i = 0; i < 600; ++i)
+    {
+	val = test_bad_map_get(&map, i);
+	UTK_TEST_ASSERT(i % 3 == 0 ? val == NULL : *val == (int)i);
+    }
+
+    test_bad_map_cleanup(&map);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/hmap");
+
+    UTK_TEST_RUN(test_hmap_put_get_del);
+
+    UTK_TEST_RUN(test_hmap_random);
+
+    UTK_TEST_RUN(test_hmap_iterate);
+
+    UTK_TEST_RUN(test_hmap_collisions);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/htable.h>
+#include <utk/unit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+struct test_htable_item {
+    struct utk_htable_node node;
+    uint64_t key;
+    int seen;
+};
+
+static size_t test_htable_hash(const void *key)
+{
+    return utk_htable_hash_u64(*(const uint64_t *)key);
+}
+
+/* all keys in the same bucket */
+static size_t test_htable_hash_bad(const void *key)
+{
+    (void)key;
+    return 42;
+}
+
+static int test_htable_cmp(const struct utk_htable_node *node,
+			   const void *key)
+{
+    const struct test_htable_item *item =
+	utk_htable_entry(node, const struct test_htable_item, node);
+
+    return item->key != *(const uint64_t *)key;
+}
+
+static struct test_htable_item *test_htable_get(struct utk_htable *ht,
+						uint64_t key)
+{
+    return utk_htable_entry_safe(utk_htable_find(ht, &key),
+				 struct test_htable_item, node);
+}
+
+UTK_TEST_DEF(test_htable_add_find_del)
+{
+    struct utk_htable ht;
+    struct test_htable_item *items = NULL;
+    struct test_htable_item *item = NULL;
+    uint64_t key;
+    size_t nb = 100000,
+	i;
+
+    items = calloc(nb, sizeof(*items));
+    UTK_TEST_ASSERT(items != NULL);
+    UTK_TEST_ASSERT(utk_htable_init(&ht, 0, test_htable_hash,
+				    test_htable_cmp) == 0);
+
+    /* grows (and rehashes) many times */
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = i * 7;
+	UTK_TEST_ASSERT(utk_htable_add(&ht, &items[i].node,
+				       &items[i].key) == 0);
+
+	/* entries stay reachable while rehashing */
+	if(i % 997 == 0)
+	{
+	    UTK_TEST_ASSERT(test_htable_get(&ht, 0) == &items[0]);
+	    UTK_TEST_ASSERT(test_htable_get(&ht, i * 7) == &items[i]);
+	}
+    }
+    UTK_TEST_ASSERT(utk_htable_count(&ht) == nb);
+
+    for(i = 0; i < nb; ++i)
+    {
+	UTK_TEST_ASSERT(test_htable_get(&ht, i * 7) == &items[i]);
+    }
+    UTK_TEST_ASSERT(test_htable_get(&ht, 1) == NULL);
+    UTK_TEST_ASSERT(test_htable_get(&ht, nb * 7) == NULL);
+
+    /* delete odd keys */
+    for(i = 1; i < nb; i += 2)
+    {
+	utk_htable_del(&ht, &items[i].node);
+	UTK_TEST_ASSERT(utk_hlist_unhashed(&items[i].node.node));
+    }
+    UTK_TEST_ASSERT(utk_htable_count(&ht) == nb / 2);
+
+    for(i = 0; i < nb; ++i)
+    {
+	item = test_htable_get(&ht, i * 7);
+	UTK_TEST_ASSERT(item == (i % 2 == 0 ? &items[i] : NULL));
+    }
+
+    key = 14;
+    UTK_TEST_ASSERT(utk_htable_find_next(&ht, utk_htable_find(&ht, &key),
+					 &key) == NULL);
+
+    utk_htable_cleanup(&ht);
+    free(items);
+}
+
+UTK_TEST_DEF(test_htable_iterate)
+{
+    struct utk_htable ht;
+    struct test_htable_item items[560];
+    struct test_htable_item *pos = NULL;
+    struct test_htable_item *n = NULL;
+    struct utk_htable_node *node = NULL;
+    size_t count,
+	i;
+
+    memset(items, 0, sizeof(items));
+    UTK_TEST_ASSERT(utk_htable_init(&ht, 0, test_htable_hash,
+				    test_htable_cmp) == 0);
+
+    count = 0;
+    utk_htable_for_each(node, &ht)
+    {
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 0);
+
+    /* 560 entries: the table is being rehashed from 512 to 1024 */
+    for(i = 0; i < 560; ++i)
+    {
+	items[i].key = i;
+	utk_htable_add(&ht, &items[i].node, &items[i].key);
+    }
+    UTK_TEST_ASSERT(ht.buckets[1] != NULL);
+
+    utk_htable_for_each_entry(pos, &ht, node)
+    {
+	pos->seen++;
+    }
+    for(i = 0; i < 560; ++i)
+    {
+	UTK_TEST_ASSERT(items[i].seen == 1);
+    }
+
+    /* delete while iterating */
+    count = 0;
+    utk_htable_for_each_entry_safe(pos, n, &ht, node)
+    {
+	if(pos->key % 3 == 0)
+	{
+	    utk_htable_del(&ht, &pos->node);
+	}
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 560);
+    UTK_TEST_ASSERT(utk_htable_count(&ht) == 373);
+
+    count = 0;
+    utk_htable_for_each_entry(pos, &ht, node)
+    {
+	UTK_TEST_ASSERT(pos->key % 3 != 0);
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 373);
+
+    utk_htable_cleanup(&ht);
+}
+
+UTK_TEST_DEF(test_htable_collisions)
+{
+    struct utk_htable ht;
+    struct test_htable_item items[64];
+    struct test_htable_item *pos = NULL;
+    uint64_t key = 5;
+    size_t count,
+	i;
+
+    memset(items, 0, sizeof(items));
+    UTK_TEST_ASSERT(utk_htable_init(&ht, 16, test_htable_hash_bad,
+				    test_htable_cmp) == 0);
+
+    /* 32 distinct keys, then 32 duplicates of key 5 */
+    for(i = 0; i < 64; ++i)
+    {
+	items[i].key = i < 32 ? i : 5;
+	utk_htable_add(&ht, &items[i].node, &items[i].key);
+    }
+    for(i = 0; i < 32; ++i)
+    {
+	UTK_TEST_ASSERT(test_htable_get(&ht, i) != NULL);
+	UTK_TEST_ASSERT(test_htable_get(&ht, i)->key == i);
+    }
+    UTK_TEST_ASSERT(test_htable_get(&ht, 32) == NULL);
+
+    count = 0;
+    utk_htable_for_each_possible_entry(pos, &ht, &key, node)
+    {
+	UTK_TEST_ASSERT(pos->key == 5);
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 33);
+
+    utk_htable_cleanup(&ht);
+}
+
+UTK_TEST_DEF(test_htable_str)
+{
+    struct utk_htable_node node;
+
+    UTK_TEST_ASSERT(utk_htable_hash_str("") == (size_t)0xcbf29ce484222325ULL);
+    UTK_TEST_ASSERT(utk_htable_hash_str("a") == (size_t)0xaf63dc4c8601ec8cULL);
+    UTK_TEST_ASSERT(utk_htable_hash_u64(1) != utk_htable_hash_u64(2));
+
+    utk_hlist_node_init(&node.node);
+    UTK_TEST_ASSERT(utk_hlist_unhashed(&node.node));
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/htable");
+
+    UTK_TEST_RUN(test_htable_add_find_del);
+
+    UTK_TEST_RUN(test_htable_iterate);
+
+    UTK_TEST_RUN(test_htable_collisions);
+
+    UTK_TEST_RUN(test_htable_str);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -28,10 +28,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 UTK_TEST_DEF(test_io_write_and_read)
 {
@@ -116,6 +118,927 @@ UTK_TEST_DEF(test_io_file_write_and_read)
     unlink("/tmp/test_io_write");
 }
 
+#define TEST_IO_PRW_THREADS 8
+#define TEST_IO_PRW_BLOCKS 64
+#define TEST_IO_PRW_BLOCK_SIZE 512
+
+struct test_io_prw_arg {
+    int fd;
+    unsigned int id;
+    int ret;
+};
+
+static void *test_io_prw_thread(void *data)
+{
+    struct test_io_prw_arg *arg = data;
+    char block[TEST_IO_PRW_BLOCK_SIZE];
+    char rblock[TEST_IO_PRW_BLOCK_SIZE];
+    unsigned int i;
+    off_t offset;
+
+    arg->ret = 0;
+
+    /* thread id writes blocks id, id + TEST_IO_PRW_THREADS, ... */
+    for(i = arg->id; i < TEST_IO_PRW_BLOCKS; i += TEST_IO_PRW_THREADS)
+    {
+	memset(block, 'A' + (int)i % 26, sizeof(block));
+	offset = (off_t)i * TEST_IO_PRW_BLOCK_SIZE;
+
+	if(utk_io_pwrite(arg->fd, block, sizeof(block), offset)
+	   != (ssize_t)sizeof(block)
+	   || utk_io_pread(arg->fd, rblock, sizeof(rblock), offset)
+	   != (ssize_t)sizeof(rblock)
+	   || memcmp(block, rblock, sizeof(block)) != 0)
+	{
+	    arg->ret = -1;
+	}
+    }
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_io_pwrite_and_pread)
+{
+    int fd;
+    unsigned int i;
+    ssize_t ret;
+    char buf[TEST_IO_PRW_BLOCK_SIZE];
+    pthread_t threads[TEST_IO_PRW_THREADS];
+    struct test_io_prw_arg args[TEST_IO_PRW_THREADS];
+
+    fd = open("/tmp/test_io_prw", O_CREAT | O_RDWR | O_TRUNC, 0666);
+    UTK_TEST_ASSERT(fd >= 0);
+
+    /* threads share the same descriptor */
+    for(i = 0; i < TEST_IO_PRW_THREADS; ++i)
+    {
+	args[i].fd = fd;
+	args[i].id = i;
+	UTK_TEST_ASSERT(pthread_create(&threads[i], NULL,
+					test_io_prw_thread, &args[i]) == 0);
+    }
+
+    for(i = 0; i < TEST_IO_PRW_THREADS; ++i)
+    {
+	pthread_join(threads[i], NULL);
+	UTK_TEST_ASSERT(args[i].ret == 0);
+    }
+
+    /* file offset is untouched */
+    UTK_TEST_ASSERT(lseek(fd, 0, SEEK_CUR) == 0);
+
+    for(i = 0; i < TEST_IO_PRW_BLOCKS; ++i)
+    {
+	ret = utk_io_pread(fd, buf, sizeof(buf),
+			   (off_t)i * TEST_IO_PRW_BLOCK_SIZE);
+	UTK_TEST_ASSERT(ret == (ssize_t)sizeof(buf));
+	UTK_TEST_ASSERT(buf[0] == 'A' + (int)i % 26
+			&& buf[sizeof(buf) - 1] == 'A' + (int)i % 26);
+    }
+
+    /* short read at end of file */
+    ret = utk_io_pread(fd, buf, sizeof(buf),
+		       (off_t)TEST_IO_PRW_BLOCKS * TEST_IO_PRW_BLOCK_SIZE - 10);
+    UTK_TEST_ASSERT(ret == 10);
+
+    ret = utk_io_pread(fd, buf, sizeof(buf),
+		       (off_t)TEST_IO_PRW_BLOCKS * TEST_IO_PRW_BLOCK_SIZE);
+    UTK_TEST_ASSERT(ret == 0);
+
+    close(fd);
+    unlink("/tmp/test_io_prw");
+}
+
+struct test_io_counting_alloc {
+    unsigned int nb_realloc;
+    unsigned int nb_free;
+};
+
+static void *test_io_counting_realloc(void *opaque, void *ptr,
+				      size_t old_size, size_t new_size)
+{
+    struct test_io_counting_alloc *ca = opaque;
+
+    (void)old_size;
+    ca->nb_realloc++;
+
+    return realloc(ptr, new_size);
+}
+
+static void test_io_counting_free(void *opaque, void *ptr)
+{
+    struct test_io_counting_alloc *ca = opaque;
+
+    ca->nb_free++;
+    free(ptr);
+}
+
+UTK_TEST_DEF(test_io_file_read_all)
+{
+    ssize_t ret;
+    char *buf = NULL;
+    char big[10000];
+    int pipefd[2];
+    struct test_io_counting_alloc ca = { 0, 0 };
+    struct utk_io_allocator alloc = {
+	test_io_counting_realloc,
+	test_io_counting_free,
+	&ca,
+    };
+
+    /* regular file is sized by fstat(): only one allocation */
+    memset(big, 'x', sizeof(big));
+    unlink("/tmp/test_io_read_all");
+    ret = utk_io_file_write("/tmp/test_io_read_all", big, sizeof(big));
+    UTK_TEST_ASSERT(ret == (ssize_t)sizeof(big));
+
+    ret = utk_io_file_read_all("/tmp/test_io_read_all", (void **)&buf, &alloc);
+    UTK_TEST_ASSERT(ret == (ssize_t)sizeof(big));
+    UTK_TEST_ASSERT(memcmp(buf, big, sizeof(big)) == 0);
+    UTK_TEST_ASSERT(buf[ret] == '\0');
+    UTK_TEST_ASSERT(ca.nb_realloc == 1);
+    free(buf);
+
+    /* empty file */
+    unlink("/tmp/test_io_read_all");
+    ret = utk_io_file_write("/tmp/test_io_read_all", "", 0);
+    UTK_TEST_ASSERT(ret == 0);
+
+    ret = utk_io_file_read_all("/tmp/test_io_read_all", (void **)&buf, NULL);
+    UTK_TEST_ASSERT(ret == 0);
+    UTK_TEST_ASSERT(buf[0] == '\0');
+    free(buf);
+
+    unlink("/tmp/test_io_read_all");
+
+    /* unknown size: buffer grows */
+    UTK_TEST_ASSERT(pipe(pipefd) == 0);
+    ret = utk_io_write(pipefd[1], big, 5000);
+    UTK_TEST_ASSERT(ret == 5000);
+    close(pipefd[1]);
+
+    ca.nb_realloc = 0;
+    ret = utk_io_read_all(pipefd[0], (void **)&buf, &alloc);
+    close(pipefd[0]);
+    UTK_TEST_ASSERT(ret == 5000);
+    UTK_TEST_ASSERT(memcmp(buf, big, 5000) == 0);
+    UTK_TEST_ASSERT(buf[ret] == '\0');
+    UTK_TEST_ASSERT(ca.nb_realloc == 2);
+    free(buf);
+
+    /* procfs file: st_size is 0 */
+    ret = utk_io_file_read_all("/proc/self/status", (void **)&buf, NULL);
+    UTK_TEST_ASSERT(ret > 0);
+    UTK_TEST_ASSERT(strlen(buf) == (size_t)ret);
+    free(buf);
+
+    /* error */
+    ca.nb_realloc = 0;
+    ret = utk_io_file_read_all("/tmp/test_io_read_all_doesnt_exist",
+			       (void **)&buf, &alloc);
+    UTK_TEST_ASSERT(ret == -1);
+    UTK_TEST_ASSERT(ca.nb_realloc == 0);
+}
+
+UTK_TEST_DEF(test_io_file_replace)
+{
+    ssize_t ret;
+    char buf[128];
+    struct stat st;
+    const char *long_str = "hello there, a long string !";
+    const char *short_str = "hi";
+
+    unlink("/tmp/test_io_replace");
+
+    ret = utk_io_file_replace("/tmp/test_io_replace",
+			      long_str, strlen(long_str));
+    UTK_TEST_ASSERT(ret == (ssize_t)strlen(long_str));
+
+    UTK_TEST_ASSERT(chmod("/tmp/test_io_replace", 0600) == 0);
+
+    /* shorter content must not leave stale tail bytes */
+    ret = utk_io_file_replace("/tmp/test_io_replace",
+			      short_str, strlen(short_str));
+    UTK_TEST_ASSERT(ret == (ssize_t)strlen(short_str));
+
+    ret = utk_io_file_read("/tmp/test_io_replace", buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == (ssize_t)strlen(short_str));
+    buf[ret] = '\0';
+    UTK_TEST_ASSERT(strcmp(buf, short_str) == 0);
+
+    /* mode is kept */
+    UTK_TEST_ASSERT(stat("/tmp/test_io_replace", &st) == 0);
+    UTK_TEST_ASSERT((st.st_mode & 07777) == 0600);
+
+    unlink("/tmp/test_io_replace");
+
+    /* directory doesn't exist */
+    ret = utk_io_file_replace("/tmp/test_io_replace_doesnt_exist/file",
+			      short_str, strlen(short_str));
+    UTK_TEST_ASSERT(ret == -1);
+}
+
+#define TEST_IO_GC_THREADS 8
+#define TEST_IO_GC_LOOPS 16
+
+struct test_io_gc_arg {
+    struct utk_io_group_commit *gc;
+    unsigned int id;
+    int ret;
+};
+
+static void *test_io_gc_thread(void *data)
+{
+    struct test_io_gc_arg *arg = data;
+    char filename[64];
+    char content[64];
+    unsigned int i;
+    ssize_t ret;
+
+    snprintf(filename, sizeof(filename), "/tmp/test_io_gc_%u", arg->id);
+
+    arg->ret = 0;
+    for(i = 0; i < TEST_IO_GC_LOOPS; ++i)
+    {
+	snprintf(content, sizeof(content), "thread %u loop %u", arg->id, i);
+
+	ret = utk_io_group_commit_replace(arg->gc, filename,
+					  content, strlen(content));
+	if(ret != (ssize_t)strlen(content))
+	{
+	    arg->ret = -1;
+	}
+    }
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_io_group_commit_replace)
+{
+    struct utk_io_group_commit gc;
+    struct test_io_gc_arg args[TEST_IO_GC_THREADS];
+    pthread_t threads[TEST_IO_GC_THREADS];
+    char filename[64];
+    char expected[64];
+    char buf[64];
+    unsigned int i;
+    ssize_t ret;
+
+    UTK_TEST_ASSERT(utk_io_group_commit_init(&gc, "/tmp") == 0);
+
+    for(i = 0; i < TEST_IO_GC_THREADS; ++i)
+    {
+	args[i].gc = &gc;
+	args[i].id = i;
+	UTK_TEST_ASSERT(pthread_create(&threads[i], NULL,
+					test_io_gc_thread, &args[i]) == 0);
+    }
+
+    for(i = 0; i < TEST_IO_GC_THREADS; ++i)
+    {
+	pthread_join(threads[i], NULL);
+	UTK_TEST_ASSERT(args[i].ret == 0);
+    }
+
+    utk_io_group_commit_cleanup(&gc);
+
+    for(i = 0; i < TEST_IO_GC_THREADS; ++i)
+    {
+	snprintf(filename, sizeof(filename), "/tmp/test_io_gc_%u", i);
+	snprintf(expected, sizeof(expected), "thread %u loop %u",
+		 i, TEST_IO_GC_LOOPS - 1);
+
+	ret = utk_io_file_read(filename, buf, sizeof(buf) - 1);
+	UTK_TEST_ASSERT(ret == (ssize_t)strlen(expected));
+	buf[ret] = '\0';
+	UTK_TEST_ASSERT(strcmp(buf, expected) == 0);
+
+	unlink(filename);
+    }
+}
+
+UTK_TEST_DEF(test_io_direct_write_and_read)
+{
+    struct utk_io_direct dio;
+    char *buf = NULL,
+	*dst = NULL,
+	*content = NULL;
+    size_t len,
+	i;
+    ssize_t ret;
+
+    unlink("/tmp/test_io_direct");
+
+    if(utk_io_direct_open(&dio, "/tmp/test_io_direct",
+			  O_CREAT | O_WRONLY | O_TRUNC, 0644) != 0)
+    {
+	UTK_TEST_ASSERT(errno == EINVAL);
+	UTK_TEST_PRINT_WARNING("/tmp doesn't support O_DIRECT, skipped");
+	return;
+    }
+
+    UTK_TEST_ASSERT(dio.align != 0 && (dio.align & (dio.align - 1)) == 0);
+
+    /* aligned part and an unaligned tail */
+    len = 3 * dio.align + 100;
+    buf = utk_io_direct_alloc(&dio, len);
+    UTK_TEST_ASSERT(buf != NULL);
+    UTK_TEST_ASSERT(((uintptr_t)buf & (dio.align - 1)) == 0);
+    for(i = 0; i < len; ++i)
+    {
+	buf[i] = (char)(i * 7);
+    }
+
+    ret = utk_io_direct_write(&dio, buf, len);
+    UTK_TEST_ASSERT(ret == (ssize_t)len);
+    UTK_TEST_ASSERT(utk_io_direct_close(&dio) == 0);
+
+    ret = utk_io_file_read_all("/tmp/test_io_direct", (void **)&content, NULL);
+    UTK_TEST_ASSERT(ret == (ssize_t)len);
+    UTK_TEST_ASSERT(memcmp(content, buf, len) == 0);
+    free(content);
+
+    /* read back with direct I/O, destination is bigger than the file */
+    UTK_TEST_ASSERT(utk_io_direct_open(&dio, "/tmp/test_io_direct",
+				       O_RDONLY, 0) == 0);
+    dst = utk_io_direct_alloc(&dio, 4 * dio.align);
+    UTK_TEST_ASSERT(dst != NULL);
+
+    ret = utk_io_direct_read(&dio, dst, 4 * dio.align);
+    UTK_TEST_ASSERT(ret == (ssize_t)len);
+    UTK_TEST_ASSERT(memcmp(dst, buf, len) == 0);
+    UTK_TEST_ASSERT(utk_io_direct_close(&dio) == 0);
+
+    free(dst);
+    free(buf);
+    unlink("/tmp/test_io_direct");
+}
+
+UTK_TEST_DEF(test_io_direct_writer)
+{
+    struct utk_io_direct dio;
+    struct utk_io_direct_writer w;
+    char chunk[1000];
+    char *content = NULL;
+    unsigned int i;
+    size_t j;
+    ssize_t ret;
+
+    unlink("/tmp/test_io_direct");
+
+    if(utk_io_direct_open(&dio, "/tmp/test_io_direct",
+			  O_CREAT | O_WRONLY | O_TRUNC, 0644) != 0)
+    {
+	UTK_TEST_ASSERT(errno == EINVAL);
+	UTK_TEST_PRINT_WARNING("/tmp doesn't support O_DIRECT, skipped");
+	return;
+    }
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_direct_writer_init(&w, &dio, 0) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+    UTK_TEST_ASSERT(utk_io_direct_writer_init(&w, &dio, 16384) == 0);
+
+    /* 1000 chunks of 1000 bytes: several buffer swaps and a tail */
+    for(i = 0; i < 1000; ++i)
+    {
+	memset(chunk, 'a' + (int)(i % 26), sizeof(chunk));
+	ret = utk_io_direct_writer_write(&w, chunk, sizeof(chunk));
+	UTK_TEST_ASSERT(ret == (ssize_t)sizeof(chunk));
+    }
+
+    UTK_TEST_ASSERT(utk_io_direct_writer_cleanup(&w) == 0);
+    UTK_TEST_ASSERT(utk_io_direct_close(&dio) == 0);
+
+    ret = utk_io_file_read_all("/tmp/test_io_direct", (void **)&content, NULL);
+    UTK_TEST_ASSERT(ret == 1000 * (ssize_t)sizeof(chunk));
+    for(j = 0; j < (size_t)ret; ++j)
+    {
+	UTK_TEST_ASSERT(content[j] == 'a' + (int)((j / sizeof(chunk)) % 26));
+    }
+    free(content);
+
+    unlink("/tmp/test_io_direct");
+}
+
+struct test_io_parallel_cb_arg {
+    size_t total;
+    unsigned int nb_calls;
+};
+
+static int test_io_parallel_cb(void *opaque, const void *chunk,
+			       off_t offset, size_t len)
+{
+    struct test_io_parallel_cb_arg *arg = opaque;
+    const unsigned char *p = chunk;
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+    {
+	if(p[i] != (unsigned char)(((size_t)offset + i) % 251))
+	{
+	    return -1;
+	}
+    }
+
+    __atomic_fetch_add(&arg->total, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&arg->nb_calls, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+UTK_TEST_DEF(test_io_file_read_parallel)
+{
+    unsigned char *content = NULL,
+	*dst = NULL;
+    size_t len,
+	i;
+    ssize_t ret;
+    struct test_io_parallel_cb_arg arg = { 0, 0 };
+
+    len = 1000 * 1000 + 17;
+    content = malloc(len);
+    dst = malloc(len + 100);
+    UTK_TEST_ASSERT(content != NULL && dst != NULL);
+
+    for(i = 0; i < len; ++i)
+    {
+	content[i] = (unsigned char)(i % 251);
+    }
+
+    unlink("/tmp/test_io_parallel");
+    ret = utk_io_file_write("/tmp/test_io_parallel", content, len);
+    UTK_TEST_ASSERT(ret == (ssize_t)len);
+
+    /* destination bigger than file */
+    ret = utk_io_file_read_parallel("/tmp/test_io_parallel", dst, len + 100,
+				    4, 65536, test_io_parallel_cb, &arg);
+    UTK_TEST_ASSERT(ret == (ssize_t)len);
+    UTK_TEST_ASSERT(memcmp(content, dst, len) == 0);
+    UTK_TEST_ASSERT(arg.total == len);
+    UTK_TEST_ASSERT(arg.nb_calls == len / 65536 + 1);
+
+    /* default parameters, partial read */
+    memset(dst, 0, len);
+    ret = utk_io_file_read_parallel("/tmp/test_io_parallel", dst, len / 2,
+				    0, 0, NULL, NULL);
+    UTK_TEST_ASSERT(ret == (ssize_t)(len / 2));
+    UTK_TEST_ASSERT(memcmp(content, dst, len / 2) == 0);
+
+    free(content);
+    free(dst);
+    unlink("/tmp/test_io_parallel");
+
+    ret = utk_io_file_read_parallel("/tmp/test_io_parallel_doesnt_exist",
+				    NULL, 0, 0, 0, NULL, NULL);
+    UTK_TEST_ASSERT(ret == -1);
+}
+
+UTK_TEST_DEF(test_io_fdcache)
+{
+    struct utk_io_fdcache cache;
+    char buf[64];
+    char filename[64];
+    unsigned int i;
+    ssize_t ret;
+
+    UTK_TEST_ASSERT(utk_io_fdcache_init(&cache, 4, 0) == 0);
+
+    unlink("/tmp/test_io_fdcache");
+    ret = utk_io_fdcache_write(&cache, "/tmp/test_io_fdcache", "hello", 5);
+    UTK_TEST_ASSERT(ret == 5);
+    UTK_TEST_ASSERT(cache.count == 1);
+
+    /* reads hit the same descriptor and always start at offset 0 */
+    for(i = 0; i < 3; ++i)
+    {
+	ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+				  buf, sizeof(buf));
+	UTK_TEST_ASSERT(ret == 5);
+	UTK_TEST_ASSERT(memcmp(buf, "hello", 5) == 0);
+    }
+    UTK_TEST_ASSERT(cache.count == 2);
+
+    ret = utk_io_fdcache_write(&cache, "/tmp/test_io_fdcache", "HE", 2);
+    UTK_TEST_ASSERT(ret == 2);
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == 5);
+    UTK_TEST_ASSERT(memcmp(buf, "HEllo", 5) == 0);
+
+    /* replaced file isn't seen until invalidation */
+    ret = utk_io_file_replace("/tmp/test_io_fdcache", "new", 3);
+    UTK_TEST_ASSERT(ret == 3);
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == 5);
+
+    utk_io_fdcache_invalidate(&cache, "/tmp/test_io_fdcache");
+    UTK_TEST_ASSERT(cache.count == 0);
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == 3);
+    UTK_TEST_ASSERT(memcmp(buf, "new", 3) == 0);
+
+    /* LRU eviction */
+    for(i = 0; i < 8; ++i)
+    {
+	snprintf(filename, sizeof(filename), "/tmp/test_io_fdcache_%u", i);
+	ret = utk_io_fdcache_write(&cache, filename, "x", 1);
+	UTK_TEST_ASSERT(ret == 1);
+	UTK_TEST_ASSERT(cache.count <= 4);
+    }
+    UTK_TEST_ASSERT(cache.count == 4);
+
+    utk_io_fdcache_cleanup(&cache);
+
+    for(i = 0; i < 8; ++i)
+    {
+	snprintf(filename, sizeof(filename), "/tmp/test_io_fdcache_%u", i);
+	unlink(filename);
+    }
+
+    /* revalidation by inode */
+    UTK_TEST_ASSERT(utk_io_fdcache_init(&cache, 4,
+					UTK_IO_FDCACHE_REVALIDATE) == 0);
+
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == 3);
+
+    ret = utk_io_file_replace("/tmp/test_io_fdcache", "newer", 5);
+    UTK_TEST_ASSERT(ret == 5);
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == 5);
+    UTK_TEST_ASSERT(memcmp(buf, "newer", 5) == 0);
+
+    unlink("/tmp/test_io_fdcache");
+    ret = utk_io_fdcache_read(&cache, "/tmp/test_io_fdcache",
+			      buf, sizeof(buf));
+    UTK_TEST_ASSERT(ret == -1);
+    UTK_TEST_ASSERT(cache.count == 0);
+
+    utk_io_fdcache_cleanup(&cache);
+}
+
+struct test_io_log_cb_arg {
+    unsigned int count;
+    int ret;
+};
+
+static int test_io_log_cb(void *opaque, const void *data, size_t len,
+			  off_t offset)
+{
+    struct test_io_log_cb_arg *arg = opaque;
+    char expected[64];
+
+    (void)offset;
+
+    snprintf(expected, sizeof(expected), "record %u", arg->count);
+    if(len != strlen(expected) || memcmp(data, expected, len) != 0)
+    {
+	arg->ret = -1;
+    }
+    arg->count++;
+
+    return 0;
+}
+
+UTK_TEST_DEF(test_io_log)
+{
+    struct utk_io_log log;
+    struct test_io_log_cb_arg arg;
+    const int policies[] = {
+	UTK_IO_LOG_SYNC_NEVER,
+	UTK_IO_LOG_SYNC_ALWAYS,
+	UTK_IO_LOG_SYNC_INTERVAL,
+    };
+    char record[64];
+    char big[1000];
+    unsigned int i,
+	p;
+    off_t end;
+    int fd;
+
+    for(p = 0; p < UTK_ARRAY_SIZE(policies); ++p)
+    {
+	unlink("/tmp/test_io_log");
+
+	/* small buffer: some appends flush it */
+	UTK_TEST_ASSERT(utk_io_log_open(&log, "/tmp/test_io_log",
+					policies[p], 10, 256) == 0);
+	for(i = 0; i < 100; ++i)
+	{
+	    snprintf(record, sizeof(record), "record %u", i);
+	    UTK_TEST_ASSERT(utk_io_log_append(&log, record,
+					      strlen(record)) == 0);
+	}
+	UTK_TEST_ASSERT(utk_io_log_close(&log) == 0);
+
+	arg.count = 0;
+	arg.ret = 0;
+	end = utk_io_log_scan("/tmp/test_io_log", test_io_log_cb, &arg);
+	UTK_TEST_ASSERT(end > 0);
+	UTK_TEST_ASSERT(arg.count == 100 && arg.ret == 0);
+    }
+
+    /* torn record: a big record cut in the middle */
+    UTK_TEST_ASSERT(utk_io_log_open(&log, "/tmp/test_io_log",
+				    UTK_IO_LOG_SYNC_NEVER, 0, 256) == 0);
+    memset(big, 'b', sizeof(big));
+    UTK_TEST_ASSERT(utk_io_log_append(&log, big, sizeof(big)) == 0);
+    UTK_TEST_ASSERT(utk_io_log_close(&log) == 0);
+
+    UTK_TEST_ASSERT(truncate("/tmp/test_io_log",
+			     end + UTK_IO_LOG_HEADER_SIZE + 500) == 0);
+
+    arg.count = 0;
+    arg.ret = 0;
+    UTK_TEST_ASSERT(utk_io_log_scan("/tmp/test_io_log",
+				    test_io_log_cb, &arg) == end);
+    UTK_TEST_ASSERT(arg.count == 100 && arg.ret == 0);
+
+    /* corrupted record */
+    fd = open("/tmp/test_io_log", O_WRONLY);
+    UTK_TEST_ASSERT(fd >= 0);
+    UTK_TEST_ASSERT(utk_io_pwrite(fd, "X", 1, end - 1) == 1);
+    close(fd);
+
+    arg.count = 0;
+    UTK_TEST_ASSERT(utk_io_log_scan("/tmp/test_io_log",
+				    test_io_log_cb, &arg) < end);
+    UTK_TEST_ASSERT(arg.count == 99);
+
+    /* open truncates the bad tail, appends go on after the last record */
+    UTK_TEST_ASSERT(utk_io_log_open(&log, "/tmp/test_io_log",
+				    UTK_IO_LOG_SYNC_ALWAYS, 0, 0) == 0);
+    UTK_TEST_ASSERT(utk_io_log_append(&log, "record 99", 9) == 0);
+    UTK_TEST_ASSERT(utk_io_log_close(&log) == 0);
+
+    arg.count = 0;
+    arg.ret = 0;
+    UTK_TEST_ASSERT(utk_io_log_scan("/tmp/test_io_log",
+				    test_io_log_cb, &arg) == end);
+    UTK_TEST_ASSERT(arg.count == 100 && arg.ret == 0);
+
+    unlink("/tmp/test_io_log");
+}
+
+static void *test_io_stats_thread(void *data)
+{
+    int *fds = data;
+    char buf[64];
+
+    utk_io_read(fds[0], buf, sizeof(buf));
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_io_stats)
+{
+    struct utk_io_stats stats;
+    pthread_t thread;
+    char buf[100];
+    uint64_t total;
+    unsigned int i;
+    int enabled;
+    int fds[2];
+
+    enabled = utk_io_stats_enabled();
+    utk_io_stats_enable(1);
+    utk_io_stats_reset();
+
+    UTK_TEST_ASSERT(pipe(fds) == 0);
+
+    /* 10 bytes then end of file: 2 syscalls, 1 short transfer */
+    UTK_TEST_ASSERT(utk_io_write(fds[1], "0123456789", 10) == 10);
+    close(fds[1]);
+    UTK_TEST_ASSERT(utk_io_read(fds[0], buf, sizeof(buf)) == 10);
+
+    utk_io_stats_get(UTK_IO_STATS_READ, &stats);
+    UTK_TEST_ASSERT(stats.calls == 1);
+    UTK_TEST_ASSERT(stats.bytes == 10);
+    UTK_TEST_ASSERT(stats.syscalls == 2);
+    UTK_TEST_ASSERT(stats.short_transfers == 1);
+    UTK_TEST_ASSERT(stats.errors == 0);
+
+    total = 0;
+    for(i = 0; i < UTK_IO_STATS_NB_BUCKETS; ++i)
+    {
+	total += stats.latency[i];
+    }
+    UTK_TEST_ASSERT(total == 1);
+    UTK_TEST_ASSERT(utk_io_stats_percentile(&stats, 50) > 0);
+
+    utk_io_stats_get(UTK_IO_STATS_WRITE, &stats);
+    UTK_TEST_ASSERT(stats.calls == 1 && stats.bytes == 10);
+    UTK_TEST_ASSERT(stats.syscalls == 1 && stats.short_transfers == 0);
+
+    /* errors */
+    UTK_TEST_ASSERT(utk_io_read(fds[1], buf, sizeof(buf)) == -1);
+    utk_io_stats_get(UTK_IO_STATS_READ, &stats);
+    UTK_TEST_ASSERT(stats.calls == 2 && stats.errors == 1);
+
+    /* calls of other threads are aggregated */
+    UTK_TEST_ASSERT(pthread_create(&thread, NULL,
+				   test_io_stats_thread, fds) == 0);
+    UTK_TEST_ASSERT(pthread_join(thread, NULL) == 0);
+    utk_io_stats_get(UTK_IO_STATS_READ, &stats);
+    UTK_TEST_ASSERT(stats.calls == 3);
+
+    /* disabled */
+    utk_io_stats_enable(0);
+    utk_io_read(fds[0], buf, sizeof(buf));
+    utk_io_stats_get(UTK_IO_STATS_READ, &stats);
+    UTK_TEST_ASSERT(stats.calls == 3);
+
+    utk_io_stats_reset();
+    utk_io_stats_get(UTK_IO_STATS_READ, &stats);
+    UTK_TEST_ASSERT(stats.calls == 0 && stats.syscalls == 0);
+
+    fds[1] = open("/dev/null", O_WRONLY);
+    UTK_TEST_ASSERT(utk_io_stats_dump(fds[1]) == 0);
+    close(fds[1]);
+    close(fds[0]);
+
+    /* latency buckets are continuous */
+    for(i = 0; i < 200; ++i)
+    {
+	UTK_TEST_ASSERT(utk_io_stats_bucket_ns(i)
+			< utk_io_stats_bucket_ns(i + 1));
+    }
+
+    utk_io_stats_enable(enabled);
+}
+
+struct test_io_follow_arg {
+    char data[256];
+    size_t len;
+};
+
+static int test_io_follow_cb(void *opaque, const void *data, size_t len)
+{
+    struct test_io_follow_arg *arg = opaque;
+
+    if(arg->len + len > sizeof(arg->data))
+    {
+	return -1;
+    }
+
+    memcpy(arg->data + arg->len, data, len);
+    arg->len += len;
+
+    return 0;
+}
+
+static void test_io_follow_append(const char *filename, const char *data)
+{
+    int fd;
+
+    fd = open(filename, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if(fd >= 0)
+    {
+	utk_io_write(fd, data, strlen(data));
+	close(fd);
+    }
+}
+
+UTK_TEST_DEF(test_io_follow)
+{
+    struct utk_io_follow follow;
+    struct utk_io_follow_file *file = NULL,
+	*other = NULL;
+    struct test_io_follow_arg arg;
+    char buf[64];
+    ssize_t cc;
+
+    unlink("/tmp/test_io_follow");
+    unlink("/tmp/test_io_follow.1");
+    unlink("/tmp/test_io_follow_other");
+    test_io_follow_append("/tmp/test_io_follow", "old\n");
+
+    UTK_TEST_ASSERT(utk_io_follow_init(&follow, 16) == 0);
+
+    memset(&arg, 0, sizeof(arg));
+    file = utk_io_follow_add(&follow, "/tmp/test_io_follow", 0,
+			     test_io_follow_cb, &arg);
+    UTK_TEST_ASSERT(file != NULL);
+
+    /* not existing yet, read without callback */
+    other = utk_io_follow_add(&follow, "/tmp/test_io_follow_other",
+			      UTK_IO_FOLLOW_FROM_START, NULL, NULL);
+    UTK_TEST_ASSERT(other != NULL);
+
+    /* nothing new */
+    UTK_TEST_ASSERT(utk_io_follow_dispatch(&follow, 20) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_follow_read(&follow, other, buf, sizeof(buf), 0)
+		    == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    /* appended data, bigger than the delivery buffer */
+    test_io_follow_append("/tmp/test_io_follow", "appended 0123456789\n");
+    UTK_TEST_ASSERT(utk_io_follow_dispatch(&follow, 1000) == 1);
+    UTK_TEST_ASSERT(arg.len == 20);
+    UTK_TEST_ASSERT(memcmp(arg.data, "appended 0123456789\n", 20) == 0);
+
+    /* truncation */
+    arg.len = 0;
+    UTK_TEST_ASSERT(truncate("/tmp/test_io_follow", 0) == 0);
+    test_io_follow_append("/tmp/test_io_follow", "again\n");
+    while(arg.len < 6 && utk_io_follow_dispatch(&follow, 1000) > 0)
+    {
+    }
+    UTK_TEST_ASSERT(arg.len == 6 && memcmp(arg.data, "again\n", 6) == 0);
+
+    /* rotation: the end of the old file then the new one */
+    arg.len = 0;
+    test_io_follow_append("/tmp/test_io_follow", "end\n");
+    UTK_TEST_ASSERT(rename("/tmp/test_io_follow",
+			   "/tmp/test_io_follow.1") == 0);
+    test_io_follow_append("/tmp/test_io_follow", "new\n");
+    while(arg.len < 8 && utk_io_follow_dispatch(&follow, 1000) > 0)
+    {
+    }
+    UTK_TEST_ASSERT(arg.len == 8 && memcmp(arg.data, "end\nnew\n", 8) == 0);
+
+    /* the other file is created */
+    test_io_follow_append("/tmp/test_io_follow_other", "other\n");
+    cc = utk_io_follow_read(&follow, other, buf, sizeof(buf), 1000);
+    UTK_TEST_ASSERT(cc == 6 && memcmp(buf, "other\n", 6) == 0);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_follow_read(&follow, other, buf, sizeof(buf), 20)
+		    == -1);
+    UTK_TEST_ASSERT(errno == ETIMEDOUT);
+
+    /* a callback stops the dispatch */
+    arg.len = sizeof(arg.data);
+    test_io_follow_append("/tmp/test_io_follow", "x\n");
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_follow_dispatch(&follow, 1000) == -1);
+    UTK_TEST_ASSERT(errno == ECANCELED);
+
+    utk_io_follow_remove(&follow, other);
+    utk_io_follow_cleanup(&follow);
+
+    unlink("/tmp/test_io_follow");
+    unlink("/tmp/test_io_follow.1");
+    unlink("/tmp/test_io_follow_other");
+}
+
+UTK_TEST_DEF(test_io_prefetch)
+{
+    struct utk_io_prefetch pf;
+    unsigned char *buf = NULL;
+    const unsigned char *chunk = NULL;
+    size_t len = 5 * 1024 * 1024 + 123,
+	total,
+	i;
+    ssize_t cc;
+    int fd;
+
+    buf = malloc(len);
+    UTK_TEST_ASSERT(buf != NULL);
+    for(i = 0; i < len; ++i)
+    {
+	buf[i] = (unsigned char)(i / 4093);
+    }
+    UTK_TEST_ASSERT(utk_io_file_write("/tmp/test_io_prefetch", buf, len)
+		    == (ssize_t)len);
+
+    fd = open("/tmp/test_io_prefetch", O_RDONLY);
+    UTK_TEST_ASSERT(fd >= 0);
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_io_prefetch_open(&pf, fd, 1, 0, 0) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    /* from the current offset, chunks in order */
+    UTK_TEST_ASSERT(lseek(fd, 100, SEEK_SET) == 100);
+    UTK_TEST_ASSERT(utk_io_prefetch_open(&pf, fd, 3, 64 * 1024, 0) == 0);
+    total = 100;
+    while((cc = utk_io_prefetch_next(&pf, (const void **)&chunk)) > 0)
+    {
+	UTK_TEST_ASSERT(cc <= 64 * 1024);
+	UTK_TEST_ASSERT(memcmp(chunk, buf + total, (size_t)cc) == 0);
+	total += (size_t)cc;
+    }
+    UTK_TEST_ASSERT(cc == 0 && total == len);
+    UTK_TEST_ASSERT(utk_io_prefetch_next(&pf, (const void **)&chunk) == 0);
+    utk_io_prefetch_close(&pf);
+    UTK_TEST_ASSERT(lseek(fd, 0, SEEK_CUR) == 100);
+
+    /* closed before the end */
+    UTK_TEST_ASSERT(utk_io_prefetch_open(&pf, fd, 2, 4096, 0) == 0);
+    UTK_TEST_ASSERT(utk_io_prefetch_next(&pf, (const void **)&chunk) == 4096);
+    utk_io_prefetch_close(&pf);
+
+    close(fd);
+    unlink("/tmp/test_io_prefetch");
+    free(buf);
+}
+
 int main(void)
 {
     UTK_TEST_MODULE_INIT("utk/io");
@@ -124,5 +1047,29 @@ int main(void)
 
     UTK_TEST_RUN(test_io_file_write_and_read);
 
+    UTK_TEST_RUN(test_io_pwrite_and_pread);
+
+    UTK_TEST_RUN(test_io_file_read_all);
+
+    UTK_TEST_RUN(test_io_file_replace);
+
+    UTK_TEST_RUN(test_io_group_commit_replace);
+
+    UTK_TEST_RUN(test_io_direct_write_and_read);
+
+    UTK_TEST_RUN(test_io_direct_writer);
+
+    UTK_TEST_RUN(test_io_file_read_parallel);
+
+    UTK_TEST_RUN(test_io_fdcache);
+
+    UTK_TEST_RUN(test_io_log);
+
+    UTK_TEST_RUN(test_io_stats);
+
+    UTK_TEST_RUN(test_io_follow);
+
+    UTK_TEST_RUN(test_io_prefetch);
+
     return UTK_TEST_MODULE_RETURN;
 }
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/list.h>
+#include <utk/unit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+struct test_list_item {
+    struct utk_list_head node;
+    unsigned int key;
+    unsigned int seq;
+};
+
+static int test_list_cmp(void *priv, const struct utk_list_head *a,
+			 const struct utk_list_head *b)
+{
+    const struct test_list_item *ia =
+	utk_list_entry(a, const struct test_list_item, node);
+    const struct test_list_item *ib =
+	utk_list_entry(b, const struct test_list_item, node);
+
+    (*(unsigned long *)priv)++;
+
+    return (ia->key > ib->key) - (ia->key < ib->key);
+}
+
+/*
+ * Check order, stability and links of a sorted list of nb items
+ */
+static void test_list_check(struct utk_test_result *__tr,
+			    struct utk_list_head *head, size_t nb)
+{
+    struct utk_list_head *pos = NULL;
+    struct test_list_item *item = NULL;
+    struct test_list_item *prev = NULL;
+    size_t count = 0;
+
+    utk_list_for_each(pos, head)
+    {
+	UTK_TEST_ASSERT(pos->next->prev == pos);
+	UTK_TEST_ASSERT(pos->prev->next == pos);
+
+	item = utk_list_entry(pos, struct test_list_item, node);
+	if(prev != NULL)
+	{
+	    UTK_TEST_ASSERT(prev->key <= item->key);
+	    if(prev->key == item->key)
+	    {
+		UTK_TEST_ASSERT(prev->seq < item->seq);
+	    }
+	}
+	prev = item;
+	count++;
+    }
+
+    UTK_TEST_ASSERT(count == nb);
+    UTK_TEST_ASSERT(head->next->prev == head);
+    UTK_TEST_ASSERT(head->prev->next == head);
+}
+
+UTK_TEST_DEF(test_list_sort_sizes)
+{
+    struct test_list_item items[300];
+    UTK_LIST_HEAD(head);
+    unsigned long calls = 0;
+    unsigned int seed = 1;
+    size_t nb,
+	i;
+
+    for(nb = 0; nb <= 300; ++nb)
+    {
+	utk_list_head_init(&head);
+	for(i = 0; i < nb; ++i)
+	{
+	    seed = seed * 1103515245 + 12345;
+	    /* few distinct keys: stability matters */
+	    items[i].key = (seed >> 16) % 16;
+	    items[i].seq = (unsigned int)i;
+	    utk_list_add_tail(&items[i].node, &head);
+	}
+
+	utk_list_sort(&calls, &head, test_list_cmp);
+	test_list_check(__tr, &head, nb);
+    }
+}
+
+UTK_TEST_DEF(test_list_sort_large)
+{
+    struct test_list_item *items = NULL;
+    UTK_LIST_HEAD(head);
+    unsigned long calls = 0;
+    unsigned int seed = 42;
+    size_t nb = 100000,
+	i;
+
+    items = malloc(nb * sizeof(*items));
+    UTK_TEST_ASSERT(items != NULL);
+
+    for(i = 0; i < nb; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	items[i].key = seed >> 8;
+	items[i].seq = (unsigned int)i;
+	utk_list_add_tail(&items[i].node, &head);
+    }
+
+    utk_list_sort(&calls, &head, test_list_cmp);
+    test_list_check(__tr, &head, nb);
+    /* n log2(n) = 1.66M */
+    UTK_TEST_ASSERT(calls < 1700000);
+
+    /* already sorted and reversed */
+    calls = 0;
+    utk_list_sort(&calls, &head, test_list_cmp);
+    test_list_check(__tr, &head, nb);
+    UTK_TEST_ASSERT(calls < 1700000);
+
+    utk_list_head_init(&head);
+    for(i = 0; i < nb; ++i)
+    {
+	items[i].key = (unsigned int)(nb - i);
+	utk_list_add_tail(&items[i].node, &head);
+    }
+    utk_list_sort(&calls, &head, test_list_cmp);
+    test_list_check(__tr, &head, nb);
+    UTK_TEST_ASSERT(utk_list_entry(head.next, struct test_list_item,
+				   node) == &items[nb - 1]);
+
+    free(items);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/list");
+
+    UTK_TEST_RUN(test_list_sort_sizes);
+
+    UTK_TEST_RUN(test_list_sort_large);
+
+    return UTK_TEST_MODULE_RETURN;
+}
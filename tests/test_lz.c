@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/lz.h>
+#include <utk/array.h>
+#include <utk/io.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static unsigned int test_lz_seed = 1;
+
+static unsigned int test_lz_rand(void)
+{
+    test_lz_seed = test_lz_seed * 1103515245 + 12345;
+
+    return test_lz_seed >> 16;
+}
+
+/*
+ * Fill buf with data of different compressibility
+ */
+static void test_lz_fill(unsigned char *buf, size_t len, unsigned int kind)
+{
+    const char *words[] = { "hello ", "world ", "foo ", "bar ", "utk " };
+    const char *word = NULL;
+    size_t i,
+	n;
+
+    switch(kind)
+    {
+    case 0:
+	memset(buf, 0, len);
+	break;
+    case 1:
+	for(i = 0; i < len; ++i)
+	{
+	    buf[i] = (unsigned char)test_lz_rand();
+	}
+	break;
+    case 2:
+	for(i = 0; i < len; i += n)
+	{
+	    word = words[test_lz_rand() % UTK_ARRAY_SIZE(words)];
+	    n = strlen(word);
+	    if(n > len - i)
+	    {
+		n = len - i;
+	    }
+	    memcpy(buf + i, word, n);
+	}
+	break;
+    default:
+	/* short period runs */
+	for(i = 0; i < len; ++i)
+	{
+	    buf[i] = (unsigned char)("abc"[i % 3]);
+	}
+	break;
+    }
+}
+
+UTK_TEST_DEF(test_lz_round_trip)
+{
+    const size_t lens[] = { 0, 1, 5, 12, 13, 20, 100, 4096, 65536, 300000 };
+    unsigned char *src = NULL,
+	*comp = NULL,
+	*dec = NULL;
+    size_t i;
+    unsigned int kind;
+    ssize_t clen,
+	dlen;
+
+    src = malloc(300000);
+    comp = malloc(utk_lz_compress_bound(300000));
+    dec = malloc(300000);
+    UTK_TEST_ASSERT(src != NULL && comp != NULL && dec != NULL);
+
+    for(kind = 0; kind < 4; ++kind)
+    {
+	for(i = 0; i < UTK_ARRAY_SIZE(lens); ++i)
+	{
+	    test_lz_fill(src, lens[i], kind);
+
+	    clen = utk_lz_compress(src, lens[i], comp,
+				   utk_lz_compress_bound(lens[i]));
+	    UTK_TEST_RAW_ASSERT(clen > 0, "kind %u len %zu", kind, lens[i]);
+
+	    if(kind != 1 && lens[i] >= 4096)
+	    {
+		/* compressible data are compressed */
+		UTK_TEST_ASSERT((size_t)clen < lens[i] / 4 * 3);
+	    }
+
+	    dlen = utk_lz_decompress(comp, (size_t)clen, dec, lens[i]);
+	    UTK_TEST_RAW_ASSERT(dlen == (ssize_t)lens[i]
+				&& memcmp(src, dec, lens[i]) == 0,
+				"kind %u len %zu", kind, lens[i]);
+
+	    /* too small destination */
+	    if(lens[i] > 0)
+	    {
+		dlen = utk_lz_decompress(comp, (size_t)clen, dec, lens[i] - 1);
+		UTK_TEST_ASSERT(dlen == -1);
+	    }
+	}
+    }
+
+    /* compressed output doesn't fit */
+    test_lz_fill(src, 4096, 1);
+    UTK_TEST_ASSERT(utk_lz_compress(src, 4096, comp, 4096) == -1);
+
+    free(src);
+    free(comp);
+    free(dec);
+}
+
+UTK_TEST_DEF(test_lz_corrupted)
+{
+    unsigned char src[8192],
+	comp[sizeof(src) + sizeof(src) / 255 + 16],
+	bad[sizeof(comp)],
+	dec[sizeof(src)];
+    unsigned int i;
+    ssize_t clen,
+	dlen;
+    size_t pos;
+
+    test_lz_fill(src, sizeof(src), 2);
+
+    clen = utk_lz_compress(src, sizeof(src), comp, sizeof(comp));
+    UTK_TEST_ASSERT(clen > 0);
+
+    /* flipped bytes and truncations never go out of buffers */
+    for(i = 0; i < 10000; ++i)
+    {
+	memcpy(bad, comp, (size_t)clen);
+	pos = test_lz_rand() % (size_t)clen;
+	bad[pos] = (unsigned char)test_lz_rand();
+
+	dlen = utk_lz_decompress(bad, (size_t)clen - (i % 3), dec, sizeof(dec));
+	UTK_TEST_ASSERT(dlen <= (ssize_t)sizeof(dec));
+    }
+
+    /* garbage */
+    for(i = 0; i < 10000; ++i)
+    {
+	test_lz_fill(bad, sizeof(bad), 1);
+	dlen = utk_lz_decompress(bad, 1 + i % sizeof(bad), dec, sizeof(dec));
+	UTK_TEST_ASSERT(dlen <= (ssize_t)sizeof(dec));
+    }
+
+    /* offset out of the output */
+    bad[0] = 0x10;
+    bad[1] = 'a';
+    bad[2] = 2;
+    bad[3] = 0;
+    UTK_TEST_ASSERT(utk_lz_decompress(bad, 4, dec, sizeof(dec)) == -1);
+    UTK_TEST_ASSERT(errno == EBADMSG);
+}
+
+UTK_TEST_DEF(test_lz_stream)
+{
+    struct utk_lz_writer w;
+    struct utk_lz_reader r;
+    unsigned char *src = NULL,
+	*dst = NULL;
+    size_t len,
+	pos,
+	n;
+    ssize_t ret;
+    off_t size;
+    int fd;
+
+    len = 1000000;
+    src = malloc(len);
+    dst = malloc(len + 1);
+    UTK_TEST_ASSERT(src != NULL && dst != NULL);
+
+    /* compressible and incompressible blocks */
+    test_lz_fill(src, len / 2, 2);
+    test_lz_fill(src + len / 2, len - len / 2, 1);
+
+    fd = open("/tmp/test_lz_stream", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    UTK_TEST_ASSERT(fd >= 0);
+
+    UTK_TEST_ASSERT(utk_lz_writer_init(&w, fd, 0) == 0);
+    for(pos = 0; pos < len; pos += n)
+    {
+	n = 1 + test_lz_rand() % 10000;
+	if(n > len - pos)
+	{
+	    n = len - pos;
+	}
+	UTK_TEST_ASSERT(utk_lz_writer_write(&w, src + pos, n) == (ssize_t)n);
+    }
+    UTK_TEST_ASSERT(utk_lz_writer_finish(&w) == 0);
+
+    size = lseek(fd, 0, SEEK_CUR);
+    UTK_TEST_ASSERT(size > 0 && (size_t)size < len);
+
+    /* read back */
+    UTK_TEST_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    UTK_TEST_ASSERT(utk_lz_reader_init(&r, fd) == 0);
+    ret = utk_lz_reader_read(&r, dst, 12345);
+    UTK_TEST_ASSERT(ret == 12345);
+    ret = utk_lz_reader_read(&r, dst + 12345, len + 1 - 12345);
+    UTK_TEST_ASSERT(ret == (ssize_t)(len - 12345));
+    UTK_TEST_ASSERT(memcmp(src, dst, len) == 0);
+    utk_lz_reader_cleanup(&r);
+
+    /* corrupted frame is detected */
+    UTK_TEST_ASSERT(utk_io_pwrite(fd, "\xff\xff", 2, 1000) == 2);
+    UTK_TEST_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    UTK_TEST_ASSERT(utk_lz_reader_init(&r, fd) == 0);
+    ret = utk_lz_reader_read(&r, dst, len);
+    UTK_TEST_ASSERT(ret == -1 && errno == EBADMSG);
+    utk_lz_reader_cleanup(&r);
+
+    close(fd);
+    unlink("/tmp/test_lz_stream");
+    free(src);
+    free(dst);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/lz");
+
+    UTK_TEST_RUN(test_lz_round_trip);
+
+    UTK_TEST_RUN(test_lz_corrupted);
+
+    UTK_TEST_RUN(test_lz_stream);
+
+    return UTK_TEST_MODULE_RETURN;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/mpsc.h>
+#include <utk/unit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define TEST_MPSC_NB_PRODUCERS 4
+#define TEST_MPSC_NB_ITEMS 200000
+
+struct test_mpsc_item {
+    struct utk_mpsc_node node;
+    unsigned int producer;
+    unsigned int seq;
+};
+
+struct test_mpsc_producer {
+    struct utk_mpsc_queue *queue;
+    struct test_mpsc_item *items;
+    unsigned int id;
+};
+
+UTK_TEST_DEF(test_mpsc_fifo)
+{
+    struct utk_mpsc_queue queue;
+    struct test_mpsc_item items[10];
+    struct test_mpsc_item *pos = NULL;
+    struct test_mpsc_item *n = NULL;
+    struct utk_mpsc_node *node = NULL;
+    unsigned int i,
+	j;
+
+    utk_mpsc_init(&queue);
+    UTK_TEST_ASSERT(utk_mpsc_empty(&queue));
+    UTK_TEST_ASSERT(utk_mpsc_pop(&queue) == NULL);
+    UTK_TEST_ASSERT(utk_mpsc_take_all(&queue) == NULL);
+
+    for(i = 0; i < 10; ++i)
+    {
+	items[i].seq = i;
+    }
+
+    /* the stub goes in and out of the queue */
+    for(i = 0; i < 100; ++i)
+    {
+	utk_mpsc_push(&queue, &items[i % 10].node);
+	UTK_TEST_ASSERT(!utk_mpsc_empty(&queue));
+	node = utk_mpsc_pop(&queue);
+	UTK_TEST_ASSERT(node == &items[i % 10].node);
+	UTK_TEST_ASSERT(utk_mpsc_empty(&queue));
+	UTK_TEST_ASSERT(utk_mpsc_pop(&queue) == NULL);
+    }
+
+    for(i = 0; i < 10; ++i)
+    {
+	utk_mpsc_push(&queue, &items[i].node);
+    }
+    for(i = 0; i < 3; ++i)
+    {
+	node = utk_mpsc_pop(&queue);
+	UTK_TEST_ASSERT(node != NULL);
+	UTK_TEST_ASSERT(utk_mpsc_entry(node, struct test_mpsc_item,
+				       node)->seq == i);
+    }
+
+    /* interleave pops and pushes around the stub */
+    utk_mpsc_push(&queue, &items[0].node);
+    j = 3;
+    utk_mpsc_for_each_entry_safe(pos, n, utk_mpsc_take_all(&queue), node)
+    {
+	UTK_TEST_ASSERT(pos->seq == j % 10);
+	j++;
+    }
+    UTK_TEST_ASSERT(j == 11);
+    UTK_TEST_ASSERT(utk_mpsc_empty(&queue));
+
+    utk_mpsc_push(&queue, &items[5].node);
+    node = utk_mpsc_take_all(&queue);
+    UTK_TEST_ASSERT(node == &items[5].node && node->next == NULL);
+    utk_mpsc_push(&queue, &items[6].node);
+    utk_mpsc_push(&queue, &items[7].node);
+    node = utk_mpsc_take_all(&queue);
+    UTK_TEST_ASSERT(node == &items[6].node);
+    UTK_TEST_ASSERT(node->next == &items[7].node);
+    UTK_TEST_ASSERT(node->next->next == NULL);
+    UTK_TEST_ASSERT(utk_mpsc_empty(&queue));
+}
+
+static void *test_mpsc_producer(void *arg)
+{
+    struct test_mpsc_producer *producer = arg;
+    unsigned int i;
+
+    for(i = 0; i < TEST_MPSC_NB_ITEMS; ++i)
+    {
+	producer->items[i].producer = producer->id;
+	producer->items[i].seq = i;
+	utk_mpsc_push(producer->queue, &producer->items[i].node);
+    }
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_mpsc_threads)
+{
+    struct utk_mpsc_queue queue;
+    struct test_mpsc_producer producers[TEST_MPSC_NB_PRODUCERS];
+    pthread_t threads[TEST_MPSC_NB_PRODUCERS];
+    unsigned int next[TEST_MPSC_NB_PRODUCERS];
+    struct test_mpsc_item *pos = NULL;
+    struct test_mpsc_item *n = NULL;
+    struct utk_mpsc_node *node = NULL;
+    size_t count = 0;
+    unsigned int i;
+    int ok = 1;
+
+    utk_mpsc_init(&queue);
+    for(i = 0; i < TEST_MPSC_NB_PRODUCERS; ++i)
+    {
+	producers[i].queue = &queue;
+	producers[i].id = i;
+	producers[i].items = calloc(TEST_MPSC_NB_ITEMS,
+				    sizeof(struct test_mpsc_item));
+	UTK_TEST_ASSERT(producers[i].items != NULL);
+	next[i] = 0;
+	UTK_TEST_ASSERT(pthread_create(&threads[i], NULL, test_mpsc_producer,
+				       &producers[i]) == 0);
+    }
+
+    /* the order of each producer is kept */
+    while(count < (size_t)TEST_MPSC_NB_PRODUCERS * TEST_MPSC_NB_ITEMS)
+    {
+	if(count % 2 == 0)
+	{
+	    node = utk_mpsc_pop(&queue);
+	    if(node != NULL)
+	    {
+		node->next = NULL;
+	    }
+	}
+	else
+	{
+	    node = utk_mpsc_take_all(&queue);
+	}
+	if(node == NULL)
+	{
+	    sched_yield();
+	    continue;
+	}
+
+	utk_mpsc_for_each_entry_safe(pos, n, node, node)
+	{
+	    ok &= (pos->seq == next[pos->producer]);
+	    next[pos->producer]++;
+	    count++;
+	}
+    }
+
+    for(i = 0; i < TEST_MPSC_NB_PRODUCERS; ++i)
+    {
+	UTK_TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+	UTK_TEST_ASSERT(next[i] == TEST_MPSC_NB_ITEMS);
+	free(producers[i].items);
+    }
+    UTK_TEST_ASSERT(ok);
+    UTK_TEST_ASSERT(utk_mpsc_empty(&queue));
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/mpsc");
+
+    UTK_TEST_RUN(test_mpsc_fifo);
+
+    UTK_TEST_RUN(test_mpsc_threads);
+
+    return UTK_TEST_MODULE_RETURN;
+}
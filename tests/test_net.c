@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/net.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define TEST_NET_NB_MSGS 64
+
+/*
+ * Send a batch of 2-buffer messages and check they are received in order
+ * (asserts fail the calling test)
+ */
+static void test_net_batch_round_trip(struct utk_test_result *__tr,
+				      int tx, int rx,
+				      const struct sockaddr *addr,
+				      socklen_t addrlen)
+{
+    struct utk_net_batch out,
+	in;
+    char headers[TEST_NET_NB_MSGS][16],
+	payload[256];
+    const char *data = NULL;
+    unsigned int i,
+	received;
+    size_t len,
+	hlen;
+    int cc;
+
+    memset(payload, 'p', sizeof(payload));
+
+    UTK_TEST_ASSERT(utk_net_batch_init(&out, TEST_NET_NB_MSGS,
+				       TEST_NET_NB_MSGS * 2) == 0);
+    UTK_TEST_ASSERT(utk_net_batch_init_recv(&in, 16, 512) == 0);
+
+    for(i = 0; i < TEST_NET_NB_MSGS; ++i)
+    {
+	snprintf(headers[i], sizeof(headers[i]), "msg %u:", i);
+	UTK_TEST_ASSERT(utk_net_batch_begin(&out, addr, addrlen) == 0);
+	UTK_TEST_ASSERT(utk_net_batch_append(&out, headers[i],
+					     strlen(headers[i])) == 0);
+	UTK_TEST_ASSERT(utk_net_batch_append(&out, payload, i) == 0);
+    }
+
+    /* full */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_net_batch_begin(&out, addr, addrlen) == -1);
+    UTK_TEST_ASSERT(errno == ENOBUFS);
+
+    UTK_TEST_ASSERT(utk_net_send_batch(tx, &out, 0) == TEST_NET_NB_MSGS);
+
+    received = 0;
+    while(received < TEST_NET_NB_MSGS)
+    {
+	cc = utk_net_recv_batch(rx, &in, 0);
+	UTK_TEST_ASSERT(cc > 0 && cc <= 16);
+
+	for(i = 0; i < (unsigned int)cc; ++i, ++received)
+	{
+	    data = utk_net_batch_msg(&in, i, &len);
+	    hlen = strlen(headers[received]);
+	    UTK_TEST_ASSERT(len == hlen + received);
+	    UTK_TEST_ASSERT(memcmp(data, headers[received], hlen) == 0);
+	    UTK_TEST_ASSERT(memcmp(data + hlen, payload, received) == 0);
+	}
+    }
+
+    /* nothing left */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_net_recv_batch(rx, &in, MSG_DONTWAIT) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    utk_net_batch_cleanup(&out);
+    utk_net_batch_cleanup(&in);
+}
+
+UTK_TEST_DEF(test_net_batch_unix)
+{
+    int fds[2];
+
+    UTK_TEST_ASSERT(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+
+    test_net_batch_round_trip(__tr, fds[0], fds[1], NULL, 0);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+UTK_TEST_DEF(test_net_batch_udp)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int tx,
+	rx;
+
+    tx = socket(AF_INET, SOCK_DGRAM, 0);
+    rx = socket(AF_INET, SOCK_DGRAM, 0);
+    UTK_TEST_ASSERT(tx >= 0 && rx >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(rx, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+	UTK_TEST_PRINT_WARNING("can't bind on 127.0.0.1 (%s), skip test",
+			       strerror(errno));
+	close(tx);
+	close(rx);
+	return;
+    }
+    UTK_TEST_ASSERT(getsockname(rx, (struct sockaddr *)&addr, &addrlen) == 0);
+
+    /* unconnected sender: destination in each message */
+    test_net_batch_round_trip(__tr, tx, rx, (struct sockaddr *)&addr, addrlen);
+
+    /* optional settings */
+    UTK_TEST_ASSERT(utk_net_set_gro(rx, 1) == 0 || errno == ENOPROTOOPT);
+    UTK_TEST_ASSERT(utk_net_set_busy_poll(rx, 0) == 0 || errno == EPERM
+		    || errno == ENOPROTOOPT);
+
+    close(tx);
+    close(rx);
+}
+
+#define TEST_NET_STREAM_SIZE (4 * 1024 * 1024)
+
+static void *test_net_stream_thread(void *data)
+{
+    int fd = *(int *)data;
+    unsigned char *buf = NULL;
+    struct iovec iov[3];
+    size_t i;
+
+    buf = malloc(TEST_NET_STREAM_SIZE);
+    if(buf == NULL)
+    {
+	return NULL;
+    }
+    for(i = 0; i < TEST_NET_STREAM_SIZE; ++i)
+    {
+	buf[i] = (unsigned char)(i * 7);
+    }
+
+    /* same content sent in one buffer then in three */
+    utk_net_send_all(fd, buf, TEST_NET_STREAM_SIZE);
+
+    iov[0].iov_base = buf;
+    iov[0].iov_len = 10;
+    iov[1].iov_base = buf + 10;
+    iov[1].iov_len = TEST_NET_STREAM_SIZE / 2;
+    iov[2].iov_base = buf + 10 + TEST_NET_STREAM_SIZE / 2;
+    iov[2].iov_len = TEST_NET_STREAM_SIZE / 2 - 10;
+    utk_net_sendv_all(fd, iov, 3);
+
+    free(buf);
+    close(fd);
+
+    return NULL;
+}
+
+UTK_TEST_DEF(test_net_stream)
+{
+    unsigned char *buf = NULL;
+    pthread_t thread;
+    size_t i;
+    int fds[2];
+    int pass;
+
+    buf = malloc(TEST_NET_STREAM_SIZE);
+    UTK_TEST_ASSERT(buf != NULL);
+
+    UTK_TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    UTK_TEST_ASSERT(pthread_create(&thread, NULL, test_net_stream_thread,
+				   &fds[1]) == 0);
+
+    for(pass = 0; pass < 2; ++pass)
+    {
+	memset(buf, 0, TEST_NET_STREAM_SIZE);
+	UTK_TEST_ASSERT(utk_net_recv_all(fds[0], buf, TEST_NET_STREAM_SIZE)
+			== TEST_NET_STREAM_SIZE);
+	for(i = 0; i < TEST_NET_STREAM_SIZE; ++i)
+	{
+	    if(buf[i] != (unsigned char)(i * 7))
+	    {
+		break;
+	    }
+	}
+	UTK_TEST_ASSERT(i == TEST_NET_STREAM_SIZE);
+    }
+
+    /* peer closed */
+    UTK_TEST_ASSERT(utk_net_recv_all(fds[0], buf, 10) == 0);
+    UTK_TEST_ASSERT(pthread_join(thread, NULL) == 0);
+
+    /* no SIGPIPE */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_net_send_all(fds[0], "x", 1) == -1);
+    UTK_TEST_ASSERT(errno == EPIPE);
+
+    close(fds[0]);
+    free(buf);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/net");
+
+    UTK_TEST_RUN(test_net_batch_unix);
+
+    UTK_TEST_RUN(test_net_batch_udp);
+
+    UTK_TEST_RUN(test_net_stream);
+
+    return UTK_TEST_MODULE_RETURN;
+}
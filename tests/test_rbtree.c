@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/rbtree.h>
+#include <utk/unit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct test_rbtree_item {
+    struct utk_rbtree_node node;
+    int key;
+    int seq;
+};
+
+static int test_rbtree_cmp(const struct utk_rbtree_node *a,
+			   const struct utk_rbtree_node *b)
+{
+    int ka = utk_rbtree_entry(a, const struct test_rbtree_item, node)->key;
+    int kb = utk_rbtree_entry(b, const struct test_rbtree_item, node)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static int test_rbtree_key(const struct utk_rbtree_node *node,
+			   const void *key)
+{
+    int k = utk_rbtree_entry(node, const struct test_rbtree_item,
+			     node)->key;
+
+    return (k > *(const int *)key) - (k < *(const int *)key);
+}
+
+/*
+ * Check the red-black properties of a subtree and count its nodes and
+ * its black height
+ */
+static void test_rbtree_check_node(struct utk_test_result *__tr,
+				   const struct utk_rbtree_node *node,
+				   size_t *count, int *height)
+{
+    int left,
+	right;
+
+    if(node == NULL)
+    {
+	*height = 1;
+	return;
+    }
+
+    (*count)++;
+    if(node->left != NULL)
+    {
+	UTK_TEST_ASSERT(node->left->parent == node);
+	UTK_TEST_ASSERT(test_rbtree_cmp(node->left, node) <= 0);
+    }
+    if(node->right != NULL)
+    {
+	UTK_TEST_ASSERT(node->right->parent == node);
+	UTK_TEST_ASSERT(test_rbtree_cmp(node->right, node) >= 0);
+    }
+    /* red (0) nodes have black children */
+    if(node->color == 0)
+    {
+	UTK_TEST_ASSERT(node->left == NULL || node->left->color != 0);
+	UTK_TEST_ASSERT(node->right == NULL || node->right->color != 0);
+    }
+
+    test_rbtree_check_node(__tr, node->left, count, &left);
+    test_rbtree_check_node(__tr, node->right, count, &right);
+    UTK_TEST_ASSERT(left == right);
+
+    *height = left + (node->color != 0);
+}
+
+static void test_rbtree_check(struct utk_test_result *__tr,
+			      const struct utk_rbtree *tree)
+{
+    const struct utk_rbtree_node *node = tree->root;
+    size_t count = 0;
+    int height;
+
+    if(node != NULL)
+    {
+	UTK_TEST_ASSERT(node->parent == NULL);
+	UTK_TEST_ASSERT(node->color != 0);
+	while(node->left != NULL)
+	{
+	    node = node->left;
+	}
+    }
+    UTK_TEST_ASSERT(tree->leftmost == node);
+
+    test_rbtree_check_node(__tr, tree->root, &count, &height);
+    UTK_TEST_ASSERT(count == utk_rbtree_count(tree));
+}
+
+UTK_TEST_DEF(test_rbtree_insert_erase)
+{
+    struct test_rbtree_item items[2000];
+    struct test_rbtree_item *pos = NULL;
+    struct test_rbtree_item *prev = NULL;
+    UTK_RBTREE(tree);
+    unsigned int seed = 1;
+    size_t count,
+	i;
+
+    UTK_TEST_ASSERT(utk_rbtree_empty(&tree));
+    UTK_TEST_ASSERT(utk_rbtree_first(&tree) == NULL);
+    UTK_TEST_ASSERT(utk_rbtree_last(&tree) == NULL);
+
+    for(i = 0; i < 2000; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	items[i].key = (int)((seed >> 16) % 500);
+	items[i].seq = (int)i;
+	utk_rbtree_insert(&tree, &items[i].node, test_rbtree_cmp);
+	if(i % 100 == 0)
+	{
+	    test_rbtree_check(__tr, &tree);
+	}
+    }
+    test_rbtree_check(__tr, &tree);
+    UTK_TEST_ASSERT(utk_rbtree_count(&tree) == 2000);
+
+    /* in order, equal keys in insertion order */
+    count = 0;
+    utk_rbtree_for_each_entry(pos, &tree, node)
+    {
+	if(prev != NULL)
+	{
+	    UTK_TEST_ASSERT(prev->key <= pos->key);
+	    UTK_TEST_ASSERT(prev->key < pos->key || prev->seq < pos->seq);
+	}
+	prev = pos;
+	count++;
+    }
+    UTK_TEST_ASSERT(count == 2000);
+    UTK_TEST_ASSERT(&prev->node == utk_rbtree_last(&tree));
+
+    /* erase in random order */
+    for(i = 0; i < 2000; ++i)
+    {
+	seed = seed * 1103515245 + 12345;
+	pos = &items[(seed >> 8) % 2000];
+	if(!utk_rbtree_node_empty(&pos->node))
+	{
+	    utk_rbtree_erase(&tree, &pos->node);
+	    UTK_TEST_ASSERT(utk_rbtree_node_empty(&pos->node));
+	}
+	if(i % 100 == 0)
+	{
+	    test_rbtree_check(__tr, &tree);
+	}
+    }
+    test_rbtree_check(__tr, &tree);
+
+    /* erase while iterating */
+    count = utk_rbtree_count(&tree);
+    utk_rbtree_for_each_entry_safe(pos, prev, &tree, node)
+    {
+	utk_rbtree_erase(&tree, &pos->node);
+	count--;
+	UTK_TEST_ASSERT(utk_rbtree_count(&tree) == count);
+    }
+    test_rbtree_check(__tr, &tree);
+    UTK_TEST_ASSERT(utk_rbtree_empty(&tree));
+}
+
+UTK_TEST_DEF(test_rbtree_bounds)
+{
+    struct test_rbtree_item items[100];
+    struct test_rbtree_item dup;
+    struct test_rbtree_item *pos = NULL;
+    struct utk_rbtree_node *node = NULL;
+    struct utk_rbtree tree;
+    int key,
+	sum;
+    size_t i;
+
+    utk_rbtree_init(&tree);
+
+    /* even keys 0..198 */
+    for(i = 0; i < 100; ++i)
+    {
+	items[i].key = (int)(i * 2);
+	UTK_TEST_ASSERT(utk_rbtree_insert_unique(&tree, &items[i].node,
+						 test_rbtree_cmp) == NULL);
+    }
+    dup.key = 42;
+    UTK_TEST_ASSERT(utk_rbtree_insert_unique(&tree, &dup.node,
+					     test_rbtree_cmp)
+		    == &items[21].node);
+    test_rbtree_check(__tr, &tree);
+
+    key = 42;
+    UTK_TEST_ASSERT(utk_rbtree_find(&tree, &key, test_rbtree_key)
+		    == &items[21].node);
+    UTK_TEST_ASSERT(utk_rbtree_lower_bound(&tree, &key, test_rbtree_key)
+		    == &items[21].node);
+    UTK_TEST_ASSERT(utk_rbtree_upper_bound(&tree, &key, test_rbtree_key)
+		    == &items[22].node);
+    key = 43;
+    UTK_TEST_ASSERT(utk_rbtree_find(&tree, &key, test_rbtree_key) == NULL);
+    UTK_TEST_ASSERT(utk_rbtree_lower_bound(&tree, &key, test_rbtree_key)
+		    == &items[22].node);
+    key = -1;
+    UTK_TEST_ASSERT(utk_rbtree_lower_bound(&tree, &key, test_rbtree_key)
+		    == utk_rbtree_first(&tree));
+    key = 198;
+    UTK_TEST_ASSERT(utk_rbtree_upper_bound(&tree, &key, test_rbtree_key)
+		    == NULL);
+
+    /* range [10, 20) */
+    key = 10;
+    sum = 0;
+    pos = utk_rbtree_entry_safe(utk_rbtree_lower_bound(&tree, &key,
+						       test_rbtree_key),
+				struct test_rbtree_item, node);
+    utk_rbtree_for_each_entry_from(pos, node)
+    {
+	if(pos->key >= 20)
+	{
+	    break;
+	}
+	sum += pos->key;
+    }
+    UTK_TEST_ASSERT(sum == 10 + 12 + 14 + 16 + 18);
+
+    /* reverse */
+    key = 198;
+    utk_rbtree_for_each_reverse(node, &tree)
+    {
+	UTK_TEST_ASSERT(test_rbtree_key(node, &key) == 0);
+	key -= 2;
+    }
+    UTK_TEST_ASSERT(key == -2);
+
+    /* leftmost follows erase */
+    utk_rbtree_erase(&tree, &items[0].node);
+    UTK_TEST_ASSERT(utk_rbtree_first(&tree) == &items[1].node);
+    test_rbtree_check(__tr, &tree);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/rbtree");
+
+    UTK_TEST_RUN(test_rbtree_insert_erase);
+
+    UTK_TEST_RUN(test_rbtree_bounds);
+
+    return UTK_TEST_MODULE_RETURN;
+}
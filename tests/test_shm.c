@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/shm.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+ * Record of len bytes filled from seq
+ */
+static void test_shm_fill(unsigned char *buf, size_t len, uint32_t seq)
+{
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+    {
+	buf[i] = (unsigned char)(seq + i);
+    }
+}
+
+UTK_TEST_DEF(test_shm_push_pop)
+{
+    struct utk_shm_ring ring;
+    unsigned char rec[1000],
+	out[1000];
+    const void *data = NULL;
+    uint32_t seq;
+    size_t len;
+    ssize_t ret;
+
+    UTK_TEST_ASSERT(utk_shm_ring_create(&ring, NULL, 3000) == 0);
+    UTK_TEST_ASSERT(ring.size == 4096);
+
+    /* empty */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, sizeof(out), 0) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, sizeof(out), 20) == -1);
+    UTK_TEST_ASSERT(errno == ETIMEDOUT);
+
+    /* too big */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_push(&ring, rec,
+				      utk_shm_ring_max_record(&ring) + 1,
+				      0) == -1);
+    UTK_TEST_ASSERT(errno == EMSGSIZE);
+
+    /* many wrap arounds with sizes which don't divide the ring */
+    for(seq = 0; seq < 10000; ++seq)
+    {
+	len = (seq * 37) % sizeof(rec);
+	test_shm_fill(rec, len, seq);
+	UTK_TEST_ASSERT(utk_shm_ring_push(&ring, rec, len, 0) == 0);
+
+	ret = utk_shm_ring_pop(&ring, out, sizeof(out), 0);
+	UTK_TEST_ASSERT(ret == (ssize_t)len);
+	UTK_TEST_ASSERT(memcmp(rec, out, len) == 0);
+    }
+
+    /* full */
+    for(seq = 0; utk_shm_ring_push(&ring, rec, 100, 0) == 0; ++seq)
+    {
+    }
+    UTK_TEST_ASSERT(errno == EAGAIN);
+    UTK_TEST_ASSERT(seq >= 4096 / 112 - 1);
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_push(&ring, rec, 100, 20) == -1);
+    UTK_TEST_ASSERT(errno == ETIMEDOUT);
+
+    /* zero copy */
+    UTK_TEST_ASSERT(utk_shm_ring_peek(&ring, &data, 0) == 100);
+    UTK_TEST_ASSERT(utk_shm_ring_peek(&ring, &data, 0) == 100);
+    utk_shm_ring_consume(&ring);
+    UTK_TEST_ASSERT(utk_shm_ring_push(&ring, rec, 100, 0) == 0);
+
+    /* destination too small */
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, 10, 0) == -1);
+    UTK_TEST_ASSERT(errno == EMSGSIZE);
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, sizeof(out), 0) == 100);
+
+    utk_shm_ring_close(&ring);
+}
+
+UTK_TEST_DEF(test_shm_named)
+{
+    struct utk_shm_ring ring,
+	other;
+    char name[64];
+    char out[16];
+
+    snprintf(name, sizeof(name), "/utk_test_shm.%d", (int)getpid());
+
+    if(utk_shm_ring_create(&ring, name, 4096) != 0)
+    {
+	UTK_TEST_PRINT_WARNING("shm_open isn't available (%s), skip test",
+			       strerror(errno));
+	return;
+    }
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_create(&other, name, 4096) == -1);
+    UTK_TEST_ASSERT(errno == EEXIST);
+
+    UTK_TEST_ASSERT(utk_shm_ring_open(&other, name) == 0);
+    UTK_TEST_ASSERT(utk_shm_ring_unlink(name) == 0);
+
+    UTK_TEST_ASSERT(utk_shm_ring_push(&other, "hello", 5, 0) == 0);
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, sizeof(out), 0) == 5);
+    UTK_TEST_ASSERT(memcmp(out, "hello", 5) == 0);
+
+    utk_shm_ring_close(&other);
+    utk_shm_ring_close(&ring);
+}
+
+#define TEST_SHM_NB_PRODUCERS 3
+#define TEST_SHM_NB_RECORDS 20000
+
+/*
+ * Several processes push in a small ring, the parent checks that records
+ * of each producer come in order and unaltered
+ */
+UTK_TEST_DEF(test_shm_processes)
+{
+    struct utk_shm_ring ring,
+	child;
+    unsigned char rec[256],
+	out[256];
+    uint32_t next[TEST_SHM_NB_PRODUCERS],
+	seq,
+	producer;
+    pid_t pids[TEST_SHM_NB_PRODUCERS];
+    unsigned int i;
+    size_t len;
+    ssize_t ret;
+    int status;
+
+    UTK_TEST_ASSERT(utk_shm_ring_create(&ring, NULL, 4096) == 0);
+
+    for(i = 0; i < TEST_SHM_NB_PRODUCERS; ++i)
+    {
+	pids[i] = fork();
+	UTK_TEST_ASSERT(pids[i] >= 0);
+	if(pids[i] == 0)
+	{
+	    if(utk_shm_ring_open_fd(&child, ring.fd) != 0)
+	    {
+		_exit(1);
+	    }
+
+	    for(seq = 0; seq < TEST_SHM_NB_RECORDS; ++seq)
+	    {
+		len = 8 + (seq * 7 + i) % (sizeof(rec) - 8);
+		memcpy(rec, &i, 4);
+		memcpy(rec + 4, &seq, 4);
+		test_shm_fill(rec + 8, len - 8, seq);
+		if(utk_shm_ring_push(&child, rec, len, 10000) != 0)
+		{
+		    _exit(1);
+		}
+	    }
+
+	    utk_shm_ring_close(&child);
+	    _exit(0);
+	}
+	next[i] = 0;
+    }
+
+    for(i = 0; i < TEST_SHM_NB_PRODUCERS * TEST_SHM_NB_RECORDS; ++i)
+    {
+	ret = utk_shm_ring_pop(&ring, out, sizeof(out), 10000);
+	UTK_TEST_ASSERT(ret >= 8);
+
+	memcpy(&producer, out, 4);
+	memcpy(&seq, out + 4, 4);
+	UTK_TEST_ASSERT(producer < TEST_SHM_NB_PRODUCERS);
+	UTK_TEST_ASSERT(seq == next[producer]);
+	next[producer]++;
+
+	len = 8 + (seq * 7 + producer) % (sizeof(rec) - 8);
+	UTK_TEST_ASSERT((size_t)ret == len);
+	test_shm_fill(rec, len - 8, seq);
+	UTK_TEST_ASSERT(memcmp(out + 8, rec, len - 8) == 0);
+    }
+
+    for(i = 0; i < TEST_SHM_NB_PRODUCERS; ++i)
+    {
+	UTK_TEST_ASSERT(waitpid(pids[i], &status, 0) == pids[i]);
+	UTK_TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_shm_ring_pop(&ring, out, sizeof(out), 0) == -1);
+    UTK_TEST_ASSERT(errno == EAGAIN);
+
+    utk_shm_ring_close(&ring);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/shm");
+
+    UTK_TEST_RUN(test_shm_push_pop);
+
+    UTK_TEST_RUN(test_shm_named);
+
+    UTK_TEST_RUN(test_shm_processes);
+
+    return UTK_TEST_MODULE_RETURN;
+}
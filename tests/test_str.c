@@ -24,6 +24,9 @@
 #include <utk/list.h>
 #include <utk/unit.h>
 
+#include <string.h>
+#include <strings.h>
+
 UTK_TEST_DEF(test_str_copy)
 {
     char buf1[1];
@@ -609,6 +612,57 @@ UTK_TEST_DEF(test_str_list_add_remove)
     utk_str_list_cleanup(&str_list);
 }
 
+UTK_TEST_DEF(test_str_list_sort)
+{
+    struct utk_str_list str_list;
+    struct utk_str_list_item *str_list_item;
+    const char *items[] = {
+	"pear",
+	"Apple",
+	"fig",
+	"apple",
+	"banana",
+    };
+    const char *sorted[] = {
+	"Apple",
+	"apple",
+	"banana",
+	"fig",
+	"pear",
+    };
+    const char *array[5];
+    unsigned int i;
+
+    utk_str_list_init(&str_list);
+    utk_str_list_sort(&str_list, NULL);
+    UTK_TEST_ASSERT(utk_list_empty(&str_list.head));
+
+    for(i = 0; i < UTK_ARRAY_SIZE(items); ++i)
+    {
+	UTK_TEST_ASSERT(utk_str_list_add(&str_list, items[i]) == 0);
+    }
+
+    /* stable: Apple stays before apple */
+    utk_str_list_sort(&str_list, strcasecmp);
+    UTK_TEST_ASSERT(utk_str_list_toarray(&str_list, array, 5) == 5);
+    for(i = 0; i < UTK_ARRAY_SIZE(sorted); ++i)
+    {
+	UTK_TEST_ASSERT(strcmp(array[i], sorted[i]) == 0);
+    }
+
+    utk_str_list_sort(&str_list, NULL);
+    UTK_TEST_ASSERT(utk_str_list_toarray(&str_list, array, 5) == 5);
+    UTK_TEST_ASSERT(strcmp(array[0], "Apple") == 0);
+    UTK_TEST_ASSERT(strcmp(array[4], "pear") == 0);
+
+    /* prev links */
+    str_list_item = utk_list_entry(str_list.head.prev,
+				   struct utk_str_list_item, node);
+    UTK_TEST_ASSERT(strcmp(str_list_item->value, "pear") == 0);
+
+    utk_str_list_cleanup(&str_list);
+}
+
 int main(void)
 {
     UTK_TEST_MODULE_INIT("utk/str");
@@ -638,6 +692,7 @@ int main(void)
 
     UTK_TEST_RUN(test_str_list_toarray);
     UTK_TEST_RUN(test_str_list_add_remove);
+    UTK_TEST_RUN(test_str_list_sort);
 
     return UTK_TEST_MODULE_RETURN;
 }
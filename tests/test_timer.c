@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2011-2016 Anthony Viallard
+ *
+ *    This file is part of Utk.
+ *
+ * Utk is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Utk is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Utk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ENABLE_UTK_VT102_COLOR 1
+#include <utk/timer.h>
+#include <utk/unit.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+struct test_timer_item {
+    struct utk_timer timer;
+    uint64_t deadline;
+    uint64_t fired;
+    int restart;
+};
+
+struct test_timer_ctx {
+    struct utk_timer_wheel *wheel;
+    uint64_t now;
+    /* time of the previous advance */
+    uint64_t prev;
+    size_t calls;
+    size_t fired;
+    /* expirations before their deadline or which were due at prev */
+    size_t early;
+    size_t late;
+};
+
+static int test_timer_cmp(const void *a, const void *b)
+{
+    const struct test_timer_item *ia = *(struct test_timer_item * const *)a;
+    const struct test_timer_item *ib = *(struct test_timer_item * const *)b;
+
+    return (ia->deadline > ib->deadline) - (ia->deadline < ib->deadline);
+}
+
+static void test_timer_cb(void *opaque, struct utk_list_head *expired)
+{
+    struct test_timer_ctx *ctx = opaque;
+    struct test_timer_item *item = NULL;
+    struct utk_timer *timer = NULL;
+    struct utk_timer *n = NULL;
+
+    ctx->calls++;
+    utk_list_for_each_entry_safe(timer, n, expired, node)
+    {
+	item = utk_timer_entry(timer, struct test_timer_item, timer);
+	item->fired = ctx->now;
+	ctx->fired++;
+	if(ctx->now < item->deadline)
+	{
+	    ctx->early++;
+	}
+	if(ctx->prev >= item->deadline + ctx->wheel->tick_size)
+	{
+	    ctx->late++;
+	}
+	if(item->restart > 0)
+	{
+	    item->restart--;
+	    item->deadline = ctx->now + 100;
+	    utk_timer_wheel_start(ctx->wheel, timer, 100);
+	}
+    }
+}
+
+UTK_TEST_DEF(test_timer_wheel_expire)
+{
+    struct utk_timer_wheel wheel;
+    struct test_timer_ctx ctx = {&wheel, 1000, 0, 0, 0, 0, 0};
+    struct test_timer_item *items = NULL;
+    struct test_timer_item **sorted = NULL;
+    uint64_t seed = 88172645463325252ULL;
+    uint64_t timeout;
+    size_t nb = 20000,
+	overdue = 0,
+	next = 0,
+	i;
+
+    errno = 0;
+    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 0, 0, test_timer_cb,
+					 &ctx) == -1);
+    UTK_TEST_ASSERT(errno == EINVAL);
+
+    /* 10 time units per tick */
+    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 10, ctx.now, test_timer_cb,
+					 &ctx) == 0);
+
+    items = calloc(nb, sizeof(*items));
+    UTK_TEST_ASSERT(items != NULL);
+
+    /* timeouts on every level */
+    for(i = 0; i < nb; ++i)
+    {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	timeout = seed % ((uint64_t)1 << (4 + i % 20));
+	utk_timer_init(&items[i].timer);
+	items[i].deadline = ctx.now + timeout;
+	utk_timer_wheel_start(&wheel, &items[i].timer, timeout);
+	UTK_TEST_ASSERT(utk_timer_pending(&items[i].timer));
+    }
+    UTK_TEST_ASSERT(utk_timer_wheel_count(&wheel) == nb);
+
+    /* by deadline: the timers due at each step */
+    sorted = malloc(nb * sizeof(*sorted));
+    UTK_TEST_ASSERT(sorted != NULL);
+    for(i = 0; i < nb; ++i)
+    {
+	sorted[i] = &items[i];
+    }
+    qsort(sorted, nb, sizeof(*sorted), test_timer_cmp);
+
+    /* irregular steps, small and big (ticks are skipped) */
+    while(utk_timer_wheel_count(&wheel) > 0 && ctx.now < 20000000)
+    {
+	ctx.prev = ctx.now;
+	ctx.now += ctx.now % 3 != 0 ? 1 + ctx.now % 7 : 1 + ctx.now % 4099;
+	utk_timer_wheel_advance(&wheel, ctx.now);
+
+	/* no timer due a tick ago is still pending */
+	while(next < nb && sorted[next]->deadline + wheel.tick_size <= ctx.now)
+	{
+	    overdue += utk_timer_pending(&sorted[next]->timer) != 0;
+	    next++;
+	}
+    }
+    UTK_TEST_ASSERT(overdue == 0);
+
+    UTK_TEST_ASSERT(utk_timer_wheel_count(&wheel) == 0);
+    UTK_TEST_ASSERT(ctx.fired == nb);
+    UTK_TEST_ASSERT(ctx.early == 0);
+    UTK_TEST_ASSERT(ctx.late == 0);
+    for(i = 0; i < nb; ++i)
+    {
+	UTK_TEST_ASSERT(!utk_timer_pending(&items[i].timer));
+    }
+
+    free(sorted);
+    free(items);
+}
+
+UTK_TEST_DEF(test_timer_wheel_cancel_restart)
+{
+    struct utk_timer_wheel wheel;
+    struct test_timer_ctx ctx = {&wheel, 0, 0, 0, 0, 0, 0};
+    struct test_timer_item items[3];
+    size_t i;
+
+    memset(items, 0, sizeof(items));
+    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 1, 0, test_timer_cb,
+					 &ctx) == 0);
+    for(i = 0; i < 3; ++i)
+    {
+	utk_timer_init(&items[i].timer);
+	items[i].deadline = 50;
+	utk_timer_wheel_start(&wheel, &items[i].timer, 50);
+    }
+
+    /* cancel, restart later, periodic */
+    utk_timer_wheel_cancel(&wheel, &items[0].timer);
+    utk_timer_wheel_cancel(&wheel, &items[0].timer);
+    UTK_TEST_ASSERT(!utk_timer_pending(&items[0].timer));
+    items[1].deadline = 500;
+    utk_timer_wheel_start(&wheel, &items[1].timer, 500);
+    items[2].restart = 2;
+    UTK_TEST_ASSERT(utk_timer_wheel_count(&wheel) == 2);
+
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 49) == 0);
+    ctx.now = 50;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 50) == 1);
+    UTK_TEST_ASSERT(items[2].fired == 50);
+    UTK_TEST_ASSERT(utk_timer_pending(&items[2].timer));
+
+    /* all at once: one callback */
+    ctx.calls = 0;
+    ctx.now = 1000;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 1000) == 2);
+    UTK_TEST_ASSERT(ctx.calls == 1);
+    UTK_TEST_ASSERT(items[1].fired == 1000);
+    UTK_TEST_ASSERT(items[0].fired == 0);
+    UTK_TEST_ASSERT(utk_timer_wheel_count(&wheel) == 1);
+
+    ctx.now = 1100;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 1100) == 1);
+    UTK_TEST_ASSERT(utk_timer_wheel_count(&wheel) == 0);
+
+    /* time going backwards is ignored */
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 10) == 0);
+
+    /* beyond the levels */
+    utk_timer_wheel_start(&wheel, &items[0].timer, (uint64_t)1 << 40);
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, (uint64_t)1 << 39) == 0);
+    ctx.now = ((uint64_t)1 << 40) + 1100;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, ctx.now - 1) == 0);
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, ctx.now) == 1);
+}
+
+UTK_TEST_DEF(test_timer_wheel_turn)
+{
+    struct utk_timer_wheel wheel;
+    struct test_timer_ctx ctx = {&wheel, 255, 0, 0, 0, 0, 0};
+    struct test_timer_item item;
+    uint64_t start,
+	timeout;
+
+    memset(&item, 0, sizeof(item));
+
+    /* the next tick is the first of a turn of the first level */
+    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 1, ctx.now, test_timer_cb,
+					 &ctx) == 0);
+    utk_timer_init(&item.timer);
+    utk_timer_wheel_start(&wheel, &item.timer, 5);
+    ctx.now = 300;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, 300) == 1);
+    UTK_TEST_ASSERT(item.fired == 300);
+
+    /* started around turns, expired by steps of 7 ticks */
+    for(start = 250; start < 262; ++start)
+    {
+	for(timeout = 1; timeout < 600; timeout += 13)
+	{
+	    memset(&ctx, 0, sizeof(ctx));
+	    ctx.wheel = &wheel;
+	    ctx.now = start;
+	    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 1, start,
+						 test_timer_cb, &ctx) == 0);
+	    item.deadline = start + timeout;
+	    utk_timer_wheel_start(&wheel, &item.timer, timeout);
+	    while(utk_timer_wheel_count(&wheel) > 0)
+	    {
+		ctx.prev = ctx.now;
+		ctx.now += 7;
+		utk_timer_wheel_advance(&wheel, ctx.now);
+	    }
+	    UTK_TEST_ASSERT(item.fired >= item.deadline);
+	    UTK_TEST_ASSERT(item.fired < item.deadline + 7);
+	    UTK_TEST_ASSERT(ctx.early == 0 && ctx.late == 0);
+	}
+    }
+}
+
+UTK_TEST_DEF(test_timer_wheel_turn_levels)
+{
+    const uint64_t turns[] = {
+	(uint64_t)1 << 14, (uint64_t)2 << 14, (uint64_t)1 << 20,
+	(uint64_t)3 << 20,
+    };
+    const uint64_t offsets[] = {0, 10, 300, 5000};
+    struct utk_timer_wheel wheel;
+    struct test_timer_ctx ctx;
+    struct test_timer_item items[2];
+    uint64_t turn;
+    size_t t,
+	o,
+	i,
+	overdue;
+
+    for(t = 0; t < sizeof(turns) / sizeof(turns[0]); ++t)
+    {
+	turn = turns[t];
+	for(o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o)
+	{
+	    memset(&ctx, 0, sizeof(ctx));
+	    memset(items, 0, sizeof(items));
+	    ctx.wheel = &wheel;
+	    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 1, 0, test_timer_cb,
+						 &ctx) == 0);
+
+	    /* cascaded from a higher level at the turn */
+	    utk_timer_init(&items[0].timer);
+	    items[0].deadline = turn + offsets[o];
+	    utk_timer_wheel_start(&wheel, &items[0].timer, items[0].deadline);
+
+	    /* the wheel sits on the turn: its cascade isn't done yet */
+	    ctx.now = turn - 1;
+	    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, ctx.now) == 0);
+
+	    /* due later, in a lower level than the first timer was */
+	    utk_timer_init(&items[1].timer);
+	    items[1].deadline = turn + (turn >> 6) * 5 + 1;
+	    utk_timer_wheel_start(&wheel, &items[1].timer,
+				  items[1].deadline - ctx.now);
+
+	    overdue = 0;
+	    while(utk_timer_wheel_count(&wheel) > 0)
+	    {
+		ctx.prev = ctx.now;
+		ctx.now += 7 + (turn >> 12);
+		utk_timer_wheel_advance(&wheel, ctx.now);
+		for(i = 0; i < 2; ++i)
+		{
+		    overdue += (utk_timer_pending(&items[i].timer)
+				&& items[i].deadline + 1 <= ctx.now);
+		}
+	    }
+	    UTK_TEST_ASSERT(overdue == 0);
+	    UTK_TEST_ASSERT(ctx.fired == 2);
+	    UTK_TEST_ASSERT(ctx.early == 0 && ctx.late == 0);
+	}
+    }
+
+    /* the first timer is in the second level */
+    memset(&ctx, 0, sizeof(ctx));
+    memset(items, 0, sizeof(items));
+    ctx.wheel = &wheel;
+    UTK_TEST_ASSERT(utk_timer_wheel_init(&wheel, 1, 0, test_timer_cb,
+					 &ctx) == 0);
+    utk_timer_init(&items[0].timer);
+    items[0].deadline = 16394;
+    utk_timer_wheel_start(&wheel, &items[0].timer, 16394);
+    ctx.now = 1300;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, ctx.now) == 0);
+    utk_timer_init(&items[1].timer);
+    items[1].deadline = 17665;
+    utk_timer_wheel_start(&wheel, &items[1].timer, 17665 - 1300);
+    ctx.now = 16383;
+    UTK_TEST_ASSERT(utk_timer_wheel_advance(&wheel, ctx.now) == 0);
+    while(utk_timer_wheel_count(&wheel) > 0)
+    {
+	ctx.prev = ctx.now;
+	ctx.now++;
+	utk_timer_wheel_advance(&wheel, ctx.now);
+    }
+    UTK_TEST_ASSERT(items[0].fired == 16394);
+    UTK_TEST_ASSERT(items[1].fired == 17665);
+}
+
+int main(void)
+{
+    UTK_TEST_MODULE_INIT("utk/timer");
+
+    UTK_TEST_RUN(test_timer_wheel_expire);
+
+    UTK_TEST_RUN(test_timer_wheel_cancel_restart);
+
+    UTK_TEST_RUN(test_timer_wheel_turn);
+
+    UTK_TEST_RUN(test_timer_wheel_turn_levels);
+
+    return UTK_TEST_MODULE_RETURN;
+}